@@ -34,6 +34,7 @@ ndBrain::ndBrain()
 ndBrain::ndBrain(const ndBrain& src)
 	:ndArray<ndBrainLayer*>()
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_neuralNetwork);
 	const ndArray<ndBrainLayer*>& srcLayers = src;
 	for (ndInt32 i = 0; i < srcLayers.GetCount(); ++i)
 	{
@@ -68,7 +68,7 @@ void ndBrainMatrix::Init(ndInt32 rows, ndInt32 columns)
 	size_t strideInBytes = size_t((ndInt64(columns * sizeof(ndBrainFloat)) + D_BRAIN_MATRIX_ALIGNMENT - 1) & -D_BRAIN_MATRIX_ALIGNMENT);
 	size_t size = size_t(rows * sizeof(ndBrainMemVector) + 256);
 	size += strideInBytes * rows;
-	m_memory = (ndBrainFloat*)ndMemory::Malloc(size_t(size));
+	m_memory = (ndBrainFloat*)ndMemory::Malloc(size_t(size), ndMemory::m_neuralNetwork);
 	m_array = (ndBrainMemVector*)m_memory;
 
 	size_t bytes = size_t((rows * sizeof(ndBrainMemVector) + D_BRAIN_MATRIX_ALIGNMENT - 1) & -D_BRAIN_MATRIX_ALIGNMENT);
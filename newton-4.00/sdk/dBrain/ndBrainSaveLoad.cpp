@@ -87,6 +87,7 @@ ndBrain* ndBrainLoad::Load(const char* const pathName)
 
 ndBrain* ndBrainLoad::Load() const
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_neuralNetwork);
 	char buffer[1024];
 	ReadString(buffer);
 	ReadString(buffer);
@@ -85,6 +85,7 @@ ndBrainTrainer::ndBrainTrainer(ndBrain* const brain)
 	,m_prefixScan()
 	,m_brain(brain)
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_neuralNetwork);
 	for (ndInt32 i = 0; i < m_brain->GetCount(); ++i)
 	{
 		m_data.PushBack(new ndLayerData((*m_brain)[i]));
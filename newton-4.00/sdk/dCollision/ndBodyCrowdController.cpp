@@ -0,0 +1,501 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndSort.h"
+#include "ndScene.h"
+#include "ndShapeCapsule.h"
+#include "ndBodyKinematic.h"
+#include "ndConvexCastNotify.h"
+#include "ndBodiesInAabbNotify.h"
+#include "ndBodyCrowdController.h"
+
+#define D_CROWD_BATCH_SIZE			32
+#define D_CROWD_HASH_BITS			16
+#define D_CROWD_HASH_MASK			((1 << D_CROWD_HASH_BITS) - 1)
+#define D_CROWD_SLIDE_ITERATIONS	3
+#define D_CROWD_SKIN				ndFloat32(1.0e-2f)
+#define D_CROWD_FLOOR_SLOPE			ndFloat32(0.7f)
+
+// static bodies overlapping a batch of agents
+class ndBodyCrowdController::ndStaticBodies : public ndBodiesInAabbNotify
+{
+	public:
+	ndStaticBodies()
+		:ndBodiesInAabbNotify()
+		,m_boxMin()
+		,m_boxMax()
+		,m_caster()
+	{
+	}
+
+	virtual void Reset()
+	{
+		ndBodiesInAabbNotify::Reset();
+		m_boxMin.SetCount(0);
+		m_boxMax.SetCount(0);
+	}
+
+	virtual void OnOverlap(const ndBody* const body)
+	{
+		ndBodyKinematic* const kinBody = ((ndBody*)body)->GetAsBodyKinematic();
+		if (kinBody && (kinBody->GetInvMass() == ndFloat32(0.0f)) && !kinBody->GetAsBodyTriggerVolume() && !kinBody->GetAsBodyPlayerCapsule())
+		{
+			const ndShapeInstance& shape = kinBody->GetCollisionShape();
+			if (!((ndShape*)shape.GetShape())->GetAsShapeNull())
+			{
+				ndVector boxMin;
+				ndVector boxMax;
+				shape.CalculateAabb(shape.GetGlobalMatrix(), boxMin, boxMax);
+				m_bodyArray.PushBack(body);
+				m_boxMin.PushBack(boxMin);
+				m_boxMax.PushBack(boxMax);
+			}
+		}
+	}
+
+	ndArray<ndVector> m_boxMin;
+	ndArray<ndVector> m_boxMax;
+	ndConvexCastNotify m_caster;
+};
+
+// interleave the bits of the x and z cells
+static inline ndUnsigned32 ndCrowdCellKey(ndInt32 x, ndInt32 z)
+{
+	ndUnsigned32 key = 0;
+	for (ndInt32 i = 0; i < D_CROWD_HASH_BITS; ++i)
+	{
+		key |= ((ndUnsigned32(x) >> i) & 1) << (2 * i);
+		key |= ((ndUnsigned32(z) >> i) & 1) << (2 * i + 1);
+	}
+	return key;
+}
+
+ndBodyCrowdController::ndBodyCrowdController(ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight)
+	:ndBodyParticleSet()
+	,m_agentShape(new ndShapeCapsule(radius, radius, ndMax(height - ndFloat32(2.0f) * radius, ndFloat32(0.01f))))
+	,m_desiredVeloc(1024)
+	,m_separation(1024)
+	,m_onFloor(1024)
+	,m_hashEntries(1024)
+	,m_hashScratch(1024)
+	,m_scene(nullptr)
+	,m_height(ndMax(height, ndFloat32(2.0f) * radius))
+	,m_stepHeight(stepHeight)
+	,m_cellOrigin_x(0)
+	,m_cellOrigin_z(0)
+{
+	m_radius = radius;
+	m_updateInBackground = false;
+
+	// the capsule axis is along y with the feet at the origin
+	ndMatrix shapeMatrix(ndGetIdentityMatrix());
+	shapeMatrix.m_front = ndVector(ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(0.0f));
+	shapeMatrix.m_up = ndVector(ndFloat32(-1.0f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f));
+	shapeMatrix.m_right = ndVector(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f));
+	shapeMatrix.m_posit = ndVector(ndFloat32(0.0f), m_height * ndFloat32(0.5f), ndFloat32(0.0f), ndFloat32(1.0f));
+	m_agentShape.SetLocalMatrix(shapeMatrix);
+}
+
+ndBodyCrowdController::~ndBodyCrowdController()
+{
+}
+
+ndInt32 ndBodyCrowdController::AddAgent(const ndVector& position)
+{
+	const ndInt32 index = ndInt32(m_posit.GetCount());
+	m_posit.PushBack(ndVector(position.m_x, position.m_y, position.m_z, ndFloat32(1.0f)));
+	m_veloc.PushBack(ndVector::m_zero);
+	m_desiredVeloc.PushBack(ndVector::m_zero);
+	m_onFloor.PushBack(0);
+	return index;
+}
+
+void ndBodyCrowdController::RemoveAgent(ndInt32 agent)
+{
+	const ndInt32 last = ndInt32(m_posit.GetCount()) - 1;
+	ndAssert((agent >= 0) && (agent <= last));
+	m_posit[agent] = m_posit[last];
+	m_veloc[agent] = m_veloc[last];
+	m_desiredVeloc[agent] = m_desiredVeloc[last];
+	m_onFloor[agent] = m_onFloor[last];
+	m_posit.SetCount(last);
+	m_veloc.SetCount(last);
+	m_desiredVeloc.SetCount(last);
+	m_onFloor.SetCount(last);
+}
+
+void ndBodyCrowdController::SortAgents(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	class ndKey_0
+	{
+		public:
+		ndKey_0(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32(entry.m_key & 0xff);
+		}
+	};
+
+	class ndKey_1
+	{
+		public:
+		ndKey_1(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32((entry.m_key >> 8) & 0xff);
+		}
+	};
+
+	class ndKey_2
+	{
+		public:
+		ndKey_2(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32((entry.m_key >> 16) & 0xff);
+		}
+	};
+
+	class ndKey_3
+	{
+		public:
+		ndKey_3(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32(entry.m_key >> 24);
+		}
+	};
+
+	ndVector boxP0[D_MAX_THREADS_COUNT];
+	ndVector boxP1[D_MAX_THREADS_COUNT];
+	auto CalculateAabb = ndMakeObject::ndFunction([this, &boxP0, &boxP1](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateAabb);
+		ndVector p0(ndFloat32(1.0e10f));
+		ndVector p1(ndFloat32(-1.0e10f));
+		const ndStartEnd startEnd(ndInt32(m_posit.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			p0 = p0.GetMin(m_posit[i]);
+			p1 = p1.GetMax(m_posit[i]);
+		}
+		boxP0[threadIndex] = p0;
+		boxP1[threadIndex] = p1;
+	});
+	threadPool->ParallelExecute(CalculateAabb);
+
+	ndVector p0(boxP0[0]);
+	ndVector p1(boxP1[0]);
+	for (ndInt32 i = 1; i < threadPool->GetThreadCount(); ++i)
+	{
+		p0 = p0.GetMin(boxP0[i]);
+		p1 = p1.GetMax(boxP1[i]);
+	}
+	const ndVector radius(m_radius, ndFloat32(0.0f), m_radius, ndFloat32(0.0f));
+	const ndVector height(ndFloat32(0.0f), m_height, ndFloat32(0.0f), ndFloat32(0.0f));
+	m_box0 = (p0 - radius) & ndVector::m_triplexMask;
+	m_box1 = (p1 + radius + height) & ndVector::m_triplexMask;
+
+	// agents closer than a diameter are in neighbor cells
+	const ndFloat32 invCellSize = ndFloat32(0.5f) / m_radius;
+	m_cellOrigin_x = ndInt32(ndFloor(p0.m_x * invCellSize)) - 1;
+	m_cellOrigin_z = ndInt32(ndFloor(p0.m_z * invCellSize)) - 1;
+
+	m_hashEntries.SetCount(m_posit.GetCount());
+	auto CalculateKeys = ndMakeObject::ndFunction([this, invCellSize](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateKeys);
+		const ndStartEnd startEnd(ndInt32(m_posit.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector& posit = m_posit[i];
+			const ndInt32 x = ndClamp(ndInt32(ndFloor(posit.m_x * invCellSize)) - m_cellOrigin_x, 0, D_CROWD_HASH_MASK);
+			const ndInt32 z = ndClamp(ndInt32(ndFloor(posit.m_z * invCellSize)) - m_cellOrigin_z, 0, D_CROWD_HASH_MASK);
+			m_hashEntries[i].m_key = ndCrowdCellKey(x, z);
+			m_hashEntries[i].m_particle = i;
+		}
+	});
+	threadPool->ParallelExecute(CalculateKeys);
+
+	ndCountingSort<ndCouplingEntry, ndKey_0, 8>(*threadPool, m_hashEntries, m_hashScratch, nullptr, nullptr);
+	ndCountingSort<ndCouplingEntry, ndKey_1, 8>(*threadPool, m_hashEntries, m_hashScratch, nullptr, nullptr);
+	ndCountingSort<ndCouplingEntry, ndKey_2, 8>(*threadPool, m_hashEntries, m_hashScratch, nullptr, nullptr);
+	ndCountingSort<ndCouplingEntry, ndKey_3, 8>(*threadPool, m_hashEntries, m_hashScratch, nullptr, nullptr);
+}
+
+void ndBodyCrowdController::SeparateAgents(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	m_separation.SetCount(m_posit.GetCount());
+	auto CalculateSeparation = ndMakeObject::ndFunction([this](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateSeparation);
+		const ndInt32 count = ndInt32(m_hashEntries.GetCount());
+		const ndFloat32 diameter = m_radius * ndFloat32(2.0f);
+		const ndFloat32 invCellSize = ndFloat32(1.0f) / diameter;
+		const ndCouplingEntry* const entries = &m_hashEntries[0];
+
+		const ndStartEnd startEnd(count, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndInt32 agent = entries[i].m_particle;
+			const ndVector posit(m_posit[agent]);
+			const ndInt32 x0 = ndInt32(ndFloor(posit.m_x * invCellSize)) - m_cellOrigin_x;
+			const ndInt32 z0 = ndInt32(ndFloor(posit.m_z * invCellSize)) - m_cellOrigin_z;
+
+			ndVector separation(ndVector::m_zero);
+			for (ndInt32 z = z0 - 1; z <= z0 + 1; ++z)
+			{
+				for (ndInt32 x = x0 - 1; x <= x0 + 1; ++x)
+				{
+					if ((x < 0) || (z < 0) || (x > D_CROWD_HASH_MASK) || (z > D_CROWD_HASH_MASK))
+					{
+						continue;
+					}
+
+					// binary search the first agent of the cell
+					const ndUnsigned32 key = ndCrowdCellKey(x, z);
+					ndInt32 start = 0;
+					ndInt32 end = count;
+					while (start < end)
+					{
+						const ndInt32 mid = (start + end) >> 1;
+						if (entries[mid].m_key < key)
+						{
+							start = mid + 1;
+						}
+						else
+						{
+							end = mid;
+						}
+					}
+
+					for (ndInt32 j = start; (j < count) && (entries[j].m_key == key); ++j)
+					{
+						const ndInt32 other = entries[j].m_particle;
+						if (other == agent)
+						{
+							continue;
+						}
+						const ndVector diff(posit - m_posit[other]);
+						if (ndAbs(diff.m_y) > m_height)
+						{
+							continue;
+						}
+						const ndFloat32 dist2 = diff.m_x * diff.m_x + diff.m_z * diff.m_z;
+						if (dist2 < diameter * diameter)
+						{
+							// each agent of the pair moves half the overlap
+							const ndFloat32 dist = ndSqrt(dist2);
+							const ndVector dir((dist > ndFloat32(1.0e-4f)) ?
+								ndVector(diff.m_x / dist, ndFloat32(0.0f), diff.m_z / dist, ndFloat32(0.0f)) :
+								ndVector((agent < other) ? ndFloat32(1.0f) : ndFloat32(-1.0f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f)));
+							separation += dir.Scale((diameter - dist) * ndFloat32(0.5f));
+						}
+					}
+				}
+			}
+
+			const ndFloat32 mag2 = separation.DotProduct(separation).GetScalar();
+			if (mag2 > m_radius * m_radius)
+			{
+				separation = separation.Scale(m_radius / ndSqrt(mag2));
+			}
+			m_separation[agent] = separation;
+		}
+	});
+	threadPool->ParallelExecute(CalculateSeparation);
+}
+
+ndVector ndBodyCrowdController::Sweep(const ndVector& origin, const ndVector& step, ndStaticBodies& bodies, ndVector& normal, ndFloat32& param) const
+{
+	param = ndFloat32(1.0f);
+	normal = ndVector::m_zero;
+	const ndFloat32 dist2 = step.DotProduct(step).GetScalar();
+	if (dist2 < ndFloat32(1.0e-12f))
+	{
+		return origin;
+	}
+
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = origin;
+	matrix.m_posit.m_w = ndFloat32(1.0f);
+	const ndVector target(matrix.m_posit + step);
+
+	const ndVector radius(m_radius, ndFloat32(0.0f), m_radius, ndFloat32(0.0f));
+	const ndVector height(ndFloat32(0.0f), m_height, ndFloat32(0.0f), ndFloat32(0.0f));
+	const ndVector boxMin(matrix.m_posit.GetMin(target) - radius);
+	const ndVector boxMax(matrix.m_posit.GetMax(target) + radius + height);
+
+	ndConvexCastNotify& caster = bodies.m_caster;
+	caster.m_cachedScene = (ndScene*)m_scene;
+	for (ndInt32 i = 0; i < ndInt32(bodies.m_bodyArray.GetCount()); ++i)
+	{
+		const ndVector& box0 = bodies.m_boxMin[i];
+		const ndVector& box1 = bodies.m_boxMax[i];
+		if (ndOverlapTest(boxMin, boxMax, box0, box1))
+		{
+			ndBodyKinematic* const body = ((ndBody*)bodies.m_bodyArray[i])->GetAsBodyKinematic();
+			if (caster.CastShape(m_agentShape, matrix, target, body) && (caster.m_param < param))
+			{
+				param = caster.m_param;
+				normal = caster.m_normal & ndVector::m_triplexMask;
+			}
+		}
+	}
+
+	if (param < ndFloat32(1.0f))
+	{
+		// stop a skin short of the contact, with the normal against the motion
+		if (normal.DotProduct(step).GetScalar() > ndFloat32(0.0f))
+		{
+			normal = normal * ndVector::m_negOne;
+		}
+		const ndFloat32 t = ndMax(param - D_CROWD_SKIN / ndSqrt(dist2), ndFloat32(0.0f));
+		return origin + step.Scale(t);
+	}
+	return origin + step;
+}
+
+void ndBodyCrowdController::MoveAgent(ndInt32 agent, ndStaticBodies& bodies)
+{
+	const ndFloat32 timestep = m_timestep;
+	const ndVector up(ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(0.0f));
+	const ndVector desired(m_desiredVeloc[agent]);
+	const ndVector origin(m_posit[agent]);
+	const bool wasOnFloor = m_onFloor[agent] ? true : false;
+
+	const ndFloat32 speed_y = wasOnFloor ? ndMax(desired.m_y, ndFloat32(0.0f)) : m_veloc[agent].m_y + m_gravity.m_y * timestep;
+	const ndFloat32 climb = speed_y * timestep;
+
+	ndFloat32 param;
+	ndVector normal;
+
+	// go up by the step height, so that the slide goes over small steps
+	ndVector posit(Sweep(origin, up.Scale(m_stepHeight + ndMax(climb, ndFloat32(0.0f))), bodies, normal, param));
+	const ndFloat32 lifted = posit.m_y - origin.m_y;
+
+	// move and slide along the walls
+	ndVector step(ndVector(desired.m_x, ndFloat32(0.0f), desired.m_z, ndFloat32(0.0f)).Scale(timestep) + m_separation[agent]);
+	for (ndInt32 i = 0; i < D_CROWD_SLIDE_ITERATIONS; ++i)
+	{
+		if (step.DotProduct(step).GetScalar() < ndFloat32(1.0e-10f))
+		{
+			break;
+		}
+		posit = Sweep(posit, step, bodies, normal, param);
+		if (param >= ndFloat32(1.0f))
+		{
+			break;
+		}
+		step = step.Scale(ndFloat32(1.0f) - param);
+		step -= normal.Scale(normal.DotProduct(step).GetScalar());
+		step.m_y = ndFloat32(0.0f);
+	}
+
+	// come down, agents on the floor snap down steps and slopes
+	const ndFloat32 fall = ndMin(lifted, m_stepHeight) + ndMax(-climb, ndFloat32(0.0f)) + D_CROWD_SKIN * ndFloat32(2.0f);
+	const ndFloat32 snap = (wasOnFloor && (climb <= ndFloat32(0.0f))) ? m_stepHeight : ndFloat32(0.0f);
+	const ndVector floor(Sweep(posit, up.Scale(-(fall + snap)), bodies, normal, param));
+	bool onFloor = false;
+	if (param < ndFloat32(1.0f))
+	{
+		posit = floor;
+		onFloor = normal.m_y > D_CROWD_FLOOR_SLOPE;
+	}
+	else
+	{
+		posit -= up.Scale(fall);
+	}
+
+	ndVector veloc(((posit - origin) & ndVector::m_triplexMask).Scale(ndFloat32(1.0f) / timestep));
+	if (onFloor)
+	{
+		veloc.m_y = ndFloat32(0.0f);
+	}
+	posit.m_w = origin.m_w;
+	m_posit[agent] = posit;
+	m_veloc[agent] = veloc;
+	m_onFloor[agent] = onFloor ? 1 : 0;
+}
+
+void ndBodyCrowdController::MoveAgents(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	ndAtomic<ndInt32> iterator(0);
+	auto MoveAgentBatches = ndMakeObject::ndFunction([this, &iterator](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(MoveAgentBatches);
+		ndStaticBodies bodies;
+		const ndInt32 count = ndInt32(m_hashEntries.GetCount());
+		const ndFloat32 timestep = m_timestep;
+		const ndVector radius(m_radius + m_stepHeight + D_CROWD_SKIN * ndFloat32(2.0f));
+		const ndVector height(ndFloat32(0.0f), m_height, ndFloat32(0.0f), ndFloat32(0.0f));
+
+		// agents of a batch are neighbors in the hash order, they share one scene query
+		for (ndInt32 i = iterator.fetch_add(D_CROWD_BATCH_SIZE); i < count; i = iterator.fetch_add(D_CROWD_BATCH_SIZE))
+		{
+			const ndInt32 batchEnd = ndMin(i + D_CROWD_BATCH_SIZE, count);
+			ndVector boxMin(ndFloat32(1.0e10f));
+			ndVector boxMax(ndFloat32(-1.0e10f));
+			for (ndInt32 j = i; j < batchEnd; ++j)
+			{
+				const ndInt32 agent = m_hashEntries[j].m_particle;
+				const ndVector& posit = m_posit[agent];
+				const ndVector veloc(m_veloc[agent].Abs().GetMax(m_desiredVeloc[agent].Abs()) + m_gravity.Abs().Scale(timestep));
+				const ndVector reach(veloc.Scale(timestep) + m_separation[agent].Abs() + radius);
+				boxMin = boxMin.GetMin(posit - reach);
+				boxMax = boxMax.GetMax(posit + reach + height);
+			}
+
+			bodies.Reset();
+			m_scene->BodiesInAabb(bodies, boxMin & ndVector::m_triplexMask, boxMax & ndVector::m_triplexMask);
+			for (ndInt32 j = i; j < batchEnd; ++j)
+			{
+				MoveAgent(m_hashEntries[j].m_particle, bodies);
+			}
+		}
+	});
+	threadPool->ParallelExecute(MoveAgentBatches);
+}
+
+void ndBodyCrowdController::Execute(ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	SortAgents(threadPool);
+	SeparateAgents(threadPool);
+	MoveAgents(threadPool);
+}
+
+void ndBodyCrowdController::Update(const ndScene* const scene, ndFloat32 timestep)
+{
+	// agents cast against the scene, so they are updated on
+	// the scene threads and never in the background.
+	if (m_posit.GetCount() && (timestep > ndFloat32(0.0f)))
+	{
+		m_scene = scene;
+		m_timestep = timestep;
+		Execute((ndScene*)scene);
+	}
+}
@@ -0,0 +1,119 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_BODY_CROWD_CONTROLLER_H__
+#define __ND_BODY_CROWD_CONTROLLER_H__
+
+#include "ndCollisionStdafx.h"
+#include "ndShapeInstance.h"
+#include "ndBodyParticleSet.h"
+
+// a set of kinematic agents that move and slide over the static world.
+// every agent is an upright capsule along the y axis, the particle positions
+// are the agent feet. agents do not create contacts, they are kept apart
+// with a spatial hash and they are moved with swept capsule casts against
+// the static bodies, in batches of nearby agents across the scene threads.
+D_MSV_NEWTON_ALIGN_32
+class ndBodyCrowdController: public ndBodyParticleSet
+{
+	public:
+	D_COLLISION_API ndBodyCrowdController(ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight);
+	D_COLLISION_API virtual ~ndBodyCrowdController();
+
+	ndInt32 GetAgentCount() const;
+	ndFloat32 GetHeight() const;
+	ndFloat32 GetStepHeight() const;
+
+	// returns the index of the new agent
+	D_COLLISION_API ndInt32 AddAgent(const ndVector& position);
+
+	// the last agent takes the index of the removed one
+	D_COLLISION_API void RemoveAgent(ndInt32 agent);
+
+	bool IsOnFloor(ndInt32 agent) const;
+	const ndVector& GetDesiredVelocity(ndInt32 agent) const;
+	void SetDesiredVelocity(ndInt32 agent, const ndVector& veloc);
+
+	D_COLLISION_API void Execute(ndThreadPool* const threadPool);
+
+	protected:
+	D_COLLISION_API virtual void Update(const ndScene* const scene, ndFloat32 timestep);
+	virtual bool RayCast(ndRayCastNotify& callback, const ndFastRay& ray, const ndFloat32 maxT) const;
+
+	private:
+	class ndStaticBodies;
+
+	void SortAgents(ndThreadPool* const threadPool);
+	void MoveAgents(ndThreadPool* const threadPool);
+	void SeparateAgents(ndThreadPool* const threadPool);
+	void MoveAgent(ndInt32 agent, ndStaticBodies& bodies);
+	ndVector Sweep(const ndVector& origin, const ndVector& step, ndStaticBodies& bodies, ndVector& normal, ndFloat32& param) const;
+
+	ndShapeInstance m_agentShape;
+	ndArray<ndVector> m_desiredVeloc;
+	ndArray<ndVector> m_separation;
+	ndArray<ndUnsigned8> m_onFloor;
+	ndArray<ndCouplingEntry> m_hashEntries;
+	ndArray<ndCouplingEntry> m_hashScratch;
+	const ndScene* m_scene;
+	ndFloat32 m_height;
+	ndFloat32 m_stepHeight;
+	ndInt32 m_cellOrigin_x;
+	ndInt32 m_cellOrigin_z;
+} D_GCC_NEWTON_ALIGN_32 ;
+
+inline bool ndBodyCrowdController::RayCast(ndRayCastNotify&, const ndFastRay&, const ndFloat32) const
+{
+	return false;
+}
+
+inline ndInt32 ndBodyCrowdController::GetAgentCount() const
+{
+	return ndInt32(m_posit.GetCount());
+}
+
+inline ndFloat32 ndBodyCrowdController::GetHeight() const
+{
+	return m_height;
+}
+
+inline ndFloat32 ndBodyCrowdController::GetStepHeight() const
+{
+	return m_stepHeight;
+}
+
+inline bool ndBodyCrowdController::IsOnFloor(ndInt32 agent) const
+{
+	return m_onFloor[agent] ? true : false;
+}
+
+inline const ndVector& ndBodyCrowdController::GetDesiredVelocity(ndInt32 agent) const
+{
+	return m_desiredVeloc[agent];
+}
+
+inline void ndBodyCrowdController::SetDesiredVelocity(ndInt32 agent, const ndVector& veloc)
+{
+	m_desiredVeloc[agent] = veloc & ndVector::m_triplexMask;
+}
+
+#endif
+
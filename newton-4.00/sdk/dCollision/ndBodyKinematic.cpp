@@ -41,44 +41,112 @@ ndBodyKinematic::ndContactkey::ndContactkey(ndUnsigned32 tag0, ndUnsigned32 tag1
 	ndAssert(m_tagLow < m_tagHigh);
 }
 
+static inline ndInt32 ndContactSlotHash(ndUnsigned64 tag, ndInt32 mask)
+{
+	// fibonacci hash
+	return ndInt32((tag * ndUnsigned64(0x9E3779B97F4A7C15)) >> 32) & mask;
+}
+
 bool ndBodyKinematic::ndContactkey::operator== (const ndContactkey& key) const
 {
 	return m_tag == key.m_tag;
 }
 
-bool ndBodyKinematic::ndContactkey::operator< (const ndContactkey& key) const
+ndBodyKinematic::ndContactMap::ndContactMap()
+	:ndClassAlloc()
+	,m_slots(nullptr)
+	,m_contacts(nullptr)
+	,m_count(0)
+	,m_slotsCount(0)
 {
-	return m_tag < key.m_tag;
 }
 
-bool ndBodyKinematic::ndContactkey::operator> (const ndContactkey& key) const
+ndBodyKinematic::ndContactMap::~ndContactMap()
 {
-	return m_tag > key.m_tag;
+	if (m_slots)
+	{
+		ndMemory::Free(m_slots);
+	}
 }
 
-ndBodyKinematic::ndContactMap::ndContactMap()
-	:ndTree<ndContact*, ndContactkey, ndContainersFreeListAlloc<ndContact*>>()
+ndInt32 ndBodyKinematic::ndContactMap::FindSlot(ndUnsigned64 tag) const
 {
+	// linear probing, the table is never more than half full
+	ndAssert(m_slotsCount);
+	const ndInt32 mask = m_slotsCount - 1;
+	ndInt32 entry = ndContactSlotHash(tag, mask);
+	while ((m_slots[entry].m_index >= 0) && (m_slots[entry].m_tag != tag))
+	{
+		entry = (entry + 1) & mask;
+	}
+	return entry;
 }
 
-ndBodyKinematic::ndContactMap::~ndContactMap()
+void ndBodyKinematic::ndContactMap::Resize(ndInt32 slotsCount)
 {
+	ndAssert(!(slotsCount & (slotsCount - 1)));
+	ndAssert(slotsCount >= 2 * m_count);
+	ndSlot* const oldSlots = m_slots;
+	const ndInt32 oldSlotsCount = m_slotsCount;
+
+	// slots and the dense contact array share one allocation
+	const size_t slotsSize = sizeof(ndSlot) * size_t(slotsCount);
+	m_slots = (ndSlot*)ndMemory::Malloc(slotsSize + sizeof(ndContact*) * size_t(slotsCount / 2));
+	ndContact** const contacts = (ndContact**)((char*)m_slots + slotsSize);
+	m_slotsCount = slotsCount;
+	for (ndInt32 i = 0; i < slotsCount; ++i)
+	{
+		m_slots[i].m_index = -1;
+	}
+
+	for (ndInt32 i = 0; i < oldSlotsCount; ++i)
+	{
+		if (oldSlots[i].m_index >= 0)
+		{
+			const ndInt32 entry = FindSlot(oldSlots[i].m_tag);
+			m_slots[entry] = oldSlots[i];
+		}
+	}
+	for (ndInt32 i = 0; i < m_count; ++i)
+	{
+		contacts[i] = m_contacts[i];
+	}
+	m_contacts = contacts;
+
+	if (oldSlots)
+	{
+		ndMemory::Free(oldSlots);
+	}
 }
 
 ndContact* ndBodyKinematic::ndContactMap::FindContact(const ndBody* const body0, const ndBody* const body1) const
 {
+	if (!m_count)
+	{
+		return nullptr;
+	}
 	ndContactkey key(body0->GetId(), body1->GetId());
-	ndNode* const node = Find(key);
-	return node ? node->GetInfo() : nullptr;
+	const ndInt32 entry = FindSlot(key.GetTag());
+	const ndInt32 index = m_slots[entry].m_index;
+	return (index >= 0) ? m_contacts[index] : nullptr;
 }
 
 void ndBodyKinematic::ndContactMap::AttachContact(ndContact* const contact)
 {
+	if (2 * (m_count + 1) > m_slotsCount)
+	{
+		Resize(m_slotsCount ? m_slotsCount * 2 : 8);
+	}
+
 	ndBody* const body0 = contact->GetBody0();
 	ndBody* const body1 = contact->GetBody1();
 	ndContactkey key(body0->GetId(), body1->GetId());
-	ndAssert(!Find(key));
-	Insert(contact, key);
+	const ndInt32 entry = FindSlot(key.GetTag());
+	ndAssert(m_slots[entry].m_index < 0);
+	m_slots[entry].m_tag = key.GetTag();
+	m_slots[entry].m_index = m_count;
+	m_contacts[m_count] = contact;
+	m_count++;
 }
 
 void ndBodyKinematic::ndContactMap::DetachContact(ndContact* const contact)
@@ -86,8 +154,60 @@ void ndBodyKinematic::ndContactMap::DetachContact(ndContact* const contact)
 	ndBody* const body0 = contact->GetBody0();
 	ndBody* const body1 = contact->GetBody1();
 	ndContactkey key(body0->GetId(), body1->GetId());
-	ndAssert(Find(key));
-	Remove(key);
+	ndInt32 entry = FindSlot(key.GetTag());
+	const ndInt32 index = m_slots[entry].m_index;
+	ndAssert(index >= 0);
+	ndAssert(m_contacts[index] == contact);
+
+	// move the last contact to the free dense entry
+	m_count--;
+	if (index != m_count)
+	{
+		ndContact* const lastContact = m_contacts[m_count];
+		ndContactkey lastKey(lastContact->GetBody0()->GetId(), lastContact->GetBody1()->GetId());
+		const ndInt32 lastEntry = FindSlot(lastKey.GetTag());
+		ndAssert(m_slots[lastEntry].m_index == m_count);
+		m_slots[lastEntry].m_index = index;
+		m_contacts[index] = lastContact;
+	}
+
+	// backward shift deletion, so that the probe chains have no holes
+	const ndInt32 mask = m_slotsCount - 1;
+	m_slots[entry].m_index = -1;
+	for (ndInt32 next = (entry + 1) & mask; m_slots[next].m_index >= 0; next = (next + 1) & mask)
+	{
+		const ndInt32 home = ndContactSlotHash(m_slots[next].m_tag, mask);
+		if (((next - home) & mask) >= ((next - entry) & mask))
+		{
+			m_slots[entry] = m_slots[next];
+			m_slots[next].m_index = -1;
+			entry = next;
+		}
+	}
+}
+
+bool ndBodyKinematic::ndContactMap::SanityCheck() const
+{
+	ndInt32 count = 0;
+	for (ndInt32 i = 0; i < m_slotsCount; ++i)
+	{
+		const ndInt32 index = m_slots[i].m_index;
+		if (index >= 0)
+		{
+			count++;
+			if ((index >= m_count) || (FindSlot(m_slots[i].m_tag) != i))
+			{
+				return false;
+			}
+			const ndContact* const contact = m_contacts[index];
+			ndContactkey key(contact->GetBody0()->GetId(), contact->GetBody1()->GetId());
+			if (key.GetTag() != m_slots[i].m_tag)
+			{
+				return false;
+			}
+		}
+	}
+	return count == m_count;
 }
 
 ndBodyKinematic::ndBodyKinematic()
@@ -610,7 +730,7 @@ ndJacobian ndBodyKinematic::CalculateNetForce() const
 	ndBodyKinematic::ndContactMap::Iterator it(contactMap);
 	for (it.Begin(); it; it++)
 	{
-		ndContact* const fronterContact = it.GetNode()->GetInfo();
+		ndContact* const fronterContact = *it;
 		if (fronterContact->IsActive())
 		{
 			if (fronterContact->GetBody0() == this)
@@ -44,9 +44,9 @@ class ndBodyKinematic : public ndBody
 		public:
 		ndContactkey(ndUnsigned32 tag0, ndUnsigned32 tag1);
 
-		bool operator> (const ndContactkey& key) const;
-		bool operator< (const ndContactkey& key) const;
 		bool operator== (const ndContactkey& key) const;
+		ndUnsigned64 GetTag() const;
+
 		private:
 		union
 		{
@@ -70,16 +70,51 @@ class ndBodyKinematic : public ndBody
 		}
 	};
 
-	class ndContactMap: public ndTree<ndContact*, ndContactkey, ndContainersFreeListAlloc<ndContact*>>
+	// open addressing hash of the body contacts, the contacts are 
+	// kept in a dense array so that iterating them is a linear walk.
+	class ndContactMap: public ndClassAlloc
 	{
+		class ndSlot
+		{
+			public:
+			ndUnsigned64 m_tag;
+			ndInt32 m_index;
+		};
+
 		public:
+		class Iterator
+		{
+			public:
+			Iterator(const ndContactMap& map);
+
+			void Begin();
+			operator ndInt32() const;
+			void operator++ ();
+			void operator++ (ndInt32);
+			ndContact* operator* () const;
+
+			private:
+			const ndContactMap* m_map;
+			ndInt32 m_index;
+		};
+
+		ndInt32 GetCount() const;
+		ndContact* GetContact(ndInt32 index) const;
 		D_COLLISION_API ndContact* FindContact(const ndBody* const body0, const ndBody* const body1) const;
+		D_COLLISION_API bool SanityCheck() const;
 
 		private:
 		ndContactMap();
 		~ndContactMap();
 		void AttachContact(ndContact* const contact);
 		void DetachContact(ndContact* const contact);
+		ndInt32 FindSlot(ndUnsigned64 tag) const;
+		void Resize(ndInt32 slotsCount);
+
+		ndSlot* m_slots;
+		ndContact** m_contacts;
+		ndInt32 m_count;
+		ndInt32 m_slotsCount;
 		friend class ndBodyKinematic;
 	};
 
@@ -179,6 +214,7 @@ class ndBodyKinematic : public ndBody
 
 	void SetAccel(const ndJacobian& accel);
 	virtual void SpecialUpdate(ndFloat32 timestep);
+	virtual void SpecialUpdateParallel(ndInt32 threadIndex, ndFloat32 timestep);
 	virtual void IntegrateGyroSubstep(const ndVector& timestep);
 	virtual void ApplyExternalForces(ndInt32 threadIndex, ndFloat32 timestep);
 	virtual ndJacobian IntegrateForceAndToque(const ndVector& force, const ndVector& torque, const ndVector& timestep) const;
@@ -321,6 +357,54 @@ inline ndBodyKinematic* ndBodyKinematic::GetAsBodyKinematic()
 	return this; 
 }
 
+inline ndUnsigned64 ndBodyKinematic::ndContactkey::GetTag() const
+{
+	return m_tag;
+}
+
+inline ndBodyKinematic::ndContactMap::Iterator::Iterator(const ndContactMap& map)
+	:m_map(&map)
+	,m_index(0)
+{
+}
+
+inline void ndBodyKinematic::ndContactMap::Iterator::Begin()
+{
+	m_index = 0;
+}
+
+inline ndBodyKinematic::ndContactMap::Iterator::operator ndInt32() const
+{
+	return m_index < m_map->m_count;
+}
+
+inline void ndBodyKinematic::ndContactMap::Iterator::operator++ ()
+{
+	m_index++;
+}
+
+inline void ndBodyKinematic::ndContactMap::Iterator::operator++ (ndInt32)
+{
+	m_index++;
+}
+
+inline ndContact* ndBodyKinematic::ndContactMap::Iterator::operator* () const
+{
+	ndAssert(m_index < m_map->m_count);
+	return m_map->m_contacts[m_index];
+}
+
+inline ndInt32 ndBodyKinematic::ndContactMap::GetCount() const
+{
+	return m_count;
+}
+
+inline ndContact* ndBodyKinematic::ndContactMap::GetContact(ndInt32 index) const
+{
+	ndAssert(index < m_count);
+	return m_contacts[index];
+}
+
 inline ndScene* ndBodyKinematic::GetScene() const
 {
 	return m_scene;
@@ -533,6 +617,10 @@ inline void ndBodyKinematic::SpecialUpdate(ndFloat32)
 	ndAssert(0);
 }
 
+inline void ndBodyKinematic::SpecialUpdateParallel(ndInt32, ndFloat32)
+{
+}
+
 inline void ndBodyKinematic::ApplyExternalForces(ndInt32, ndFloat32)
 {
 }
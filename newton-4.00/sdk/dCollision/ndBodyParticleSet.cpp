@@ -24,6 +24,10 @@
 #include "ndWorld.h"
 #include "ndBodyParticleSet.h"
 
+#define D_COUPLING_GRID_BITS			10
+#define D_COUPLING_GRID_MASK			((1 << D_COUPLING_GRID_BITS) - 1)
+#define D_PARTICLE_COUPLING_RELAXATION	ndFloat32(0.25f)
+
 ndBodyParticleSet::ndBodyParticleSet()
 	:ndBody()
 	,ndBackgroundTask()
@@ -32,13 +36,273 @@ ndBodyParticleSet::ndBodyParticleSet()
 	,m_gravity(ndVector::m_zero)
 	,m_posit(1024)
 	,m_veloc(1024)
+	,m_couplingEntries(1024)
+	,m_couplingScratch(1024)
 	,m_listNode(nullptr)
 	,m_radius(ndFloat32 (0.125f))
 	,m_timestep(ndFloat32(0.0f))
 	,m_updateInBackground(true)
+	,m_bodyCoupling(false)
 {
 }
 
 ndBodyParticleSet::~ndBodyParticleSet()
 {
 }
+
+void ndBodyParticleSet::CoupleBodies(ndScene* const scene)
+{
+	D_TRACKTIME();
+	class ndBox
+	{
+		public:
+		ndBox()
+			:m_min(ndFloat32(1.0e10f))
+			,m_max(ndFloat32(-1.0e10f))
+		{
+		}
+		ndVector m_min;
+		ndVector m_max;
+	};
+
+	class ndCouplingBodies : public ndBodiesInAabbNotify
+	{
+		public:
+		virtual void OnOverlap(const ndBody* const body)
+		{
+			ndBodyKinematic* const kinBody = ((ndBody*)body)->GetAsBodyKinematic();
+			ndShape* const shape = (ndShape*)kinBody->GetCollisionShape().GetShape();
+			if (shape->GetAsShapeConvex() && !shape->GetAsShapeNull())
+			{
+				m_bodyArray.PushBack(body);
+			}
+		}
+	};
+
+	class ndKey_x
+	{
+		public:
+		ndKey_x(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32(entry.m_key & D_COUPLING_GRID_MASK);
+		}
+	};
+
+	class ndKey_y
+	{
+		public:
+		ndKey_y(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32((entry.m_key >> D_COUPLING_GRID_BITS) & D_COUPLING_GRID_MASK);
+		}
+	};
+
+	class ndKey_z
+	{
+		public:
+		ndKey_z(void* const) {}
+		ndInt32 GetKey(const ndCouplingEntry& entry) const
+		{
+			return ndInt32((entry.m_key >> (D_COUPLING_GRID_BITS * 2)) & D_COUPLING_GRID_MASK);
+		}
+	};
+
+	const ndInt32 particleCount = ndInt32(m_posit.GetCount());
+	ndBox boxes[D_MAX_THREADS_COUNT];
+	auto CalculateAabb = ndMakeObject::ndFunction([this, &boxes](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateAabb);
+		ndBox box;
+		const ndStartEnd startEnd(ndInt32(m_posit.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			box.m_min = box.m_min.GetMin(m_posit[i]);
+			box.m_max = box.m_max.GetMax(m_posit[i]);
+		}
+		boxes[threadIndex] = box;
+	});
+	scene->ParallelExecute(CalculateAabb);
+
+	ndBox box;
+	const ndInt32 threadCount = scene->GetThreadCount();
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		box.m_min = box.m_min.GetMin(boxes[i].m_min);
+		box.m_max = box.m_max.GetMax(boxes[i].m_max);
+	}
+	const ndVector padding(m_radius);
+	const ndVector origin((box.m_min - padding) & ndVector::m_triplexMask);
+	const ndVector box1((box.m_max + padding) & ndVector::m_triplexMask);
+
+	// one scene query for the whole particle set
+	ndCouplingBodies bodies;
+	scene->BodiesInAabb(bodies, origin, box1);
+	if (!bodies.m_bodyArray.GetCount())
+	{
+		return;
+	}
+
+	// bin the particles in a coarse grid, so that each body only visits 
+	// the particles in the cells under its aabb.
+	const ndVector extend(box1 - origin);
+	const ndFloat32 maxExtend = ndMax(extend.m_x, ndMax(extend.m_y, extend.m_z));
+	const ndFloat32 cellSize = ndMax(ndFloat32(4.0f) * m_radius, maxExtend / ndFloat32(D_COUPLING_GRID_MASK));
+	const ndVector invCellSize(ndFloat32(1.0f) / cellSize);
+	const ndVector maxCell(ndFloat32(D_COUPLING_GRID_MASK));
+
+	m_couplingEntries.SetCount(particleCount);
+	m_couplingScratch.SetCount(particleCount);
+	auto CalculateKeys = ndMakeObject::ndFunction([this, &origin, &invCellSize, &maxCell](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateKeys);
+		const ndStartEnd startEnd(ndInt32(m_posit.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector cell(((m_posit[i] - origin) * invCellSize).GetMax(ndVector::m_zero).GetMin(maxCell).GetInt());
+			ndCouplingEntry& entry = m_couplingEntries[i];
+			entry.m_key = ndUnsigned32((cell.m_iz << (D_COUPLING_GRID_BITS * 2)) | (cell.m_iy << D_COUPLING_GRID_BITS) | cell.m_ix);
+			entry.m_particle = i;
+		}
+	});
+	scene->ParallelExecute(CalculateKeys);
+	ndCountingSort<ndCouplingEntry, ndKey_x, D_COUPLING_GRID_BITS>(*scene, m_couplingEntries, m_couplingScratch, nullptr, nullptr);
+	ndCountingSort<ndCouplingEntry, ndKey_y, D_COUPLING_GRID_BITS>(*scene, m_couplingEntries, m_couplingScratch, nullptr, nullptr);
+	ndCountingSort<ndCouplingEntry, ndKey_z, D_COUPLING_GRID_BITS>(*scene, m_couplingEntries, m_couplingScratch, nullptr, nullptr);
+
+	ndAtomic<ndInt32> iterator(0);
+	auto CoupleBodies = ndMakeObject::ndFunction([this, scene, &bodies, &iterator, &origin, &invCellSize, &maxCell](ndInt32 threadIndex, ndInt32)
+	{
+		D_TRACKTIME_NAMED(CoupleBodies);
+		const ndFloat32 radius = m_radius;
+		const ndFloat32 particleMass = GetParticleMass();
+		const ndFloat32 invTimestep = ndFloat32(1.0f) / scene->GetTimestep();
+		const ndVector padding(radius);
+		const ndCouplingEntry* const entries = &m_couplingEntries[0];
+		const ndInt32 entriesCount = ndInt32(m_couplingEntries.GetCount());
+		ndArray<ndCouplingImpulse>& impulses = m_couplingImpulses[threadIndex];
+
+		const ndInt32 bodyCount = ndInt32(bodies.m_bodyArray.GetCount());
+		for (ndInt32 i = iterator++; i < bodyCount; i = iterator++)
+		{
+			ndBodyKinematic* const body = ((ndBody*)bodies.m_bodyArray[i])->GetAsBodyKinematic();
+			const ndShapeInstance& shape = body->GetCollisionShape();
+			const ndMatrix& matrix = shape.GetGlobalMatrix();
+
+			ndVector obbSize;
+			ndVector obbOrigin;
+			ndVector minBox;
+			ndVector maxBox;
+			shape.CalculateObb(obbOrigin, obbSize);
+			shape.CalculateAabb(matrix, minBox, maxBox);
+			const ndVector cell0(((minBox - padding - origin) * invCellSize).GetMax(ndVector::m_zero).GetMin(maxCell).GetInt());
+			const ndVector cell1(((maxBox + padding - origin) * invCellSize).GetMax(ndVector::m_zero).GetMin(maxCell).GetInt());
+
+			const ndFloat32 invMass = body->GetInvMass();
+			const ndVector com(body->GetGlobalGetCentreOfMass());
+
+			const ndInt32 contactStart = ndInt32(impulses.GetCount());
+			for (ndInt32 z = ndInt32(cell0.m_iz); z <= ndInt32(cell1.m_iz); ++z)
+			{
+				for (ndInt32 y = ndInt32(cell0.m_iy); y <= ndInt32(cell1.m_iy); ++y)
+				{
+					// the cells of a row are contiguous in the sorted entries
+					const ndUnsigned32 row = ndUnsigned32((z << (D_COUPLING_GRID_BITS * 2)) | (y << D_COUPLING_GRID_BITS));
+					const ndUnsigned32 key0 = row | ndUnsigned32(cell0.m_ix);
+					const ndUnsigned32 key1 = row | ndUnsigned32(cell1.m_ix);
+
+					ndInt32 i0 = 0;
+					ndInt32 i1 = entriesCount;
+					while (i0 < i1)
+					{
+						const ndInt32 mid = (i0 + i1) >> 1;
+						if (entries[mid].m_key < key0)
+						{
+							i0 = mid + 1;
+						}
+						else
+						{
+							i1 = mid;
+						}
+					}
+
+					for (ndInt32 j = i0; (j < entriesCount) && (entries[j].m_key <= key1); ++j)
+					{
+						const ndInt32 index = entries[j].m_particle;
+						const ndVector point((m_posit[index] & ndVector::m_triplexMask) | ndVector::m_wOne);
+						const ndVector localDist(matrix.UntransformVector(point) - obbOrigin);
+						const ndVector penetration(obbSize + padding - localDist.Abs());
+						if ((penetration.m_x > ndFloat32(0.0f)) && (penetration.m_y > ndFloat32(0.0f)) && (penetration.m_z > ndFloat32(0.0f)))
+						{
+							// push out along the obb face of least penetration
+							ndInt32 axis = (penetration.m_x < penetration.m_y) ? 0 : 1;
+							axis = (penetration[axis] < penetration.m_z) ? axis : 2;
+							ndVector localNormal(ndVector::m_zero);
+							localNormal[axis] = (localDist[axis] >= ndFloat32(0.0f)) ? ndFloat32(1.0f) : ndFloat32(-1.0f);
+							const ndVector normal(matrix.RotateVector(localNormal));
+
+							const ndVector relativeVeloc(m_veloc[index] - body->GetVelocityAtPoint(point));
+							const ndFloat32 normalSpeed = relativeVeloc.DotProduct(normal).GetScalar();
+							const ndFloat32 separationSpeed = penetration[axis] * D_PARTICLE_COUPLING_RELAXATION * invTimestep;
+							const ndFloat32 deltaSpeed = separationSpeed - normalSpeed;
+							if (deltaSpeed > ndFloat32(0.0f))
+							{
+								ndCouplingImpulse contact;
+								contact.m_veloc = normal.Scale(deltaSpeed);
+								contact.m_particle = index;
+								impulses.PushBack(contact);
+							}
+						}
+					}
+				}
+			}
+
+			// the contacts of a body are solved at once, each one sees the particle 
+			// against the body mass split between all the contacts, so that the body 
+			// does not overshoot. the particle and the body get the same impulse.
+			const ndInt32 contactCount = ndInt32(impulses.GetCount()) - contactStart;
+			const ndFloat32 contactMass = particleMass / (ndFloat32(1.0f) + ndFloat32(contactCount) * particleMass * invMass);
+			if (contactCount && (invMass > ndFloat32(0.0f)))
+			{
+				ndVector force(ndVector::m_zero);
+				ndVector torque(ndVector::m_zero);
+				for (ndInt32 j = contactStart; j < ndInt32(impulses.GetCount()); ++j)
+				{
+					const ndCouplingImpulse& contact = impulses[j];
+					const ndVector impulse(contact.m_veloc.Scale(contactMass));
+					const ndVector point(m_posit[contact.m_particle] & ndVector::m_triplexMask);
+					const ndVector contactForce(impulse.Scale(-invTimestep));
+					force += contactForce;
+					torque += (point - com).CrossProduct(contactForce);
+				}
+				body->SetForce(body->GetForce() + (force & ndVector::m_triplexMask));
+				body->SetTorque(body->GetTorque() + (torque & ndVector::m_triplexMask));
+				body->SetSleepState(false);
+			}
+
+			const ndFloat32 particleScale = contactMass / particleMass;
+			for (ndInt32 j = contactStart; j < ndInt32(impulses.GetCount()); ++j)
+			{
+				impulses[j].m_veloc = impulses[j].m_veloc.Scale(particleScale);
+			}
+		}
+	});
+
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		m_couplingImpulses[i].SetCount(0);
+	}
+	scene->ParallelExecute(CoupleBodies);
+
+	// a particle can touch more than one body, apply the impulses serially
+	for (ndInt32 i = 0; i < threadCount; ++i)
+	{
+		const ndArray<ndCouplingImpulse>& impulses = m_couplingImpulses[i];
+		for (ndInt32 j = 0; j < ndInt32(impulses.GetCount()); ++j)
+		{
+			const ndCouplingImpulse& impulse = impulses[j];
+			m_veloc[impulse.m_particle] += impulse.m_veloc;
+		}
+	}
+}
@@ -48,19 +48,44 @@ class ndBodyParticleSet: public ndBody, public ndBackgroundTask
 	void SetAsynUpdate(bool update);
 	ndFloat32 GetParticleRadius() const;
 	virtual void SetParticleRadius(ndFloat32 radius);
+	virtual ndFloat32 GetParticleMass() const;
+
+	// when enabled, particles and convex rigid bodies push on each other 
+	// in every sub step. bodies are approximated by their collision obb.
+	bool GetBodyCoupling() const;
+	void SetBodyCoupling(bool state);
 
 	D_COLLISION_API virtual void Update(const ndScene* const scene, ndFloat32 timestep) = 0;
+	D_COLLISION_API virtual void CoupleBodies(ndScene* const scene);
 
 	protected:
+	class ndCouplingEntry
+	{
+		public:
+		ndUnsigned32 m_key;
+		ndInt32 m_particle;
+	};
+
+	class ndCouplingImpulse
+	{
+		public:
+		ndVector m_veloc;
+		ndInt32 m_particle;
+	};
+
 	ndVector m_box0;
 	ndVector m_box1;
 	ndVector m_gravity;
 	ndArray<ndVector> m_posit;
 	ndArray<ndVector> m_veloc;
+	ndArray<ndCouplingEntry> m_couplingEntries;
+	ndArray<ndCouplingEntry> m_couplingScratch;
+	ndArray<ndCouplingImpulse> m_couplingImpulses[D_MAX_THREADS_COUNT];
 	ndBodyList::ndNode* m_listNode;
 	ndFloat32 m_radius;
 	ndFloat32 m_timestep;
 	bool m_updateInBackground;
+	bool m_bodyCoupling;
 	friend class ndWorld;
 	friend class ndScene;
 } D_GCC_NEWTON_ALIGN_32 ;
@@ -80,6 +105,21 @@ inline void ndBodyParticleSet::SetParticleRadius(ndFloat32 raidus)
 	m_radius = raidus;
 }
 
+inline ndFloat32 ndBodyParticleSet::GetParticleMass() const
+{
+	return ndFloat32(1.0f);
+}
+
+inline bool ndBodyParticleSet::GetBodyCoupling() const
+{
+	return m_bodyCoupling;
+}
+
+inline void ndBodyParticleSet::SetBodyCoupling(bool state)
+{
+	m_bodyCoupling = state;
+}
+
 inline ndArray<ndVector>& ndBodyParticleSet::GetPositions()
 {
 	return m_posit;
@@ -40,12 +40,13 @@ D_MSV_NEWTON_ALIGN_32
 class ndBodyPlayerCapsuleContactSolver
 {
 	public:
-	ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player);
+	ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player, ndInt32 threadIndex);
 	void CalculateContacts();
 
 	ndContactPoint m_contactBuffer[D_PLAYER_MAX_ROWS];
 	ndBodyPlayerCapsule* m_player;
 	ndInt32 m_contactCount;
+	ndInt32 m_threadIndex;
 } D_GCC_NEWTON_ALIGN_32;
 
 D_MSV_NEWTON_ALIGN_32
@@ -60,7 +61,7 @@ class ndBodyPlayerCapsuleImpulseSolver
 	void AddAngularRows();
 	ndInt32 AddLinearRow(const ndVector& dir, const ndVector& r, ndFloat32 speed, ndFloat32 low, ndFloat32 high, ndInt32 normalIndex = -1);
 	ndInt32 AddContactRow(const ndContactPoint* const contact, const ndVector& dir, const ndVector& r, ndFloat32 speed, ndFloat32 low, ndFloat32 high, ndInt32 normalIndex = -1);
-	void ApplyReaction(ndFloat32 timestep);
+	void ApplyReaction(ndBodyPlayerCapsule* const controller, ndFloat32 timestep);
 
 	ndMatrix m_invInertia;
 	ndVector m_veloc;
@@ -79,11 +80,15 @@ class ndBodyPlayerCapsuleImpulseSolver
 
 ndBodyPlayerCapsule::ndBodyPlayerCapsule()
 	:ndBodyKinematicBase()
+	,m_reactions()
+	,m_serialUpdate(true)
 {
 }
 
 ndBodyPlayerCapsule::ndBodyPlayerCapsule(const ndMatrix& localAxis, ndFloat32 mass, ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight)
 	:ndBodyKinematicBase()
+	,m_reactions()
+	,m_serialUpdate(true)
 {
 	Init(localAxis, mass, radius, height, stepHeight);
 }
@@ -487,7 +492,7 @@ void ndBodyPlayerCapsule::ResolveCollision(ndBodyPlayerCapsuleContactSolver& con
 	impulseSolver.AddAngularRows();
 
 	veloc += impulseSolver.CalculateImpulse().Scale(m_invMass);
-	impulseSolver.ApplyReaction(timestep);
+	impulseSolver.ApplyReaction(this, timestep);
 
 	SetVelocity(veloc);
 }
@@ -506,9 +511,10 @@ void ndBodyPlayerCapsuleImpulseSolver::Reset(ndBodyPlayerCapsule* const controll
 	m_veloc = controller->GetVelocity();
 }
 
-ndBodyPlayerCapsuleContactSolver::ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player)
+ndBodyPlayerCapsuleContactSolver::ndBodyPlayerCapsuleContactSolver(ndBodyPlayerCapsule* const player, ndInt32 threadIndex)
 	:m_player(player)
 	,m_contactCount(0)
+	,m_threadIndex(threadIndex)
 {
 }
 
@@ -534,7 +540,7 @@ void ndBodyPlayerCapsuleContactSolver::CalculateContacts()
 			contact.m_material = contactNotify->GetMaterial(&contact, body0->GetCollisionShape(), body1->GetCollisionShape());
 	
 			ndContactPoint contactBuffer[D_MAX_CONTATCS];
-			ndContactSolver contactSolver(&contact, scene->GetContactNotify(), ndFloat32(1.0f), 0);
+			ndContactSolver contactSolver(&contact, scene->GetContactNotify(), ndFloat32(1.0f), m_threadIndex);
 			contactSolver.m_instance0.SetGlobalMatrix(contactSolver.m_instance0.GetLocalMatrix() * body0->GetMatrix());
 			contactSolver.m_instance1.SetGlobalMatrix(contactSolver.m_instance1.GetLocalMatrix() * body1->GetMatrix());
 			contactSolver.m_separatingVector = srcContact->m_separatingVector;
@@ -694,7 +700,7 @@ void ndBodyPlayerCapsuleImpulseSolver::AddAngularRows()
 	}
 }
 
-void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndFloat32 timestep)
+void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndBodyPlayerCapsule* const controller, ndFloat32 timestep)
 {
 	ndFloat32 invTimeStep = 0.1f / timestep;
 	for (ndInt32 i = 0; i < m_rowCount; ++i) 
@@ -705,16 +711,83 @@ void ndBodyPlayerCapsuleImpulseSolver::ApplyReaction(ndFloat32 timestep)
 			ndBodyKinematic* const body1 = ((ndBodyKinematic*)m_contactPoint[i]->m_body1);
 			ndVector force(m_jacobianPairs[i].m_jacobianM1.m_linear.Scale(m_impulseMag[i] * invTimeStep));
 			ndVector torque(m_jacobianPairs[i].m_jacobianM1.m_angular.Scale(m_impulseMag[i] * invTimeStep));
-			body1->SetForce(force + body1->GetForce());
-			body1->SetTorque(torque + body1->GetTorque());
+			controller->AddReaction(body1, force, torque);
 			body0->m_equilibriumOverride = 1;
 		}
 	}
 }
 
+void ndBodyPlayerCapsule::AddReaction(ndBodyKinematic* const body, const ndVector& force, const ndVector& torque)
+{
+	// reactions on other bodies are applied later from the serial pass,
+	// the array only belongs to this player so it can grow from a worker thread.
+	ndInt32 index = 0;
+	const ndInt32 count = ndInt32(m_reactions.GetCount());
+	for (; (index < count) && (m_reactions[index].m_body != body); ++index);
+	if (index == count)
+	{
+		ndReaction reaction;
+		reaction.m_force = ndVector::m_zero;
+		reaction.m_torque = ndVector::m_zero;
+		reaction.m_body = body;
+		m_reactions.PushBack(reaction);
+	}
+	m_reactions[index].m_force += force;
+	m_reactions[index].m_torque += torque;
+}
+
+bool ndBodyPlayerCapsule::IsTouchingOtherPlayer() const
+{
+	ndBodyKinematic::ndContactMap::Iterator it(GetContactMap());
+	for (it.Begin(); it; it++)
+	{
+		const ndContact* const contact = *it;
+		if (contact->IsActive())
+		{
+			ndBodyKinematic* const body0 = contact->GetBody0();
+			ndBodyKinematic* const body1 = contact->GetBody1();
+			ndBodyKinematic* const other = (body0 == this) ? body1 : body0;
+			if (other->GetAsBodyPlayerCapsule())
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void ndBodyPlayerCapsule::SpecialUpdateParallel(ndInt32 threadIndex, ndFloat32 timestep)
+{
+	// players in contact with other players read each other state,
+	// those are updated in the serial pass, in special list order.
+	m_reactions.SetCount(0);
+	m_serialUpdate = IsTouchingOtherPlayer();
+	if (!m_serialUpdate)
+	{
+		UpdatePlayer(threadIndex, timestep);
+	}
+}
+
 void ndBodyPlayerCapsule::SpecialUpdate(ndFloat32 timestep)
 {
-	ndBodyPlayerCapsuleContactSolver contactSolver(this);
+	if (m_serialUpdate)
+	{
+		UpdatePlayer(0, timestep);
+	}
+
+	for (ndInt32 i = 0; i < ndInt32(m_reactions.GetCount()); ++i)
+	{
+		const ndReaction& reaction = m_reactions[i];
+		ndBodyKinematic* const body = reaction.m_body;
+		body->SetForce(body->GetForce() + reaction.m_force);
+		body->SetTorque(body->GetTorque() + reaction.m_torque);
+	}
+	m_reactions.SetCount(0);
+}
+
+void ndBodyPlayerCapsule::UpdatePlayer(ndInt32 threadIndex, ndFloat32 timestep)
+{
+	ndBodyPlayerCapsuleContactSolver contactSolver(this, threadIndex);
 	ndFloat32 timeLeft = timestep;
 	const ndFloat32 timeEpsilon = timestep * (1.0f / 16.0f);
 
@@ -51,10 +51,20 @@ class ndBodyPlayerCapsule : public ndBodyKinematicBase
 
 	bool IsOnFloor() const;
 
+	// ApplyInputs and ContactFrictionCallback can be called from worker threads,
+	// concurrently with other players, they should only change this player.
 	virtual void ApplyInputs(ndFloat32 timestep);
 	virtual ndFloat32 ContactFrictionCallback(const ndVector& position, const ndVector& normal, ndInt32 contactId, const ndBodyKinematic* const otherbody) const;
 
 	private:
+	class ndReaction
+	{
+		public:
+		ndVector m_force;
+		ndVector m_torque;
+		ndBodyKinematic* m_body;
+	};
+
 	enum dCollisionState
 	{
 		m_colliding,
@@ -71,13 +81,18 @@ class ndBodyPlayerCapsule : public ndBodyKinematicBase
 	dCollisionState TestPredictCollision(const ndBodyPlayerCapsuleContactSolver& contactSolver, const ndVector& veloc) const;
 	void ResolveInterpenetrations(ndBodyPlayerCapsuleContactSolver& contactSolver, ndBodyPlayerCapsuleImpulseSolver& impulseSolver);
 	void IntegrateVelocity(ndFloat32 timestep);
+	void UpdatePlayer(ndInt32 threadIndex, ndFloat32 timestep);
+	void AddReaction(ndBodyKinematic* const body, const ndVector& force, const ndVector& torque);
+	bool IsTouchingOtherPlayer() const;
 
 	D_COLLISION_API virtual void SpecialUpdate(ndFloat32 timestep);
+	D_COLLISION_API virtual void SpecialUpdateParallel(ndInt32 threadIndex, ndFloat32 timestep);
 	D_COLLISION_API void Init(const ndMatrix& localAxis, ndFloat32 mass, ndFloat32 radius, ndFloat32 height, ndFloat32 stepHeight);
 
 	protected: 
 	ndMatrix m_localFrame;
 	ndVector m_impulse;
+	ndArray<ndReaction> m_reactions;
 	ndFloat32 m_mass;
 	ndFloat32 m_invMass;
 	ndFloat32 m_headingAngle;
@@ -92,6 +107,9 @@ class ndBodyPlayerCapsule : public ndBodyKinematicBase
 	bool m_isAirbone;
 	bool m_isOnFloor;
 	bool m_isCrouched;
+	bool m_serialUpdate;
+
+	friend class ndBodyPlayerCapsuleImpulseSolver;
 } D_GCC_NEWTON_ALIGN_32;
 
 inline ndBodyPlayerCapsule* ndBodyPlayerCapsule::GetAsBodyPlayerCapsule()
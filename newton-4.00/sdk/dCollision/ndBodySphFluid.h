@@ -37,7 +37,7 @@ class ndBodySphFluid: public ndBodyParticleSet
 	ndFloat32 GetViscosity() const;
 	void SetViscosity(ndFloat32 viscosity);
 	
-	//ndFloat32 GetParticleMass() const;
+	virtual ndFloat32 GetParticleMass() const;
 	//void SetParticleMass(ndFloat32 mass);
 
 	void SetParticleRadius(ndFloat32 radius);
@@ -56,24 +56,21 @@ class ndBodySphFluid: public ndBodyParticleSet
 	virtual bool RayCast(ndRayCastNotify& callback, const ndFastRay& ray, const ndFloat32 maxT) const;
 
 	private:
-	class ndGridHash;
 	class ndParticlePair;
+	class ndCellNeighbors;
 	class ndWorkingBuffers;
 	class ndParticleKernelDistance;
 
-	void SortGrids(ndThreadPool* const threadPool);
-	void BuildBuckets(ndThreadPool* const threadPool);
-	void CreateGrids(ndThreadPool* const threadPool);
+	void BuildPairs(ndThreadPool* const threadPool);
 	void CaculateAabb(ndThreadPool* const threadPool);
-	void SortBuckets(ndThreadPool* const threadPool);
-	void CalculateScans(ndThreadPool* const threadPool);
-	void SortCellBuckects(ndThreadPool* const threadPool);
+	void SortParticles(ndThreadPool* const threadPool);
+	void BuildCellLists(ndThreadPool* const threadPool);
+	void GatherParticles(ndThreadPool* const threadPool);
+	ndInt32 UpdateCellKeys(ndThreadPool* const threadPool);
 	void IntegrateParticles(ndThreadPool* const threadPool);
 	void CalculateAccelerations(ndThreadPool* const threadPool);
 	void CalculateParticlesDensity(ndThreadPool* const threadPool);
 
-	bool TraceHashes() const;
-
 	ndWorkingBuffers* m_workingBuffers;
 	ndFloat32 m_mass;
 	ndFloat32 m_viscosity;
@@ -102,10 +99,10 @@ inline void ndBodySphFluid::SetViscosity(ndFloat32 viscosity)
 	m_viscosity = viscosity;
 }
 
-//inline ndFloat32 ndBodySphFluid::GetParticleMass() const
-//{
-//	return m_mass;
-//}
+inline ndFloat32 ndBodySphFluid::GetParticleMass() const
+{
+	return m_mass;
+}
 
 //inline void ndBodySphFluid::SetParticleMass(ndFloat32 mass)
 //{
@@ -26,6 +26,11 @@
 
 ndBodyTriggerVolume::ndBodyTriggerVolume()
 	:ndBodyKinematicBase()
+	,m_inside()
+	,m_overlaps()
+	,m_enterEvents()
+	,m_stayEvents()
+	,m_exitEvents()
 {
 }
 
@@ -35,8 +40,24 @@ ndBodyTriggerVolume::~ndBodyTriggerVolume()
 
 void ndBodyTriggerVolume::SpecialUpdate(ndFloat32 timestep)
 {
-	const ndContactMap& contactMap = GetContactMap();
+	class ndCompareId
+	{
+		public:
+		ndCompareId(void* const)
+		{
+		}
 
+		ndInt32 Compare(const ndBodyKinematic* const bodyA, const ndBodyKinematic* const bodyB) const
+		{
+			const ndUnsigned32 idA = bodyA->GetId();
+			const ndUnsigned32 idB = bodyB->GetId();
+			return (idA < idB) ? -1 : ((idA > idB) ? 1 : 0);
+		}
+	};
+
+	// the narrow phase only sets the overlap state of each contact
+	m_inside.SetCount(0);
+	const ndContactMap& contactMap = GetContactMap();
 	ndBodyKinematic::ndContactMap::Iterator it(contactMap);
 	for (it.Begin(); it; it++)
 	{
@@ -45,7 +66,93 @@ void ndBodyTriggerVolume::SpecialUpdate(ndFloat32 timestep)
 		{
 			ndBodyKinematic* const body0 = contact->GetBody0();
 			ndBodyKinematic* const body1 = contact->GetBody1();
-			OnTrigger((body1 == this) ? body0 : body1, timestep);
+			m_inside.PushBack((body1 == this) ? body0 : body1);
+		}
+	}
+	if (m_inside.GetCount() > 1)
+	{
+		ndSort<ndBodyKinematic*, ndCompareId>(&m_inside[0], ndInt32(m_inside.GetCount()), nullptr);
+	}
+
+	// merge against the bodies inside last step
+	m_enterEvents.SetCount(0);
+	m_stayEvents.SetCount(0);
+	m_exitEvents.SetCount(0);
+	ndInt32 i0 = 0;
+	ndInt32 i1 = 0;
+	const ndInt32 count0 = ndInt32(m_overlaps.GetCount());
+	const ndInt32 count1 = ndInt32(m_inside.GetCount());
+	while ((i0 < count0) || (i1 < count1))
+	{
+		const ndUnsigned32 id0 = (i0 < count0) ? m_overlaps[i0]->GetId() : ndUnsigned32(-1);
+		const ndUnsigned32 id1 = (i1 < count1) ? m_inside[i1]->GetId() : ndUnsigned32(-1);
+		if ((i0 < count0) && (i1 < count1) && (id0 == id1))
+		{
+			m_stayEvents.PushBack(m_inside[i1]);
+			i0++;
+			i1++;
+		}
+		else if ((i1 >= count1) || ((i0 < count0) && (id0 < id1)))
+		{
+			m_exitEvents.PushBack(m_overlaps[i0]);
+			i0++;
 		}
+		else
+		{
+			m_enterEvents.PushBack(m_inside[i1]);
+			i1++;
+		}
+	}
+	m_overlaps.Swap(m_inside);
+
+	if (m_enterEvents.GetCount() || m_stayEvents.GetCount() || m_exitEvents.GetCount())
+	{
+		OnTriggerEvents(timestep);
+	}
+}
+
+void ndBodyTriggerVolume::OnTriggerEvents(ndFloat32 timestep)
+{
+	for (ndInt32 i = 0; i < ndInt32(m_exitEvents.GetCount()); ++i)
+	{
+		OnTriggerExit(m_exitEvents[i], timestep);
+	}
+	for (ndInt32 i = 0; i < ndInt32(m_enterEvents.GetCount()); ++i)
+	{
+		OnTriggerEnter(m_enterEvents[i], timestep);
+		OnTrigger(m_enterEvents[i], timestep);
+	}
+	for (ndInt32 i = 0; i < ndInt32(m_stayEvents.GetCount()); ++i)
+	{
+		OnTrigger(m_stayEvents[i], timestep);
+	}
+}
+
+static bool ndRemoveTriggerBody(ndArray<ndBodyKinematic*>& array, const ndBodyKinematic* const body)
+{
+	for (ndInt32 i = 0; i < ndInt32(array.GetCount()); ++i)
+	{
+		if (array[i] == body)
+		{
+			for (ndInt32 j = i + 1; j < ndInt32(array.GetCount()); ++j)
+			{
+				array[j - 1] = array[j];
+			}
+			array.SetCount(array.GetCount() - 1);
+			return true;
+		}
+	}
+	return false;
+}
+
+void ndBodyTriggerVolume::RemoveOverlap(ndBodyKinematic* const body)
+{
+	// the body is about to leave the world, do not keep references to it
+	ndRemoveTriggerBody(m_enterEvents, body);
+	ndRemoveTriggerBody(m_stayEvents, body);
+	ndRemoveTriggerBody(m_exitEvents, body);
+	if (ndRemoveTriggerBody(m_overlaps, body))
+	{
+		OnTriggerExit(body, ndFloat32(0.0f));
 	}
 }
@@ -35,6 +35,16 @@ class ndBodyTriggerVolume : public ndBodyKinematicBase
 
 	ndBodyTriggerVolume* GetAsBodyTriggerVolume();
 
+	// bodies that entered, stayed or left the trigger in the last step, sorted by body id.
+	const ndArray<ndBodyKinematic*>& GetEnterEvents() const;
+	const ndArray<ndBodyKinematic*>& GetStayEvents() const;
+	const ndArray<ndBodyKinematic*>& GetExitEvents() const;
+
+	// called once per step with the batched events, the default calls 
+	// OnTriggerEnter, OnTrigger and OnTriggerExit for each body.
+	// bodies removed from the world while inside report OnTriggerExit right away.
+	D_COLLISION_API virtual void OnTriggerEvents(ndFloat32 timestep);
+
 	virtual void OnTrigger(ndBodyKinematic* const body, ndFloat32 timestep);
 	virtual void OnTriggerEnter(ndBodyKinematic* const body, ndFloat32 timestep);
 	virtual void OnTriggerExit(ndBodyKinematic* const body, ndFloat32 timestep);
@@ -43,7 +53,15 @@ class ndBodyTriggerVolume : public ndBodyKinematicBase
 
 	private:
 	virtual void IntegrateExternalForce(ndFloat32 timestep);
+	void RemoveOverlap(ndBodyKinematic* const body);
+
+	ndArray<ndBodyKinematic*> m_inside;
+	ndArray<ndBodyKinematic*> m_overlaps;
+	ndArray<ndBodyKinematic*> m_enterEvents;
+	ndArray<ndBodyKinematic*> m_stayEvents;
+	ndArray<ndBodyKinematic*> m_exitEvents;
 
+	friend class ndScene;
 } D_GCC_NEWTON_ALIGN_32;
 
 inline ndBodyTriggerVolume* ndBodyTriggerVolume::GetAsBodyTriggerVolume()
@@ -51,6 +69,21 @@ inline ndBodyTriggerVolume* ndBodyTriggerVolume::GetAsBodyTriggerVolume()
 	return this; 
 }
 
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetEnterEvents() const
+{
+	return m_enterEvents;
+}
+
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetStayEvents() const
+{
+	return m_stayEvents;
+}
+
+inline const ndArray<ndBodyKinematic*>& ndBodyTriggerVolume::GetExitEvents() const
+{
+	return m_exitEvents;
+}
+
 inline void ndBodyTriggerVolume::OnTriggerEnter(ndBodyKinematic* const, ndFloat32)
 {
 	//dAssert(0);
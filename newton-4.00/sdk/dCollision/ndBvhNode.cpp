@@ -201,6 +201,7 @@ ndBvhSceneManager::~ndBvhSceneManager()
 
 ndBvhNode* ndBvhSceneManager::AddBody(ndBodyKinematic* const body, ndBvhNode* root)
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_bvh);
 	m_workingArray.m_isDirty = 1;
 	ndBvhLeafNode* const bodyNode = new ndBvhLeafNode(body);
 	ndBvhInternalNode* sceneNode = new ndBvhInternalNode();
@@ -317,6 +318,7 @@ void ndBvhSceneManager::CleanUp()
 
 void ndBvhSceneManager::Update(ndThreadPool& threadPool)
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_bvh);
 	ndBvhNodeArray& nodeArray = m_workingArray;
 
 	if (nodeArray.m_isDirty && nodeArray.GetCount())
@@ -60,11 +60,13 @@
 #include <ndPolygonMeshDesc.h>
 #include <ndShapeStatic_bvh.h>
 #include <ndShapeConvexHull.h>
+#include <ndShapeCache.h>
 #include <ndShapeStaticMesh.h>
 #include <ndShapeHeightfield.h>
 #include <ndConvexCastNotify.h>
 #include <ndBodyPlayerCapsule.h>
 #include <ndBodyTriggerVolume.h>
+#include <ndBodyCrowdController.h>
 #include <ndBodiesInAabbNotify.h>
 #include <ndShapeConvexPolygon.h>
 #include <ndBodyKinematicBase.h>
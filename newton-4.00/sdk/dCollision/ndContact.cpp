@@ -26,20 +26,101 @@
 #include "ndBodyKinematic.h"
 #include "ndContactOptions.h"
 
+// cache lines touched by the bytes [first, last] of an object placed at base
+static constexpr ndInt32 ndCacheLinesSpan(size_t base, size_t first, size_t last)
+{
+	return ndInt32((base + last) / 64 - (base + first) / 64 + 1);
+}
+
 ndVector ndContact::m_initialSeparatingVector(ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(0.0f));
 
 #define D_REST_RELATIVE_VELOCITY		ndFloat32 (1.0e-3f)
 #define D_MAX_DYNAMIC_FRICTION_SPEED	ndFloat32 (0.3f)
 #define D_MAX_PENETRATION_STIFFNESS		ndFloat32 (50.0f)
 #define D_DIAGONAL_REGULARIZER			ndFloat32 (1.0e-3f)
+#define D_CHILD_CACHE_MAX_MOTION		ndFloat32 (1.0e3f)
+
+ndContactChildCache::ndContactChildCache()
+	:ndTree<ndContactChildPair, ndContactChildPairKey, ndContainersFreeListAlloc<ndContactChildPair>>()
+	,m_relativeMatrix(ndGetIdentityMatrix())
+	,m_shape0(nullptr)
+	,m_shape1(nullptr)
+	,m_motion(ndFloat32(0.0f))
+	,m_version0(0)
+	,m_version1(0)
+	,m_lru(0)
+{
+}
+
+void ndContactChildCache::Update(const ndShape* const shape0, const ndShape* const shape1, ndUnsigned32 version0, ndUnsigned32 version1, const ndMatrix& relativeMatrix, ndFloat32 radius0)
+{
+	m_lru++;
+	if ((shape0 != m_shape0) || (shape1 != m_shape1) || (version0 != m_version0) || (version1 != m_version1) || (m_motion > D_CHILD_CACHE_MAX_MOTION))
+	{
+		// the children layout changed, nothing in the cache can be trusted.
+		RemoveAll();
+		m_shape0 = shape0;
+		m_shape1 = shape1;
+		m_version0 = version0;
+		m_version1 = version1;
+		m_motion = ndFloat32(0.0f);
+		m_relativeMatrix = relativeMatrix;
+		return;
+	}
+
+	// upper bound of the displacement of any point of shape0 relative to shape1, 
+	// the chord of the rotation angle is sqrt (3 - trace(R1 * transpose(R0)))
+	const ndVector step((relativeMatrix.m_posit - m_relativeMatrix.m_posit) & ndVector::m_triplexMask);
+	const ndFloat32 trace = 
+		relativeMatrix.m_front.DotProduct(m_relativeMatrix.m_front).GetScalar() +
+		relativeMatrix.m_up.DotProduct(m_relativeMatrix.m_up).GetScalar() +
+		relativeMatrix.m_right.DotProduct(m_relativeMatrix.m_right).GetScalar();
+	const ndFloat32 chord = ndSqrt(ndMax(ndFloat32(3.0f) - trace, ndFloat32(0.0f)));
+	m_motion += ndSqrt(step.DotProduct(step).GetScalar()) + chord * radius0;
+	m_relativeMatrix = relativeMatrix;
+}
+
+ndContactChildPair& ndContactChildCache::GetPair(const void* const key0, const void* const key1)
+{
+	bool wasFound;
+	ndContactChildPair pair;
+	ndNode* const node = Insert(pair, ndContactChildPairKey(key0, key1), wasFound);
+	ndContactChildPair& info = node->GetInfo();
+	if (!wasFound)
+	{
+		info.m_motionStamp = m_motion;
+		info.m_separationDistance = ndFloat32(-1.0f);
+		info.m_separatingVector = ndContact::m_initialSeparatingVector;
+		info.m_supportVertexCache[0] = 0;
+		info.m_supportVertexCache[1] = 0;
+	}
+	info.m_lru = m_lru;
+	return info;
+}
+
+void ndContactChildCache::RemoveStalePairs()
+{
+	// pairs not visited this update are no longer near each other.
+	Iterator it(*this);
+	for (it.Begin(); it; )
+	{
+		ndNode* const node = it.GetNode();
+		it++;
+		if (node->GetInfo().m_lru != m_lru)
+		{
+			Remove(node);
+		}
+	}
+}
+
+#if defined(__GNUC__)
+// the layout checks below take offsetof of a class with virtual functions
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+#endif
 
 ndContact::ndContact()
 	:ndConstraint()
-	,m_positAcc(ndFloat32(10.0f))
-	,m_rotationAcc()
-	,m_separatingVector(m_initialSeparatingVector)
-	,m_contacPointsList()
-	,m_material(nullptr)
 	,m_timeOfImpact(ndFloat32(1.0e10f))
 	,m_separationDistance(ndFloat32(0.0f))
 	,m_sceneLru(0)
@@ -47,14 +128,37 @@ ndContact::ndContact()
 	,m_inTrigger(0)
 	,m_isAttached(0)
 	,m_isIntersetionTestOnly(0)
+	,m_positAcc(ndFloat32(10.0f))
+	,m_rotationAcc()
+	,m_separatingVector(m_initialSeparatingVector)
+	,m_childCache(nullptr)
+	,m_material(nullptr)
 	//,m_skeletonIntraCollision(1)
 	,m_skeletonSelftCollision(1)
+	,m_contacPointsList()
 {
+	// the walks over the contact array in CalculateContacts and DeleteDeadContacts 
+	// read the body pointers and flags of the base class and the hot block. contacts 
+	// are only D_MEMORY_ALIGMNET aligned, so check every placement in a cache line.
+	static_assert(D_MEMORY_ALIGMNET >= 32, "a contact starts at offset 0 or 32 of a cache line");
+	static_assert(ndCacheLinesSpan(0, offsetof(ndContact, m_body0), offsetof(ndContact, m_rotationAcc) + sizeof(ndQuaternion) - 1) <= 2, "contact hot data layout");
+	static_assert(ndCacheLinesSpan(32, offsetof(ndContact, m_body0), offsetof(ndContact, m_rotationAcc) + sizeof(ndQuaternion) - 1) <= 2, "contact hot data layout");
+
 	m_active = 0;
+	m_supportVertexCache[0] = 0;
+	m_supportVertexCache[1] = 0;
 }
 
+#if defined(__GNUC__)
+#pragma GCC diagnostic pop
+#endif
+
 ndContact::~ndContact()
 {
+	if (m_childCache)
+	{
+		delete m_childCache;
+	}
 }
 
 void ndContact::SetBodies(ndBodyKinematic* const body0, ndBodyKinematic* const body1)
@@ -83,10 +187,38 @@ void ndContact::InitSurrogateContact(ndContact* const surrogate, ndBodyKinematic
 
 	surrogate->m_active = m_active;
 	surrogate->m_contacPointsList.RemoveAll();
-	for (ndContactPointList::ndNode* node = m_contacPointsList.GetFirst(); node; node = node->GetNext())
+	for (ndInt32 i = 0; i < m_contacPointsList.GetCount(); ++i)
 	{
-		const ndContactMaterial& contact = node->GetInfo();
-		surrogate->m_contacPointsList.Append(contact);
+		surrogate->m_contacPointsList.Append(m_contacPointsList[i]);
+	}
+}
+
+void ndContactPointList::Reserve(ndInt32 count)
+{
+	if (count > m_capacity)
+	{
+		// few size classes, so that the free list keeps them all
+		ndInt32 capacity = ndMax(m_capacity, ndInt32(D_CONTACT_MIN_POINTS_CAPACITY));
+		while (capacity < count)
+		{
+			capacity *= 2;
+		}
+		ndNode* const points = (ndNode*)ndFreeListAlloc::operator new(size_t(capacity) * sizeof(ndNode));
+		for (ndInt32 i = 0; i < m_count; ++i)
+		{
+			new (&points[i]) ndNode(m_points[i]);
+			points[i].m_next = &points[i + 1];
+		}
+		if (m_count)
+		{
+			points[m_count - 1].m_next = nullptr;
+		}
+		if (m_points)
+		{
+			ndFreeListAlloc::operator delete(m_points);
+		}
+		m_points = points;
+		m_capacity = capacity;
 	}
 }
 
@@ -109,13 +241,11 @@ void ndContact::JacobianDerivative(ndConstraintDescritor& desc)
 	ndInt32 frictionIndex = 0;
 	if (m_maxDof) 
 	{
-		ndInt32 i = 0;
-		frictionIndex = m_contacPointsList.GetCount();
-		for (ndContactPointList::ndNode* node = m_contacPointsList.GetFirst(); node; node = node->GetNext())
+		const ndInt32 count = m_contacPointsList.GetCount();
+		frictionIndex = count;
+		for (ndInt32 i = 0; i < count; ++i)
 		{
-			const ndContactMaterial& contact = node->GetInfo();
-			JacobianContactDerivative(desc, contact, i, frictionIndex);
-			i++;
+			JacobianContactDerivative(desc, m_contacPointsList[i], i, frictionIndex);
 		}
 	}
 	desc.m_rowsCount = frictionIndex;
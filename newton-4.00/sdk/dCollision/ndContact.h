@@ -31,6 +31,7 @@ class ndBodyKinematic;
 class ndShapeInstance;
 
 #define D_MAX_CONTATCS					128
+#define D_CONTACT_MIN_POINTS_CAPACITY	4
 #define D_CONSTRAINT_MAX_ROWS			(3 * 16)
 #define D_RESTING_CONTACT_PENETRATION	(D_PENETRATION_TOL + ndFloat32 (1.0f / 1024.0f))
 
@@ -83,15 +84,139 @@ class ndContactMaterial: public ndContactPoint
 	ndMaterial m_material;
 } D_GCC_NEWTON_ALIGN_32;
 
-class ndContactPointList : public ndList<ndContactMaterial, ndContainersFreeListAlloc<ndContactMaterial>>
+// the contact points of one manifold, stored contiguously in a buffer owned by the list.
+// the buffer lives out of the contact, so the contact array walks do not pay for the 
+// point data. capacities are powers of two from D_CONTACT_MIN_POINTS_CAPACITY, served 
+// by the free list allocator, and the buffer is kept until the contact is destroyed.
+// nodes are linked in array order so the list can still be walked with 
+// GetFirst/GetNext, adding points may relocate the nodes.
+class ndContactPointList
 {
 	public:
-	ndContactPointList()
-		:ndList<ndContactMaterial, ndContainersFreeListAlloc<ndContactMaterial>>()
+	D_MSV_NEWTON_ALIGN_32
+	class ndNode: public ndContactMaterial
 	{
+		public:
+		ndNode()
+			:ndContactMaterial()
+			,m_next(nullptr)
+		{
+		}
+
+		ndContactMaterial& GetInfo()
+		{
+			return *this;
+		}
+
+		const ndContactMaterial& GetInfo() const
+		{
+			return *this;
+		}
+
+		ndNode* GetNext() const
+		{
+			return m_next;
+		}
+
+		private:
+		ndNode* m_next;
+		friend class ndContactPointList;
+	} D_GCC_NEWTON_ALIGN_32;
+
+	ndContactPointList();
+	~ndContactPointList();
+
+	ndInt32 GetCount() const;
+	ndInt32 GetCapacity() const;
+	ndNode* GetFirst() const;
+	ndNode* GetLast() const;
+
+	ndContactMaterial& operator[] (ndInt32 i);
+	const ndContactMaterial& operator[] (ndInt32 i) const;
+
+	ndNode* Append();
+	ndNode* Append(const ndContactMaterial& point);
+
+	// the points after the removed one move down one slot
+	void Remove(ndInt32 index);
+	void Remove(ndNode* const node);
+	void RemoveAll();
+
+	D_COLLISION_API void Reserve(ndInt32 count);
+
+	private:
+	ndContactPointList(const ndContactPointList&);
+	ndContactPointList& operator=(const ndContactPointList&);
+
+	ndNode* m_points;
+	ndInt32 m_count;
+	ndInt32 m_capacity;
+};
+
+class ndContactChildPairKey
+{
+	public:
+	ndContactChildPairKey()
+		:m_key0(nullptr)
+		,m_key1(nullptr)
+	{
+	}
+
+	ndContactChildPairKey(const void* const key0, const void* const key1)
+		:m_key0(key0)
+		,m_key1(key1)
+	{
+	}
+
+	bool operator< (const ndContactChildPairKey& key) const
+	{
+		return (m_key0 < key.m_key0) || ((m_key0 == key.m_key0) && (m_key1 < key.m_key1));
+	}
+
+	bool operator> (const ndContactChildPairKey& key) const
+	{
+		return (m_key0 > key.m_key0) || ((m_key0 == key.m_key0) && (m_key1 > key.m_key1));
 	}
+
+	const void* m_key0;
+	const void* m_key1;
 };
 
+D_MSV_NEWTON_ALIGN_32
+class ndContactChildPair
+{
+	public:
+	ndVector m_separatingVector;
+	ndFloat32 m_separationDistance;
+	ndFloat32 m_motionStamp;
+	ndInt32 m_supportVertexCache[2];
+	ndUnsigned32 m_lru;
+} D_GCC_NEWTON_ALIGN_32;
+
+// narrow phase state of each pair of children of a compound contact, 
+// it lets the contact solver skip child pairs that are known to be apart 
+// until the motion of the two bodies consumes their separation distance.
+D_MSV_NEWTON_ALIGN_32
+class ndContactChildCache: public ndTree<ndContactChildPair, ndContactChildPairKey, ndContainersFreeListAlloc<ndContactChildPair>>
+{
+	public:
+	ndContactChildCache();
+
+	void Update(const ndShape* const shape0, const ndShape* const shape1, ndUnsigned32 version0, ndUnsigned32 version1, const ndMatrix& relativeMatrix, ndFloat32 radius0);
+	ndContactChildPair& GetPair(const void* const key0, const void* const key1);
+	ndFloat32 GetSeparationBound(const ndContactChildPair& pair) const;
+	void SetSeparation(ndContactChildPair& pair, ndFloat32 distance) const;
+	void RemoveStalePairs();
+
+	ndMatrix m_relativeMatrix;
+	const ndShape* m_shape0;
+	const ndShape* m_shape1;
+	ndFloat32 m_motion;
+	ndUnsigned32 m_version0;
+	ndUnsigned32 m_version1;
+	ndUnsigned32 m_lru;
+} D_GCC_NEWTON_ALIGN_32;
+
 D_MSV_NEWTON_ALIGN_32 
 class ndContact: public ndConstraint
 {
@@ -122,24 +247,37 @@ class ndContact: public ndConstraint
 	void CalculatePointDerivative(ndInt32 index, ndConstraintDescritor& desc, const ndVector& dir, const ndPointParam& param) const;
 	void JacobianContactDerivative(ndConstraintDescritor& desc, const ndContactMaterial& contact, ndInt32 normalIndex, ndInt32& frictionIndex);
 
+	// hot data, read for every contact on every substep by CalculateContacts 
+	// and DeleteDeadContacts. it follows the body pointers and flags of the 
+	// base class, the constructor checks that from m_body0 to the end of this 
+	// block the bytes span at most two cache lines for any aligned placement.
+	// a field read by those walks must be added to this block.
+	ndFloat32 m_timeOfImpact;
+	ndFloat32 m_separationDistance;
+	ndUnsigned32 m_sceneLru;
+	ndUnsigned8 m_isDead;
+	ndUnsigned8 m_inTrigger;
+	ndUnsigned8 m_isAttached;
+	ndUnsigned8 m_isIntersetionTestOnly;
 	ndVector m_positAcc;
 	ndQuaternion m_rotationAcc;
+
+	// cold data, only read by the narrow phase and the solver.
+	// the contact points live out of line in m_contacPointsList, so the whole contact 
+	// is a few cache lines. contacts are not moved into handle indexed pools, 
+	// they still come one at a time from the ndConstraint free list allocator.
 	ndVector m_separatingVector;
-	ndContactPointList m_contacPointsList;
+	ndContactChildCache* m_childCache;
 	ndMaterial* m_material;
-	ndFloat32 m_timeOfImpact;
-	ndFloat32 m_separationDistance;
-	ndUnsigned32 m_sceneLru;
-	ndUnsigned32 m_isDead : 1;
-	ndUnsigned32 m_inTrigger : 1;
-	ndUnsigned32 m_isAttached : 1;
-	ndUnsigned32 m_isIntersetionTestOnly : 1;
-	ndUnsigned32 m_skeletonSelftCollision : 1;
+	ndInt32 m_supportVertexCache[2];
+	ndUnsigned8 m_skeletonSelftCollision;
+	ndContactPointList m_contacPointsList;
 	static ndVector m_initialSeparatingVector;
 
 	friend class ndScene;
 	friend class ndIkSolver;
 	friend class ndContactArray;
+	friend class ndContactChildCache;
 	friend class ndBodyKinematic;
 	friend class ndContactSolver;
 	friend class ndShapeInstance;
@@ -148,6 +286,17 @@ class ndContact: public ndConstraint
 	friend class ndBodyPlayerCapsuleContactSolver;
 } D_GCC_NEWTON_ALIGN_32 ;
 
+inline ndFloat32 ndContactChildCache::GetSeparationBound(const ndContactChildPair& pair) const
+{
+	return pair.m_separationDistance - (m_motion - pair.m_motionStamp);
+}
+
+inline void ndContactChildCache::SetSeparation(ndContactChildPair& pair, ndFloat32 distance) const
+{
+	pair.m_motionStamp = m_motion;
+	pair.m_separationDistance = distance;
+}
+
 inline ndContact* ndContact::GetAsContact()
 {
 	return this;
@@ -163,6 +312,102 @@ inline const ndMaterial* ndContact::GetMaterial() const
 //	return m_maxDOF;
 //}
 
+inline ndContactPointList::ndContactPointList()
+	:m_points(nullptr)
+	,m_count(0)
+	,m_capacity(0)
+{
+}
+
+inline ndContactPointList::~ndContactPointList()
+{
+	if (m_points)
+	{
+		ndFreeListAlloc::operator delete(m_points);
+	}
+}
+
+inline ndInt32 ndContactPointList::GetCount() const
+{
+	return m_count;
+}
+
+inline ndInt32 ndContactPointList::GetCapacity() const
+{
+	return m_capacity;
+}
+
+inline ndContactPointList::ndNode* ndContactPointList::GetFirst() const
+{
+	return m_count ? m_points : nullptr;
+}
+
+inline ndContactPointList::ndNode* ndContactPointList::GetLast() const
+{
+	return m_count ? &m_points[m_count - 1] : nullptr;
+}
+
+inline ndContactMaterial& ndContactPointList::operator[] (ndInt32 i)
+{
+	ndAssert(i >= 0);
+	ndAssert(i < m_count);
+	return m_points[i];
+}
+
+inline const ndContactMaterial& ndContactPointList::operator[] (ndInt32 i) const
+{
+	ndAssert(i >= 0);
+	ndAssert(i < m_count);
+	return m_points[i];
+}
+
+inline ndContactPointList::ndNode* ndContactPointList::Append()
+{
+	if (m_count == m_capacity)
+	{
+		Reserve(m_count + 1);
+	}
+	ndNode* const node = new (&m_points[m_count]) ndNode();
+	if (m_count)
+	{
+		m_points[m_count - 1].m_next = node;
+	}
+	m_count++;
+	return node;
+}
+
+inline ndContactPointList::ndNode* ndContactPointList::Append(const ndContactMaterial& point)
+{
+	ndNode* const node = Append();
+	node->GetInfo() = point;
+	return node;
+}
+
+inline void ndContactPointList::Remove(ndInt32 index)
+{
+	ndAssert(index >= 0);
+	ndAssert(index < m_count);
+	m_count--;
+	for (ndInt32 i = index; i < m_count; ++i)
+	{
+		m_points[i].GetInfo() = m_points[i + 1].GetInfo();
+	}
+	if (m_count)
+	{
+		m_points[m_count - 1].m_next = nullptr;
+	}
+}
+
+inline void ndContactPointList::Remove(ndNode* const node)
+{
+	Remove(ndInt32(node - m_points));
+}
+
+inline void ndContactPointList::RemoveAll()
+{
+	m_count = 0;
+}
+
 inline ndContactPointList& ndContact::GetContactPoints()
 {
 	return m_contacPointsList;
@@ -36,6 +36,9 @@
 #include "ndShapeConvexPolygon.h"
 #include "ndShapeStaticProceduralMesh.h"
 
+#define D_CHILD_PAIR_SEPARATION_TOL	ndFloat32 (1.0f / 256.0f)
+#define D_CHILD_PAIR_FACE_PADDING	ndFloat32 (1.0f / 8.0f)
+
 ndVector ndContactSolver::m_pruneUpDir(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(1.0f), ndFloat32(0.0f));
 ndVector ndContactSolver::m_pruneSupportX(ndFloat32(1.0f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f));
 
@@ -344,6 +347,7 @@ ndContactSolver::ndContactSolver()
 	,m_timestep(ndFloat32 (0.0f))
 	,m_skinMargin(ndFloat32(0.0f))
 	,m_separationDistance(ndFloat32(0.0f))
+	,m_faceQueryPadding(ndFloat32(0.0f))
 	,m_threadId(0)
 	,m_maxCount(D_MAX_CONTATCS)
 	,m_faceIndex(0)
@@ -351,6 +355,8 @@ ndContactSolver::ndContactSolver()
 	,m_pruneContacts(1)
 	,m_intersectionTestOnly(0)
 {
+	m_supportVertexCache[0] = 0;
+	m_supportVertexCache[1] = 0;
 }
 
 ndContactSolver::ndContactSolver(ndShapeInstance* const instance, ndContactNotify* const notification, ndFloat32 timestep, ndInt32 threadIndex)
@@ -365,6 +371,7 @@ ndContactSolver::ndContactSolver(ndShapeInstance* const instance, ndContactNotif
 	,m_timestep(timestep)
 	,m_skinMargin(ndFloat32(0.0f))
 	,m_separationDistance(ndFloat32(0.0f))
+	,m_faceQueryPadding(ndFloat32(0.0f))
 	,m_threadId(threadIndex)
 	,m_maxCount(D_MAX_CONTATCS)
 	,m_faceIndex(0)
@@ -372,6 +379,8 @@ ndContactSolver::ndContactSolver(ndShapeInstance* const instance, ndContactNotif
 	,m_pruneContacts(1)
 	,m_intersectionTestOnly(0)
 {
+	m_supportVertexCache[0] = 0;
+	m_supportVertexCache[1] = 0;
 }
 
 ndContactSolver::ndContactSolver(ndContact* const contact, ndContactNotify* const notification, ndFloat32 timestep, ndInt32 threadIndex)
@@ -388,6 +397,7 @@ ndContactSolver::ndContactSolver(ndContact* const contact, ndContactNotify* cons
 	,m_timestep(timestep)
 	,m_skinMargin(ndFloat32(0.0f))
 	,m_separationDistance(ndFloat32(0.0f))
+	,m_faceQueryPadding(ndFloat32(0.0f))
 	,m_threadId(threadIndex)
 	,m_maxCount(D_MAX_CONTATCS)
 	,m_faceIndex(0)
@@ -395,6 +405,8 @@ ndContactSolver::ndContactSolver(ndContact* const contact, ndContactNotify* cons
 	,m_pruneContacts(1)
 	,m_intersectionTestOnly(0)
 {
+	m_supportVertexCache[0] = contact->m_supportVertexCache[0];
+	m_supportVertexCache[1] = contact->m_supportVertexCache[1];
 }
 
 ndContactSolver::ndContactSolver(const ndContactSolver& src, const ndShapeInstance& instance0, const ndShapeInstance& instance1)
@@ -411,6 +423,7 @@ ndContactSolver::ndContactSolver(const ndContactSolver& src, const ndShapeInstan
 	,m_timestep(src.m_timestep)
 	,m_skinMargin(src.m_skinMargin)
 	,m_separationDistance(src.m_separationDistance)
+	,m_faceQueryPadding(ndFloat32(0.0f))
 	,m_threadId(src.m_threadId)
 	,m_maxCount(D_MAX_CONTATCS)
 	,m_faceIndex(0)
@@ -418,6 +431,9 @@ ndContactSolver::ndContactSolver(const ndContactSolver& src, const ndShapeInstan
 	,m_pruneContacts(src.m_pruneContacts)
 	,m_intersectionTestOnly(src.m_intersectionTestOnly)
 {
+	// only reuse the cached support vertices when the shapes did not change
+	m_supportVertexCache[0] = (instance0.GetShape() == src.m_instance0.GetShape()) ? src.m_supportVertexCache[0] : 0;
+	m_supportVertexCache[1] = (instance1.GetShape() == src.m_instance1.GetShape()) ? src.m_supportVertexCache[1] : 0;
 }
 
 void ndContactSolver::TranslateSimplex(const ndVector& step)
@@ -438,8 +454,8 @@ void ndContactSolver::SupportVertex(const ndVector& dir0, ndInt32 vertexIndex)
 	
 	const ndMatrix& matrix0 = m_instance0.m_globalMatrix;
 	const ndMatrix& matrix1 = m_instance1.m_globalMatrix;
-	ndVector p(matrix0.TransformVector(m_instance0.SupportVertexSpecial(matrix0.UnrotateVector (dir0))) & ndVector::m_triplexMask);
-	ndVector q(matrix1.TransformVector(m_instance1.SupportVertexSpecial(matrix1.UnrotateVector (dir1))) & ndVector::m_triplexMask);
+	ndVector p(matrix0.TransformVector(m_instance0.SupportVertexSpecial(matrix0.UnrotateVector (dir0), &m_supportVertexCache[0])) & ndVector::m_triplexMask);
+	ndVector q(matrix1.TransformVector(m_instance1.SupportVertexSpecial(matrix1.UnrotateVector (dir1), &m_supportVertexCache[1])) & ndVector::m_triplexMask);
 	m_hullDiff[vertexIndex] = p - q;
 	m_hullSum[vertexIndex] = p + q;
 }
@@ -2404,6 +2420,76 @@ ndInt32 ndContactSolver::CalculateIntersectingPlane(ndInt32 count)
 	return -1;
 }
 
+bool ndContactSolver::CalculateOverlap()
+{
+	// boolean gjk, stops as soon as a separating plane or a point of the 
+	// minkowski difference closer than the skin margin to the origin is found.
+	const ndFloat64 margin = m_skinMargin + D_PENETRATION_TOL;
+	SupportVertex(m_separatingVector, 0);
+	ndBigVector v(m_hullDiff[0]);
+	ndInt32 index = 1;
+	for (ndInt32 iter = 0; iter < D_CONNICS_CONTATS_ITERATIONS; ++iter)
+	{
+		const ndFloat64 dist2 = v.DotProduct(v).GetScalar();
+		if (dist2 <= margin * margin)
+		{
+			m_separationDistance = ndFloat32(ndSqrt(dist2) - margin);
+			return true;
+		}
+
+		const ndVector dir(v.Scale(-ndRsqrt(dist2)));
+		ndAssert(dir.m_w == ndFloat32(0.0f));
+		SupportVertex(dir, index);
+
+		// the whole minkowski difference is behind the plane through w
+		const ndVector w(m_hullDiff[index]);
+		const ndFloat64 separation = -dir.DotProduct(w).GetScalar();
+		if (separation > margin)
+		{
+			m_separatingVector = dir;
+			m_separationDistance = ndFloat32(separation - margin);
+			return false;
+		}
+
+		const ndVector wv(w - ndVector(v));
+		if (dir.DotProduct(wv).GetScalar() < ndFloat32(1.0e-3f))
+		{
+			// converged, the simplex distance is the shapes distance
+			m_separatingVector = dir;
+			m_separationDistance = ndFloat32(ndSqrt(dist2) - margin);
+			return false;
+		}
+
+		index++;
+		switch (index)
+		{
+			case 2:
+			{
+				v = ReduceLine(index);
+				break;
+			}
+
+			case 3:
+			{
+				v = ReduceTriangle(index);
+				break;
+			}
+
+			case 4:
+			{
+				v = ReduceTetrahedrum(index);
+				break;
+			}
+		}
+	}
+
+	// out of iterations without a decision, 
+	// fall back to the closest points of the full contact path
+	const bool colliding = CalculateClosestPoints();
+	m_separationDistance = m_separatingVector.DotProduct(m_closestPoint1 - m_closestPoint0).GetScalar() - m_skinMargin - D_PENETRATION_TOL;
+	return colliding && (m_separationDistance <= ndFloat32(1.0e-5f));
+}
+
 bool ndContactSolver::CalculateClosestPoints()
 {
 	ndInt32 simplexPointCount = CalculateClosestSimplex();
@@ -2448,6 +2534,8 @@ ndInt32 ndContactSolver::CalculateContactsDiscrete()
 
 	m_contact->m_timeOfImpact = m_timestep;
 	m_contact->m_separatingVector = m_separatingVector;
+	m_contact->m_supportVertexCache[0] = m_supportVertexCache[0];
+	m_contact->m_supportVertexCache[1] = m_supportVertexCache[1];
 	ndAssert(!count || (m_separationDistance < ndFloat32(100.0f)));
 	m_contact->m_separationDistance = m_separationDistance;
 	return count;
@@ -2542,14 +2630,17 @@ ndInt32 ndContactSolver::ConvexToConvexContactsDiscrete()
 	ndAssert(!m_instance1.GetShape()->GetAsShapeNull());
 
 	ndInt32 count = 0;
-	bool colliding = CalculateClosestPoints();
-	ndFloat32 penetration = m_separatingVector.DotProduct(m_closestPoint1 - m_closestPoint0).GetScalar() - m_skinMargin - D_PENETRATION_TOL;
-	m_separationDistance = penetration;
 	if (m_intersectionTestOnly)
 	{
-		count = (penetration <= ndFloat32(0.0f)) ? 1 : 0;
+		// overlap only pairs, like triggers, do not need closest points
+		count = CalculateOverlap() ? 1 : 0;
+		return count;
 	}
-	else if (colliding)
+
+	bool colliding = CalculateClosestPoints();
+	ndFloat32 penetration = m_separatingVector.DotProduct(m_closestPoint1 - m_closestPoint0).GetScalar() - m_skinMargin - D_PENETRATION_TOL;
+	m_separationDistance = penetration;
+	if (colliding)
 	{
 		if (penetration <= ndFloat32(1.0e-5f))
 		{
@@ -2912,6 +3003,23 @@ ndInt32 ndContactSolver::CompoundToConvexContactsDiscrete()
 	return contactCount;
 }
 
+ndContactChildCache* ndContactSolver::GetChildCache(const ndShapeCompound* const compound0, const ndShape* const shape1, ndUnsigned32 version1, const ndMatrix& matrix0, const ndMatrix& matrix1) const
+{
+	ndAssert(m_contact);
+	if (!m_contact->m_childCache)
+	{
+		m_contact->m_childCache = new ndContactChildCache;
+	}
+
+	const ndShapeCompound::ndNodeBase* const root = compound0->m_root;
+	const ndVector extends(root->m_p0.Abs().GetMax(root->m_p1.Abs()) & ndVector::m_triplexMask);
+	const ndFloat32 radius = ndSqrt(extends.DotProduct(extends).GetScalar());
+
+	ndContactChildCache* const childCache = m_contact->m_childCache;
+	childCache->Update(compound0, shape1, compound0->GetVersion(), version1, matrix0 * matrix1.OrthoInverse(), radius);
+	return childCache;
+}
+
 ndInt32 ndContactSolver::CompoundToCompoundContactsDiscrete()
 {
 	ndContact* const contactJoint = m_contact;
@@ -2939,6 +3047,7 @@ ndInt32 ndContactSolver::CompoundToCompoundContactsDiscrete()
 	stackPool[0].m_dist2 = data.CalculateDistance2(compoundShape0->m_root->m_origin, compoundShape0->m_root->m_size, compoundShape1->m_root->m_origin, compoundShape1->m_root->m_size);
 
 	ndFloat32 closestDist = (stackPool[0].m_dist2 > ndFloat32(0.0f)) ? stackPool[0].m_dist2 : ndFloat32(1.0e10f);
+	ndContactChildCache* const childCache = GetChildCache(compoundShape0, compoundShape1, compoundShape1->GetVersion(), matrix0, matrix1);
 
 	ndStackEntry callback;
 	while (stack)
@@ -2965,30 +3074,48 @@ ndInt32 ndContactSolver::CompoundToCompoundContactsDiscrete()
 				bool processContacts = m_notification->OnCompoundSubShapeOverlap(contactJoint, m_timestep, subShape0, subShape1);
 				if (processContacts)
 				{
-					ndShapeInstance childInstance0(*subShape0, subShape0->GetShape());
-					ndShapeInstance childInstance1(*subShape1, subShape1->GetShape());
-					childInstance0.m_globalMatrix = childInstance0.GetLocalMatrix() * matrix0;
-					childInstance1.m_globalMatrix = childInstance1.GetLocalMatrix() * matrix1;
-
-					ndContactSolver contactSolver(*this, childInstance0, childInstance1);
-					contactSolver.m_pruneContacts = 0;
-					contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
-					contactSolver.m_contactBuffer += contactCount;
-
-					ndInt32 count = contactSolver.ConvexContactsDiscrete();
-					ndFloat32 dist = ndMax(contactSolver.m_separationDistance, ndFloat32(0.0f));
-					closestDist = ndMin(closestDist, dist * dist);
-					if (!m_intersectionTestOnly)
+					ndContactChildPair& childPair = childCache->GetPair(node0, node1);
+					const ndFloat32 separationBound = childCache->GetSeparationBound(childPair);
+					if (separationBound > D_CHILD_PAIR_SEPARATION_TOL)
 					{
-						for (ndInt32 i = 0; i < count; ++i)
-						{
-							contacts[contactCount + i].m_shapeInstance0 = subShape0;
-							contacts[contactCount + i].m_shapeInstance1 = subShape1;
-						}
-						contactCount += count;
-						if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+						// this pair was apart and the bodies have not moved enough to close the gap
+						closestDist = ndMin(closestDist, separationBound * separationBound);
+					}
+					else
+					{
+						ndShapeInstance childInstance0(*subShape0, subShape0->GetShape());
+						ndShapeInstance childInstance1(*subShape1, subShape1->GetShape());
+						childInstance0.m_globalMatrix = childInstance0.GetLocalMatrix() * matrix0;
+						childInstance1.m_globalMatrix = childInstance1.GetLocalMatrix() * matrix1;
+
+						ndContactSolver contactSolver(*this, childInstance0, childInstance1);
+						contactSolver.m_pruneContacts = 0;
+						contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
+						contactSolver.m_contactBuffer += contactCount;
+						contactSolver.m_separatingVector = childPair.m_separatingVector;
+						contactSolver.m_supportVertexCache[0] = childPair.m_supportVertexCache[0];
+						contactSolver.m_supportVertexCache[1] = childPair.m_supportVertexCache[1];
+
+						ndInt32 count = contactSolver.ConvexContactsDiscrete();
+						childCache->SetSeparation(childPair, contactSolver.m_separationDistance);
+						childPair.m_separatingVector = contactSolver.m_separatingVector;
+						childPair.m_supportVertexCache[0] = contactSolver.m_supportVertexCache[0];
+						childPair.m_supportVertexCache[1] = contactSolver.m_supportVertexCache[1];
+
+						ndFloat32 dist = ndMax(contactSolver.m_separationDistance, ndFloat32(0.0f));
+						closestDist = ndMin(closestDist, dist * dist);
+						if (!m_intersectionTestOnly)
 						{
-							contactCount = PruneContacts(contactCount, 16);
+							for (ndInt32 i = 0; i < count; ++i)
+							{
+								contacts[contactCount + i].m_shapeInstance0 = subShape0;
+								contacts[contactCount + i].m_shapeInstance1 = subShape1;
+							}
+							contactCount += count;
+							if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+							{
+								contactCount = PruneContacts(contactCount, 16);
+							}
 						}
 					}
 				}
@@ -3054,6 +3181,8 @@ ndInt32 ndContactSolver::CompoundToCompoundContactsDiscrete()
 		}
 	}
 
+	childCache->RemoveStalePairs();
+
 	if (m_pruneContacts && (contactCount > 1))
 	{
 		contactCount = PruneContacts(contactCount, 16);
@@ -3100,6 +3229,7 @@ ndInt32 ndContactSolver::CompoundToShapeStaticBvhContactsDiscrete()
 
 	ndStackBvhStackEntry callback;
 	ndFloat32 closestDist = (stackPool[0].m_dist2 > ndFloat32(0.0f)) ? stackPool[0].m_dist2 : ndFloat32(1.0e10f);
+	ndContactChildCache* const childCache = GetChildCache(compoundShape, bvhTreeCollision, 0, compoundMatrix, treeMatrix);
 	while (stack)
 	{
 		stack--;
@@ -3125,27 +3255,43 @@ ndInt32 ndContactSolver::CompoundToShapeStaticBvhContactsDiscrete()
 				bool processContacts = m_notification->OnCompoundSubShapeOverlap(contactJoint, m_timestep, subShape, bvhTreeInstance);
 				if (processContacts)
 				{
-					ndShapeInstance childInstance(*subShape, subShape->GetShape());
-					childInstance.m_globalMatrix = childInstance.GetLocalMatrix() * compoundMatrix;
-
-					ndContactSolver contactSolver(*this, childInstance, m_instance1);
-					contactSolver.m_pruneContacts = 0;
-					contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
-					contactSolver.m_contactBuffer += contactCount;
-
-					ndInt32 count = contactSolver.ConvexToSaticStaticBvhContactsNodeDescrete(collisionTreeNode);
-					ndFloat32 dist = ndMax(contactSolver.m_separationDistance, ndFloat32(0.0f));
-					closestDist = ndMin(closestDist, dist * dist);
-					if (!m_intersectionTestOnly)
+					ndContactChildPair& childPair = childCache->GetPair(compoundNode, collisionTreeNode);
+					const ndFloat32 separationBound = childCache->GetSeparationBound(childPair);
+					if (separationBound > D_CHILD_PAIR_SEPARATION_TOL)
 					{
-						for (ndInt32 i = 0; i < count; ++i)
-						{
-							contacts[contactCount + i].m_shapeInstance0 = subShape;
-						}
-						contactCount += count;
-						if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+						// this child was apart from the mesh and the bodies have not moved enough to close the gap
+						closestDist = ndMin(closestDist, separationBound * separationBound);
+					}
+					else
+					{
+						ndShapeInstance childInstance(*subShape, subShape->GetShape());
+						childInstance.m_globalMatrix = childInstance.GetLocalMatrix() * compoundMatrix;
+
+						ndContactSolver contactSolver(*this, childInstance, m_instance1);
+						contactSolver.m_pruneContacts = 0;
+						contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
+						contactSolver.m_contactBuffer += contactCount;
+
+						// faces outside the padded query box are at least the padding away from the child
+						contactSolver.m_faceQueryPadding = D_CHILD_PAIR_FACE_PADDING;
+						contactSolver.m_separationDistance = ndFloat32(1.0e10f);
+						ndInt32 count = contactSolver.ConvexToSaticStaticBvhContactsNodeDescrete(collisionTreeNode);
+						const ndFloat32 separation = ndMin(contactSolver.m_separationDistance, D_CHILD_PAIR_FACE_PADDING);
+						childCache->SetSeparation(childPair, separation);
+
+						ndFloat32 dist = ndMax(separation, ndFloat32(0.0f));
+						closestDist = ndMin(closestDist, dist * dist);
+						if (!m_intersectionTestOnly)
 						{
-							contactCount = PruneContacts(contactCount, 16);
+							for (ndInt32 i = 0; i < count; ++i)
+							{
+								contacts[contactCount + i].m_shapeInstance0 = subShape;
+							}
+							contactCount += count;
+							if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+							{
+								contactCount = PruneContacts(contactCount, 16);
+							}
 						}
 					}
 				}
@@ -3233,6 +3379,8 @@ ndInt32 ndContactSolver::CompoundToShapeStaticBvhContactsDiscrete()
 		}
 	}
 
+	childCache->RemoveStalePairs();
+
 	if (m_pruneContacts && (contactCount > 1))
 	{
 		contactCount = PruneContacts(contactCount, 16);
@@ -3252,6 +3400,7 @@ ndInt32 ndContactSolver::CompoundToStaticHeightfieldContactsDiscrete()
 	ndShapeInstance* const compoundInstance = &compoundBody->GetCollisionShape();
 	ndShapeInstance* const heightfieldInstance = &heightfieldBody->GetCollisionShape();
 	ndShapeCompound* const compoundShape = compoundInstance->GetShape()->GetAsShapeCompound();
+	const ndShapeHeightfield* const heightfieldShape = heightfieldInstance->GetShape()->GetAsShapeHeightfield();
 
 	ndShapeCompound::ndNodeBase nodeProxi;
 	nodeProxi.m_left = nullptr;
@@ -3272,6 +3421,7 @@ ndInt32 ndContactSolver::CompoundToStaticHeightfieldContactsDiscrete()
 	stackPool[0] = compoundShape->m_root;
 	stackDistance[0] = callback.CalculateHeighfieldDist2(data, compoundShape->m_root, heightfieldInstance);
 	ndFloat32 closestDist = (stackDistance[0] > ndFloat32(0.0f)) ? stackDistance[0] : ndFloat32(1.0e10f);
+	ndContactChildCache* const childCache = GetChildCache(compoundShape, heightfieldShape, heightfieldShape->GetVersion(), compoundMatrix, heightfieldMatrix);
 
 	while (stack)
 	{
@@ -3295,28 +3445,44 @@ ndInt32 ndContactSolver::CompoundToStaticHeightfieldContactsDiscrete()
 				bool processContacts = m_notification->OnCompoundSubShapeOverlap(contactJoint, m_timestep, subShape, heightfieldInstance);
 				if (processContacts)
 				{
-					ndShapeInstance childInstance(*subShape, subShape->GetShape());
-					childInstance.m_globalMatrix = childInstance.GetLocalMatrix() * compoundMatrix;
-
-					ndContactSolver contactSolver(*this, childInstance, m_instance1);
-					contactSolver.m_pruneContacts = 0;
-					contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
-					contactSolver.m_contactBuffer += contactCount;
-
-					ndInt32 count = contactSolver.ConvexContactsDiscrete();
-					//closestDist = ndMin(closestDist, contactSolver.m_separationDistance);
-					ndFloat32 dist = ndMax(contactSolver.m_separationDistance, ndFloat32(0.0f));
-					closestDist = ndMin(closestDist, dist * dist);
-					if (!m_intersectionTestOnly)
+					ndContactChildPair& childPair = childCache->GetPair(node, heightfieldInstance);
+					const ndFloat32 separationBound = childCache->GetSeparationBound(childPair);
+					if (separationBound > D_CHILD_PAIR_SEPARATION_TOL)
 					{
-						for (ndInt32 i = 0; i < count; ++i)
-						{
-							contacts[contactCount + i].m_shapeInstance0 = subShape;
-						}
-						contactCount += count;
-						if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+						// this child was apart from the mesh and the bodies have not moved enough to close the gap
+						closestDist = ndMin(closestDist, separationBound * separationBound);
+					}
+					else
+					{
+						ndShapeInstance childInstance(*subShape, subShape->GetShape());
+						childInstance.m_globalMatrix = childInstance.GetLocalMatrix() * compoundMatrix;
+
+						ndContactSolver contactSolver(*this, childInstance, m_instance1);
+						contactSolver.m_pruneContacts = 0;
+						contactSolver.m_maxCount = D_MAX_CONTATCS - contactCount;
+						contactSolver.m_contactBuffer += contactCount;
+
+						// faces outside the padded query box are at least the padding away from the child
+						contactSolver.m_faceQueryPadding = D_CHILD_PAIR_FACE_PADDING;
+						contactSolver.m_separationDistance = ndFloat32(1.0e10f);
+						ndInt32 count = contactSolver.ConvexContactsDiscrete();
+						const ndFloat32 separation = ndMin(contactSolver.m_separationDistance, D_CHILD_PAIR_FACE_PADDING);
+						childCache->SetSeparation(childPair, separation);
+
+						//closestDist = ndMin(closestDist, contactSolver.m_separationDistance);
+						ndFloat32 dist = ndMax(separation, ndFloat32(0.0f));
+						closestDist = ndMin(closestDist, dist * dist);
+						if (!m_intersectionTestOnly)
 						{
-							contactCount = PruneContacts(contactCount, 16);
+							for (ndInt32 i = 0; i < count; ++i)
+							{
+								contacts[contactCount + i].m_shapeInstance0 = subShape;
+							}
+							contactCount += count;
+							if (contactCount > (D_MAX_CONTATCS - 2 * (D_CONSTRAINT_MAX_ROWS / 3)))
+							{
+								contactCount = PruneContacts(contactCount, 16);
+							}
 						}
 					}
 				}
@@ -3359,6 +3525,8 @@ ndInt32 ndContactSolver::CompoundToStaticHeightfieldContactsDiscrete()
 		}
 	}
 
+	childCache->RemoveStalePairs();
+
 	if (m_pruneContacts && (contactCount > 1))
 	{
 		contactCount = PruneContacts(contactCount, 16);
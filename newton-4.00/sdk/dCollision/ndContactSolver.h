@@ -29,7 +29,9 @@
 class ndPlane;
 class ndBodyKinematic;
 class ndContactNotify;
+class ndShapeCompound;
 class ndPolygonMeshDesc;
+class ndContactChildCache;
 
 D_MSV_NEWTON_ALIGN_32
 class ndMinkFace
@@ -90,6 +92,7 @@ class ndContactSolver: public ndDownHeap<ndMinkFace *, ndFloat32>
 	ndInt32 CompoundToStaticHeightfieldContactsDiscrete(); // done
 	ndInt32 CalculatePolySoupToHullContactsDescrete(ndPolygonMeshDesc& data); // done
 	ndInt32 ConvexToSaticStaticBvhContactsNodeDescrete(const ndAabbPolygonSoup::ndNode* const node); // done
+	ndContactChildCache* GetChildCache(const ndShapeCompound* const compound0, const ndShape* const shape1, ndUnsigned32 version1, const ndMatrix& matrix0, const ndMatrix& matrix1) const;
 
 	ndInt32 ConvexContactsContinue(); // done
 	ndInt32 CompoundContactsContinue(); // done
@@ -117,6 +120,7 @@ class ndContactSolver: public ndDownHeap<ndMinkFace *, ndFloat32>
 	inline void DeleteFace(ndMinkFace* const face);
 	inline ndMinkFace* AddFace(ndInt32 v0, ndInt32 v1, ndInt32 v2);
 
+	bool CalculateOverlap();
 	bool CalculateClosestPoints();
 	ndInt32 CalculateClosestSimplex();
 	
@@ -159,11 +163,13 @@ class ndContactSolver: public ndDownHeap<ndMinkFace *, ndFloat32>
 	ndFloat32 m_timestep;
 	ndFloat32 m_skinMargin;
 	ndFloat32 m_separationDistance;
+	ndFloat32 m_faceQueryPadding;
 
 	ndInt32 m_threadId;
 	ndInt32 m_maxCount;
 	ndInt32 m_faceIndex;
 	ndInt32 m_vertexIndex;
+	ndInt32 m_supportVertexCache[2];
 	ndUnsigned32 m_pruneContacts		: 1;
 	ndUnsigned32 m_intersectionTestOnly	: 1;
 	
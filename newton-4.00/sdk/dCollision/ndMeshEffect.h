@@ -570,6 +570,11 @@ class ndMeshEffect: public ndPolyhedra
 	D_COLLISION_API ndMeshEffect* InverseConvexMeshIntersection(const ndMeshEffect* const convexMesh) const;
 	D_COLLISION_API ndMeshEffect* CreateVoronoiConvexDecomposition(const ndArray<ndVector>& pointCloud, ndInt32 interiorMaterialIndex, const ndMatrix& textureProjectionMatrix);
 
+	// clips the voronoi cells of the point cloud against the mesh across the thread pool
+	// and returns a compound of one convex hull per piece. ReportProgress is called 
+	// as cells are done, returning false cancels the job and the function returns nullptr.
+	D_COLLISION_API ndShapeInstance* CreateVoronoiConvexCompound(ndThreadPool& threadPool, const ndArray<ndVector>& pointCloud) const;
+
 	protected:
 	D_COLLISION_API void Init();
 	D_COLLISION_API virtual void BeginFace();
@@ -585,6 +590,7 @@ class ndMeshEffect: public ndPolyhedra
 	ndInt32 AddInterpolatedHalfAttribute(ndEdge* const edge, ndInt32 midPoint);
 	
 	void MergeFaces(const ndMeshEffect* const source);
+	void CalculateVoronoiCells(const ndArray<ndVector>& pointCloud, ndArray<ndBigVector>& cellPoints, ndArray<ndInt32>& cellStart) const;
 	D_COLLISION_API ndMeshEffect* GetNextLayer(ndInt32 mark);
 
 	ndString m_name;
@@ -24,6 +24,8 @@
 #include "ndStack.h"
 #include "ndMatrix.h"
 #include "ndMeshEffect.h"
+#include "ndShapeInstance.h"
+#include "ndShapeCompound.h"
 #include "ndConvexHull3d.h"
 #include "ndConvexHull4d.h"
 #include "ndDelaunayTetrahedralization.h"
@@ -1107,7 +1109,7 @@ dAssert(0);
 }
 #endif
 
-ndMeshEffect* ndMeshEffect::CreateVoronoiConvexDecomposition(const ndArray<ndVector>& pointCloud, ndInt32 interiorMaterialIndex, const ndMatrix& textureProjectionMatrix)
+void ndMeshEffect::CalculateVoronoiCells(const ndArray<ndVector>& pointCloud, ndArray<ndBigVector>& cellPoints, ndArray<ndInt32>& cellStart) const
 {
 	ndStack<ndBigVector> buffer(ndInt32(pointCloud.GetCount() + 32));
 	ndBigVector* const pool = &buffer[0];
@@ -1201,10 +1203,10 @@ ndMeshEffect* ndMeshEffect::CreateVoronoiConvexDecomposition(const ndArray<ndVec
 		index++;
 	}
 	
-	const ndFloat32 normalAngleInRadians = ndFloat32(30.0f * ndDegreeToRad);
-	ndMeshEffect* const voronoiPartition = new ndMeshEffect;
-	voronoiPartition->BeginBuild();
-	ndInt32 layer = 0;
+	// each delaunay vertex inside the guard zone is the center of a voronoi cell,
+	// the cell is the convex hull of the centers of the tetrahedra that share the vertex. 
+	cellPoints.SetCount(0);
+	cellStart.SetCount(0);
 	ndTree<ndList<ndInt32>, ndInt32>::Iterator iter(delaunayNodes);
 	for (iter.Begin(); iter; iter++) 
 	{
@@ -1229,23 +1231,44 @@ ndMeshEffect* ndMeshEffect::CreateVoronoiConvexDecomposition(const ndArray<ndVec
 			count1 = ndVertexListToIndexList(&pointArray[0].m_x, sizeof(ndBigVector), 3, count1, &indexArray[0], ndFloat64(1.0e-3f));
 			if (count1 >= 4) 
 			{
-				ndMeshEffect convexMesh(&pointArray[0].m_x, count1, sizeof(ndBigVector), ndFloat64(0.0f));
-				if (convexMesh.GetCount()) 
+				cellStart.PushBack(ndInt32(cellPoints.GetCount()));
+				for (ndInt32 i = 0; i < count1; ++i)
 				{
-					convexMesh.m_materials.SetCount(interiorMaterialIndex + 1);
-					convexMesh.CalculateNormals(normalAngleInRadians);
-					convexMesh.UniformBoxMapping(interiorMaterialIndex, textureProjectionMatrix);
-					for (ndInt32 i = 0; i < convexMesh.m_points.m_vertex.GetCount(); ++i) 
-					{
-						convexMesh.m_points.m_layers[i] = layer;
-					}
-					voronoiPartition->MergeFaces(&convexMesh);
-					layer++;
+					cellPoints.PushBack(pointArray[i]);
 				}
 			}
 		}
 	}
+	cellStart.PushBack(ndInt32(cellPoints.GetCount()));
+}
 
+ndMeshEffect* ndMeshEffect::CreateVoronoiConvexDecomposition(const ndArray<ndVector>& pointCloud, ndInt32 interiorMaterialIndex, const ndMatrix& textureProjectionMatrix)
+{
+	ndArray<ndBigVector> cellPoints;
+	ndArray<ndInt32> cellStart;
+	CalculateVoronoiCells(pointCloud, cellPoints, cellStart);
+
+	const ndFloat32 normalAngleInRadians = ndFloat32(30.0f * ndDegreeToRad);
+	ndMeshEffect* const voronoiPartition = new ndMeshEffect;
+	voronoiPartition->BeginBuild();
+	ndInt32 layer = 0;
+	for (ndInt32 i = 0; i < ndInt32(cellStart.GetCount()) - 1; ++i)
+	{
+		const ndInt32 start = cellStart[i];
+		ndMeshEffect convexMesh(&cellPoints[start].m_x, cellStart[i + 1] - start, sizeof(ndBigVector), ndFloat64(0.0f));
+		if (convexMesh.GetCount()) 
+		{
+			convexMesh.m_materials.SetCount(interiorMaterialIndex + 1);
+			convexMesh.CalculateNormals(normalAngleInRadians);
+			convexMesh.UniformBoxMapping(interiorMaterialIndex, textureProjectionMatrix);
+			for (ndInt32 j = 0; j < convexMesh.m_points.m_vertex.GetCount(); ++j) 
+			{
+				convexMesh.m_points.m_layers[j] = layer;
+			}
+			voronoiPartition->MergeFaces(&convexMesh);
+			layer++;
+		}
+	}
 	voronoiPartition->EndBuild(false);
 	//voronoiPartition->SaveOFF("xxx0.off");
 
@@ -1257,3 +1280,248 @@ ndMeshEffect* ndMeshEffect::CreateVoronoiConvexDecomposition(const ndArray<ndVec
 	}
 	return voronoiPartition;
 }
+
+// the faces of a closed mesh, used to clip convex cells against the mesh from many threads.
+// the hull of the intersection of the mesh with a convex cell is the hull of the mesh faces 
+// clipped by the cell planes, plus the cell vertices that are inside the mesh.
+class ndMeshEffectCellClipper
+{
+	public:
+	ndMeshEffectCellClipper(const ndMeshEffect& mesh)
+		:m_points()
+		,m_faceStart()
+		,m_faceIndex()
+		,m_faceBoxes()
+	{
+		const ndBigVector* const points = (ndBigVector*)mesh.GetVertexPool();
+		for (ndInt32 i = 0; i < mesh.GetVertexCount(); ++i)
+		{
+			m_points.PushBack(points[i]);
+		}
+
+		const ndInt32 mark = mesh.IncLRU();
+		ndPolyhedra::Iterator iter(mesh);
+		for (iter.Begin(); iter; iter++)
+		{
+			ndEdge* const face = &(*iter);
+			if ((face->m_incidentFace > 0) && (face->m_mark != mark))
+			{
+				ndBigVector boxP0(ndFloat64(1.0e20f));
+				ndBigVector boxP1(ndFloat64(-1.0e20f));
+				m_faceStart.PushBack(ndInt32(m_faceIndex.GetCount()));
+				ndEdge* ptr = face;
+				do
+				{
+					ptr->m_mark = mark;
+					m_faceIndex.PushBack(ptr->m_incidentVertex);
+					boxP0 = boxP0.GetMin(m_points[ptr->m_incidentVertex]);
+					boxP1 = boxP1.GetMax(m_points[ptr->m_incidentVertex]);
+					ptr = ptr->m_next;
+				} while (ptr != face);
+				m_faceBoxes.PushBack(boxP0);
+				m_faceBoxes.PushBack(boxP1);
+			}
+		}
+		m_faceStart.PushBack(ndInt32(m_faceIndex.GetCount()));
+	}
+
+	ndShapeInstance* ClipCell(const ndBigVector* const cellPoints, ndInt32 count) const
+	{
+		ndConvexHull3d cell(&cellPoints[0].m_x, sizeof(ndBigVector), count, ndFloat64(0.0f));
+		if (!cell.GetCount())
+		{
+			return nullptr;
+		}
+
+		ndBigVector cellP0;
+		ndBigVector cellP1;
+		cell.GetAABB(cellP0, cellP1);
+		ndArray<ndBigPlane> planes;
+		const ndArray<ndBigVector>& cellVertex = cell.GetVertexPool();
+		for (ndConvexHull3d::ndNode* node = cell.GetFirst(); node; node = node->GetNext())
+		{
+			const ndConvexHull3dFace& face = node->GetInfo();
+			ndBigPlane plane(cellVertex[face.m_index[0]], cellVertex[face.m_index[1]], cellVertex[face.m_index[2]]);
+			plane = plane.Scale(ndFloat64(1.0f) / sqrt(plane.DotProduct(plane & ndBigVector::m_triplexMask).GetScalar()));
+			planes.PushBack(plane);
+		}
+
+		ndArray<ndBigVector> piecePoints;
+		ndArray<ndBigVector> polygon;
+		ndArray<ndBigVector> clipped;
+		for (ndInt32 i = 0; i < ndInt32(cellVertex.GetCount()); ++i)
+		{
+			if (IsInside(cellVertex[i]))
+			{
+				piecePoints.PushBack(cellVertex[i]);
+			}
+		}
+
+		for (ndInt32 i = 0; i < ndInt32(m_faceStart.GetCount()) - 1; ++i)
+		{
+			const ndBigVector& boxP0 = m_faceBoxes[i * 2 + 0];
+			const ndBigVector& boxP1 = m_faceBoxes[i * 2 + 1];
+			const ndBigVector overlap((boxP0 <= cellP1) & (boxP1 >= cellP0));
+			if ((overlap.GetSignMask() & 0x07) == 0x07)
+			{
+				ClipFace(i, planes, piecePoints, polygon, clipped);
+			}
+		}
+
+		if (piecePoints.GetCount() < 4)
+		{
+			return nullptr;
+		}
+		ndMeshEffect piece(&piecePoints[0].m_x, ndInt32(piecePoints.GetCount()), sizeof(ndBigVector), ndFloat64(0.0f));
+		return piece.GetCount() ? piece.CreateConvexCollision(ndFloat64(0.0f)) : nullptr;
+	}
+
+	private:
+	// polygon and clipped are scratch buffers owned by the caller, so that they are 
+	// allocated once per cell. a plane adds at most one point per edge of the polygon.
+	void ClipFace(ndInt32 faceIndex, const ndArray<ndBigPlane>& planes, ndArray<ndBigVector>& piecePoints, ndArray<ndBigVector>& polygon, ndArray<ndBigVector>& clipped) const
+	{
+		ndInt32 count = 0;
+		polygon.SetCount(m_faceStart[faceIndex + 1] - m_faceStart[faceIndex]);
+		for (ndInt32 i = m_faceStart[faceIndex]; i < m_faceStart[faceIndex + 1]; ++i)
+		{
+			polygon[count] = m_points[m_faceIndex[i]];
+			count++;
+		}
+
+		for (ndInt32 i = 0; (i < ndInt32(planes.GetCount())) && count; ++i)
+		{
+			const ndBigPlane& plane = planes[i];
+			ndInt32 clippedCount = 0;
+			clipped.SetCount(count * 2);
+			ndBigVector p0(polygon[count - 1]);
+			ndFloat64 side0 = plane.Evalue(p0);
+			for (ndInt32 j = 0; j < count; ++j)
+			{
+				const ndBigVector& p1 = polygon[j];
+				const ndFloat64 side1 = plane.Evalue(p1);
+				if (side0 <= ndFloat64(0.0f))
+				{
+					clipped[clippedCount] = p0;
+					clippedCount++;
+				}
+				if ((side0 * side1) < ndFloat64(0.0f))
+				{
+					const ndFloat64 t = side0 / (side0 - side1);
+					clipped[clippedCount] = p0 + (p1 - p0).Scale(t);
+					clippedCount++;
+				}
+				p0 = p1;
+				side0 = side1;
+			}
+			ndAssert(clippedCount <= count * 2);
+			clipped.SetCount(clippedCount);
+			polygon.Swap(clipped);
+			count = clippedCount;
+		}
+
+		for (ndInt32 i = 0; i < count; ++i)
+		{
+			piecePoints.PushBack(polygon[i]);
+		}
+	}
+
+	// generalized winding number, the sum of the solid angles of the faces seen from the point
+	bool IsInside(const ndBigVector& point) const
+	{
+		ndFloat64 solidAngle = ndFloat64(0.0f);
+		for (ndInt32 i = 0; i < ndInt32(m_faceStart.GetCount()) - 1; ++i)
+		{
+			const ndInt32 start = m_faceStart[i];
+			const ndBigVector a((m_points[m_faceIndex[start]] - point) & ndBigVector::m_triplexMask);
+			const ndFloat64 aMag = sqrt(a.DotProduct(a).GetScalar());
+			for (ndInt32 j = start + 2; j < m_faceStart[i + 1]; ++j)
+			{
+				const ndBigVector b((m_points[m_faceIndex[j - 1]] - point) & ndBigVector::m_triplexMask);
+				const ndBigVector c((m_points[m_faceIndex[j]] - point) & ndBigVector::m_triplexMask);
+				const ndFloat64 bMag = sqrt(b.DotProduct(b).GetScalar());
+				const ndFloat64 cMag = sqrt(c.DotProduct(c).GetScalar());
+				const ndFloat64 num = a.DotProduct(b.CrossProduct(c)).GetScalar();
+				const ndFloat64 den = aMag * bMag * cMag + a.DotProduct(b).GetScalar() * cMag + a.DotProduct(c).GetScalar() * bMag + b.DotProduct(c).GetScalar() * aMag;
+				solidAngle += ndFloat64(2.0f) * atan2(num, den);
+			}
+		}
+		return fabs(solidAngle) > ndFloat64(2.0f) * ndPi;
+	}
+
+	ndArray<ndBigVector> m_points;
+	ndArray<ndInt32> m_faceStart;
+	ndArray<ndInt32> m_faceIndex;
+	ndArray<ndBigVector> m_faceBoxes;
+};
+
+ndShapeInstance* ndMeshEffect::CreateVoronoiConvexCompound(ndThreadPool& threadPool, const ndArray<ndVector>& pointCloud) const
+{
+	D_TRACKTIME();
+	ndArray<ndBigVector> cellPoints;
+	ndArray<ndInt32> cellStart;
+	CalculateVoronoiCells(pointCloud, cellPoints, cellStart);
+	const ndInt32 cellCount = ndInt32(cellStart.GetCount()) - 1;
+
+	ndArray<ndShapeInstance*> pieces;
+	pieces.SetCount(cellCount);
+
+	// every cell is clipped against the mesh and turned into a hull by one thread,
+	// the calling thread reports partial progress and the report can cancel the job.
+	// completion is reported once all threads are done.
+	const ndMeshEffectCellClipper clipper(*this);
+	ndAtomic<ndInt32> iterator(0);
+	ndAtomic<ndInt32> cellsDone(0);
+	ndAtomic<ndInt32> cancel(0);
+	auto ClipCells = ndMakeObject::ndFunction([this, &clipper, &iterator, &cellsDone, &cancel, &cellPoints, &cellStart, &pieces, cellCount](ndInt32 threadIndex, ndInt32)
+	{
+		D_TRACKTIME_NAMED(ClipCells);
+		for (ndInt32 i = iterator.fetch_add(1); i < cellCount; i = iterator.fetch_add(1))
+		{
+			pieces[i] = nullptr;
+			if (!cancel.load())
+			{
+				const ndInt32 start = cellStart[i];
+				pieces[i] = clipper.ClipCell(&cellPoints[start], cellStart[i + 1] - start);
+			}
+
+			const ndInt32 done = cellsDone.fetch_add(1) + 1;
+			if ((threadIndex == 0) && (done < cellCount) && !cancel.load() && !ReportProgress(ndFloat32(done) / ndFloat32(cellCount)))
+			{
+				cancel.store(1);
+			}
+		}
+	});
+	threadPool.ParallelExecute(ClipCells);
+
+	if (!cancel.load() && !ReportProgress(ndFloat32(1.0f)))
+	{
+		cancel.store(1);
+	}
+
+	// pieces are added in cell order, so the compound does not depend on the thread count.
+	ndShapeInstance* compoundInstance = nullptr;
+	if (!cancel.load())
+	{
+		compoundInstance = new ndShapeInstance(new ndShapeCompound());
+		ndShapeCompound* const compound = compoundInstance->GetShape()->GetAsShapeCompound();
+		compound->BeginAddRemove();
+		for (ndInt32 i = 0; i < cellCount; ++i)
+		{
+			if (pieces[i])
+			{
+				compound->AddCollision(pieces[i]);
+			}
+		}
+		compound->EndAddRemove();
+	}
+
+	for (ndInt32 i = 0; i < cellCount; ++i)
+	{
+		if (pieces[i])
+		{
+			delete pieces[i];
+		}
+	}
+	return compoundInstance;
+}
@@ -71,6 +71,16 @@ ndPolygonMeshDesc::ndPolygonMeshDesc(ndContactSolver& proxy, bool ccdMode)
 	m_staticMeshQuery = &scene->m_staticMeshQuery[proxy.m_threadId];
 	m_proceduralStaticMeshFaceQuery = &scene->m_proceduralStaticMeshQuery[proxy.m_threadId];
 	Init();
+
+	if (proxy.m_faceQueryPadding > ndFloat32(0.0f))
+	{
+		// grow the query box, so that any face not collected 
+		// is at least the padding distance away from the convex shape.
+		const ndVector padding((m_polySoupInstance->GetInvScale() * ndVector(proxy.m_faceQueryPadding)) & ndVector::m_triplexMask);
+		m_p0 -= padding;
+		m_p1 += padding;
+		m_size += padding.GetMax() & ndVector::m_triplexMask;
+	}
 }
 
 ndPolygonMeshDesc::~ndPolygonMeshDesc()
@@ -40,6 +40,8 @@
 #define D_NARROW_PHASE_DIST			ndFloat32 (0.2f)
 #define D_CONTACT_TRANSLATION_ERROR	ndFloat32 (1.0e-3f)
 #define D_CONTACT_ANGULAR_ERROR		(ndFloat32 (0.25f * ndDegreeToRad))
+#define D_CONTACT_PAIR_KEY_BITS		8
+#define D_CONTACT_QUIET_PAIR_KEY	((1 << D_CONTACT_PAIR_KEY_BITS) - 1)
 
 ndVector ndScene::m_velocTol(ndFloat32(1.0e-16f));
 ndVector ndScene::m_angularContactError2(D_CONTACT_ANGULAR_ERROR * D_CONTACT_ANGULAR_ERROR);
@@ -51,15 +53,17 @@ ndScene::ndScene()
 	,m_particleSetList()
 	,m_contactArray()
 	,m_bvhSceneManager()
-	,m_scratchBuffer(1024 * sizeof (void*))
 	,m_sceneBodyArray(1024)
 	,m_activeConstraintArray(1024)
 	,m_specialUpdateList()
+	,m_specialUpdateArray()
 	,m_backgroundThread()
 	,m_newPairs(1024)
+	,m_contactBatches(256)
 	,m_lock()
 	,m_rootNode(nullptr)
 	,m_sentinelBody(nullptr)
+	,m_scratchContactArray(nullptr)
 	,m_contactNotifyCallback(new ndContactNotify(nullptr))
 	,m_timestep(ndFloat32 (0.0f))
 	,m_lru(D_CONTACT_DELAY_FRAMES)
@@ -82,15 +86,17 @@ ndScene::ndScene(const ndScene& src)
 	,m_particleSetList()
 	,m_contactArray(src.m_contactArray)
 	,m_bvhSceneManager(src.m_bvhSceneManager)
-	,m_scratchBuffer()
 	,m_sceneBodyArray()
 	,m_activeConstraintArray()
 	,m_specialUpdateList()
+	,m_specialUpdateArray()
 	,m_backgroundThread()
 	,m_newPairs(1024)
+	,m_contactBatches(256)
 	,m_lock()
 	,m_rootNode(nullptr)
 	,m_sentinelBody(nullptr)
+	,m_scratchContactArray(nullptr)
 	,m_contactNotifyCallback(nullptr)
 	,m_timestep(ndFloat32(0.0f))
 	,m_lru(src.m_lru)
@@ -103,7 +109,6 @@ ndScene::ndScene(const ndScene& src)
 	SetThreadCount(src.GetThreadCount());
 	m_backgroundThread.SetThreadCount(m_backgroundThread.GetThreadCount());
 
-	m_scratchBuffer.Swap(stealData->m_scratchBuffer);
 	m_sceneBodyArray.Swap(stealData->m_sceneBodyArray);
 	m_activeConstraintArray.Swap(stealData->m_activeConstraintArray);
 
@@ -174,6 +179,16 @@ void ndScene::End()
 	m_frameNumber++;
 }
 
+void ndScene::ResetFrameArena()
+{
+	m_frameArena.Reset();
+}
+
+size_t ndScene::GetFrameArenaPeakUsage() const
+{
+	return m_frameArena.GetPeakUsage();
+}
+
 bool ndScene::AddParticle(const ndSharedPtr<ndBody>& particle)
 {
 	ndBodyParticleSet* const particleSet = particle->GetAsBodyParticleSet();
@@ -278,9 +293,15 @@ bool ndScene::RemoveBody(const ndSharedPtr<ndBody>& body)
 		m_bvhSceneManager.RemoveBody(kinematicBody);
 
 		ndBodyKinematic::ndContactMap& contactMap = kinematicBody->GetContactMap();
-		while (contactMap.GetRoot())
+		while (contactMap.GetCount())
 		{
-			ndContact* const contact = contactMap.GetRoot()->GetInfo();
+			ndContact* const contact = contactMap.GetContact(contactMap.GetCount() - 1);
+			ndBodyKinematic* const otherBody = (contact->GetBody0() == kinematicBody) ? contact->GetBody1() : contact->GetBody0();
+			ndBodyTriggerVolume* const trigger = otherBody->GetAsBodyTriggerVolume();
+			if (trigger)
+			{
+				trigger->RemoveOverlap(kinematicBody);
+			}
 			m_contactArray.DetachContact(contact);
 		}
 
@@ -404,19 +425,9 @@ void ndScene::CalculateJointContacts(ndInt32 threadIndex, ndContact* const conta
 			contact->SetActive(true);
 			if (contactSolver.m_intersectionTestOnly)
 			{
-				ndBodyKinematic* otherBody = body0;
-				ndBodyTriggerVolume* trigger = body1->GetAsBodyTriggerVolume();
-				if (!trigger)
-				{
-					otherBody = body1;
-					trigger = body0->GetAsBodyTriggerVolume();
-				}
-
-				if (trigger && !contact->m_inTrigger)
-				{
-					contact->m_inTrigger = 1;
-					trigger->OnTriggerEnter(otherBody, m_timestep);
-				}
+				// trigger events are collected by the trigger in its special update
+				const bool isTrigger = body0->GetAsBodyTriggerVolume() || body1->GetAsBodyTriggerVolume();
+				contact->m_inTrigger = isTrigger ? 1 : 0;
 				contact->m_isIntersetionTestOnly = 1;
 			}
 			else
@@ -431,20 +442,7 @@ void ndScene::CalculateJointContacts(ndInt32 threadIndex, ndContact* const conta
 		{
 			if (contactSolver.m_intersectionTestOnly)
 			{
-				ndBodyKinematic* otherBody = body0;
-				ndBodyTriggerVolume* trigger = body1->GetAsBodyTriggerVolume();
-				if (!trigger)
-				{
-					otherBody = body1;
-					trigger = body0->GetAsBodyTriggerVolume();
-				}
-				
-				if (trigger && contact->m_inTrigger)
-				{
-					contact->m_inTrigger = 0;
-					ndAssert(contact->m_isIntersetionTestOnly);
-					trigger->GetAsBodyTriggerVolume()->OnTriggerExit(otherBody, m_timestep);
-				}
+				contact->m_inTrigger = 0;
 				contact->m_isIntersetionTestOnly = 1;
 			}
 			contact->m_maxDof = 0;
@@ -467,15 +465,14 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 	contact->m_material = m_contactNotifyCallback->GetMaterial(contact, body0->GetCollisionShape(), body1->GetCollisionShape());
 	const ndContactPoint* const contactArray = contactSolver->m_contactBuffer;
 	
-	ndInt32 count = 0;
 	ndVector cachePosition[D_MAX_CONTATCS];
-	ndContactPointList::ndNode* nodes[D_MAX_CONTATCS];
+	ndInt32 cacheIndex[D_MAX_CONTATCS];
 	ndContactPointList& contactPointList = contact->m_contacPointsList;
-	for (ndContactPointList::ndNode* contactNode = contactPointList.GetFirst(); contactNode; contactNode = contactNode->GetNext()) 
+	ndInt32 count = contactPointList.GetCount();
+	for (ndInt32 i = 0; i < count; ++i) 
 	{
-		nodes[count] = contactNode;
-		cachePosition[count] = contactNode->GetInfo().m_point;
-		count++;
+		cacheIndex[i] = i;
+		cachePosition[i] = contactPointList[i].m_point;
 	}
 	
 	const ndVector& v0 = body0->m_veloc;
@@ -522,7 +519,6 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 	{
 		ndInt32 index = -1;
 		ndFloat32 min = ndFloat32(1.0e20f);
-		ndContactPointList::ndNode* contactNode = nullptr;
 		for (ndInt32 j = 0; j < count; ++j) 
 		{
 			ndVector v(ndVector::m_triplexMask & (cachePosition[j] - contactArray[i].m_point));
@@ -532,23 +528,21 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 			{
 				index = j;
 				min = diff;
-				contactNode = nodes[j];
 			}
 		}
 	
-		if (contactNode) 
+		ndContactMaterial* contactPoint = nullptr;
+		if (index != -1) 
 		{
 			count--;
-			ndAssert(index != -1);
-			nodes[index] = nodes[count];
+			contactPoint = &contactPointList[cacheIndex[index]];
+			cacheIndex[index] = cacheIndex[count];
 			cachePosition[index] = cachePosition[count];
 		}
 		else 
 		{
-			contactNode = contactPointList.Append();
+			contactPoint = &contactPointList.Append()->GetInfo();
 		}
-
-		ndContactMaterial* const contactPoint = &contactNode->GetInfo();
 	
 		ndAssert(ndCheckFloat(contactArray[i].m_point.m_x));
 		ndAssert(ndCheckFloat(contactArray[i].m_point.m_y));
@@ -639,9 +633,20 @@ void ndScene::ProcessContacts(ndInt32, ndInt32 contactCount, ndContactSolver* co
 		ndAssert(contactPoint->m_normal.m_w == ndFloat32(0.0f));
 	}
 	
+	// remove the unused points from the back, so the indices stay valid
+	for (ndInt32 i = 1; i < count; ++i)
+	{
+		const ndInt32 key = cacheIndex[i];
+		ndInt32 j = i - 1;
+		for (; (j >= 0) && (cacheIndex[j] < key); --j)
+		{
+			cacheIndex[j + 1] = cacheIndex[j];
+		}
+		cacheIndex[j + 1] = key;
+	}
 	for (ndInt32 i = 0; i < count; ++i) 
 	{
-		contactPointList.Remove(nodes[i]);
+		contactPointList.Remove(cacheIndex[i]);
 	}
 	
 	//contact->m_maxDof = ndUnsigned32(3 * contactPointList.GetCount());
@@ -919,9 +924,38 @@ void ndScene::CalculateContacts(ndInt32 threadIndex, ndContact* const contact)
 
 void ndScene::UpdateSpecial()
 {
+	D_TRACKTIME();
+	if (!m_specialUpdateList.GetCount())
+	{
+		return;
+	}
+
+	m_specialUpdateArray.SetCount(0);
 	for (ndSpecialList<ndBodyKinematic>::ndNode* node = m_specialUpdateList.GetFirst(); node; node = node->GetNext())
 	{
-		ndBodyKinematic* const body = node->GetInfo();
+		m_specialUpdateArray.PushBack(node->GetInfo());
+	}
+
+	// first pass runs concurrently, each body can only change its own state.
+	ndAtomic<ndInt32> iterator(0);
+	auto SpecialUpdateParallel = ndMakeObject::ndFunction([this, &iterator](ndInt32 threadIndex, ndInt32)
+	{
+		D_TRACKTIME_NAMED(SpecialUpdateParallel);
+		const ndFloat32 timestep = m_timestep;
+		const ndInt32 count = ndInt32(m_specialUpdateArray.GetCount());
+		for (ndInt32 i = iterator++; i < count; i = iterator++)
+		{
+			ndBodyKinematic* const body = m_specialUpdateArray[i];
+			body->SpecialUpdateParallel(threadIndex, timestep);
+		}
+	});
+	ParallelExecute(SpecialUpdateParallel);
+
+	// second pass runs serially in special list order, 
+	// here bodies can apply effects to other bodies and call user callbacks.
+	for (ndInt32 i = 0; i < ndInt32(m_specialUpdateArray.GetCount()); ++i)
+	{
+		ndBodyKinematic* const body = m_specialUpdateArray[i];
 		body->SpecialUpdate(m_timestep);
 	}
 }
@@ -1204,10 +1238,10 @@ void ndScene::Cleanup()
 	m_contactArray.Resize(1024);
 	m_sceneBodyArray.Resize(1024);
 	m_activeConstraintArray.Resize(1024);
-	m_scratchBuffer.Resize(1024 * sizeof(void*));
 
 	m_contactArray.SetCount(0);
-	m_scratchBuffer.SetCount(0);
+	m_scratchContactArray = nullptr;
+	m_frameArena.CleanUp();
 	m_sceneBodyArray.SetCount(0);
 	m_activeConstraintArray.SetCount(0);
 }
@@ -1540,14 +1574,15 @@ void ndScene::CreateNewContacts()
 {
 	D_TRACKTIME();
 	const ndInt32 contactCount = ndInt32(m_contactArray.GetCount());
-	m_scratchBuffer.SetCount(ndInt32((contactCount + m_newPairs.GetCount() + 16) * sizeof(ndContact*)));
-
-	ndContact** const tmpJointsArray = (ndContact**)&m_scratchBuffer[0];
+	// CalculateContacts and DeleteDeadContacts use this array later in the substep
+	m_scratchContactArray = m_frameArena.Alloc<ndContact*>(ndInt32(contactCount + m_newPairs.GetCount() + 16));
+	ndContact** const tmpJointsArray = m_scratchContactArray;
 
 	ndAtomic<ndInt32> iterator(0);
 	auto CreateNewContacts = ndMakeObject::ndFunction([this, &iterator, tmpJointsArray](ndInt32, ndInt32)
 	{
 		D_TRACKTIME_NAMED(CreateNewContacts);
+		ndMemory::ndCategoryScope scope(ndMemory::m_contacts);
 		const ndArray<ndContactPairs>& newPairs = m_newPairs;
 		ndBodyKinematic** const bodyArray = &GetActiveBodyArray()[0];
 
@@ -1588,28 +1623,173 @@ void ndScene::CreateNewContacts()
 	}
 }
 
+ndInt32 ndScene::CalculatePairCost(const ndContact* const contact) const
+{
+	class ndShapeComplexity
+	{
+		public:
+		ndShapeComplexity(const ndShapeInstance& instance)
+		{
+			const ndShape* const shape = instance.GetShape();
+			switch (shape->GetCollisionId())
+			{
+				case ::m_sphere:
+				case ::m_capsule:
+				case ::m_pointCollision:
+				case ::m_nullCollision:
+					m_cost = 1;
+					break;
+
+				case ::m_box:
+				case ::m_cone:
+				case ::m_cylinder:
+				case ::m_chamferCylinder:
+					m_cost = 2;
+					break;
+
+				case ::m_convexHull:
+					m_cost = 2 + shape->GetConvexVertexCount() / 16;
+					break;
+
+				case ::m_compound:
+					m_cost = 2 + ((ndShape*)shape)->GetAsShapeCompound()->GetTree().GetCount() / 2;
+					break;
+
+				case ::m_staticProceduralMesh:
+					m_cost = 32;
+					break;
+
+				default:
+					m_cost = 16;
+			}
+		}
+		ndInt32 m_cost;
+	};
+
+	const ndShapeComplexity cost0(contact->GetBody0()->GetCollisionShape());
+	const ndShapeComplexity cost1(contact->GetBody1()->GetCollisionShape());
+	return ndMin(cost0.m_cost * cost1.m_cost, ndInt32(D_WORKER_BATCH_SIZE));
+}
+
+void ndScene::BuildContactBatches(ndContact** const srcArray, ndContact** const dstArray, ndInt32 count)
+{
+	D_TRACKTIME();
+	class ndContactPairTypeKey
+	{
+		public:
+		ndContactPairTypeKey(void* const)
+		{
+		}
+
+		ndInt32 GetKey(const ndContact* const contact) const
+		{
+			const ndBodyKinematic* const body0 = contact->GetBody0();
+			const ndBodyKinematic* const body1 = contact->GetBody1();
+			if (contact->m_isDead | (body0->m_equilibrium & body1->m_equilibrium))
+			{
+				return D_CONTACT_QUIET_PAIR_KEY;
+			}
+			const ndInt32 id0 = body0->GetCollisionShape().GetShape()->GetCollisionId();
+			const ndInt32 id1 = body1->GetCollisionShape().GetShape()->GetCollisionId();
+			return (id0 << 4) + id1;
+		}
+	};
+
+	class ndBucket
+	{
+		public:
+		ndInt32 m_start;
+		ndInt32 m_count;
+		ndInt32 m_cost;
+	};
+
+	class ndCompareBucket
+	{
+		public:
+		ndCompareBucket(void* const)
+		{
+		}
+
+		ndInt32 Compare(const ndBucket& bucketA, const ndBucket& bucketB) const
+		{
+			if (bucketA.m_cost > bucketB.m_cost)
+			{
+				return -1;
+			}
+			else if (bucketA.m_cost < bucketB.m_cost)
+			{
+				return 1;
+			}
+			return bucketA.m_start - bucketB.m_start;
+		}
+	};
+
+	// bucket all contacts by shape pair type, so that contiguous 
+	// work items run the same narrow phase code path.
+	ndUnsigned32 prefixScan[(1 << D_CONTACT_PAIR_KEY_BITS) + 1];
+	ndCountingSort<ndContact*, ndContactPairTypeKey, D_CONTACT_PAIR_KEY_BITS>(*this, srcArray, dstArray, count, prefixScan, nullptr);
+
+	ndInt32 bucketCount = 0;
+	ndBucket buckets[1 << D_CONTACT_PAIR_KEY_BITS];
+	for (ndInt32 i = 0; i < (1 << D_CONTACT_PAIR_KEY_BITS); ++i)
+	{
+		const ndInt32 start = ndInt32(prefixScan[i]);
+		const ndInt32 size = ndInt32(prefixScan[i + 1]) - start;
+		if (size)
+		{
+			ndBucket& bucket = buckets[bucketCount];
+			bucket.m_start = start;
+			bucket.m_count = size;
+			bucket.m_cost = (i == D_CONTACT_QUIET_PAIR_KEY) ? 0 : CalculatePairCost(dstArray[start]);
+			bucketCount++;
+		}
+	}
+
+	// dispatch the most expensive pair types first, and size 
+	// each batch so that all batches carry similar work.
+	ndSort<ndBucket, ndCompareBucket>(buckets, bucketCount, nullptr);
+
+	m_contactBatches.SetCount(0);
+	for (ndInt32 i = 0; i < bucketCount; ++i)
+	{
+		const ndBucket& bucket = buckets[i];
+		const ndInt32 batchSize = ndMax(ndInt32(D_WORKER_BATCH_SIZE) / ndMax(bucket.m_cost, 1), 1);
+		const ndInt32 end = bucket.m_start + bucket.m_count;
+		for (ndInt32 j = bucket.m_start; j < end; j += batchSize)
+		{
+			m_contactBatches.PushBack(ndContactBatch(j, ndMin(batchSize, end - j)));
+		}
+	}
+}
+
 void ndScene::CalculateContacts()
 {
 	D_TRACKTIME();
+	ndMemory::ndCategoryScope scope(ndMemory::m_contacts);
 	m_activeConstraintArray.SetCount(0);
 	const ndInt32 contactCount = ndInt32(m_contactArray.GetCount() + m_newPairs.GetCount());
 	m_contactArray.SetCount(contactCount);
 	if (contactCount)
 	{
-		ndContact** const tmpJointsArray = (ndContact**)&m_scratchBuffer[0];
+		// the contact array is rebuilt from the scratch buffer by DeleteDeadContacts, 
+		// so it can be used here to hold the contacts sorted by pair type.
+		ndContact** const tmpJointsArray = m_scratchContactArray;
+		ndContact** const sortedJointsArray = &m_contactArray[0];
+		BuildContactBatches(tmpJointsArray, sortedJointsArray, contactCount);
 
 		ndAtomic<ndInt32> iterator(0);
-		auto CalculateContactPoints = ndMakeObject::ndFunction([this, &iterator, tmpJointsArray](ndInt32 threadIndex, ndInt32)
+		auto CalculateContactPoints = ndMakeObject::ndFunction([this, &iterator, sortedJointsArray](ndInt32 threadIndex, ndInt32)
 		{
 			D_TRACKTIME_NAMED(CalculateContactPoints);
+			ndMemory::ndCategoryScope scope(ndMemory::m_contacts);
 
-			const ndInt32 jointCount = ndInt32(m_contactArray.GetCount());
-			for (ndInt32 i = iterator.fetch_add(D_WORKER_BATCH_SIZE); i < jointCount; i = iterator.fetch_add(D_WORKER_BATCH_SIZE))
+			const ndInt32 batchCount = ndInt32(m_contactBatches.GetCount());
+			for (ndInt32 i = iterator++; i < batchCount; i = iterator++)
 			{
-				const ndInt32 maxSpan = ((jointCount - i) >= D_WORKER_BATCH_SIZE) ? D_WORKER_BATCH_SIZE : jointCount - i;
-				for (ndInt32 j = 0; j < maxSpan; ++j)
+				const ndContactBatch& batch = m_contactBatches[i];
+				for (ndInt32 j = 0; j < batch.m_count; ++j)
 				{
-					ndContact* const contact = tmpJointsArray[i + j];
+					ndContact* const contact = sortedJointsArray[batch.m_start + j];
 					ndAssert(contact);
 					if (!contact->m_isDead)
 					{
@@ -1656,7 +1836,7 @@ void ndScene::DeleteDeadContacts()
 	if (m_contactArray.GetCount())
 	{
 		D_TRACKTIME();
-		ndContact** const tmpJointsArray = (ndContact**)&m_scratchBuffer[0];
+		ndContact** const tmpJointsArray = m_scratchContactArray;
 		ndCountingSort<ndContact*, ndJointActive, 2>(*this, tmpJointsArray, &m_contactArray[0], ndInt32(m_contactArray.GetCount()), prefixScan, nullptr);
 		if (prefixScan[m_dead + 1] != prefixScan[m_dead])
 		{
@@ -1697,6 +1877,21 @@ void ndScene::DeleteDeadContacts()
 	}
 }
 
+void ndScene::ParticleCoupling()
+{
+	D_TRACKTIME();
+	for (ndBodyList::ndNode* node = m_particleSetList.GetFirst(); node; node = node->GetNext())
+	{
+		ndBodyParticleSet* const body = node->GetInfo()->GetAsBodyParticleSet();
+		if (body->GetBodyCoupling() && body->GetPositions().GetCount())
+		{
+			// the particles can not be touched while the background update is running
+			body->Sync();
+			body->CoupleBodies(this);
+		}
+	}
+}
+
 void ndScene::ParticleUpdate(ndFloat32 timestep)
 {
 	D_TRACKTIME();
@@ -71,6 +71,25 @@ class ndScene : public ndThreadPool
 		ndUnsigned32 m_body1;
 	};
 
+	class ndContactBatch
+	{
+		public:
+		ndContactBatch()
+			:m_start(0)
+			,m_count(0)
+		{
+		}
+
+		ndContactBatch(ndInt32 start, ndInt32 count)
+			:m_start(start)
+			,m_count(count)
+		{
+		}
+
+		ndInt32 m_start;
+		ndInt32 m_count;
+	};
+
 	public:
 	D_COLLISION_API virtual ~ndScene();
 	D_COLLISION_API virtual bool AddBody(const ndSharedPtr<ndBody>& body);
@@ -110,7 +129,14 @@ class ndScene : public ndThreadPool
 	ndArray<ndConstraint*>& GetActiveContactArray();
 	const ndArray<ndConstraint*>& GetActiveContactArray() const;
 
-	ndArray<ndUnsigned8>& GetScratchBuffer();
+	// transient memory for the step being simulated, reset at the start of every substep.
+	// it replaces the old GetScratchBuffer. buffers are carved from the thread that 
+	// drives the update, before the parallel jobs that use them are dispatched.
+	ndFrameArena& GetFrameArena();
+	D_COLLISION_API void ResetFrameArena();
+
+	// the largest amount of transient memory used by one step
+	D_COLLISION_API size_t GetFrameArenaPeakUsage() const;
 
 	ndFloat32 GetTimestep() const;
 	void SetTimestep(ndFloat32 timestep);
@@ -128,6 +154,8 @@ class ndScene : public ndThreadPool
 	void AddPair(ndBodyKinematic* const body0, ndBodyKinematic* const body1, ndInt32 threadId);
 	void SubmitPairs(ndBvhLeafNode* const bodyNode, ndBvhNode* const node, bool forward, ndInt32 threadId);
 
+	ndInt32 CalculatePairCost(const ndContact* const contact) const;
+	void BuildContactBatches(ndContact** const srcArray, ndContact** const dstArray, ndInt32 count);
 	void CalculateJointContacts(ndInt32 threadIndex, ndContact* const contact);
 	void ProcessContacts(ndInt32 threadIndex, ndInt32 contactCount, ndContactSolver* const contactSolver);
 
@@ -150,6 +178,7 @@ class ndScene : public ndThreadPool
 	D_COLLISION_API virtual void CalculateContacts(ndInt32 threadIndex, ndContact* const contact);
 	D_COLLISION_API virtual void UpdateTransformNotify(ndInt32 threadIndex, ndBodyKinematic* const body);
 
+	D_COLLISION_API virtual void ParticleCoupling();
 	D_COLLISION_API virtual void ParticleUpdate(ndFloat32 timestep);
 	D_COLLISION_API virtual bool AddParticle(const ndSharedPtr<ndBody>& particle);
 	D_COLLISION_API virtual bool RemoveParticle(const ndSharedPtr<ndBody>& particle);
@@ -158,19 +187,22 @@ class ndScene : public ndThreadPool
 	ndBodyList m_particleSetList;
 	ndContactArray m_contactArray;
 	ndBvhSceneManager m_bvhSceneManager;
-	ndArray<ndUnsigned8> m_scratchBuffer;
 	ndArray<ndBodyKinematic*> m_sceneBodyArray;
 	ndArray<ndConstraint*> m_activeConstraintArray;
 	ndSpecialList<ndBodyKinematic> m_specialUpdateList;
+	ndArray<ndBodyKinematic*> m_specialUpdateArray;
 	ndThreadBackgroundWorker m_backgroundThread;
 	ndArray<ndContactPairs> m_newPairs;
+	ndArray<ndContactBatch> m_contactBatches;
 	ndArray<ndContactPairs> m_partialNewPairs[D_MAX_THREADS_COUNT];
 	ndPolygonMeshDesc::ndStaticMeshFaceQuery m_staticMeshQuery[D_MAX_THREADS_COUNT];
 	ndPolygonMeshDesc::ndProceduralStaticMeshFaceQuery m_proceduralStaticMeshQuery[D_MAX_THREADS_COUNT];
+	ndFrameArena m_frameArena;
 
 	ndSpinLock m_lock;
 	ndBvhNode* m_rootNode;
 	ndBodyKinematic* m_sentinelBody;
+	ndContact** m_scratchContactArray;
 	ndContactNotify* m_contactNotifyCallback;
 	
 	ndFloat32 m_timestep;
@@ -216,9 +248,9 @@ inline ndInt32 ndScene::GetThreadCount() const
 	return pool.GetThreadCount();
 }
 
-inline ndArray<ndUnsigned8>& ndScene::GetScratchBuffer()
+inline ndFrameArena& ndScene::GetFrameArena()
 {
-	return m_scratchBuffer;
+	return m_frameArena;
 }
 
 inline const ndBodyList& ndScene::GetParticleList() const
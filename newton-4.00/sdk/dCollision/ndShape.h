@@ -242,6 +242,7 @@ class ndShape: public ndContainersFreeListAlloc<ndShape>
 
 	virtual ndInt32 GetConvexVertexCount() const;
 
+	ndShapeID GetCollisionId() const;
 	ndVector GetObbSize() const;
 	ndVector GetObbOrigin() const;
 	ndFloat32 GetUmbraClipSize() const;
@@ -258,6 +259,7 @@ class ndShape: public ndContainersFreeListAlloc<ndShape>
 
 	virtual ndVector SupportVertex(const ndVector& dir) const = 0;
 	virtual ndVector SupportVertexSpecial(const ndVector& dir, ndFloat32 skinMargin) const = 0;
+	virtual ndVector SupportVertexCached(const ndVector& dir, ndFloat32 skinMargin, ndInt32* const vertexCache) const;
 	virtual void CalculateAabb(const ndMatrix& matrix, ndVector& p0, ndVector& p1) const = 0;
 	virtual ndVector SupportVertexSpecialProjectPoint(const ndVector& point, const ndVector& dir) const = 0;
 	virtual ndInt32 CalculatePlaneIntersection(const ndVector& normal, const ndVector& point, ndVector* const contactsOut) const = 0;
@@ -318,6 +320,16 @@ inline ndMatrix ndShape::CalculateInertiaAndCenterOfMass(const ndMatrix&, const
 	return ndGetZeroMatrix();
 }
 
+inline ndVector ndShape::SupportVertexCached(const ndVector& dir, ndFloat32 skinMargin, ndInt32* const) const
+{
+	return SupportVertexSpecial(dir, skinMargin);
+}
+
+inline ndShapeID ndShape::GetCollisionId() const
+{
+	return m_collisionId;
+}
+
 inline ndVector ndShape::GetObbOrigin() const
 {
 	return m_boxOrigin;
@@ -0,0 +1,414 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#include "ndCoreStdafx.h"
+#include "ndCollisionStdafx.h"
+#include "ndShapeCache.h"
+#include "ndShapeInstance.h"
+#include "ndShapeCompound.h"
+#include "ndShapeConvexHull.h"
+#include "ndShapeStatic_bvh.h"
+
+#define D_SHAPE_CACHE_COMPOUND_MAGIC	0x646e7063
+#define D_SHAPE_CACHE_COMPOUND_VERSION	1
+
+class ndCookedCompoundHeader
+{
+	public:
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndInt32 m_childCount;
+	ndInt32 m_layoutCount;
+	ndFloat64 m_treeEntropy;
+};
+
+class ndCookedCompoundChild
+{
+	public:
+	ndMatrix m_localMatrix;
+	ndVector m_scale;
+	ndInt64 m_userId;
+	ndInt32 m_key;
+	ndInt32 m_collisionMode;
+};
+
+// fnv-1a over the bytes. ndCRC64 shifts the whole accumulator out every eight bytes, 
+// so its result only depends on the tail of the data and can not key large inputs.
+static ndUnsigned64 ndHashKey(const void* const buffer, size_t size, ndUnsigned64 key)
+{
+	const unsigned char* const ptr = (unsigned char*)buffer;
+	for (size_t i = 0; i < size; ++i)
+	{
+		key = (key ^ ndUnsigned64(ptr[i])) * ndUnsigned64(0x100000001b3);
+	}
+	return key;
+}
+
+ndShapeCache::ndShapeCache(const char* const path)
+	:ndClassAlloc()
+	,m_hits(0)
+	,m_misses(0)
+	,m_tmpIndex(0)
+{
+	strncpy(m_path, path, sizeof(m_path) - 1);
+	m_path[sizeof(m_path) - 1] = 0;
+	ndInt32 length = ndInt32(strlen(m_path));
+	while (length && ((m_path[length - 1] == '/') || (m_path[length - 1] == '\\')))
+	{
+		length--;
+		m_path[length] = 0;
+	}
+}
+
+ndShapeCache::~ndShapeCache()
+{
+}
+
+ndUnsigned64 ndShapeCache::CalculateKey(const ndPolygonSoupBuilder& builder, bool optimize)
+{
+	// only x, y, z are hashed, w is not part of the mesh
+	const ndInt32 optimizeFlag = optimize ? 1 : 0;
+	ndUnsigned64 key = ndCRC64("ndShapeStatic_bvh");
+	key = ndHashKey(&optimizeFlag, sizeof(optimizeFlag), key);
+	const ndInt32 vertexCount = ndInt32(builder.m_vertexPoints.GetCount());
+	for (ndInt32 i = 0; i < vertexCount; ++i)
+	{
+		key = ndHashKey(&builder.m_vertexPoints[i].m_x, 3 * sizeof(ndFloat64), key);
+	}
+	const ndInt32 normalCount = ndInt32(builder.m_normalPoints.GetCount());
+	for (ndInt32 i = 0; i < normalCount; ++i)
+	{
+		key = ndHashKey(&builder.m_normalPoints[i].m_x, 3 * sizeof(ndFloat64), key);
+	}
+	if (builder.m_faceVertexCount.GetCount())
+	{
+		key = ndHashKey(&builder.m_faceVertexCount[0], size_t(builder.m_faceVertexCount.GetCount()) * sizeof(ndInt32), key);
+	}
+	if (builder.m_vertexIndex.GetCount())
+	{
+		key = ndHashKey(&builder.m_vertexIndex[0], size_t(builder.m_vertexIndex.GetCount()) * sizeof(ndInt32), key);
+	}
+	if (builder.m_normalIndex.GetCount())
+	{
+		key = ndHashKey(&builder.m_normalIndex[0], size_t(builder.m_normalIndex.GetCount()) * sizeof(ndInt32), key);
+	}
+	const ndInt32 counts[] = { vertexCount, normalCount, ndInt32(builder.m_faceVertexCount.GetCount()) };
+	return ndHashKey(counts, sizeof(counts), key);
+}
+
+ndUnsigned64 ndShapeCache::CalculateKey(ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut)
+{
+	ndUnsigned64 key = ndCRC64("ndShapeConvexHull");
+	const ndInt32 stride = strideInBytes / ndInt32(sizeof(ndFloat32));
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		key = ndHashKey(&vertexArray[i * stride], 3 * sizeof(ndFloat32), key);
+	}
+	key = ndHashKey(&count, sizeof(count), key);
+	key = ndHashKey(&tolerance, sizeof(tolerance), key);
+	return ndHashKey(&maxPointsOut, sizeof(maxPointsOut), key);
+}
+
+void ndShapeCache::GetEntryPath(ndUnsigned64 key, const char* const extension, char* const pathOut, ndInt32 size) const
+{
+	snprintf(pathOut, size_t(size), "%s/%016llx.%s", m_path, (long long unsigned)key, extension);
+}
+
+void ndShapeCache::GetTmpPath(ndUnsigned64 key, const char* const extension, char* const pathOut, ndInt32 size)
+{
+	// entries are written next to the final name and renamed when complete, 
+	// so that other threads or processes never read a partial entry.
+	const ndInt32 index = m_tmpIndex.fetch_add(1);
+	snprintf(pathOut, size_t(size), "%s/%016llx.%s.%d.tmp", m_path, (long long unsigned)key, extension, index);
+}
+
+bool ndShapeCache::CommitEntry(const char* const tmpPath, ndUnsigned64 key, const char* const extension, bool state) const
+{
+	if (state)
+	{
+		char path[512];
+		GetEntryPath(key, extension, path, sizeof(path));
+		remove(path);
+		state = (rename(tmpPath, path) == 0);
+	}
+	if (!state)
+	{
+		remove(tmpPath);
+	}
+	return state;
+}
+
+ndShapeStatic_bvh* ndShapeCache::LoadStaticMesh(ndUnsigned64 key)
+{
+	// the image constructor goes through DeserializeImage, which validates the whole 
+	// image and leaves the mesh empty when the entry is missing, truncated or damaged.
+	char path[512];
+	GetEntryPath(key, "bvh", path, sizeof(path));
+	ndShapeStatic_bvh* const mesh = new ndShapeStatic_bvh(path);
+	if (!mesh->GetRootNode())
+	{
+		delete mesh;
+		return nullptr;
+	}
+	return mesh;
+}
+
+void ndShapeCache::SaveStaticMesh(ndUnsigned64 key, const ndShapeStatic_bvh* const mesh)
+{
+	char tmpPath[512];
+	GetTmpPath(key, "bvh", tmpPath, sizeof(tmpPath));
+	mesh->SerializeImage(tmpPath);
+	CommitEntry(tmpPath, key, "bvh", true);
+}
+
+ndShapeStatic_bvh* ndShapeCache::CreateStaticMesh(ndPolygonSoupBuilder& builder, bool optimize)
+{
+	D_TRACKTIME();
+	const ndUnsigned64 key = CalculateKey(builder, optimize);
+	ndShapeStatic_bvh* mesh = LoadStaticMesh(key);
+	if (mesh)
+	{
+		m_hits.fetch_add(1);
+	}
+	else
+	{
+		m_misses.fetch_add(1);
+		builder.End(optimize);
+		mesh = new ndShapeStatic_bvh(builder);
+		SaveStaticMesh(key, mesh);
+	}
+	return mesh;
+}
+
+ndShapeStatic_bvh* ndShapeCache::CreateStaticMesh(ndThreadPool& threadPool, ndPolygonSoupBuilder& builder, bool optimize)
+{
+	D_TRACKTIME();
+	const ndUnsigned64 key = CalculateKey(builder, optimize);
+	ndShapeStatic_bvh* mesh = LoadStaticMesh(key);
+	if (mesh)
+	{
+		m_hits.fetch_add(1);
+	}
+	else
+	{
+		m_misses.fetch_add(1);
+		builder.End(threadPool, optimize);
+		mesh = new ndShapeStatic_bvh(threadPool, builder);
+		SaveStaticMesh(key, mesh);
+	}
+	return mesh;
+}
+
+ndShapeConvexHull* ndShapeCache::LoadConvexHull(ndUnsigned64 key)
+{
+	char path[512];
+	GetEntryPath(key, "hull", path, sizeof(path));
+	ndShapeConvexHull* hull = nullptr;
+	FILE* const file = fopen(path, "rb");
+	if (file)
+	{
+		hull = ndShapeConvexHull::DeserializeCooked(file);
+		fclose(file);
+	}
+	return hull;
+}
+
+void ndShapeCache::SaveConvexHull(ndUnsigned64 key, const ndShapeConvexHull* const hull)
+{
+	char tmpPath[512];
+	GetTmpPath(key, "hull", tmpPath, sizeof(tmpPath));
+	FILE* const file = fopen(tmpPath, "wb");
+	if (file)
+	{
+		const bool state = hull->SerializeCooked(file);
+		fclose(file);
+		CommitEntry(tmpPath, key, "hull", state);
+	}
+}
+
+ndShapeConvexHull* ndShapeCache::CreateConvexHull(ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut)
+{
+	D_TRACKTIME();
+	const ndUnsigned64 key = CalculateKey(count, strideInBytes, tolerance, vertexArray, maxPointsOut);
+	ndShapeConvexHull* hull = LoadConvexHull(key);
+	if (hull)
+	{
+		m_hits.fetch_add(1);
+	}
+	else
+	{
+		m_misses.fetch_add(1);
+		hull = new ndShapeConvexHull(count, strideInBytes, tolerance, vertexArray, maxPointsOut);
+		SaveConvexHull(key, hull);
+	}
+	return hull;
+}
+
+bool ndShapeCache::SaveCompound(ndUnsigned64 key, const ndShapeInstance& compoundInstance)
+{
+	D_TRACKTIME();
+	const ndShapeCompound* const compound = ((ndShape*)compoundInstance.GetShape())->GetAsShapeCompound();
+	if (!compound || !compound->m_root)
+	{
+		return false;
+	}
+
+	const ndShapeCompound::ndTreeArray& tree = compound->GetTree();
+	ndShapeCompound::ndTreeArray::Iterator iter(tree);
+	for (iter.Begin(); iter; iter++)
+	{
+		const ndShapeInstance* const child = iter.GetNode()->GetInfo()->GetShape();
+		if ((child->GetShape()->GetCollisionId() != m_convexHull) || (child->GetScaleType() == ndShapeInstance::m_global))
+		{
+			return false;
+		}
+	}
+
+	ndArray<ndInt32> layout;
+	compound->GetTreeLayout(layout);
+
+	char tmpPath[512];
+	GetTmpPath(key, "compound", tmpPath, sizeof(tmpPath));
+	FILE* const file = fopen(tmpPath, "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	ndCookedCompoundHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_magic = D_SHAPE_CACHE_COMPOUND_MAGIC;
+	header.m_version = D_SHAPE_CACHE_COMPOUND_VERSION;
+	header.m_childCount = tree.GetCount();
+	header.m_layoutCount = ndInt32(layout.GetCount());
+	header.m_treeEntropy = compound->m_treeEntropy;
+	bool state = (fwrite(&header, sizeof(header), 1, file) == 1);
+	for (iter.Begin(); state && iter; iter++)
+	{
+		const ndShapeInstance* const child = iter.GetNode()->GetInfo()->GetShape();
+		ndCookedCompoundChild info;
+		memset(&info, 0, sizeof(info));
+		info.m_localMatrix = child->GetLocalMatrix();
+		info.m_scale = child->GetScale();
+		info.m_userId = child->GetMaterial().m_userId;
+		info.m_key = iter.GetNode()->GetKey();
+		info.m_collisionMode = child->GetCollisionMode() ? 1 : 0;
+		state = (fwrite(&info, sizeof(info), 1, file) == 1);
+		state = state && ((const ndShapeConvexHull*)child->GetShape())->SerializeCooked(file);
+	}
+	state = state && (fwrite(&layout[0], sizeof(ndInt32) * size_t(layout.GetCount()), 1, file) == 1);
+	fclose(file);
+	return CommitEntry(tmpPath, key, "compound", state);
+}
+
+ndShapeInstance* ndShapeCache::LoadCompound(ndUnsigned64 key)
+{
+	D_TRACKTIME();
+	char path[512];
+	GetEntryPath(key, "compound", path, sizeof(path));
+	FILE* const file = fopen(path, "rb");
+	if (!file)
+	{
+		m_misses.fetch_add(1);
+		return nullptr;
+	}
+
+	ndCookedCompoundHeader header;
+	bool state = (fread(&header, sizeof(header), 1, file) == 1);
+	state = state && (header.m_magic == D_SHAPE_CACHE_COMPOUND_MAGIC) && (header.m_version == D_SHAPE_CACHE_COMPOUND_VERSION);
+	state = state && (header.m_childCount > 0) && (header.m_layoutCount == 2 * header.m_childCount - 1);
+
+	// read all the children before making the compound, so that a bad entry does not leave a partial shape
+	ndArray<ndCookedCompoundChild> children;
+	ndArray<ndShapeConvexHull*> hulls;
+	for (ndInt32 i = 0; state && (i < header.m_childCount); ++i)
+	{
+		ndCookedCompoundChild info;
+		state = (fread(&info, sizeof(info), 1, file) == 1);
+		ndShapeConvexHull* const hull = state ? ndShapeConvexHull::DeserializeCooked(file) : nullptr;
+		state = state && hull;
+		if (state)
+		{
+			children.PushBack(info);
+			hulls.PushBack(hull);
+		}
+	}
+	ndArray<ndInt32> layout;
+	if (state)
+	{
+		layout.SetCount(header.m_layoutCount);
+		state = (fread(&layout[0], sizeof(ndInt32) * size_t(header.m_layoutCount), 1, file) == 1);
+	}
+	fclose(file);
+
+	ndShapeInstance* instance = nullptr;
+	if (state)
+	{
+		instance = new ndShapeInstance(new ndShapeCompound());
+		ndShapeCompound* const compound = instance->GetShape()->GetAsShapeCompound();
+		compound->BeginAddRemove();
+		for (ndInt32 i = 0; state && (i < header.m_childCount); ++i)
+		{
+			const ndCookedCompoundChild& info = children[i];
+			state = (info.m_key >= 0) && !compound->m_array.Find(info.m_key);
+			if (state)
+			{
+				ndShapeInstance child(hulls[i]);
+				ndShapeMaterial material(child.GetMaterial());
+				material.m_userId = info.m_userId;
+				child.SetMaterial(material);
+				child.SetLocalMatrix(info.m_localMatrix);
+				child.SetScale(info.m_scale);
+				child.SetCollisionMode(info.m_collisionMode ? true : false);
+				compound->AddLeaf(&child, info.m_key);
+				hulls[i] = nullptr;
+			}
+		}
+		compound->m_treeEntropy = header.m_treeEntropy;
+		state = state && compound->SetTreeLayout(layout);
+		if (!state)
+		{
+			// the leaves are owned by the tree, an empty layout releases them
+			compound->SetTreeLayout(ndArray<ndInt32>());
+			delete instance;
+			instance = nullptr;
+		}
+	}
+
+	for (ndInt32 i = 0; i < ndInt32(hulls.GetCount()); ++i)
+	{
+		if (hulls[i])
+		{
+			delete hulls[i];
+		}
+	}
+
+	if (instance)
+	{
+		m_hits.fetch_add(1);
+	}
+	else
+	{
+		m_misses.fetch_add(1);
+	}
+	return instance;
+}
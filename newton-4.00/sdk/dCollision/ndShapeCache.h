@@ -0,0 +1,94 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+* 
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+* 
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+* 
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+* 
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+* 
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+
+#ifndef __ND_SHAPE_CACHE_H__
+#define __ND_SHAPE_CACHE_H__
+
+#include "ndCollisionStdafx.h"
+
+class ndShapeInstance;
+class ndShapeStatic_bvh;
+class ndShapeConvexHull;
+
+// optional on disk cache of cooked collision shapes.
+// an entry is a file in the cache directory named after the hash of the source 
+// data and the build parameters, so building the same shape again is a file read. 
+// entries that are missing or that fail to load are built and written again.
+// all functions can be called from several threads at once.
+class ndShapeCache: public ndClassAlloc
+{
+	public:
+	D_COLLISION_API ndShapeCache(const char* const path);
+	D_COLLISION_API ~ndShapeCache();
+
+	const char* GetPath() const;
+	ndInt32 GetHitCount() const;
+	ndInt32 GetMissCount() const;
+
+	D_COLLISION_API static ndUnsigned64 CalculateKey(const ndPolygonSoupBuilder& builder, bool optimize);
+	D_COLLISION_API static ndUnsigned64 CalculateKey(ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut);
+
+	// the builder is passed with its faces added but not ended, the key is the hash of
+	// the raw faces and the optimize flag. End(optimize) is only called on a miss.
+	D_COLLISION_API ndShapeStatic_bvh* CreateStaticMesh(ndPolygonSoupBuilder& builder, bool optimize);
+	D_COLLISION_API ndShapeStatic_bvh* CreateStaticMesh(ndThreadPool& threadPool, ndPolygonSoupBuilder& builder, bool optimize);
+	D_COLLISION_API ndShapeConvexHull* CreateConvexHull(ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut = 0x7fffffff);
+
+	// compounds are stored with a key chosen by the application, usually the hash of 
+	// the source asset and the decomposition parameters. only compounds of convex hulls 
+	// can be stored, the children keep their keys, local matrix, scale and material id.
+	D_COLLISION_API ndShapeInstance* LoadCompound(ndUnsigned64 key);
+	D_COLLISION_API bool SaveCompound(ndUnsigned64 key, const ndShapeInstance& compound);
+
+	private:
+	void GetEntryPath(ndUnsigned64 key, const char* const extension, char* const pathOut, ndInt32 size) const;
+	void GetTmpPath(ndUnsigned64 key, const char* const extension, char* const pathOut, ndInt32 size);
+	bool CommitEntry(const char* const tmpPath, ndUnsigned64 key, const char* const extension, bool state) const;
+
+	ndShapeStatic_bvh* LoadStaticMesh(ndUnsigned64 key);
+	void SaveStaticMesh(ndUnsigned64 key, const ndShapeStatic_bvh* const mesh);
+	ndShapeConvexHull* LoadConvexHull(ndUnsigned64 key);
+	void SaveConvexHull(ndUnsigned64 key, const ndShapeConvexHull* const hull);
+
+	char m_path[256];
+	ndAtomic<ndInt32> m_hits;
+	ndAtomic<ndInt32> m_misses;
+	ndAtomic<ndInt32> m_tmpIndex;
+};
+
+inline const char* ndShapeCache::GetPath() const
+{
+	return m_path;
+}
+
+inline ndInt32 ndShapeCache::GetHitCount() const
+{
+	return m_hits.load();
+}
+
+inline ndInt32 ndShapeCache::GetMissCount() const
+{
+	return m_misses.load();
+}
+
+#endif
+
@@ -48,6 +48,7 @@ ndShapeCompound::ndNodeBase::~ndNodeBase()
 ndShapeCompound::ndNodeBase::ndNodeBase()
 	:ndClassAlloc()
 	,m_type(m_node)
+	,m_dirty(0)
 	,m_left(nullptr)
 	,m_right(nullptr)
 	,m_parent(nullptr)
@@ -64,6 +65,7 @@ ndShapeCompound::ndNodeBase::ndNodeBase(const ndNodeBase& copyFrom)
 	,m_origin(copyFrom.m_origin)
 	,m_area(copyFrom.m_area)
 	,m_type(copyFrom.m_type)
+	,m_dirty(0)
 	,m_left(nullptr)
 	,m_right(nullptr)
 	,m_parent(nullptr)
@@ -76,6 +78,7 @@ ndShapeCompound::ndNodeBase::ndNodeBase(const ndNodeBase& copyFrom)
 ndShapeCompound::ndNodeBase::ndNodeBase(ndShapeInstance* const instance)
 	:ndClassAlloc()
 	,m_type(m_leaf)
+	,m_dirty(0)
 	,m_left(nullptr)
 	,m_right(nullptr)
 	,m_parent(nullptr)
@@ -83,11 +86,15 @@ ndShapeCompound::ndNodeBase::ndNodeBase(ndShapeInstance* const instance)
 	,m_shapeInstance(new ndShapeInstance(*instance))
 {
 	CalculateAABB();
+	m_massOrigin = ndVector::m_zero;
+	m_massInertiaII = ndVector::m_zero;
+	m_massInertiaIJ = ndVector::m_zero;
 }
 
 ndShapeCompound::ndNodeBase::ndNodeBase(ndNodeBase* const left, ndNodeBase* const right)
 	:ndClassAlloc()
 	,m_type(m_node)
+	,m_dirty(0)
 	,m_left(left)
 	,m_right(right)
 	,m_parent(nullptr)
@@ -115,6 +122,16 @@ inline void ndShapeCompound::ndNodeBase::CalculateAABB()
 	SetBox(p0, p1);
 }
 
+void ndShapeCompound::ndNodeBase::CalculateMassProperties()
+{
+	const ndMatrix shapeInertia(m_shapeInstance->CalculateInertia());
+	const ndFloat32 shapeVolume = m_shapeInstance->GetVolume();
+	m_massOrigin = (shapeInertia.m_posit & ndVector::m_triplexMask).Scale(shapeVolume);
+	m_massOrigin.m_w = shapeVolume;
+	m_massInertiaII = ndVector(shapeInertia[0][0], shapeInertia[1][1], shapeInertia[2][2], ndFloat32(0.0f)).Scale(shapeVolume);
+	m_massInertiaIJ = ndVector(shapeInertia[1][2], shapeInertia[0][2], shapeInertia[0][1], ndFloat32(0.0f)).Scale(shapeVolume);
+}
+
 inline void ndShapeCompound::ndNodeBase::SetBox(const ndVector& p0, const ndVector& p1)
 {
 	m_p0 = p0;
@@ -262,18 +279,24 @@ ndShapeCompound::ndShapeCompound()
 	,m_root(nullptr)
 	,m_myInstance(nullptr)
 	,m_idIndex(0)
+	,m_refitCount(0)
+	,m_dirtyCount(0)
+	,m_version(0)
 {
 }
 
 ndShapeCompound::ndShapeCompound(const ndShapeCompound& source, const ndShapeInstance* const myInstance)
 	:ndShape(source)
 	,m_array()
-	,m_treeEntropy(ndFloat32(0.0f))
+	,m_treeEntropy(source.m_treeEntropy)
 	,m_boxMinRadius(ndFloat32(0.0f))
 	,m_boxMaxRadius(ndFloat32(0.0f))
 	,m_root(nullptr)
 	,m_myInstance(myInstance)
-	,m_idIndex(0)
+	,m_idIndex(source.m_idIndex)
+	,m_refitCount(0)
+	,m_dirtyCount(0)
+	,m_version(0)
 {
 	ndTreeArray::Iterator iter(source.m_array);
 	for (iter.Begin(); iter; iter++) 
@@ -281,6 +304,9 @@ ndShapeCompound::ndShapeCompound(const ndShapeCompound& source, const ndShapeIns
 		ndNodeBase* const node = iter.GetNode()->GetInfo();
 		ndShapeInstance* const shape = node->GetShape();
 		ndNodeBase* const newNode = new ndNodeBase(shape);
+		newNode->m_massOrigin = node->m_massOrigin;
+		newNode->m_massInertiaII = node->m_massInertiaII;
+		newNode->m_massInertiaIJ = node->m_massInertiaIJ;
 		m_array.AddNode(newNode, iter.GetNode()->GetKey(), m_myInstance);
 	}
 
@@ -893,15 +919,45 @@ ndShapeCompound::ndNodeBase* ndShapeCompound::BuildTopDownBig(ndNodeBase** const
 
 void ndShapeCompound::EndAddRemove()
 {
+	m_version++;
 	if (m_root) 
 	{
 		//dgScopeSpinLock lock(&m_criticalSectionLock);
 
-		ndTreeArray::Iterator iter(m_array);
-		for (iter.Begin(); iter; iter++) 
+		// when children were only added, removed or moved with the compound interface, 
+		// the leaves are up to date and the tree was refit incrementally. 
+		// leaves edited in place and marked with MarkChildDirty are updated here. without any interface edit, children may have 
+		// been edited through the tree nodes, so update them all.
+		const bool fullUpdate = (m_refitCount == 0) && (m_dirtyCount == 0);
+		if (m_dirtyCount)
+		{
+			ndTreeArray::Iterator iter(m_array);
+			for (iter.Begin(); iter; iter++) 
+			{
+				ndNodeBase* const node = iter.GetNode()->GetInfo();
+				if (node->m_dirty)
+				{
+					node->m_dirty = 0;
+					node->CalculateAABB();
+					node->CalculateMassProperties();
+					if (node->m_parent)
+					{
+						RefitNode(node->m_parent);
+					}
+				}
+			}
+		}
+		m_refitCount = 0;
+		m_dirtyCount = 0;
+		if (fullUpdate)
 		{
-			ndNodeBase* const node = iter.GetNode()->GetInfo();
-			node->CalculateAABB();
+			ndTreeArray::Iterator iter(m_array);
+			for (iter.Begin(); iter; iter++) 
+			{
+				ndNodeBase* const node = iter.GetNode()->GetInfo();
+				node->CalculateAABB();
+				node->CalculateMassProperties();
+			}
 		}
 
 		ndInt32 stack = 1;
@@ -933,7 +989,18 @@ void ndShapeCompound::EndAddRemove()
 		
 		if (nodeCount)
 		{
-			ndFloat64 cost = CalculateEntropy(nodeCount, nodeArray);
+			if (fullUpdate)
+			{
+				// parents are always before their children in the array
+				for (ndInt32 i = nodeCount - 1; i >= 0; --i)
+				{
+					ndNodeBase* const node = nodeArray[i];
+					node->SetBox(node->m_left->m_p0.GetMin(node->m_right->m_p0), node->m_left->m_p1.GetMax(node->m_right->m_p1));
+				}
+			}
+
+			// the expensive rebalancing only happens when the tree quality drifted too much
+			ndFloat64 cost = fullUpdate ? CalculateEntropy(nodeCount, nodeArray) : CalculateCost(nodeCount, nodeArray);
 			if ((cost > m_treeEntropy * ndFloat32(2.0f)) || (cost < m_treeEntropy * ndFloat32(0.5f))) 
 			{
 				ndInt32 leafNodesCount = 0;
@@ -997,20 +1064,227 @@ void ndShapeCompound::EndAddRemove()
 			m_treeEntropy = ndFloat32(2.0f);
 		}
 		
-		ndAssert(m_root->m_size.m_w == ndFloat32(0.0f));
-		m_boxMinRadius = ndMin(ndMin(m_root->m_size.m_x, m_root->m_size.m_y), m_root->m_size.m_z);
-		m_boxMaxRadius = ndSqrt(m_root->m_size.DotProduct(m_root->m_size).GetScalar());
-		
-		m_boxSize = m_root->m_size;
-		m_boxOrigin = m_root->m_origin;
-		MassProperties();
+		UpdateRootBounds();
 	}
 }
 
-//void ndShapeCompound::RemoveNode(ndTreeArray::ndNode* const node)
-void ndShapeCompound::RemoveNode(ndTreeArray::ndNode* const)
+void ndShapeCompound::UpdateRootBounds()
 {
-	ndAssert(0);
+	ndAssert(m_root->m_size.m_w == ndFloat32(0.0f));
+	m_boxMinRadius = ndMin(ndMin(m_root->m_size.m_x, m_root->m_size.m_y), m_root->m_size.m_z);
+	m_boxMaxRadius = ndSqrt(m_root->m_size.DotProduct(m_root->m_size).GetScalar());
+
+	m_boxSize = m_root->m_size;
+	m_boxOrigin = m_root->m_origin;
+	MassProperties();
+}
+
+void ndShapeCompound::GetTreeLayout(ndArray<ndInt32>& layout) const
+{
+	layout.SetCount(0);
+	if (!m_root)
+	{
+		return;
+	}
+
+	// node, right, left order reversed is the post order
+	ndInt32 stack = 1;
+	ndNodeBase* stackBuffer[D_COMPOUND_STACK_DEPTH];
+	stackBuffer[0] = m_root;
+	while (stack)
+	{
+		stack--;
+		const ndNodeBase* const node = stackBuffer[stack];
+		if (node->m_type == m_node)
+		{
+			layout.PushBack(-1);
+			stackBuffer[stack] = node->m_left;
+			stack++;
+			stackBuffer[stack] = node->m_right;
+			stack++;
+			ndAssert(stack < ndInt32(sizeof(stackBuffer) / sizeof(stackBuffer[0])));
+		}
+		else
+		{
+			layout.PushBack(node->m_myNode->GetKey());
+		}
+	}
+
+	const ndInt32 count = ndInt32(layout.GetCount());
+	for (ndInt32 i = 0; i < count / 2; ++i)
+	{
+		ndSwap(layout[i], layout[count - 1 - i]);
+	}
+}
+
+void ndShapeCompound::AddLeaf(ndShapeInstance* const part, ndInt32 key)
+{
+	ndAssert(m_myInstance);
+	ndAssert(!m_root);
+	ndAssert(!m_array.Find(key));
+	ndNodeBase* const newNode = new ndNodeBase(part);
+	newNode->CalculateMassProperties();
+	m_array.AddNode(newNode, key, m_myInstance);
+	m_idIndex = ndMax(m_idIndex, key + 1);
+}
+
+bool ndShapeCompound::SetTreeLayout(const ndArray<ndInt32>& layout)
+{
+	ndAssert(!m_root);
+
+	// check the layout before linking any node, a bad layout leaves the compound empty
+	ndInt32 stack = 0;
+	ndInt32 leafCount = 0;
+	ndArray<ndInt8> used;
+	bool state = m_array.GetCount() && (layout.GetCount() == 2 * m_array.GetCount() - 1);
+	if (state)
+	{
+		used.SetCount(m_idIndex);
+		memset(&used[0], 0, size_t(m_idIndex) * sizeof(ndInt8));
+	}
+	for (ndInt32 i = 0; state && (i < ndInt32(layout.GetCount())); ++i)
+	{
+		const ndInt32 key = layout[i];
+		if (key == -1)
+		{
+			state = (stack >= 2);
+			stack--;
+		}
+		else
+		{
+			state = (key >= 0) && (key < m_idIndex) && !used[key] && m_array.Find(key);
+			if (state)
+			{
+				used[key] = 1;
+			}
+			leafCount++;
+			stack++;
+		}
+	}
+	state = state && (stack == 1) && (leafCount == m_array.GetCount());
+
+	if (!state)
+	{
+		ndTreeArray::Iterator iter(m_array);
+		for (iter.Begin(); iter; iter++)
+		{
+			delete iter.GetNode()->GetInfo();
+		}
+		m_array.RemoveAll();
+		return false;
+	}
+
+	stack = 0;
+	ndStack<ndNodeBase*> stackBuffer(leafCount);
+	for (ndInt32 i = 0; i < ndInt32(layout.GetCount()); ++i)
+	{
+		const ndInt32 key = layout[i];
+		if (key == -1)
+		{
+			stack--;
+			stackBuffer[stack - 1] = new ndNodeBase(stackBuffer[stack - 1], stackBuffer[stack]);
+		}
+		else
+		{
+			stackBuffer[stack] = m_array.Find(key)->GetInfo();
+			stack++;
+		}
+	}
+	m_root = stackBuffer[0];
+	m_refitCount = 0;
+	m_version++;
+	UpdateRootBounds();
+	return true;
+}
+
+void ndShapeCompound::RefitNode(ndNodeBase* const node) const
+{
+	for (ndNodeBase* parent = node; parent; parent = parent->m_parent)
+	{
+		ndAssert(parent->m_type == m_node);
+		const ndVector p0(parent->m_left->m_p0.GetMin(parent->m_right->m_p0));
+		const ndVector p1(parent->m_left->m_p1.GetMax(parent->m_right->m_p1));
+		const ndVector test((p0 == parent->m_p0) & (p1 == parent->m_p1));
+		if (test.GetSignMask() == 0x0f)
+		{
+			break;
+		}
+		parent->SetBox(p0, p1);
+	}
+}
+
+ndFloat64 ndShapeCompound::CalculateCost(ndInt32 count, ndNodeBase** array) const
+{
+	ndFloat64 cost = ndFloat32(0.0f);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		cost += array[i]->m_area;
+	}
+	return cost;
+}
+
+void ndShapeCompound::RemoveNode(ndTreeArray::ndNode* const node)
+{
+	ndAssert(m_myInstance);
+	ndNodeBase* const leaf = node->GetInfo();
+	ndAssert(leaf->m_type == m_leaf);
+
+	ndNodeBase* const parent = leaf->m_parent;
+	if (!parent)
+	{
+		ndAssert(m_root == leaf);
+		m_root = nullptr;
+	}
+	else
+	{
+		// the sibling takes the place of the parent
+		ndNodeBase* const sibling = (parent->m_left == leaf) ? parent->m_right : parent->m_left;
+		ndNodeBase* const grandParent = parent->m_parent;
+		sibling->m_parent = grandParent;
+		if (!grandParent)
+		{
+			ndAssert(m_root == parent);
+			m_root = sibling;
+		}
+		else
+		{
+			if (grandParent->m_left == parent)
+			{
+				grandParent->m_left = sibling;
+			}
+			else
+			{
+				ndAssert(grandParent->m_right == parent);
+				grandParent->m_right = sibling;
+			}
+			RefitNode(grandParent);
+		}
+		parent->m_left = nullptr;
+		parent->m_right = nullptr;
+		delete parent;
+	}
+
+	leaf->m_parent = nullptr;
+	m_array.Remove(node);
+	delete leaf;
+	m_refitCount++;
+}
+
+void ndShapeCompound::SetSubShapeLocalMatrix(ndTreeArray::ndNode* const node, const ndMatrix& localMatrix)
+{
+	ndAssert(m_myInstance);
+	ndNodeBase* const leaf = node->GetInfo();
+	ndAssert(leaf->m_type == m_leaf);
+
+	leaf->m_shapeInstance->SetLocalMatrix(localMatrix);
+	leaf->CalculateAABB();
+	leaf->CalculateMassProperties();
+	if (leaf->m_parent)
+	{
+		RefitNode(leaf->m_parent);
+	}
+	m_refitCount++;
+	m_version++;
 }
 
 ndShapeInstance* ndShapeCompound::GetShapeInstance(ndTreeArray::ndNode* const node)
@@ -1018,13 +1292,32 @@ ndShapeInstance* ndShapeCompound::GetShapeInstance(ndTreeArray::ndNode* const no
 	return node->GetInfo()->GetShape();
 }
 
+const ndShapeInstance* ndShapeCompound::GetShapeInstance(const ndTreeArray::ndNode* const node) const
+{
+	return node->GetInfo()->GetShape();
+}
+
+void ndShapeCompound::MarkChildDirty(ndTreeArray::ndNode* const node)
+{
+	ndNodeBase* const leaf = node->GetInfo();
+	ndAssert(leaf->m_type == m_leaf);
+	if (!leaf->m_dirty)
+	{
+		leaf->m_dirty = 1;
+		m_dirtyCount++;
+	}
+	m_version++;
+}
+
 ndShapeCompound::ndTreeArray::ndNode* ndShapeCompound::AddCollision(ndShapeInstance* const subInstance)
 {
 	ndAssert(m_myInstance);
 	ndNodeBase* const newNode = new ndNodeBase(subInstance);
+	newNode->CalculateMassProperties();
 	m_array.AddNode(newNode, m_idIndex, m_myInstance);
 
 	m_idIndex++;
+	m_refitCount++;
 	
 	if (!m_root) 
 	{
@@ -1120,15 +1413,15 @@ void ndShapeCompound::MassProperties()
 	bool hasVolume = true;
 	for (iter.Begin(); iter; iter++) 
 	{
-		ndShapeInstance* const collision = iter.GetNode()->GetInfo()->GetShape();
-		ndMatrix shapeInertia(collision->CalculateInertia());
-		ndFloat32 shapeVolume = collision->GetVolume();
+		// use the volume integrals cached in the leaves
+		const ndNodeBase* const node = iter.GetNode()->GetInfo();
+		ndShapeInstance* const collision = node->GetShape();
 
 		hasVolume = hasVolume && (collision->GetShape()->GetAsShapeStaticMesh() != nullptr);
-		volume += shapeVolume;
-		origin += shapeInertia.m_posit.Scale(shapeVolume);
-		inertiaII += ndVector(shapeInertia[0][0], shapeInertia[1][1], shapeInertia[2][2], ndFloat32(0.0f)).Scale(shapeVolume);
-		inertiaIJ += ndVector(shapeInertia[1][2], shapeInertia[0][2], shapeInertia[0][1], ndFloat32(0.0f)).Scale(shapeVolume);
+		volume += node->m_massOrigin.m_w;
+		origin += node->m_massOrigin & ndVector::m_triplexMask;
+		inertiaII += node->m_massInertiaII;
+		inertiaIJ += node->m_massInertiaIJ;
 	}
 
 	m_inertia = ndVector::m_zero;
@@ -1235,10 +1528,9 @@ ndUnsigned64 ndShapeCompound::GetHash(ndUnsigned64 hash) const
 	ndUnsigned64 crc = hash;
 	ndShapeCompound::ndTreeArray::Iterator it(GetTree());
 
-	ndShapeCompound* const compoundShape = (ndShapeCompound*)this;
 	for (it.Begin(); it; it++)
 	{
-		const ndShapeInstance* const childInstance = compoundShape->GetShapeInstance(it.GetNode());
+		const ndShapeInstance* const childInstance = it.GetNode()->GetInfo()->GetShape();
 		const ndShape* const childShape = childInstance->GetShape();
 		crc = childShape->GetHash(crc);
 	}
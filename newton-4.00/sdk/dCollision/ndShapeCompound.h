@@ -54,12 +54,19 @@ class ndShapeCompound: public ndShape
 	void SetOwner(const ndShapeInstance* const myInstance);
 
 	D_COLLISION_API const ndTreeArray& GetTree() const;
+	ndUnsigned32 GetVersion() const;
 	D_COLLISION_API virtual ndUnsigned64 GetHash(ndUnsigned64 hash) const;
 
 	D_COLLISION_API virtual void BeginAddRemove();
 	D_COLLISION_API virtual void RemoveNode(ndTreeArray::ndNode* const node);
 	D_COLLISION_API virtual ndTreeArray::ndNode* AddCollision(ndShapeInstance* const part);
 	D_COLLISION_API virtual ndShapeInstance* GetShapeInstance(ndTreeArray::ndNode* const node);
+	D_COLLISION_API virtual const ndShapeInstance* GetShapeInstance(const ndTreeArray::ndNode* const node) const;
+	D_COLLISION_API virtual void SetSubShapeLocalMatrix(ndTreeArray::ndNode* const node, const ndMatrix& localMatrix);
+
+	// a child edited in place through GetShapeInstance must be marked, 
+	// it is updated at the next EndAddRemove.
+	D_COLLISION_API virtual void MarkChildDirty(ndTreeArray::ndNode* const node);
 	D_COLLISION_API virtual void EndAddRemove();
 
 	protected:
@@ -87,13 +94,22 @@ class ndShapeCompound: public ndShape
 	virtual void MassProperties();
 	void ApplyScale(const ndVector& scale);
 	void SetSubShapeOwner(ndBodyKinematic* const body);
+	void RefitNode(ndNodeBase* const node) const;
 	void ImproveNodeFitness(ndNodeBase* const node) const;
+	ndFloat64 CalculateCost(ndInt32 count, ndNodeBase** array) const;
 	ndFloat64 CalculateEntropy(ndInt32 count, ndNodeBase** array);
 	ndNodeBase* BuildTopDown(ndNodeBase** const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBase** rootNodesMemory, ndInt32& rootIndex);
 	ndNodeBase* BuildTopDownBig(ndNodeBase** const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBase** rootNodesMemory, ndInt32& rootIndex);
 	ndFloat32 CalculateSurfaceArea(ndNodeBase* const node0, ndNodeBase* const node1, ndVector& minBox, ndVector& maxBox) const;
 	ndMatrix CalculateInertiaAndCenterOfMass(const ndMatrix& alignMatrix, const ndVector& localScale, const ndMatrix& matrix) const;
 	ndFloat32 CalculateMassProperties(const ndMatrix& offset, ndVector& inertia, ndVector& crossInertia, ndVector& centerOfMass) const;
+	void UpdateRootBounds();
+
+	// the tree in post order, leaves are the child key and inner nodes are -1.
+	// a saved tree is restored by adding the children with their keys and then the layout.
+	void GetTreeLayout(ndArray<ndInt32>& layout) const;
+	void AddLeaf(ndShapeInstance* const part, ndInt32 key);
+	bool SetTreeLayout(const ndArray<ndInt32>& layout);
 
 	ndTreeArray m_array;
 	ndFloat64 m_treeEntropy;
@@ -102,7 +118,11 @@ class ndShapeCompound: public ndShape
 	ndNodeBase* m_root;
 	const ndShapeInstance* m_myInstance;
 	ndInt32 m_idIndex;
+	ndInt32 m_refitCount;
+	ndInt32 m_dirtyCount;
+	ndUnsigned32 m_version;
 
+	friend class ndShapeCache;
 	friend class ndBodyKinematic;
 	friend class ndShapeInstance;
 	friend class ndContactSolver;
@@ -113,6 +133,12 @@ inline ndShapeCompound* ndShapeCompound::GetAsShapeCompound()
 	return this; 
 }
 
+inline ndUnsigned32 ndShapeCompound::GetVersion() const
+{
+	// incremented each time the children layout changes
+	return m_version;
+}
+
 inline void ndShapeCompound::SetOwner(const ndShapeInstance* const instance)
 {
 	m_myInstance = instance;
@@ -132,14 +158,21 @@ class ndShapeCompound::ndNodeBase: public ndClassAlloc
 
 	private:
 	void CalculateAABB();
+	void CalculateMassProperties();
 	void SetBox(const ndVector& p0, const ndVector& p1);
 
 	ndVector m_p0;
 	ndVector m_p1;
 	ndVector m_size;
 	ndVector m_origin;
+
+	// leaf volume integrals, m_massOrigin.m_w is the volume
+	ndVector m_massOrigin;
+	ndVector m_massInertiaII;
+	ndVector m_massInertiaIJ;
 	ndFloat32 m_area;
 	ndInt32 m_type;
+	ndInt32 m_dirty;
 	ndNodeBase* m_left;
 	ndNodeBase* m_right;
 	ndNodeBase* m_parent;
@@ -22,11 +22,15 @@
 #include "ndCoreStdafx.h"
 #include "ndCollisionStdafx.h"
 #include "ndShapeInstance.h"
+#include "ndContactSolver.h"
 #include "ndShapeConvexHull.h"
 
 #define D_CONVEX_VERTEX_SPLIT_BOX			8
 #define D_CONVEX_VERTEX_BRUTE_FORCE_SPLIT	(3 * D_CONVEX_VERTEX_SPLIT_BOX)
 
+#define D_CONVEX_HULL_COOKED_MAGIC		0x6c6c7568
+#define D_CONVEX_HULL_COOKED_VERSION	1
+
 D_MSV_NEWTON_ALIGN_32
 class ndShapeConvexHull::ndConvexBox
 {
@@ -40,6 +44,33 @@ class ndShapeConvexHull::ndConvexBox
 	ndInt32 m_rightBox;
 } D_GCC_NEWTON_ALIGN_32;
 
+class ndCookedHullHeader
+{
+	public:
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndUnsigned32 m_boxSizeInBytes;
+	ndInt32 m_vertexCount;
+	ndInt32 m_edgeCount;
+	ndInt32 m_faceCount;
+	ndInt32 m_supportTreeCount;
+	ndInt32 m_soaVertexCount;
+};
+
+ndShapeConvexHull::ndShapeConvexHull()
+	:ndShapeConvex(m_convexHull)
+	,m_supportTree(nullptr)
+	,m_faceArray(nullptr)
+	,m_soa_x(nullptr)
+	,m_soa_y(nullptr)
+	,m_soa_z(nullptr)
+	,m_soa_index(nullptr)
+	,m_vertexToEdgeMapping(nullptr)
+	,m_faceCount(0)
+	,m_soaVertexCount(0)
+	,m_supportTreeCount(0)
+{
+}
 
 ndShapeConvexHull::ndShapeConvexHull (ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut)
 	:ndShapeConvex(m_convexHull)
@@ -93,6 +124,182 @@ ndShapeConvexHull::~ndShapeConvexHull()
 	}
 }
 
+void ndShapeConvexHull::CreateHulls(ndThreadPool& threadPool, ndInt32 hullCount, const ndInt32* const pointCount, const ndFloat32* const* const vertexArray, ndInt32 strideInBytes, ndFloat32 tolerance, ndShapeConvexHull** const hullsOut, ndInt32 maxPointsOut)
+{
+	D_TRACKTIME();
+	// hulls are of very different sizes, threads take them one at a time.
+	ndAtomic<ndInt32> iterator(0);
+	auto BuildHulls = ndMakeObject::ndFunction([&iterator, hullCount, pointCount, vertexArray, strideInBytes, tolerance, hullsOut, maxPointsOut](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(BuildHulls);
+		for (ndInt32 i = iterator.fetch_add(1); i < hullCount; i = iterator.fetch_add(1))
+		{
+			hullsOut[i] = new ndShapeConvexHull(pointCount[i], strideInBytes, tolerance, vertexArray[i], maxPointsOut);
+		}
+	});
+	threadPool.ParallelExecute(BuildHulls);
+}
+
+bool ndShapeConvexHull::SerializeCooked(FILE* const file) const
+{
+	ndCookedHullHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_magic = D_CONVEX_HULL_COOKED_MAGIC;
+	header.m_version = D_CONVEX_HULL_COOKED_VERSION;
+	header.m_boxSizeInBytes = sizeof(ndConvexBox);
+	header.m_vertexCount = m_vertexCount;
+	header.m_edgeCount = m_edgeCount;
+	header.m_faceCount = m_faceCount;
+	header.m_supportTreeCount = m_supportTreeCount;
+	header.m_soaVertexCount = m_soaVertexCount;
+
+	// pointers are saved as indices
+	ndStack<ndInt32> edges(4 * m_edgeCount);
+	for (ndInt32 i = 0; i < m_edgeCount; ++i)
+	{
+		const ndConvexSimplexEdge& edge = m_simplex[i];
+		edges[i * 4 + 0] = ndInt32(edge.m_twin - m_simplex);
+		edges[i * 4 + 1] = ndInt32(edge.m_next - m_simplex);
+		edges[i * 4 + 2] = ndInt32(edge.m_prev - m_simplex);
+		edges[i * 4 + 3] = edge.m_vertex;
+	}
+	ndStack<ndInt32> faces(m_faceCount);
+	for (ndInt32 i = 0; i < m_faceCount; ++i)
+	{
+		faces[i] = ndInt32(m_faceArray[i] - m_simplex);
+	}
+	ndStack<ndInt32> vertexToEdge(m_vertexCount);
+	for (ndInt32 i = 0; i < m_vertexCount; ++i)
+	{
+		vertexToEdge[i] = ndInt32(m_vertexToEdgeMapping[i] - m_simplex);
+	}
+
+	auto Write = [file](const void* const data, size_t sizeInBytes)
+	{
+		return !sizeInBytes || (fwrite(data, sizeInBytes, 1, file) == 1);
+	};
+
+	bool state = Write(&header, sizeof(header));
+	state = state && Write(m_vertex, sizeof(ndVector) * size_t(m_vertexCount));
+	state = state && Write(&edges[0], sizeof(ndInt32) * size_t(4 * m_edgeCount));
+	state = state && Write(&faces[0], sizeof(ndInt32) * size_t(m_faceCount));
+	state = state && Write(&vertexToEdge[0], sizeof(ndInt32) * size_t(m_vertexCount));
+	state = state && Write(m_supportTree, sizeof(ndConvexBox) * size_t(m_supportTreeCount));
+	state = state && Write(m_soa_x, sizeof(ndVector) * size_t(m_soaVertexCount));
+	state = state && Write(m_soa_y, sizeof(ndVector) * size_t(m_soaVertexCount));
+	state = state && Write(m_soa_z, sizeof(ndVector) * size_t(m_soaVertexCount));
+	state = state && Write(m_soa_index, sizeof(ndVector) * size_t(m_soaVertexCount));
+	return state;
+}
+
+ndShapeConvexHull* ndShapeConvexHull::DeserializeCooked(FILE* const file)
+{
+	ndCookedHullHeader header;
+	if (fread(&header, sizeof(header), 1, file) != 1)
+	{
+		return nullptr;
+	}
+	if ((header.m_magic != D_CONVEX_HULL_COOKED_MAGIC) ||
+		(header.m_version != D_CONVEX_HULL_COOKED_VERSION) ||
+		(header.m_boxSizeInBytes != sizeof(ndConvexBox)) ||
+		(header.m_vertexCount < 4) || (header.m_vertexCount >= D_MAX_EDGE_COUNT) ||
+		(header.m_edgeCount < 6) || (header.m_edgeCount >= D_MAX_EDGE_COUNT) ||
+		(header.m_faceCount < 4) || (header.m_faceCount > header.m_edgeCount) ||
+		(header.m_supportTreeCount < 0) || (header.m_supportTreeCount > header.m_vertexCount) ||
+		((header.m_vertexCount > D_CONVEX_VERTEX_BRUTE_FORCE_SPLIT) != (header.m_supportTreeCount > 0)) ||
+		(header.m_soaVertexCount < 1) || (header.m_soaVertexCount > header.m_vertexCount))
+	{
+		return nullptr;
+	}
+
+	ndShapeConvexHull* const hull = new ndShapeConvexHull();
+	hull->m_vertexCount = ndUnsigned16(header.m_vertexCount);
+	hull->m_edgeCount = ndUnsigned16(header.m_edgeCount);
+	hull->m_faceCount = header.m_faceCount;
+	hull->m_supportTreeCount = header.m_supportTreeCount;
+	hull->m_soaVertexCount = header.m_soaVertexCount;
+
+	hull->m_vertex = (ndVector*)ndMemory::Malloc(size_t(header.m_vertexCount * sizeof(ndVector)));
+	hull->m_simplex = (ndConvexSimplexEdge*)ndMemory::Malloc(size_t(header.m_edgeCount * sizeof(ndConvexSimplexEdge)));
+	hull->m_vertexToEdgeMapping = (const ndConvexSimplexEdge**)ndMemory::Malloc(size_t(header.m_vertexCount * sizeof(ndConvexSimplexEdge*)));
+	hull->m_faceArray = (ndConvexSimplexEdge**)ndMemory::Malloc(size_t(header.m_faceCount * sizeof(ndConvexSimplexEdge*)));
+	if (header.m_supportTreeCount)
+	{
+		hull->m_supportTree = (ndConvexBox*)ndMemory::Malloc(size_t(header.m_supportTreeCount * sizeof(ndConvexBox)));
+	}
+	hull->m_soa_x = (ndVector*)ndMemory::Malloc(size_t(header.m_soaVertexCount * sizeof(ndVector)));
+	hull->m_soa_y = (ndVector*)ndMemory::Malloc(size_t(header.m_soaVertexCount * sizeof(ndVector)));
+	hull->m_soa_z = (ndVector*)ndMemory::Malloc(size_t(header.m_soaVertexCount * sizeof(ndVector)));
+	hull->m_soa_index = (ndVector*)ndMemory::Malloc(size_t(header.m_soaVertexCount * sizeof(ndVector)));
+
+	auto Read = [file](void* const data, size_t sizeInBytes)
+	{
+		return !sizeInBytes || (fread(data, sizeInBytes, 1, file) == 1);
+	};
+
+	ndStack<ndInt32> edges(4 * header.m_edgeCount);
+	ndStack<ndInt32> faces(header.m_faceCount);
+	ndStack<ndInt32> vertexToEdge(header.m_vertexCount);
+	bool state = Read(hull->m_vertex, sizeof(ndVector) * size_t(header.m_vertexCount));
+	state = state && Read(&edges[0], sizeof(ndInt32) * size_t(4 * header.m_edgeCount));
+	state = state && Read(&faces[0], sizeof(ndInt32) * size_t(header.m_faceCount));
+	state = state && Read(&vertexToEdge[0], sizeof(ndInt32) * size_t(header.m_vertexCount));
+	state = state && Read(hull->m_supportTree, sizeof(ndConvexBox) * size_t(header.m_supportTreeCount));
+	state = state && Read(hull->m_soa_x, sizeof(ndVector) * size_t(header.m_soaVertexCount));
+	state = state && Read(hull->m_soa_y, sizeof(ndVector) * size_t(header.m_soaVertexCount));
+	state = state && Read(hull->m_soa_z, sizeof(ndVector) * size_t(header.m_soaVertexCount));
+	state = state && Read(hull->m_soa_index, sizeof(ndVector) * size_t(header.m_soaVertexCount));
+
+	// a damaged file must not leave dangling edges
+	const ndUnsigned32 edgeCount = ndUnsigned32(header.m_edgeCount);
+	for (ndInt32 i = 0; state && (i < header.m_edgeCount); ++i)
+	{
+		const ndInt32* const edge = &edges[i * 4];
+		state = (ndUnsigned32(edge[0]) < edgeCount) && (ndUnsigned32(edge[1]) < edgeCount) &&
+				(ndUnsigned32(edge[2]) < edgeCount) && (ndUnsigned32(edge[3]) < ndUnsigned32(header.m_vertexCount));
+		if (state)
+		{
+			ndConvexSimplexEdge& simplex = hull->m_simplex[i];
+			simplex.m_twin = &hull->m_simplex[edge[0]];
+			simplex.m_next = &hull->m_simplex[edge[1]];
+			simplex.m_prev = &hull->m_simplex[edge[2]];
+			simplex.m_vertex = edge[3];
+		}
+	}
+	for (ndInt32 i = 0; state && (i < header.m_faceCount); ++i)
+	{
+		state = ndUnsigned32(faces[i]) < edgeCount;
+		hull->m_faceArray[i] = state ? &hull->m_simplex[faces[i]] : nullptr;
+	}
+	for (ndInt32 i = 0; state && (i < header.m_vertexCount); ++i)
+	{
+		state = ndUnsigned32(vertexToEdge[i]) < edgeCount;
+		hull->m_vertexToEdgeMapping[i] = state ? &hull->m_simplex[vertexToEdge[i]] : nullptr;
+	}
+	for (ndInt32 i = 0; state && (i < header.m_supportTreeCount); ++i)
+	{
+		const ndConvexBox& box = hull->m_supportTree[i];
+		if (box.m_leftBox == -1)
+		{
+			state = (box.m_rightBox == -1) && (box.m_vertexStart >= 0) && (box.m_vertexCount >= 0) &&
+					(box.m_vertexStart + box.m_vertexCount <= header.m_vertexCount) && (box.m_soaVertexStart >= 0) && 
+					(box.m_soaVertexCount >= 0) && (box.m_soaVertexStart + box.m_soaVertexCount <= header.m_soaVertexCount);
+		}
+		else
+		{
+			state = (box.m_leftBox > i) && (box.m_leftBox < header.m_supportTreeCount) && (box.m_rightBox > i) && (box.m_rightBox < header.m_supportTreeCount);
+		}
+	}
+
+	if (!state)
+	{
+		delete hull;
+		return nullptr;
+	}
+	hull->SetVolumeAndCG();
+	return hull;
+}
+
 bool ndShapeConvexHull::Create(ndInt32 count, ndInt32 strideInBytes, const ndFloat32* const vertexArray, ndFloat32 tolerance, ndInt32 maxPointsOut)
 {
 	ndStack<ndBigVector> buffer(2 * count);
@@ -963,6 +1170,50 @@ ndVector ndShapeConvexHull::SupportFeatureVertex(const ndVector& dir, ndInt32* c
 	}
 }
 
+ndVector ndShapeConvexHull::SupportVertexHillClimb(const ndVector& dir, ndInt32* const vertexCache) const
+{
+	// the hull is convex, so walking the vertex adjacency graph toward 
+	// the direction always ends at the global support vertex.
+	ndInt32 index = ((*vertexCache >= 0) && (*vertexCache < m_vertexCount)) ? *vertexCache : 0;
+	ndFloat32 maxProj = m_vertex[index].DotProduct(dir).GetScalar();
+
+	ndInt32 climbing = 1;
+	for (ndInt32 steps = m_vertexCount; climbing && steps; --steps)
+	{
+		climbing = 0;
+		const ndConvexSimplexEdge* const edge = m_vertexToEdgeMapping[index];
+		const ndConvexSimplexEdge* ptr = edge;
+		do
+		{
+			const ndInt32 neighbor = ptr->m_twin->m_vertex;
+			const ndFloat32 proj = m_vertex[neighbor].DotProduct(dir).GetScalar();
+			if (proj > maxProj)
+			{
+				index = neighbor;
+				maxProj = proj;
+				climbing = 1;
+			}
+			ptr = ptr->m_twin->m_next;
+		} while (ptr != edge);
+	}
+
+	*vertexCache = index;
+	return m_vertex[index];
+}
+
+ndVector ndShapeConvexHull::SupportVertexCached(const ndVector& dir, ndFloat32, ndInt32* const vertexCache) const
+{
+	ndAssert(dir.m_w == ndFloat32(0.0f));
+	if (vertexCache && (m_vertexCount > D_CONVEX_VERTEX_BRUTE_FORCE_SPLIT))
+	{
+		return SupportVertexHillClimb(dir, vertexCache);
+	}
+	else
+	{
+		return SupportVertexBruteForce(dir, vertexCache);
+	}
+}
+
 ndShapeInfo ndShapeConvexHull::GetShapeInfo() const
 {
 	ndShapeInfo info(ndShapeConvex::GetShapeInfo());
@@ -34,6 +34,15 @@ class ndShapeConvexHull : public ndShapeConvex
 	D_COLLISION_API ndShapeConvexHull(ndInt32 count, ndInt32 strideInBytes, ndFloat32 tolerance, const ndFloat32* const vertexArray, ndInt32 maxPointsOut = 0x7fffffff);
 	D_COLLISION_API virtual ~ndShapeConvexHull();
 
+	// builds a batch of hulls across the thread pool, hull i is made of pointCount[i] 
+	// points read from vertexArray[i], the new shapes are written to hullsOut[i].
+	D_COLLISION_API static void CreateHulls(ndThreadPool& threadPool, ndInt32 hullCount, const ndInt32* const pointCount, const ndFloat32* const* const vertexArray, ndInt32 strideInBytes, ndFloat32 tolerance, ndShapeConvexHull** const hullsOut, ndInt32 maxPointsOut = 0x7fffffff);
+
+	// the cooked hull, vertex, edge adjacency and support tree, 
+	// it loads back without building the hull again.
+	D_COLLISION_API bool SerializeCooked(FILE* const file) const;
+	D_COLLISION_API static ndShapeConvexHull* DeserializeCooked(FILE* const file);
+
 	protected:
 	D_COLLISION_API ndShapeInfo GetShapeInfo() const;
 	D_COLLISION_API ndUnsigned64 GetHash(ndUnsigned64 hash) const;
@@ -42,8 +51,11 @@ class ndShapeConvexHull : public ndShapeConvex
 	bool Create(ndInt32 count, ndInt32 strideInBytes, const ndFloat32* const vertexArray, ndFloat32 tolerance, ndInt32 maxPointsOut);
 	virtual ndVector SupportVertex(const ndVector& dir) const;
 	virtual ndVector SupportFeatureVertex(const ndVector& dir, ndInt32* const vertexIndex) const;
+	virtual ndVector SupportVertexCached(const ndVector& dir, ndFloat32 skinMargin, ndInt32* const vertexCache) const;
 	
 	private:
+	ndShapeConvexHull();
+	ndVector SupportVertexHillClimb(const ndVector& dir, ndInt32* const vertexCache) const;
 	ndVector SupportVertexBruteForce(const ndVector& dir, ndInt32* const vertexIndex) const;
 	ndVector SupportVertexhierarchical(const ndVector& dir, ndInt32* const vertexIndex) const;
 	
@@ -29,7 +29,6 @@
 
 ndVector ndShapeHeightfield::m_yMask(0xffffffff, 0, 0xffffffff, 0);
 ndVector ndShapeHeightfield::m_padding(ndFloat32(0.25f), ndFloat32(0.25f), ndFloat32(0.25f), ndFloat32(0.0f));
-ndVector ndShapeHeightfield::m_elevationPadding(ndFloat32(0.0f), ndFloat32(1.0e10f), ndFloat32(0.0f), ndFloat32(0.0f));
 
 ndInt32 ndShapeHeightfield::m_cellIndices[][4] =
 {
@@ -45,12 +44,20 @@ ndShapeHeightfield::ndShapeHeightfield(
 	,m_maxBox(ndVector::m_zero)
 	,m_atributeMap(width * height)
 	,m_elevationMap(width * height)
+	,m_tiles()
+	,m_pyramid()
+	,m_pyramidLevels()
 	,m_horizontalScale_x(horizontalScale_x)
 	,m_horizontalScale_z(horizontalScale_z)
 	,m_horizontalScaleInv_x(ndFloat32(1.0f) / horizontalScale_x)
 	,m_horizontalScaleInv_z(ndFloat32(1.0f) / horizontalScale_z)
 	,m_width(width)
 	,m_height(height)
+	,m_tileSize(0)
+	,m_tileCount_x(0)
+	,m_tileCount_z(0)
+	,m_pyramidBlock(D_HEIGHTFIELD_PYRAMID_BLOCK)
+	,m_version(0)
 	,m_diagonalMode(constructionMode)
 {
 	ndAssert(width >= 2);
@@ -61,11 +68,151 @@ ndShapeHeightfield::ndShapeHeightfield(
 	memset(&m_atributeMap[0], 0, sizeof(ndInt8) * m_atributeMap.GetCount());
 	memset(&m_elevationMap[0], 0, sizeof(ndReal) * m_elevationMap.GetCount());
 
+	BuildPyramid();
+	CalculateLocalObb();
+}
+
+ndShapeHeightfield::ndShapeHeightfield(
+	ndInt32 width, ndInt32 height, ndInt32 tileSize, ndGridConstruction constructionMode,
+	ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z)
+	:ndShapeStaticMesh(m_heightField)
+	,m_minBox(ndVector::m_zero)
+	,m_maxBox(ndVector::m_zero)
+	,m_atributeMap()
+	,m_elevationMap()
+	,m_tiles()
+	,m_pyramid()
+	,m_pyramidLevels()
+	,m_horizontalScale_x(horizontalScale_x)
+	,m_horizontalScale_z(horizontalScale_z)
+	,m_horizontalScaleInv_x(ndFloat32(1.0f) / horizontalScale_x)
+	,m_horizontalScaleInv_z(ndFloat32(1.0f) / horizontalScale_z)
+	,m_width(width)
+	,m_height(height)
+	,m_tileSize(tileSize)
+	,m_tileCount_x((width - 1) / tileSize)
+	,m_tileCount_z((height - 1) / tileSize)
+	,m_pyramidBlock(tileSize)
+	,m_version(0)
+	,m_diagonalMode(constructionMode)
+{
+	ndAssert(tileSize >= 1);
+	ndAssert(width >= 2);
+	ndAssert(height >= 2);
+	ndAssert(((width - 1) % tileSize) == 0);
+	ndAssert(((height - 1) % tileSize) == 0);
+
+	m_tiles.SetCount(m_tileCount_x * m_tileCount_z);
+	for (ndInt32 i = ndInt32(m_tiles.GetCount()) - 1; i >= 0; --i)
+	{
+		m_tiles[i] = nullptr;
+	}
+	BuildPyramid();
 	CalculateLocalObb();
 }
 
 ndShapeHeightfield::~ndShapeHeightfield(void)
 {
+	for (ndInt32 i = ndInt32(m_tiles.GetCount()) - 1; i >= 0; --i)
+	{
+		if (m_tiles[i])
+		{
+			delete m_tiles[i];
+		}
+	}
+}
+
+ndShapeHeightfield::ndTile::ndTile(ndInt32 tileSize)
+	:ndClassAlloc()
+	,m_elevation()
+	,m_atributes()
+	,m_minHeight(ndReal(0.0f))
+	,m_maxHeight(ndReal(0.0f))
+	,m_scale(ndReal(0.0f))
+	,m_stride(tileSize + 1)
+{
+	m_elevation.SetCount(m_stride * m_stride);
+	m_atributes.SetCount(tileSize * tileSize);
+}
+
+void ndShapeHeightfield::SetTile(ndInt32 tile_x, ndInt32 tile_z, const ndReal* const elevation, const ndInt8* const atributes)
+{
+	ndAssert(m_tileSize);
+	ndAssert((tile_x >= 0) && (tile_x < m_tileCount_x));
+	ndAssert((tile_z >= 0) && (tile_z < m_tileCount_z));
+
+	// updating a resident tile reuses its memory
+	ndTile*& tile = m_tiles[tile_z * m_tileCount_x + tile_x];
+	if (!tile)
+	{
+		tile = new ndTile(m_tileSize);
+	}
+
+	const ndInt32 count = ndInt32(tile->m_elevation.GetCount());
+	ndReal minHeight = ndReal(1.0e10f);
+	ndReal maxHeight = -ndReal(1.0e10f);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		minHeight = ndMin(minHeight, elevation[i]);
+		maxHeight = ndMax(maxHeight, elevation[i]);
+	}
+
+	// quantize to 16 bits relative to the tile elevation range
+	const ndReal range = maxHeight - minHeight;
+	const ndReal invScale = (range > ndReal(1.0e-6f)) ? ndReal(65535.0f) / range : ndReal(0.0f);
+	tile->m_minHeight = minHeight;
+	tile->m_maxHeight = maxHeight;
+	tile->m_scale = range * ndReal(1.0f / 65535.0f);
+	for (ndInt32 i = 0; i < count; ++i)
+	{
+		const ndInt32 value = ndInt32((elevation[i] - minHeight) * invScale + ndReal(0.5f));
+		tile->m_elevation[i] = ndUnsigned16(ndClamp(value, 0, 65535));
+	}
+
+	if (atributes)
+	{
+		ndMemCpy(&tile->m_atributes[0], atributes, ndInt32(tile->m_atributes.GetCount()));
+	}
+	else
+	{
+		memset(&tile->m_atributes[0], 0, sizeof(ndInt8) * tile->m_atributes.GetCount());
+	}
+	UpdateElevationMapAabb(tile_x * m_tileSize, tile_z * m_tileSize, (tile_x + 1) * m_tileSize, (tile_z + 1) * m_tileSize);
+}
+
+void ndShapeHeightfield::UnloadTile(ndInt32 tile_x, ndInt32 tile_z)
+{
+	ndAssert(m_tileSize);
+	ndTile*& tile = m_tiles[tile_z * m_tileCount_x + tile_x];
+	if (tile)
+	{
+		delete tile;
+		tile = nullptr;
+		UpdateElevationMapAabb(tile_x * m_tileSize, tile_z * m_tileSize, (tile_x + 1) * m_tileSize, (tile_z + 1) * m_tileSize);
+	}
+}
+
+ndReal ndShapeHeightfield::GetTileElevation(ndInt32 x, ndInt32 z) const
+{
+	// border vertices are shared, read them from any resident tile that has them
+	const ndInt32 tile_x = ndMin(x / m_tileSize, m_tileCount_x - 1);
+	const ndInt32 tile_z = ndMin(z / m_tileSize, m_tileCount_z - 1);
+	for (ndInt32 i = 0; i < 4; ++i)
+	{
+		const ndInt32 ix = tile_x - (i & 1);
+		const ndInt32 iz = tile_z - (i >> 1);
+		const ndInt32 localX = x - ix * m_tileSize;
+		const ndInt32 localZ = z - iz * m_tileSize;
+		if ((ix >= 0) && (iz >= 0) && (localX <= m_tileSize) && (localZ <= m_tileSize))
+		{
+			const ndTile* const tile = m_tiles[iz * m_tileCount_x + ix];
+			if (tile)
+			{
+				return tile->GetElevation(localX, localZ);
+			}
+		}
+	}
+	return ndReal(0.0f);
 }
 
 ndShapeInfo ndShapeHeightfield::GetShapeInfo() const
@@ -77,20 +224,23 @@ ndShapeInfo ndShapeHeightfield::GetShapeInfo() const
 	info.m_heightfield.m_gridsDiagonals = m_diagonalMode;
 	info.m_heightfield.m_horizonalScale_x = m_horizontalScale_x;
 	info.m_heightfield.m_horizonalScale_z = m_horizontalScale_z;
-	info.m_heightfield.m_elevation = (ndReal*)&m_elevationMap[0];
-	info.m_heightfield.m_atributes = (ndInt8*)&m_atributeMap[0];
+	info.m_heightfield.m_elevation = m_tileSize ? nullptr : (ndReal*)&m_elevationMap[0];
+	info.m_heightfield.m_atributes = m_tileSize ? nullptr : (ndInt8*)&m_atributeMap[0];
 
 	return info;
 }
 
 void ndShapeHeightfield::CalculateLocalObb()
 {
-	ndReal y0 = ndReal (1.0e10f);
-	ndReal y1 = -ndReal(1.0e10f);
-	for (ndInt32 i = ndInt32(m_elevationMap.GetCount()-1); i >= 0; --i)
+	// the root of the pyramid bounds the whole map
+	const ndElevationBounds& root = m_pyramid[m_pyramid.GetCount() - 1];
+	ndReal y0 = root.m_min;
+	ndReal y1 = root.m_max;
+	if (y0 > y1)
 	{
-		y0 = ndMin(y0, m_elevationMap[i]);
-		y1 = ndMax(y1, m_elevationMap[i]);
+		// no tile is resident
+		y0 = ndReal(0.0f);
+		y1 = ndReal(0.0f);
 	}
 
 	m_minBox = ndVector(ndFloat32(0.0f), ndFloat32 (y0), ndFloat32(0.0f), ndFloat32(0.0f));
@@ -102,7 +252,142 @@ void ndShapeHeightfield::CalculateLocalObb()
 
 void ndShapeHeightfield::UpdateElevationMapAabb()
 {
+	UpdateElevationMapAabb(0, 0, m_width - 1, m_height - 1);
+}
+
+void ndShapeHeightfield::UpdateElevationMapAabb(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1)
+{
+	// only the blocks that contain the modified vertices are recalculated
+	UpdatePyramid(x0, z0, x1, z1);
 	CalculateLocalObb();
+	m_version++;
+}
+
+void ndShapeHeightfield::BuildPyramid()
+{
+	// each level halves the block count of the one below, up to a single root block
+	ndInt32 start = 0;
+	ndInt32 size = m_pyramidBlock;
+	m_pyramidLevels.SetCount(0);
+	for (;;)
+	{
+		ndPyramidLevel level;
+		level.m_start = start;
+		level.m_count_x = (m_width - 1 + size - 1) / size;
+		level.m_count_z = (m_height - 1 + size - 1) / size;
+		m_pyramidLevels.PushBack(level);
+		start += level.m_count_x * level.m_count_z;
+		if ((level.m_count_x == 1) && (level.m_count_z == 1))
+		{
+			break;
+		}
+		size *= 2;
+	}
+	m_pyramid.SetCount(start);
+	UpdatePyramid(0, 0, m_width - 1, m_height - 1);
+}
+
+void ndShapeHeightfield::CalculateBlockBounds(ndInt32 block_x, ndInt32 block_z, ndElevationBounds& bounds) const
+{
+	if (m_tileSize)
+	{
+		// the finest blocks are the tiles, empty space has inverted bounds
+		const ndTile* const tile = m_tiles[block_z * m_tileCount_x + block_x];
+		if (!tile)
+		{
+			bounds.m_min = ndReal(1.0e10f);
+			bounds.m_max = -ndReal(1.0e10f);
+			return;
+		}
+
+		// border vertices can be read from a neighbor tile with its own quantization,
+		// so they are added through the same accessor the cells use.
+		ndReal minVal = tile->m_minHeight;
+		ndReal maxVal = tile->m_maxHeight;
+		const ndInt32 x0 = block_x * m_tileSize;
+		const ndInt32 z0 = block_z * m_tileSize;
+		for (ndInt32 i = 0; i <= m_tileSize; ++i)
+		{
+			const ndReal h0 = GetTileElevation(x0 + i, z0);
+			const ndReal h1 = GetTileElevation(x0 + i, z0 + m_tileSize);
+			const ndReal h2 = GetTileElevation(x0, z0 + i);
+			const ndReal h3 = GetTileElevation(x0 + m_tileSize, z0 + i);
+			minVal = ndMin(minVal, ndMin(ndMin(h0, h1), ndMin(h2, h3)));
+			maxVal = ndMax(maxVal, ndMax(ndMax(h0, h1), ndMax(h2, h3)));
+		}
+		bounds.m_min = minVal;
+		bounds.m_max = maxVal;
+		return;
+	}
+
+	const ndInt32 x0 = block_x * m_pyramidBlock;
+	const ndInt32 z0 = block_z * m_pyramidBlock;
+	const ndInt32 x1 = ndMin(x0 + m_pyramidBlock, m_width - 1);
+	const ndInt32 z1 = ndMin(z0 + m_pyramidBlock, m_height - 1);
+
+	ndReal minVal = ndReal(1.0e10f);
+	ndReal maxVal = -ndReal(1.0e10f);
+	for (ndInt32 z = z0; z <= z1; ++z)
+	{
+		for (ndInt32 x = x0; x <= x1; ++x)
+		{
+			const ndReal high = GetElevation(x, z);
+			minVal = ndMin(high, minVal);
+			maxVal = ndMax(high, maxVal);
+		}
+	}
+	bounds.m_min = minVal;
+	bounds.m_max = maxVal;
+}
+
+void ndShapeHeightfield::UpdatePyramid(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1)
+{
+	// a vertex is shared by the blocks on both sides of a block border
+	const ndPyramidLevel& base = m_pyramidLevels[0];
+	ndInt32 block_x0 = ndClamp(x0 - 1, 0, m_width - 2) / m_pyramidBlock;
+	ndInt32 block_z0 = ndClamp(z0 - 1, 0, m_height - 2) / m_pyramidBlock;
+	ndInt32 block_x1 = ndMin(ndClamp(x1, 0, m_width - 2) / m_pyramidBlock, base.m_count_x - 1);
+	ndInt32 block_z1 = ndMin(ndClamp(z1, 0, m_height - 2) / m_pyramidBlock, base.m_count_z - 1);
+
+	for (ndInt32 z = block_z0; z <= block_z1; ++z)
+	{
+		for (ndInt32 x = block_x0; x <= block_x1; ++x)
+		{
+			CalculateBlockBounds(x, z, m_pyramid[base.m_start + z * base.m_count_x + x]);
+		}
+	}
+
+	for (ndInt32 i = 1; i < ndInt32(m_pyramidLevels.GetCount()); ++i)
+	{
+		const ndPyramidLevel& child = m_pyramidLevels[i - 1];
+		const ndPyramidLevel& level = m_pyramidLevels[i];
+		block_x0 >>= 1;
+		block_z0 >>= 1;
+		block_x1 >>= 1;
+		block_z1 >>= 1;
+		for (ndInt32 z = block_z0; z <= block_z1; ++z)
+		{
+			for (ndInt32 x = block_x0; x <= block_x1; ++x)
+			{
+				ndReal minVal = ndReal(1.0e10f);
+				ndReal maxVal = -ndReal(1.0e10f);
+				const ndInt32 cx1 = ndMin(2 * x + 1, child.m_count_x - 1);
+				const ndInt32 cz1 = ndMin(2 * z + 1, child.m_count_z - 1);
+				for (ndInt32 cz = 2 * z; cz <= cz1; ++cz)
+				{
+					for (ndInt32 cx = 2 * x; cx <= cx1; ++cx)
+					{
+						const ndElevationBounds& bounds = m_pyramid[child.m_start + cz * child.m_count_x + cx];
+						minVal = ndMin(bounds.m_min, minVal);
+						maxVal = ndMax(bounds.m_max, maxVal);
+					}
+				}
+				ndElevationBounds& bounds = m_pyramid[level.m_start + z * level.m_count_x + x];
+				bounds.m_min = minVal;
+				bounds.m_max = maxVal;
+			}
+		}
+	}
 }
 
 const ndInt32* ndShapeHeightfield::GetIndexList() const
@@ -124,59 +409,41 @@ void ndShapeHeightfield::DebugShape(const ndMatrix& matrix, ndShapeDebugNotify&
 	const ndInt32 i2 = indirectIndex[2];
 	const ndInt32 i3 = indirectIndex[3];
 
-	ndInt32 base = 0;
 	for (ndInt32 z = 0; z < m_height - 1; ++z)
 	{
-		const ndVector p0 ((ndFloat32)(0 + 0) * m_horizontalScale_x, ndFloat32(m_elevationMap[base + 0]),               (ndFloat32)(z + 0) * m_horizontalScale_z, ndFloat32(0.0f));
-		const ndVector p1 ((ndFloat32)(0 + 0) * m_horizontalScale_x, ndFloat32(m_elevationMap[base + 0 + m_width + 0]), (ndFloat32)(z + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+		const ndVector p0 ((ndFloat32)(0 + 0) * m_horizontalScale_x, ndFloat32(GetElevation(0, z + 0)), (ndFloat32)(z + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+		const ndVector p1 ((ndFloat32)(0 + 0) * m_horizontalScale_x, ndFloat32(GetElevation(0, z + 1)), (ndFloat32)(z + 1) * m_horizontalScale_z, ndFloat32(0.0f));
 
 		points[0 * 2 + 0] = matrix.TransformVector(p0);
 		points[1 * 2 + 0] = matrix.TransformVector(p1);
 
 		for (ndInt32 x = 0; x < m_width - 1; ++x) 
 		{
-			const ndVector p2 ((ndFloat32)(x + 1) * m_horizontalScale_x, ndFloat32(m_elevationMap[base + x + 1]),			(ndFloat32)(z + 0) * m_horizontalScale_z, ndFloat32(0.0f));
-			const ndVector p3 ((ndFloat32)(x + 1) * m_horizontalScale_x, ndFloat32(m_elevationMap[base + x + m_width + 1]), (ndFloat32)(z + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+			const ndVector p2 ((ndFloat32)(x + 1) * m_horizontalScale_x, ndFloat32(GetElevation(x + 1, z + 0)), (ndFloat32)(z + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+			const ndVector p3 ((ndFloat32)(x + 1) * m_horizontalScale_x, ndFloat32(GetElevation(x + 1, z + 1)), (ndFloat32)(z + 1) * m_horizontalScale_z, ndFloat32(0.0f));
 
 			points[0 * 2 + 1] = matrix.TransformVector(p2);
 			points[1 * 2 + 1] = matrix.TransformVector(p3);
 
-			triangle[0] = points[i1];
-			triangle[1] = points[i0];
-			triangle[2] = points[i2];
-			debugCallback.DrawPolygon(3, triangle, edgeType);
-
-			triangle[0] = points[i1];
-			triangle[1] = points[i2];
-			triangle[2] = points[i3];
-			debugCallback.DrawPolygon(3, triangle, edgeType);
+			if (IsCellResident(x, z))
+			{
+				triangle[0] = points[i1];
+				triangle[1] = points[i0];
+				triangle[2] = points[i2];
+				debugCallback.DrawPolygon(3, triangle, edgeType);
+
+				triangle[0] = points[i1];
+				triangle[1] = points[i2];
+				triangle[2] = points[i3];
+				debugCallback.DrawPolygon(3, triangle, edgeType);
+			}
 
 			points[0 * 2 + 0] = points[0 * 2 + 1];
 			points[1 * 2 + 0] = points[1 * 2 + 1];
 		}
-		base += m_width;
 	}
 }
 
-void ndShapeHeightfield::CalculateMinExtend2d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const
-{
-	const ndVector scale(m_horizontalScale_x, ndFloat32(0.0f), m_horizontalScale_z, ndFloat32(0.0f));
-	const ndVector q0(p0.GetMin(p1) - m_padding);
-	const ndVector q1(p0.GetMax(p1) + scale + m_padding);
-
-	const ndVector invScale(m_horizontalScaleInv_x, ndFloat32(0.0f), m_horizontalScaleInv_z, ndFloat32(0.0f));
-	boxP0 = (((q0 * invScale).Floor() * scale)         & m_yMask) - m_elevationPadding;
-	boxP1 = (((q1 * invScale).Floor() * scale + scale) & m_yMask) + m_elevationPadding;
-	ndAssert(boxP0.m_w == ndFloat32(0.0f));
-	ndAssert(boxP1.m_w == ndFloat32(0.0f));
-
-	const ndVector minBox(boxP0.Select(m_minBox, m_yMask));
-	const ndVector maxBox(boxP1.Select(m_maxBox, m_yMask));
-
-	boxP0 = boxP0.GetMax(minBox);
-	boxP1 = boxP1.GetMin(maxBox);
-}
-
 void ndShapeHeightfield::CalculateMinExtend3d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const
 {
 	ndAssert(p0.m_x <= p1.m_x);
@@ -224,6 +491,12 @@ void ndShapeHeightfield::GetLocalAabb(const ndVector& q0, const ndVector& q1, nd
 	ndFloat32 minHeight = ndFloat32(1.0e10f);
 	ndFloat32 maxHeight = ndFloat32(-1.0e10f);
 	CalculateMinAndMaxElevation(x0, x1, z0, z1, minHeight, maxHeight);
+	if (minHeight > maxHeight)
+	{
+		// no resident tile under the box
+		minHeight = m_minBox.m_y;
+		maxHeight = m_minBox.m_y;
+	}
 	boxP0.m_y = minHeight;
 	boxP1.m_y = maxHeight;
 	ndAssert(boxP0.m_x <= boxP1.m_x);
@@ -242,14 +515,17 @@ ndFloat32 ndShapeHeightfield::RayCastCell(const ndFastRay& ray, ndInt32 xIndex0,
 		return ndFloat32(1.2f);
 	}
 
-	ndAssert(maxT <= 1.0);
+	if (!IsCellResident(xIndex0, zIndex0))
+	{
+		return ndFloat32(1.2f);
+	}
 
-	ndInt32 base = zIndex0 * m_width + xIndex0;
+	ndAssert(maxT <= 1.0);
 
-	points[0 * 2 + 0] = ndVector((ndFloat32)(xIndex0 + 0) * m_horizontalScale_x, ndFloat32 (m_elevationMap[base + 0]),			 (ndFloat32)(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
-	points[0 * 2 + 1] = ndVector((ndFloat32)(xIndex0 + 1) * m_horizontalScale_x, ndFloat32 (m_elevationMap[base + 1]),			 (ndFloat32)(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
-	points[1 * 2 + 1] = ndVector((ndFloat32)(xIndex0 + 1) * m_horizontalScale_x, ndFloat32 (m_elevationMap[base + m_width + 1]), (ndFloat32)(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
-	points[1 * 2 + 0] = ndVector((ndFloat32)(xIndex0 + 0) * m_horizontalScale_x, ndFloat32 (m_elevationMap[base + m_width + 0]), (ndFloat32)(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[0 * 2 + 0] = ndVector((ndFloat32)(xIndex0 + 0) * m_horizontalScale_x, ndFloat32 (GetElevation(xIndex0 + 0, zIndex0 + 0)), (ndFloat32)(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[0 * 2 + 1] = ndVector((ndFloat32)(xIndex0 + 1) * m_horizontalScale_x, ndFloat32 (GetElevation(xIndex0 + 1, zIndex0 + 0)), (ndFloat32)(zIndex0 + 0) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[1 * 2 + 1] = ndVector((ndFloat32)(xIndex0 + 1) * m_horizontalScale_x, ndFloat32 (GetElevation(xIndex0 + 1, zIndex0 + 1)), (ndFloat32)(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
+	points[1 * 2 + 0] = ndVector((ndFloat32)(xIndex0 + 0) * m_horizontalScale_x, ndFloat32 (GetElevation(xIndex0 + 0, zIndex0 + 1)), (ndFloat32)(zIndex0 + 1) * m_horizontalScale_z, ndFloat32(0.0f));
 
 	ndFloat32 t = ndFloat32(1.2f);
 	if (m_diagonalMode == m_normalDiagonals)
@@ -319,111 +595,143 @@ ndFloat32 ndShapeHeightfield::RayCastCell(const ndFastRay& ray, ndInt32 xIndex0,
 
 ndFloat32 ndShapeHeightfield::RayCast(ndRayCastNotify&, const ndVector& localP0, const ndVector& localP1, ndFloat32 maxT, const ndBody* const, ndContactPoint& contactOut) const
 {
-	ndVector boxP0;
-	ndVector boxP1;
-
-	// calculate the ray bounding box
-	CalculateMinExtend2d(localP0, localP1, boxP0, boxP1);
+	const ndVector dp(localP1 - localP0);
+	const ndInt32 cells_x = m_width - 1;
+	const ndInt32 cells_z = m_height - 1;
+
+	// clip the ray against the horizontal extent of the grid
+	ndFloat32 tMin = ndFloat32(0.0f);
+	ndFloat32 tMax = ndMin(maxT, ndFloat32(1.0f));
+	const ndFloat32 size_x = ndFloat32(cells_x) * m_horizontalScale_x;
+	const ndFloat32 size_z = ndFloat32(cells_z) * m_horizontalScale_z;
+	if (ndAbs(dp.m_x) > ndFloat32(1.0e-9f))
+	{
+		const ndFloat32 t0 = -localP0.m_x / dp.m_x;
+		const ndFloat32 t1 = (size_x - localP0.m_x) / dp.m_x;
+		tMin = ndMax(tMin, ndMin(t0, t1));
+		tMax = ndMin(tMax, ndMax(t0, t1));
+	}
+	else if ((localP0.m_x < ndFloat32(0.0f)) || (localP0.m_x > size_x))
+	{
+		return ndFloat32(1.2f);
+	}
+	if (ndAbs(dp.m_z) > ndFloat32(1.0e-9f))
+	{
+		const ndFloat32 t0 = -localP0.m_z / dp.m_z;
+		const ndFloat32 t1 = (size_z - localP0.m_z) / dp.m_z;
+		tMin = ndMax(tMin, ndMin(t0, t1));
+		tMax = ndMin(tMax, ndMax(t0, t1));
+	}
+	else if ((localP0.m_z < ndFloat32(0.0f)) || (localP0.m_z > size_z))
+	{
+		return ndFloat32(1.2f);
+	}
+	if (tMin > tMax)
+	{
+		return ndFloat32(1.2f);
+	}
 
-	ndVector p0(localP0);
-	ndVector p1(localP1);
-	
-	// clip the line against the bounding box
-	if (ndRayBoxClip(p0, p1, boxP0, boxP1)) 
+	const ndFloat32 invDx = (ndAbs(dp.m_x) > ndFloat32(1.0e-9f)) ? ndFloat32(1.0f) / dp.m_x : ndFloat32(0.0f);
+	const ndFloat32 invDz = (ndAbs(dp.m_z) > ndFloat32(1.0e-9f)) ? ndFloat32(1.0f) / dp.m_z : ndFloat32(0.0f);
+	auto RegionExit = [this, &localP0, &dp, invDx, invDz](ndInt32 x0, ndInt32 x1, ndInt32 z0, ndInt32 z1, ndFloat32& tx, ndFloat32& tz)
 	{
-		ndVector dp(p1 - p0);
-		ndVector normalOut(ndVector::m_zero);
-	
-		ndFloat32 scale_x = m_horizontalScale_x;
-		ndFloat32 invScale_x = m_horizontalScaleInv_x;
-		ndFloat32 scale_z = m_horizontalScale_z;
-		ndFloat32 invScale_z = m_horizontalScaleInv_z;
-		ndInt32 ix0 = FastInt(p0.m_x * invScale_x);
-		ndInt32 iz0 = FastInt(p0.m_z * invScale_z);
-	
-		// implement a 3ddda line algorithm 
-		ndInt32 xInc;
+		tx = (dp.m_x > ndFloat32(0.0f)) ? (ndFloat32(x1) * m_horizontalScale_x - localP0.m_x) * invDx : ndFloat32(1.0e10f);
+		tx = (dp.m_x < ndFloat32(0.0f)) ? (ndFloat32(x0) * m_horizontalScale_x - localP0.m_x) * invDx : tx;
+		tz = (dp.m_z > ndFloat32(0.0f)) ? (ndFloat32(z1) * m_horizontalScale_z - localP0.m_z) * invDz : ndFloat32(1.0e10f);
+		tz = (dp.m_z < ndFloat32(0.0f)) ? (ndFloat32(z0) * m_horizontalScale_z - localP0.m_z) * invDz : tz;
+		return ndMin(tx, tz);
+	};
+
+	const ndVector q(localP0 + dp.Scale(tMin));
+	ndInt32 xIndex = ndClamp(FastInt(q.m_x * m_horizontalScaleInv_x), 0, cells_x - 1);
+	ndInt32 zIndex = ndClamp(FastInt(q.m_z * m_horizontalScaleInv_z), 0, cells_z - 1);
+
+	ndFloat32 t = tMin;
+	ndFastRay ray(localP0, localP1);
+	ndVector normalOut(ndVector::m_zero);
+	const ndReal tol = ndReal(1.0e-3f);
+	for (;;)
+	{
+		// climb the pyramid while the ray stays above or below the block bounds, 
+		// and skip the largest empty block in a single step.
+		ndInt32 x0 = xIndex;
+		ndInt32 z0 = zIndex;
+		ndInt32 x1 = xIndex + 1;
+		ndInt32 z1 = zIndex + 1;
 		ndFloat32 tx;
-		ndFloat32 stepX;
-		if (dp.m_x > ndFloat32(0.0f)) 
+		ndFloat32 tz;
+		ndFloat32 tExit = RegionExit(x0, x1, z0, z1, tx, tz);
+
+		bool isEmpty = false;
+		for (ndInt32 i = 0; i < ndInt32(m_pyramidLevels.GetCount()); ++i)
 		{
-			xInc = 1;
-			ndFloat32 val = ndFloat32(1.0f) / dp.m_x;
-			stepX = scale_x * val;
-			tx = (scale_x * ((ndFloat32)ix0 + ndFloat32(1.0f)) - p0.m_x) * val;
+			const ndPyramidLevel& level = m_pyramidLevels[i];
+			const ndInt32 size = m_pyramidBlock << i;
+			const ndInt32 block_x = xIndex / size;
+			const ndInt32 block_z = zIndex / size;
+			const ndElevationBounds& bounds = m_pyramid[level.m_start + block_z * level.m_count_x + block_x];
+
+			const ndInt32 bx0 = block_x * size;
+			const ndInt32 bz0 = block_z * size;
+			const ndInt32 bx1 = ndMin(bx0 + size, cells_x);
+			const ndInt32 bz1 = ndMin(bz0 + size, cells_z);
+			ndFloat32 blockTx;
+			ndFloat32 blockTz;
+			const ndFloat32 blockExit = RegionExit(bx0, bx1, bz0, bz1, blockTx, blockTz);
+			const ndFloat32 y0 = localP0.m_y + dp.m_y * t;
+			const ndFloat32 y1 = localP0.m_y + dp.m_y * ndMin(blockExit, tMax);
+			if ((ndMin(y0, y1) <= ndFloat32(bounds.m_max + tol)) && (ndMax(y0, y1) >= ndFloat32(bounds.m_min - tol)))
+			{
+				break;
+			}
+			isEmpty = true;
+			x0 = bx0;
+			z0 = bz0;
+			x1 = bx1;
+			z1 = bz1;
+			tx = blockTx;
+			tz = blockTz;
+			tExit = blockExit;
 		}
-		else if (dp.m_x < ndFloat32(0.0f)) 
+
+		if (!isEmpty)
 		{
-			xInc = -1;
-			ndFloat32 val = -ndFloat32(1.0f) / dp.m_x;
-			stepX = scale_x * val;
-			tx = -(scale_x * (ndFloat32)ix0 - p0.m_x) * val;
+			ndFloat32 hitT = RayCastCell(ray, xIndex, zIndex, normalOut, maxT);
+			if (hitT < maxT) 
+			{
+				// bail out at the first intersection and copy the data into the descriptor
+				ndAssert(normalOut.m_w == ndFloat32(0.0f));
+				contactOut.m_normal = normalOut.Normalize();
+				contactOut.m_shapeId0 = GetAtribute(xIndex, zIndex);
+				contactOut.m_shapeId1 = GetAtribute(xIndex, zIndex);
+				return hitT;
+			}
 		}
-		else 
+
+		if (tExit >= tMax)
 		{
-			xInc = 0;
-			stepX = ndFloat32(0.0f);
-			tx = ndFloat32(1.0e10f);
+			break;
 		}
-	
-		ndInt32 zInc;
-		ndFloat32 tz;
-		ndFloat32 stepZ;
-		if (dp.m_z > ndFloat32(0.0f)) 
+
+		// step to the cell across the face the ray leaves the region through
+		const ndVector p(localP0 + dp.Scale(tExit));
+		ndInt32 nextX = ndClamp(FastInt(p.m_x * m_horizontalScaleInv_x), x0, x1 - 1);
+		ndInt32 nextZ = ndClamp(FastInt(p.m_z * m_horizontalScaleInv_z), z0, z1 - 1);
+		if (tx <= tExit)
 		{
-			zInc = 1;
-			ndFloat32 val = ndFloat32(1.0f) / dp.m_z;
-			stepZ = scale_z * val;
-			tz = (scale_z * ((ndFloat32)iz0 + ndFloat32(1.0f)) - p0.m_z) * val;
+			nextX = (dp.m_x > ndFloat32(0.0f)) ? x1 : x0 - 1;
 		}
-		else if (dp.m_z < ndFloat32(0.0f)) 
+		if (tz <= tExit)
 		{
-			zInc = -1;
-			ndFloat32 val = -ndFloat32(1.0f) / dp.m_z;
-			stepZ = scale_z * val;
-			tz = -(scale_z * (ndFloat32)iz0 - p0.m_z) * val;
+			nextZ = (dp.m_z > ndFloat32(0.0f)) ? z1 : z0 - 1;
 		}
-		else 
+		if ((nextX < 0) || (nextZ < 0) || (nextX >= cells_x) || (nextZ >= cells_z))
 		{
-			zInc = 0;
-			stepZ = ndFloat32(0.0f);
-			tz = ndFloat32(1.0e10f);
+			break;
 		}
-	
-		ndFloat32 txAcc = tx;
-		ndFloat32 tzAcc = tz;
-		ndInt32 xIndex0 = ix0;
-		ndInt32 zIndex0 = iz0;
-		ndFastRay ray(localP0, localP1);
-	
-		// for each cell touched by the line
-		do 
-		{
-			ndFloat32 t = RayCastCell(ray, xIndex0, zIndex0, normalOut, maxT);
-			if (t < maxT) 
-			{
-				// bail out at the first intersection and copy the data into the descriptor
-				ndAssert(normalOut.m_w == ndFloat32(0.0f));
-				contactOut.m_normal = normalOut.Normalize();
-				contactOut.m_shapeId0 = m_atributeMap[zIndex0 * m_width + xIndex0];
-				contactOut.m_shapeId1 = m_atributeMap[zIndex0 * m_width + xIndex0];
-	
-				return t;
-			}
-	
-			if (txAcc < tzAcc) 
-			{
-				xIndex0 += xInc;
-				tx = txAcc;
-				txAcc += stepX;
-			}
-			else 
-			{
-				zIndex0 += zInc;
-				tz = tzAcc;
-				tzAcc += stepZ;
-			}
-		} while ((tx <= ndFloat32(1.0f)) || (tz <= ndFloat32(1.0f)));
+		xIndex = nextX;
+		zIndex = nextZ;
+		t = tExit;
 	}
 	
 	// if no cell was hit, return a large value
@@ -432,19 +740,85 @@ ndFloat32 ndShapeHeightfield::RayCast(ndRayCastNotify&, const ndVector& localP0,
 
 void ndShapeHeightfield::CalculateMinAndMaxElevation(ndInt32 x0, ndInt32 x1, ndInt32 z0, ndInt32 z1, ndFloat32& minHeight, ndFloat32& maxHeight) const
 {
+	class ndStackEntry
+	{
+		public:
+		ndInt32 m_level;
+		ndInt32 m_x;
+		ndInt32 m_z;
+	};
+
 	ndReal minVal = ndReal(1.0e10f);
 	ndReal maxVal = -ndReal(1.0e10f);
 
-	ndInt32 base = z0 * m_width;
-	for (ndInt32 z = z0; z <= z1; ++z) 
+	// descend the pyramid from the root, blocks inside the query contribute 
+	// their bounds, only the blocks that straddle the query border are opened.
+	ndInt32 stack = 1;
+	ndStackEntry stackPool[128];
+	stackPool[0].m_level = ndInt32(m_pyramidLevels.GetCount()) - 1;
+	stackPool[0].m_x = 0;
+	stackPool[0].m_z = 0;
+	while (stack)
 	{
-		for (ndInt32 x = x0; x <= x1; ++x) 
+		stack--;
+		const ndStackEntry entry(stackPool[stack]);
+		const ndPyramidLevel& level = m_pyramidLevels[entry.m_level];
+		const ndElevationBounds& bounds = m_pyramid[level.m_start + entry.m_z * level.m_count_x + entry.m_x];
+		if ((bounds.m_min > bounds.m_max) || ((bounds.m_min >= minVal) && (bounds.m_max <= maxVal)))
 		{
-			ndReal high = m_elevationMap[base + x];
-			minVal = ndMin(high, minVal);
-			maxVal = ndMax(high, maxVal);
+			// empty space, or nothing in the block can grow the bounds
+			continue;
+		}
+
+		const ndInt32 size = m_pyramidBlock << entry.m_level;
+		const ndInt32 bx0 = entry.m_x * size;
+		const ndInt32 bz0 = entry.m_z * size;
+		const ndInt32 bx1 = ndMin(bx0 + size, m_width - 1);
+		const ndInt32 bz1 = ndMin(bz0 + size, m_height - 1);
+		if ((bx0 > x1) || (bx1 < x0) || (bz0 > z1) || (bz1 < z0))
+		{
+			continue;
+		}
+
+		if ((bx0 >= x0) && (bx1 <= x1) && (bz0 >= z0) && (bz1 <= z1))
+		{
+			minVal = ndMin(bounds.m_min, minVal);
+			maxVal = ndMax(bounds.m_max, maxVal);
+		}
+		else if (entry.m_level == 0)
+		{
+			const ndInt32 sx0 = ndMax(bx0, x0);
+			const ndInt32 sz0 = ndMax(bz0, z0);
+			const ndInt32 sx1 = ndMin(bx1, x1);
+			const ndInt32 sz1 = ndMin(bz1, z1);
+			// shared border vertices must read the same tile the cells read
+			for (ndInt32 z = sz0; z <= sz1; ++z) 
+			{
+				for (ndInt32 x = sx0; x <= sx1; ++x) 
+				{
+					const ndReal high = GetElevation(x, z);
+					minVal = ndMin(high, minVal);
+					maxVal = ndMax(high, maxVal);
+				}
+			}
+		}
+		else
+		{
+			const ndPyramidLevel& child = m_pyramidLevels[entry.m_level - 1];
+			const ndInt32 cx1 = ndMin(2 * entry.m_x + 1, child.m_count_x - 1);
+			const ndInt32 cz1 = ndMin(2 * entry.m_z + 1, child.m_count_z - 1);
+			for (ndInt32 z = 2 * entry.m_z; z <= cz1; ++z)
+			{
+				for (ndInt32 x = 2 * entry.m_x; x <= cx1; ++x)
+				{
+					stackPool[stack].m_level = entry.m_level - 1;
+					stackPool[stack].m_x = x;
+					stackPool[stack].m_z = z;
+					stack++;
+					ndAssert(stack < ndInt32(sizeof(stackPool) / sizeof(stackPool[0])));
+				}
+			}
 		}
-		base += m_width;
 	}
 
 	minHeight = minVal;
@@ -498,17 +872,15 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 		vertex.SetCount(vertexCount);
 
 		ndInt32 vertexIndex = 0;
-		ndInt32 base = z0 * m_width;
 		for (ndInt32 z = z0; z <= z1; ++z) 
 		{
 			ndFloat32 zVal = m_horizontalScale_z * (ndFloat32)z;
 			for (ndInt32 x = x0; x <= x1; ++x) 
 			{
-				vertex[vertexIndex] = ndVector(m_horizontalScale_x * (ndFloat32)x, ndFloat32(m_elevationMap[base + x]), zVal, ndFloat32(0.0f));
+				vertex[vertexIndex] = ndVector(m_horizontalScale_x * (ndFloat32)x, ndFloat32(GetElevation(x, z)), zVal, ndFloat32(0.0f));
 				vertexIndex++;
 				ndAssert(vertexIndex <= vertex.GetCount());
 			}
-			base += m_width;
 		}
 
 		ndInt32 normalBase = vertexIndex;
@@ -528,7 +900,6 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 			ndGridQuad* const quadArray = (ndGridQuad*)&quadDataArray[0];
 			for (ndInt32 z = z0; z < z1; ++z)
 			{
-				ndInt32 zStep = z * m_width;
 				for (ndInt32 x = x0; x < x1; ++x)
 				{
 					ndInt32 vIndex[4];
@@ -563,12 +934,13 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 					vertex[normalIndex1] = n1;
 
 					ndGridQuad& quad = quadArray[quadCount];
+					const ndInt32 material = GetAtribute(x, z);
 
 					faceIndexCount.PushBack(3);
 					quad.m_triangle0.m_i0 = i2;
 					quad.m_triangle0.m_i1 = i1;
 					quad.m_triangle0.m_i2 = i0;
-					quad.m_triangle0.m_material = m_atributeMap[zStep + x];
+					quad.m_triangle0.m_material = material;
 					quad.m_triangle0.m_normal = normalIndex0;
 					quad.m_triangle0.m_normal_edge01 = normalIndex0;
 					quad.m_triangle0.m_normal_edge12 = normalIndex0;
@@ -579,7 +951,7 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 					quad.m_triangle1.m_i0 = i1;
 					quad.m_triangle1.m_i1 = i2;
 					quad.m_triangle1.m_i2 = i3;
-					quad.m_triangle1.m_material = m_atributeMap[zStep + x];
+					quad.m_triangle1.m_material = material;
 					quad.m_triangle1.m_normal = normalIndex1;
 					quad.m_triangle1.m_normal_edge01 = normalIndex1;
 					quad.m_triangle1.m_normal_edge12 = normalIndex1;
@@ -727,6 +1099,14 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 		ndArray<ndInt32>& address = query.m_faceIndexStart;
 		ndArray<ndFloat32>& hitDistance = query.m_hitDistance;
 
+		// faces of cells in tiles that are not resident are culled
+		const ndInt32 quadsPerRow = x1 - x0;
+		auto IsFaceResident = [this, x0, z0, quadsPerRow](ndInt32 face)
+		{
+			const ndInt32 quad = face >> 1;
+			return IsCellResident(x0 + quad % quadsPerRow, z0 + quad / quadsPerRow);
+		};
+
 		if (data->m_doContinueCollisionTest) 
 		{
 			//ndAssert(0);
@@ -736,7 +1116,7 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 			{
 				const ndInt32* const indexArray = &indices[faceIndexCount1];
 				const ndVector& faceNormal = vertex[indexArray[4]];
-				ndFloat32 dist = data->PolygonBoxRayDistance(faceNormal, 3, indexArray, stride, &vertex[0].m_x, ray);
+				ndFloat32 dist = IsFaceResident(i) ? data->PolygonBoxRayDistance(faceNormal, 3, indexArray, stride, &vertex[0].m_x, ray) : ndFloat32(1.0f);
 				if (dist < ndFloat32(1.0f)) 
 				{
 					hitDistance.PushBack(dist);
@@ -755,7 +1135,7 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 			{
 				const ndInt32* const indexArray = &indices[faceIndexCount1];
 				const ndVector& faceNormal = vertex[indexArray[4]];
-				ndFloat32 dist = data->PolygonBoxDistance(faceNormal, 3, indexArray, stride, &vertex[0].m_x);
+				ndFloat32 dist = IsFaceResident(i) ? data->PolygonBoxDistance(faceNormal, 3, indexArray, stride, &vertex[0].m_x) : ndFloat32(0.0f);
 				if (dist > ndFloat32(0.0f)) 
 				{
 					hitDistance.PushBack(dist);
@@ -776,6 +1156,23 @@ void ndShapeHeightfield::GetCollidingFaces(ndPolygonMeshDesc* const data) const
 
 ndUnsigned64 ndShapeHeightfield::GetHash(ndUnsigned64 hash) const
 {
+	if (m_tileSize)
+	{
+		for (ndInt32 i = 0; i < ndInt32(m_tiles.GetCount()); ++i)
+		{
+			const ndTile* const tile = m_tiles[i];
+			if (tile)
+			{
+				// the same tile at another location, or with another range, is another shape
+				hash = ndCRC64(&i, ndInt32(sizeof(ndInt32)), hash);
+				hash = ndCRC64(&tile->m_minHeight, ndInt32(sizeof(ndReal)), hash);
+				hash = ndCRC64(&tile->m_scale, ndInt32(sizeof(ndReal)), hash);
+				hash = ndCRC64(&tile->m_atributes[0], ndInt32(tile->m_atributes.GetCount()) * ndInt32(sizeof(ndInt8)), hash);
+				hash = ndCRC64(&tile->m_elevation[0], ndInt32(tile->m_elevation.GetCount()) * ndInt32(sizeof(ndUnsigned16)), hash);
+			}
+		}
+		return hash;
+	}
 	hash = ndCRC64(&m_atributeMap[0], ndInt32(m_atributeMap.GetCount()) * ndInt32(sizeof(ndInt8)), hash);
 	hash = ndCRC64(&m_elevationMap[0], ndInt32(m_elevationMap.GetCount()) * ndInt32(sizeof(ndReal)), hash);
 	return hash;
@@ -25,6 +25,9 @@
 #include "ndCollisionStdafx.h"
 #include "ndShapeStaticMesh.h"
 
+// cells per side of the finest min/max elevation pyramid block
+#define D_HEIGHTFIELD_PYRAMID_BLOCK	4
+
 class ndShapeHeightfield: public ndShapeStaticMesh
 {
 	public:
@@ -55,16 +58,46 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 		m_invertedDiagonals,
 	};
 
+	// a square block of tileSize x tileSize cells with 16 bit elevations,
+	// the tile stores the (tileSize + 1) x (tileSize + 1) vertices of its cells
+	// so border vertices are shared with the neighbor tiles.
+	class ndTile: public ndClassAlloc
+	{
+		public:
+		ndTile(ndInt32 tileSize);
+
+		ndReal GetElevation(ndInt32 x, ndInt32 z) const;
+
+		ndArray<ndUnsigned16> m_elevation;
+		ndArray<ndInt8> m_atributes;
+		ndReal m_minHeight;
+		ndReal m_maxHeight;
+		ndReal m_scale;
+		ndInt32 m_stride;
+	};
+
 	D_CLASS_REFLECTION(ndShapeHeightfield,ndShapeStaticMesh)
 	D_COLLISION_API ndShapeHeightfield(ndInt32 width, ndInt32 height, ndGridConstruction constructionMode,ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z);
+	D_COLLISION_API ndShapeHeightfield(ndInt32 width, ndInt32 height, ndInt32 tileSize, ndGridConstruction constructionMode, ndFloat32 horizontalScale_x, ndFloat32 horizontalScale_z);
 	D_COLLISION_API virtual ~ndShapeHeightfield();
 
 	ndArray<ndReal>& GetElevationMap();
 	const ndArray<ndReal>& GetElevationMap() const;
 
+	ndUnsigned32 GetVersion() const;
 	D_COLLISION_API void UpdateElevationMapAabb();
+	D_COLLISION_API void UpdateElevationMapAabb(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1);
 	D_COLLISION_API void GetLocalAabb(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 
+	// tiled heightfields, tiles can be loaded, updated and unloaded between world updates.
+	// cells in tiles that are not resident do not generate contacts nor ray hits
+	ndInt32 GetTileSize() const;
+	ndInt32 GetTileCount_x() const;
+	ndInt32 GetTileCount_z() const;
+	bool IsTileResident(ndInt32 tile_x, ndInt32 tile_z) const;
+	D_COLLISION_API void SetTile(ndInt32 tile_x, ndInt32 tile_z, const ndReal* const elevation, const ndInt8* const atributes);
+	D_COLLISION_API void UnloadTile(ndInt32 tile_x, ndInt32 tile_z);
+
 	protected:
 	virtual ndShapeInfo GetShapeInfo() const;
 	virtual ndUnsigned64 GetHash(ndUnsigned64 hash) const;
@@ -74,29 +107,58 @@ class ndShapeHeightfield: public ndShapeStaticMesh
 	virtual void GetCollidingFaces(ndPolygonMeshDesc* const data) const;
 
 	private: 
+	class ndElevationBounds
+	{
+		public:
+		ndReal m_min;
+		ndReal m_max;
+	};
+
+	class ndPyramidLevel
+	{
+		public:
+		ndInt32 m_start;
+		ndInt32 m_count_x;
+		ndInt32 m_count_z;
+	};
+
+	void BuildPyramid();
+	void UpdatePyramid(ndInt32 x0, ndInt32 z0, ndInt32 x1, ndInt32 z1);
+	void CalculateBlockBounds(ndInt32 block_x, ndInt32 block_z, ndElevationBounds& bounds) const;
 	void CalculateLocalObb();
 	ndInt32 FastInt(ndFloat32 x) const;
 	const ndInt32* GetIndexList() const;
-	void CalculateMinExtend2d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 	void CalculateMinExtend3d(const ndVector& p0, const ndVector& p1, ndVector& boxP0, ndVector& boxP1) const;
 	ndFloat32 RayCastCell(const ndFastRay& ray, ndInt32 xIndex0, ndInt32 zIndex0, ndVector& normalOut, ndFloat32 maxT) const;
 	void CalculateMinAndMaxElevation(ndInt32 x0, ndInt32 x1, ndInt32 z0, ndInt32 z1, ndFloat32& minHeight, ndFloat32& maxHeight) const;
 
+	ndReal GetElevation(ndInt32 x, ndInt32 z) const;
+	ndInt8 GetAtribute(ndInt32 x, ndInt32 z) const;
+	bool IsCellResident(ndInt32 x, ndInt32 z) const;
+	ndReal GetTileElevation(ndInt32 x, ndInt32 z) const;
+
 	ndVector m_minBox;
 	ndVector m_maxBox;
 	ndArray<ndInt8> m_atributeMap;
 	ndArray<ndReal> m_elevationMap;
+	ndArray<ndTile*> m_tiles;
+	ndArray<ndElevationBounds> m_pyramid;
+	ndArray<ndPyramidLevel> m_pyramidLevels;
 	ndFloat32 m_horizontalScale_x;
 	ndFloat32 m_horizontalScale_z;
 	ndFloat32 m_horizontalScaleInv_x;
 	ndFloat32 m_horizontalScaleInv_z;
 	ndInt32 m_width;
 	ndInt32 m_height;
+	ndInt32 m_tileSize;
+	ndInt32 m_tileCount_x;
+	ndInt32 m_tileCount_z;
+	ndInt32 m_pyramidBlock;
+	ndUnsigned32 m_version;
 	ndGridConstruction m_diagonalMode;
 
 	static ndVector m_yMask;
 	static ndVector m_padding;
-	static ndVector m_elevationPadding;
 	static ndInt32 m_cellIndices[][4];
 
 	friend class ndContactSolver;
@@ -112,6 +174,57 @@ inline const ndArray<ndReal>& ndShapeHeightfield::GetElevationMap() const
 	return m_elevationMap;
 }
 
+inline ndReal ndShapeHeightfield::ndTile::GetElevation(ndInt32 x, ndInt32 z) const
+{
+	return m_minHeight + m_scale * ndReal(m_elevation[z * m_stride + x]);
+}
+
+inline ndUnsigned32 ndShapeHeightfield::GetVersion() const
+{
+	return m_version;
+}
+
+inline ndInt32 ndShapeHeightfield::GetTileSize() const
+{
+	return m_tileSize;
+}
+
+inline ndInt32 ndShapeHeightfield::GetTileCount_x() const
+{
+	return m_tileCount_x;
+}
+
+inline ndInt32 ndShapeHeightfield::GetTileCount_z() const
+{
+	return m_tileCount_z;
+}
+
+inline bool ndShapeHeightfield::IsTileResident(ndInt32 tile_x, ndInt32 tile_z) const
+{
+	ndAssert(m_tileSize);
+	return m_tiles[tile_z * m_tileCount_x + tile_x] ? true : false;
+}
+
+inline ndReal ndShapeHeightfield::GetElevation(ndInt32 x, ndInt32 z) const
+{
+	return m_tileSize ? GetTileElevation(x, z) : m_elevationMap[z * m_width + x];
+}
+
+inline ndInt8 ndShapeHeightfield::GetAtribute(ndInt32 x, ndInt32 z) const
+{
+	if (!m_tileSize)
+	{
+		return m_atributeMap[z * m_width + x];
+	}
+	const ndTile* const tile = m_tiles[(z / m_tileSize) * m_tileCount_x + x / m_tileSize];
+	return tile ? tile->m_atributes[(z % m_tileSize) * m_tileSize + x % m_tileSize] : 0;
+}
+
+inline bool ndShapeHeightfield::IsCellResident(ndInt32 x, ndInt32 z) const
+{
+	return !m_tileSize || m_tiles[(z / m_tileSize) * m_tileCount_x + x / m_tileSize];
+}
+
 inline ndInt32 ndShapeHeightfield::FastInt(ndFloat32 x) const
 {
 	ndInt32 i = ndInt32(x);
@@ -135,6 +135,7 @@ class ndShapeInstance: public ndContainersFreeListAlloc<ndShapeInstance>
 	ndVector SupportVertex(const ndVector& dir) const;
 	ndMatrix GetScaledTransform(const ndMatrix& matrix) const;
 	ndVector SupportVertexSpecial(const ndVector& dir) const;
+	ndVector SupportVertexSpecial(const ndVector& dir, ndInt32* const vertexCache) const;
 	ndVector SupportVertexSpecialProjectPoint(const ndVector& point, const ndVector& dir) const;
 
 	const ndMatrix& GetLocalMatrix() const;
@@ -290,6 +291,29 @@ inline ndVector ndShapeInstance::SupportVertexSpecial(const ndVector& inDir) con
 	}
 }
 
+inline ndVector ndShapeInstance::SupportVertexSpecial(const ndVector& inDir, ndInt32* const vertexCache) const
+{
+	const ndVector dir(inDir & ndVector::m_triplexMask);
+	ndAssert(dir.m_w == ndFloat32(0.0f));
+	ndAssert(ndAbs(dir.DotProduct(dir).GetScalar() - ndFloat32(1.0f)) < ndFloat32(1.0e-2f));
+	switch (m_scaleType)
+	{
+		case m_unit:
+		{
+			return m_shape->SupportVertexCached(dir, m_skinMargin, vertexCache);
+		}
+		case m_uniform:
+		{
+			return m_scale * m_shape->SupportVertexCached(dir, m_skinMargin, vertexCache);
+		}
+
+		case m_global:
+		case m_nonUniform:
+		default:
+			return SupportVertex(dir);
+	}
+}
+
 inline ndVector ndShapeInstance::SupportVertexSpecialProjectPoint(const ndVector& point, const ndVector& inDir) const
 {
 	const ndVector dir(inDir & ndVector::m_triplexMask);
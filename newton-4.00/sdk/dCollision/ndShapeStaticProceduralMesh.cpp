@@ -29,6 +29,12 @@
 
 ndShapeStaticProceduralMesh::ndShapeStaticProceduralMesh(ndFloat32 sizex, ndFloat32 sizey, ndFloat32 sizez)
 	:ndShapeStaticMesh(m_staticProceduralMesh)
+	,m_faceCache()
+	,m_faceCacheLock()
+	,m_faceCacheCellSize(ndFloat32(0.0f))
+	,m_faceCacheInvCellSize(ndFloat32(0.0f))
+	,m_faceCacheStamp(0)
+	,m_faceCacheBudget(D_FACE_CACHE_DEFAULT_BUDGET)
 {
 	m_boxOrigin = ndVector::m_zero;
 	m_boxSize = ndVector(sizex, sizey, sizez, ndFloat32 (0.0f)) * ndVector::m_half;
@@ -36,6 +42,276 @@ ndShapeStaticProceduralMesh::ndShapeStaticProceduralMesh(ndFloat32 sizex, ndFloa
 
 ndShapeStaticProceduralMesh::~ndShapeStaticProceduralMesh(void)
 {
+	InvalidateFaceCache();
+}
+
+void ndShapeStaticProceduralMesh::SetFaceCacheCellSize(ndFloat32 cellSize)
+{
+	InvalidateFaceCache();
+	m_faceCacheCellSize = ndMax(cellSize, ndFloat32(0.0f));
+	m_faceCacheInvCellSize = (m_faceCacheCellSize > ndFloat32(0.0f)) ? ndFloat32(1.0f) / m_faceCacheCellSize : ndFloat32(0.0f);
+}
+
+void ndShapeStaticProceduralMesh::SetFaceCacheBudget(ndInt32 maxCells)
+{
+	m_faceCacheBudget = ndMax(maxCells, ndInt32(1));
+	ndScopeSpinLock lock(m_faceCacheLock);
+	EvictFaceCache();
+}
+
+void ndShapeStaticProceduralMesh::InvalidateFaceCache()
+{
+	ndFaceCache::Iterator it(m_faceCache);
+	for (it.Begin(); it; it++)
+	{
+		delete *it;
+	}
+	m_faceCache.RemoveAll();
+}
+
+void ndShapeStaticProceduralMesh::InvalidateFaceCache(const ndVector& minBox, const ndVector& maxBox)
+{
+	if (m_faceCacheCellSize == ndFloat32(0.0f))
+	{
+		return;
+	}
+
+	const ndVector p0(minBox.Scale(m_faceCacheInvCellSize).Floor());
+	const ndVector p1(maxBox.Scale(m_faceCacheInvCellSize).Floor());
+	ndFaceCache::Iterator it(m_faceCache);
+	for (it.Begin(); it; )
+	{
+		ndFaceCache::ndNode* const node = it.GetNode();
+		it++;
+
+		const ndUnsigned64 key = node->GetKey();
+		const ndFloat32 x = ndFloat32(ndInt32((key >> 42) & 0x1fffff) - (1 << 20));
+		const ndFloat32 y = ndFloat32(ndInt32((key >> 21) & 0x1fffff) - (1 << 20));
+		const ndFloat32 z = ndFloat32(ndInt32(key & 0x1fffff) - (1 << 20));
+		if ((x >= p0.m_x) && (x <= p1.m_x) && (y >= p0.m_y) && (y <= p1.m_y) && (z >= p0.m_z) && (z <= p1.m_z))
+		{
+			delete node->GetInfo();
+			m_faceCache.Remove(node);
+		}
+	}
+}
+
+ndUnsigned64 ndShapeStaticProceduralMesh::GetFaceCacheKey(ndInt32 x, ndInt32 y, ndInt32 z)
+{
+	// 21 bits per axis, biased to be positive
+	const ndUnsigned64 bias = 1 << 20;
+	const ndUnsigned64 key_x = (ndUnsigned64(x) + bias) & 0x1fffff;
+	const ndUnsigned64 key_y = (ndUnsigned64(y) + bias) & 0x1fffff;
+	const ndUnsigned64 key_z = (ndUnsigned64(z) + bias) & 0x1fffff;
+	return (key_x << 42) | (key_y << 21) | key_z;
+}
+
+void ndShapeStaticProceduralMesh::BuildFaceCacheCell(ndFaceCacheCell* const cell, ndInt32 x, ndInt32 y, ndInt32 z) const
+{
+	const ndVector minBox(ndFloat32(x) * m_faceCacheCellSize, ndFloat32(y) * m_faceCacheCellSize, ndFloat32(z) * m_faceCacheCellSize, ndFloat32(0.0f));
+	const ndVector maxBox(minBox + (ndVector(m_faceCacheCellSize) & ndVector::m_triplexMask));
+	GetCollidingFaces(minBox, maxBox, cell->m_vertex, cell->m_faceList, cell->m_faceMaterial, cell->m_indexList);
+
+	ndInt32 faceStart = 0;
+	for (ndInt32 i = 0; i < cell->m_faceList.GetCount(); ++i)
+	{
+		ndVector box0(ndFloat32(1.0e10f));
+		ndVector box1(ndFloat32(-1.0e10f));
+		for (ndInt32 j = 0; j < cell->m_faceList[i]; ++j)
+		{
+			const ndVector& point = cell->m_vertex[cell->m_indexList[faceStart + j]];
+			box0 = box0.GetMin(point);
+			box1 = box1.GetMax(point);
+		}
+		cell->m_faceBox.PushBack(box0 & ndVector::m_triplexMask);
+		cell->m_faceBox.PushBack(box1 & ndVector::m_triplexMask);
+		faceStart += cell->m_faceList[i];
+	}
+}
+
+void ndShapeStaticProceduralMesh::EvictFaceCache() const
+{
+	// called with the lock held, cells in use by other queries are skipped
+	class ndCompareStamp
+	{
+		public:
+		ndCompareStamp(void*)
+		{
+		}
+
+		ndInt32 Compare(const ndFaceCache::ndNode* const nodeA, const ndFaceCache::ndNode* const nodeB) const
+		{
+			const ndUnsigned64 stampA = nodeA->GetInfo()->m_lastUsed;
+			const ndUnsigned64 stampB = nodeB->GetInfo()->m_lastUsed;
+			return (stampA < stampB) ? -1 : ((stampA > stampB) ? 1 : 0);
+		}
+	};
+
+	if (m_faceCache.GetCount() <= m_faceCacheBudget)
+	{
+		return;
+	}
+
+	ndArray<ndFaceCache::ndNode*> candidates;
+	ndFaceCache::Iterator it(m_faceCache);
+	for (it.Begin(); it; it++)
+	{
+		if ((*it)->m_refCount.load() == 0)
+		{
+			candidates.PushBack(it.GetNode());
+		}
+	}
+	if (candidates.GetCount())
+	{
+		ndSort<ndFaceCache::ndNode*, ndCompareStamp>(&candidates[0], ndInt32(candidates.GetCount()), nullptr);
+	}
+
+	// evict a quarter of the budget past the limit, so that the scan is not done on every miss
+	const ndInt32 target = m_faceCacheBudget - (m_faceCacheBudget >> 2);
+	for (ndInt32 i = 0; (i < ndInt32(candidates.GetCount())) && (m_faceCache.GetCount() > target); ++i)
+	{
+		delete candidates[i]->GetInfo();
+		m_faceCache.Remove(candidates[i]);
+	}
+}
+
+const ndShapeStaticProceduralMesh::ndFaceCacheCell* ndShapeStaticProceduralMesh::AcquireFaceCacheCell(ndInt32 x, ndInt32 y, ndInt32 z) const
+{
+	const ndUnsigned64 key = GetFaceCacheKey(x, y, z);
+	ndFaceCacheCell* cell = nullptr;
+	bool wasFound = false;
+	{
+		ndScopeSpinLock lock(m_faceCacheLock);
+		ndFaceCache::ndNode* node = m_faceCache.Find(key);
+		if (node)
+		{
+			wasFound = true;
+			cell = node->GetInfo();
+		}
+		else
+		{
+			// insert an empty cell first, so that no other thread generates it again
+			cell = new ndFaceCacheCell;
+			node = m_faceCache.Insert(cell, key);
+		}
+		m_faceCacheStamp++;
+		cell->m_lastUsed = m_faceCacheStamp;
+		cell->m_refCount.fetch_add(1);
+		if (!wasFound)
+		{
+			EvictFaceCache();
+		}
+	}
+
+	if (wasFound)
+	{
+		// another thread may still be generating the cell
+		while (!cell->m_ready.load())
+		{
+			ndThreadYield();
+		}
+	}
+	else
+	{
+		// generate outside the lock, other threads may be generating other cells
+		BuildFaceCacheCell(cell, x, y, z);
+		cell->m_ready.store(1);
+	}
+	return cell;
+}
+
+void ndShapeStaticProceduralMesh::ReleaseFaceCacheCell(const ndFaceCacheCell* const cell) const
+{
+	((ndFaceCacheCell*)cell)->m_refCount.fetch_add(-1);
+}
+
+bool ndShapeStaticProceduralMesh::GetCachedFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexList) const
+{
+	if (m_faceCacheCellSize == ndFloat32(0.0f))
+	{
+		return false;
+	}
+
+	const ndVector p0(minBox.Scale(m_faceCacheInvCellSize).Floor());
+	const ndVector p1(maxBox.Scale(m_faceCacheInvCellSize).Floor());
+	const ndInt32 x0 = ndInt32(p0.m_x);
+	const ndInt32 y0 = ndInt32(p0.m_y);
+	const ndInt32 z0 = ndInt32(p0.m_z);
+	const ndInt32 x1 = ndInt32(p1.m_x);
+	const ndInt32 y1 = ndInt32(p1.m_y);
+	const ndInt32 z1 = ndInt32(p1.m_z);
+	const ndInt32 cellCount = (x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+	if (cellCount > D_FACE_CACHE_MAX_CELLS)
+	{
+		return false;
+	}
+
+	// vertices shared by faces of different cells are welded so that 
+	// the edge normals across cell borders can still be resolved.
+	ndArray<ndInt32> remap;
+	ndTree<ndInt32, ndFaceCacheVertexKey, ndContainersFreeListAlloc<ndInt32>> weldMap;
+	for (ndInt32 z = z0; z <= z1; ++z)
+	{
+		for (ndInt32 y = y0; y <= y1; ++y)
+		{
+			for (ndInt32 x = x0; x <= x1; ++x)
+			{
+				const ndFaceCacheCell* const cell = AcquireFaceCacheCell(x, y, z);
+				remap.SetCount(cell->m_vertex.GetCount());
+				for (ndInt32 i = ndInt32(remap.GetCount()) - 1; i >= 0; --i)
+				{
+					remap[i] = -1;
+				}
+
+				ndInt32 faceStart = 0;
+				for (ndInt32 i = 0; i < cell->m_faceList.GetCount(); ++i)
+				{
+					const ndInt32 faceStride = cell->m_faceList[i];
+					const ndVector& box0 = cell->m_faceBox[i * 2 + 0];
+					const ndVector& box1 = cell->m_faceBox[i * 2 + 1];
+					const bool overlap = 
+						(box0.m_x <= maxBox.m_x) && (box1.m_x >= minBox.m_x) &&
+						(box0.m_y <= maxBox.m_y) && (box1.m_y >= minBox.m_y) &&
+						(box0.m_z <= maxBox.m_z) && (box1.m_z >= minBox.m_z);
+
+					// a face that spans several cells is only taken from the first one the query visits
+					const ndVector owner(box0.Scale(m_faceCacheInvCellSize).Floor().GetMax(p0));
+					if (overlap && (ndInt32(owner.m_x) == x) && (ndInt32(owner.m_y) == y) && (ndInt32(owner.m_z) == z))
+					{
+						faceList.PushBack(faceStride);
+						faceMaterial.PushBack(cell->m_faceMaterial[i]);
+						for (ndInt32 j = 0; j < faceStride; ++j)
+						{
+							const ndInt32 index = cell->m_indexList[faceStart + j];
+							if (remap[index] < 0)
+							{
+								const ndVector& point = cell->m_vertex[index];
+								if (cellCount > 1)
+								{
+									bool wasFound;
+									ndTree<ndInt32, ndFaceCacheVertexKey, ndContainersFreeListAlloc<ndInt32>>::ndNode* const node = weldMap.Insert(ndInt32(vertex.GetCount()), ndFaceCacheVertexKey(point), wasFound);
+									if (!wasFound)
+									{
+										vertex.PushBack(point);
+									}
+									remap[index] = node->GetInfo();
+								}
+								else
+								{
+									remap[index] = ndInt32(vertex.GetCount());
+									vertex.PushBack(point);
+								}
+							}
+							indexList.PushBack(remap[index]);
+						}
+					}
+					faceStart += faceStride;
+				}
+				ReleaseFaceCacheCell(cell);
+			}
+		}
+	}
+	return true;
 }
 
 ndShapeInfo ndShapeStaticProceduralMesh::GetShapeInfo() const
@@ -54,7 +330,10 @@ void ndShapeStaticProceduralMesh::GetCollidingFaces(ndPolygonMeshDesc* const dat
 	ndArray<ndInt32>& faceList = query.m_faceIndexCount;
 	ndArray<ndInt32>& indexList = meshPatch.m_indexListList;
 	ndArray<ndInt32>& faceMaterialList = meshPatch.m_faceMaterial;
-	GetCollidingFaces(data->GetOrigin(), data->GetTarget(), vertex, faceList, faceMaterialList, indexList);
+	if (!GetCachedFaces(data->GetOrigin(), data->GetTarget(), vertex, faceList, faceMaterialList, indexList))
+	{
+		GetCollidingFaces(data->GetOrigin(), data->GetTarget(), vertex, faceList, faceMaterialList, indexList);
+	}
 
 	if (faceList.GetCount() == 0)
 	{
@@ -25,6 +25,12 @@
 #include "ndCollisionStdafx.h"
 #include "ndShapeStaticMesh.h"
 
+// queries that touch more cells than this bypass the face cache
+#define D_FACE_CACHE_MAX_CELLS	64
+
+// default max number of cells kept by the face cache
+#define D_FACE_CACHE_DEFAULT_BUDGET	4096
+
 class ndShapeStaticProceduralMesh: public ndShapeStaticMesh
 {
 	public:
@@ -63,6 +69,20 @@ class ndShapeStaticProceduralMesh: public ndShapeStaticMesh
 	virtual ndShapeStaticProceduralMesh* GetAsShapeStaticProceduralMesh() { return this; }
 	virtual void GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexListList) const;
 
+	// optional cache of generated faces keyed by cubic cells of cellSize, zero disables it.
+	// with the cache enabled the generator must return every face whose bounding box 
+	// overlaps the query box. invalidate the cache when the procedural source changes, 
+	// never during a world update. bodies at rest on the changed region keep their 
+	// cached contacts until they move or are woken up.
+	// when the cache holds more than budget cells the least recently used are evicted.
+	D_COLLISION_API void SetFaceCacheCellSize(ndFloat32 cellSize);
+	D_COLLISION_API void SetFaceCacheBudget(ndInt32 maxCells);
+	D_COLLISION_API void InvalidateFaceCache();
+	D_COLLISION_API void InvalidateFaceCache(const ndVector& minBox, const ndVector& maxBox);
+	ndFloat32 GetFaceCacheCellSize() const;
+	ndInt32 GetFaceCacheCellCount() const;
+	ndInt32 GetFaceCacheBudget() const;
+
 	protected:
 	D_COLLISION_API virtual ndShapeInfo GetShapeInfo() const;
 	D_COLLISION_API virtual ndUnsigned64 GetHash(ndUnsigned64 hash) const;
@@ -70,9 +90,72 @@ class ndShapeStaticProceduralMesh: public ndShapeStaticMesh
 	D_COLLISION_API virtual void GetCollidingFaces(ndPolygonMeshDesc* const data) const;
 
 	private:
+	class ndFaceCacheCell: public ndClassAlloc
+	{
+		public:
+		ndFaceCacheCell();
+
+		ndArray<ndVector> m_vertex;
+		ndArray<ndVector> m_faceBox;
+		ndArray<ndInt32> m_faceList;
+		ndArray<ndInt32> m_faceMaterial;
+		ndArray<ndInt32> m_indexList;
+		ndUnsigned64 m_lastUsed;
+		ndAtomic<ndInt32> m_refCount;
+		ndAtomic<ndInt32> m_ready;
+	};
+
+	class ndFaceCacheVertexKey
+	{
+		public:
+		ndFaceCacheVertexKey(const ndVector& point);
+
+		bool operator< (const ndFaceCacheVertexKey& key) const;
+		bool operator> (const ndFaceCacheVertexKey& key) const;
+
+		ndFloat32 m_x;
+		ndFloat32 m_y;
+		ndFloat32 m_z;
+	};
+
+	class ndFaceCache: public ndTree<ndFaceCacheCell*, ndUnsigned64, ndContainersFreeListAlloc<ndFaceCacheCell*>>
+	{
+		public:
+		ndFaceCache();
+	};
+
+	static ndUnsigned64 GetFaceCacheKey(ndInt32 x, ndInt32 y, ndInt32 z);
+	const ndFaceCacheCell* AcquireFaceCacheCell(ndInt32 x, ndInt32 y, ndInt32 z) const;
+	void ReleaseFaceCacheCell(const ndFaceCacheCell* const cell) const;
+	void BuildFaceCacheCell(ndFaceCacheCell* const cell, ndInt32 x, ndInt32 y, ndInt32 z) const;
+	void EvictFaceCache() const;
+	bool GetCachedFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexList) const;
+
+	mutable ndFaceCache m_faceCache;
+	mutable ndSpinLock m_faceCacheLock;
+	ndFloat32 m_faceCacheCellSize;
+	ndFloat32 m_faceCacheInvCellSize;
+	mutable ndUnsigned64 m_faceCacheStamp;
+	ndInt32 m_faceCacheBudget;
+
 	friend class ndContactSolver;
 };
 
+inline ndFloat32 ndShapeStaticProceduralMesh::GetFaceCacheCellSize() const
+{
+	return m_faceCacheCellSize;
+}
+
+inline ndInt32 ndShapeStaticProceduralMesh::GetFaceCacheCellCount() const
+{
+	return m_faceCache.GetCount();
+}
+
+inline ndInt32 ndShapeStaticProceduralMesh::GetFaceCacheBudget() const
+{
+	return m_faceCacheBudget;
+}
+
 inline void ndShapeStaticProceduralMesh::GetCollidingFaces(const ndVector&, const ndVector&, ndArray<ndVector>&, ndArray<ndInt32>&, ndArray<ndInt32>&, ndArray<ndInt32>&) const
 {
 	ndAssert(0);
@@ -106,4 +189,47 @@ inline ndShapeStaticProceduralMesh::ndEdgeMap::ndEdgeMap()
 {
 }
 
+inline ndShapeStaticProceduralMesh::ndFaceCacheCell::ndFaceCacheCell()
+	:ndClassAlloc()
+	,m_vertex()
+	,m_faceBox()
+	,m_faceList()
+	,m_faceMaterial()
+	,m_indexList()
+	,m_lastUsed(0)
+	,m_refCount(0)
+	,m_ready(0)
+{
+}
+
+inline ndShapeStaticProceduralMesh::ndFaceCacheVertexKey::ndFaceCacheVertexKey(const ndVector& point)
+	:m_x(point.m_x)
+	,m_y(point.m_y)
+	,m_z(point.m_z)
+{
+}
+
+inline bool ndShapeStaticProceduralMesh::ndFaceCacheVertexKey::operator< (const ndFaceCacheVertexKey& key) const
+{
+	if (m_x != key.m_x)
+	{
+		return m_x < key.m_x;
+	}
+	if (m_y != key.m_y)
+	{
+		return m_y < key.m_y;
+	}
+	return m_z < key.m_z;
+}
+
+inline bool ndShapeStaticProceduralMesh::ndFaceCacheVertexKey::operator> (const ndFaceCacheVertexKey& key) const
+{
+	return key < *this;
+}
+
+inline ndShapeStaticProceduralMesh::ndFaceCache::ndFaceCache()
+	:ndTree<ndFaceCacheCell*, ndUnsigned64, ndContainersFreeListAlloc<ndFaceCacheCell*>>()
+{
+}
+
 #endif
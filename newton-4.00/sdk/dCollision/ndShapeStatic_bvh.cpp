@@ -66,9 +66,49 @@ ndShapeStatic_bvh::ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder)
 	,ndAabbPolygonSoup()
 	,m_trianglesCount(0)
 {
+	ndMemory::ndCategoryScope scope(ndMemory::m_staticMesh);
 	Create(builder);
 	CalculateAdjacent();
+	CalculateBoundsAndFaceCount();
+}
+
+ndShapeStatic_bvh::ndShapeStatic_bvh(ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder)
+	:ndShapeStaticMesh(m_boundingBoxHierachy)
+	,ndAabbPolygonSoup()
+	,m_trianglesCount(0)
+{
+	ndMemory::ndCategoryScope scope(ndMemory::m_staticMesh);
+	Create(threadPool, builder);
+	CalculateAdjacent(threadPool);
+	CalculateBoundsAndFaceCount();
+}
+
+ndShapeStatic_bvh::ndShapeStatic_bvh(const char* const imagePath)
+	:ndShapeStaticMesh(m_boundingBoxHierachy)
+	,ndAabbPolygonSoup()
+	,m_trianglesCount(0)
+{
+	ndMemory::ndCategoryScope scope(ndMemory::m_staticMesh);
+	if (DeserializeImage(imagePath))
+	{
+		CalculateBoundsAndFaceCount();
+	}
+}
+
+ndShapeStatic_bvh::ndShapeStatic_bvh(void* const image, size_t sizeInBytes)
+	:ndShapeStaticMesh(m_boundingBoxHierachy)
+	,ndAabbPolygonSoup()
+	,m_trianglesCount(0)
+{
+	ndMemory::ndCategoryScope scope(ndMemory::m_staticMesh);
+	if (SetImage(image, sizeInBytes))
+	{
+		CalculateBoundsAndFaceCount();
+	}
+}
 
+void ndShapeStatic_bvh::CalculateBoundsAndFaceCount()
+{
 	ndVector p0;
 	ndVector p1;
 	GetAABB(p0, p1);
@@ -32,6 +32,9 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 
 	D_COLLISION_API ndShapeStatic_bvh();
 	D_COLLISION_API ndShapeStatic_bvh(const ndPolygonSoupBuilder& builder);
+	D_COLLISION_API ndShapeStatic_bvh(ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder);
+	D_COLLISION_API ndShapeStatic_bvh(const char* const imagePath);
+	D_COLLISION_API ndShapeStatic_bvh(void* const image, size_t sizeInBytes);
 	D_COLLISION_API virtual ~ndShapeStatic_bvh();
 
 	void *operator new (size_t size);
@@ -52,6 +55,7 @@ class ndShapeStatic_bvh: public ndShapeStaticMesh, public ndAabbPolygonSoup
 	static ndIntersectStatus GetPolygon(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 
 	private: 
+	void CalculateBoundsAndFaceCount();
 
 	static ndIntersectStatus CalculateHash (
 			void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes,
@@ -21,16 +21,386 @@
 
 #include "ndCoreStdafx.h"
 #include "ndTypes.h"
-#include "ndHeap.h"
+#include "ndSort.h"
 #include "ndStack.h"
-#include "ndList.h"
 #include "ndMatrix.h"
-#include "ndPolyhedra.h"
+#include "ndProfiler.h"
+#include "ndThreadPool.h"
 #include "ndAabbPolygonSoup.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define DG_STACK_DEPTH 512
 
+#define D_AABB_BUILD_TASKS				64
+#define D_AABB_BUILD_TASK_MIN_SIZE		256
+
+// image layout: header, vertex array, face index array and node array,
+// each section aligned so that the image can be used in place.
+#define D_POLYGON_SOUP_IMAGE_MAGIC		0x49535344
+#define D_POLYGON_SOUP_IMAGE_VERSION	1
+#define D_POLYGON_SOUP_IMAGE_ALIGN		64
+
+// compact images store the node boxes in 16 bit relative to the parent box 
+// and the face indices as variable length deltas, they are expanded on load.
+#define D_POLYGON_SOUP_IMAGE_COMPACT	(1<<0)
+#define D_POLYGON_SOUP_IMAGE_QUANTIZE	0xffff
+
+class ndAabbPolygonSoup::ndImageHeader
+{
+	public:
+	ndUnsigned32 m_magic;
+	ndUnsigned32 m_version;
+	ndUnsigned32 m_vertexSizeInBytes;
+	ndUnsigned32 m_nodeSizeInBytes;
+	ndInt32 m_vertexCount;
+	ndInt32 m_indexCount;
+	ndInt32 m_nodesCount;
+	ndUnsigned32 m_flags;
+	ndUnsigned64 m_vertexOffset;
+	ndUnsigned64 m_indexOffset;
+	ndUnsigned64 m_indexSizeInBytes;
+	ndUnsigned64 m_nodeOffset;
+	ndUnsigned64 m_imageSize;
+	ndFloat32 m_rootBox[6];
+};
+
+class ndImageCompactNode
+{
+	public:
+	ndUnsigned32 m_left;
+	ndUnsigned32 m_right;
+	ndUnsigned16 m_box[6];
+};
+
+static ndUnsigned64 ndAlignImageOffset(ndUnsigned64 offset)
+{
+	return (offset + D_POLYGON_SOUP_IMAGE_ALIGN - 1) & ~ndUnsigned64(D_POLYGON_SOUP_IMAGE_ALIGN - 1);
+}
+
+static void ndSetImageLayout(ndAabbPolygonSoup::ndImageHeader& header)
+{
+	header.m_vertexOffset = ndAlignImageOffset(sizeof(ndAabbPolygonSoup::ndImageHeader));
+	header.m_indexOffset = ndAlignImageOffset(header.m_vertexOffset + header.m_vertexSizeInBytes * ndUnsigned64(header.m_vertexCount));
+	header.m_nodeOffset = ndAlignImageOffset(header.m_indexOffset + header.m_indexSizeInBytes);
+	header.m_imageSize = ndAlignImageOffset(header.m_nodeOffset + header.m_nodeSizeInBytes * ndUnsigned64(header.m_nodesCount));
+}
+
+static void ndWriteImageSection(FILE* const file, ndUnsigned64& offset, ndUnsigned64 sectionOffset, const void* const data, ndUnsigned64 sizeInBytes)
+{
+	char padding[D_POLYGON_SOUP_IMAGE_ALIGN];
+	memset(padding, 0, sizeof(padding));
+	ndAssert((sectionOffset - offset) <= sizeof(padding));
+	fwrite(padding, size_t(sectionOffset - offset), 1, file);
+	if (sizeInBytes)
+	{
+		fwrite(data, size_t(sizeInBytes), 1, file);
+	}
+	offset = sectionOffset + sizeInBytes;
+}
+
+static bool ndValidateImageHeader(const ndAabbPolygonSoup::ndImageHeader* const header, size_t sizeInBytes, ndUnsigned32 flags, ndUnsigned32 nodeSizeInBytes)
+{
+	return (header->m_magic == D_POLYGON_SOUP_IMAGE_MAGIC) &&
+		(header->m_version == D_POLYGON_SOUP_IMAGE_VERSION) &&
+		(header->m_flags == flags) &&
+		(header->m_vertexSizeInBytes == sizeof(ndTriplex)) &&
+		(header->m_nodeSizeInBytes == nodeSizeInBytes) &&
+		(header->m_vertexCount >= 0) && (header->m_indexCount >= 0) && (header->m_nodesCount >= 0) &&
+		(header->m_imageSize <= sizeInBytes) &&
+		(((header->m_vertexOffset | header->m_indexOffset | header->m_nodeOffset) & 0xf) == 0) &&
+		(header->m_vertexOffset >= sizeof(ndAabbPolygonSoup::ndImageHeader)) &&
+		(header->m_vertexOffset <= header->m_imageSize) &&
+		(header->m_indexOffset <= header->m_imageSize) &&
+		(header->m_nodeOffset <= header->m_imageSize) &&
+		(header->m_indexSizeInBytes <= header->m_imageSize) &&
+		(header->m_vertexOffset + sizeof(ndTriplex) * ndUnsigned64(header->m_vertexCount) <= header->m_indexOffset) &&
+		(header->m_indexOffset + header->m_indexSizeInBytes <= header->m_nodeOffset) &&
+		(header->m_nodeOffset + nodeSizeInBytes * ndUnsigned64(header->m_nodesCount) <= header->m_imageSize);
+}
+
+// a damaged image must not send the queries out of the arrays or into a loop,
+// children come after their parent, each node has a single parent 
+// and every vertex index of a face is inside the vertex array.
+static bool ndValidateImageTree(const ndAabbPolygonSoup::ndNode* const nodes, ndInt32 nodesCount, const ndInt32* const indices, ndInt32 indexCount, ndInt32 vertexCount)
+{
+	const ndUnsigned32 vCount = ndUnsigned32(vertexCount);
+	ndStack<ndInt32> depth(ndMax(nodesCount, 1));
+	for (ndInt32 i = 0; i < nodesCount; ++i)
+	{
+		depth[i] = -1;
+	}
+	depth[0] = 0;
+
+	for (ndInt32 i = 0; i < nodesCount; ++i)
+	{
+		const ndAabbPolygonSoup::ndNode& node = nodes[i];
+		if ((depth[i] < 0) || (ndUnsigned32(node.m_indexBox0) >= vCount) || (ndUnsigned32(node.m_indexBox1) >= vCount))
+		{
+			return false;
+		}
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndAabbPolygonSoup::ndNode::ndLeafNodePtr& child = j ? node.m_right : node.m_left;
+			if (child.IsLeaf())
+			{
+				// index format i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
+				const ndInt32 count = ndInt32(child.GetCount());
+				const ndInt64 start = ndInt64(child.GetIndex());
+				if ((start + count * 2 + 3) > ndInt64(indexCount))
+				{
+					return false;
+				}
+				const ndInt32* const face = &indices[start];
+				if (ndUnsigned32(face[count + 1]) >= vCount)
+				{
+					return false;
+				}
+				for (ndInt32 k = 0; k < count; ++k)
+				{
+					if ((ndUnsigned32(face[k]) >= vCount) || (ndUnsigned32(face[count + 2 + k] & (~D_CONCAVE_EDGE_MASK)) >= vCount))
+					{
+						return false;
+					}
+				}
+			}
+			else
+			{
+				const ndUnsigned32 index = child.m_node;
+				if ((index <= ndUnsigned32(i)) || (index >= ndUnsigned32(nodesCount)) || (depth[ndInt32(index)] >= 0) || (depth[i] + 2 >= DG_STACK_DEPTH))
+				{
+					return false;
+				}
+				depth[ndInt32(index)] = depth[i] + 1;
+			}
+		}
+	}
+	return true;
+}
+
+static ndFloat32 ndDequantizeImageCoord(ndFloat32 p0, ndFloat32 p1, ndInt32 q)
+{
+	if (q <= 0)
+	{
+		return p0;
+	}
+	else if (q >= D_POLYGON_SOUP_IMAGE_QUANTIZE)
+	{
+		return p1;
+	}
+	return p0 + (p1 - p0) * (ndFloat32(q) / ndFloat32(D_POLYGON_SOUP_IMAGE_QUANTIZE));
+}
+
+static void ndDequantizeImageBox(const ndFloat32* const parentBox, const ndUnsigned16* const q, ndFloat32* const box)
+{
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		box[i] = ndDequantizeImageCoord(parentBox[i], parentBox[i + 3], q[i]);
+		box[i + 3] = ndDequantizeImageCoord(parentBox[i], parentBox[i + 3], q[i + 3]);
+	}
+}
+
+// rounds outward, so that the decoded box always contains the original box
+static ndUnsigned16 ndQuantizeImageCoord(ndFloat32 p0, ndFloat32 p1, ndFloat32 value, bool roundUp)
+{
+	ndInt32 q = roundUp ? D_POLYGON_SOUP_IMAGE_QUANTIZE : 0;
+	if (p1 > p0)
+	{
+		const ndFloat32 t = (value - p0) * ndFloat32(D_POLYGON_SOUP_IMAGE_QUANTIZE) / (p1 - p0);
+		q = ndClamp(ndInt32(roundUp ? ndCeil(t) : ndFloor(t)), ndInt32(0), ndInt32(D_POLYGON_SOUP_IMAGE_QUANTIZE));
+	}
+	if (roundUp)
+	{
+		while ((q < D_POLYGON_SOUP_IMAGE_QUANTIZE) && (ndDequantizeImageCoord(p0, p1, q) < value))
+		{
+			q++;
+		}
+	}
+	else
+	{
+		while ((q > 0) && (ndDequantizeImageCoord(p0, p1, q) > value))
+		{
+			q--;
+		}
+	}
+	return ndUnsigned16(q);
+}
+
+// zig zag delta to the previous index as a variable length integer
+static void ndEncodeImageIndex(ndArray<ndUnsigned8>& stream, ndInt32 value, ndInt32 prevValue)
+{
+	const ndUnsigned32 delta = ndUnsigned32(value) - ndUnsigned32(prevValue);
+	ndUnsigned32 code = (delta << 1) ^ (ndUnsigned32(0) - (delta >> 31));
+	while (code >= 0x80)
+	{
+		stream.PushBack(ndUnsigned8(code | 0x80));
+		code >>= 7;
+	}
+	stream.PushBack(ndUnsigned8(code));
+}
+
+static bool ndDecodeImageIndex(const ndUnsigned8*& ptr, const ndUnsigned8* const end, ndInt32& value)
+{
+	ndUnsigned32 code = 0;
+	for (ndInt32 shift = 0; shift < 35; shift += 7)
+	{
+		if (ptr >= end)
+		{
+			return false;
+		}
+		const ndUnsigned32 byte = *ptr++;
+		code |= (byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			const ndUnsigned32 delta = (code >> 1) ^ (ndUnsigned32(0) - (code & 1));
+			value = ndInt32(ndUnsigned32(value) + delta);
+			return true;
+		}
+	}
+	return false;
+}
+
+// each entry of a face is delta encoded against the previous entry of the same kind
+#define D_IMAGE_INDEX_ATTRIBUTE		0
+#define D_IMAGE_INDEX_VERTEX		1
+#define D_IMAGE_INDEX_NORMAL		2
+#define D_IMAGE_INDEX_EDGE_NORMAL	3
+#define D_IMAGE_INDEX_FACE_SIZE		4
+#define D_IMAGE_INDEX_KINDS			5
+
+static bool ndClassifyImageIndices(const ndAabbPolygonSoup::ndNode* const nodes, ndInt32 nodesCount, ndUnsigned8* const kinds, ndInt32 indexCount)
+{
+	memset(kinds, D_IMAGE_INDEX_ATTRIBUTE, size_t(indexCount));
+	for (ndInt32 i = 0; i < nodesCount; ++i)
+	{
+		for (ndInt32 j = 0; j < 2; ++j)
+		{
+			const ndAabbPolygonSoup::ndNode::ndLeafNodePtr& child = j ? nodes[i].m_right : nodes[i].m_left;
+			// empty leaves alias the first face, they have nothing to classify
+			const ndInt32 count = child.IsLeaf() ? ndInt32(child.GetCount()) : 0;
+			if (count)
+			{
+				const ndInt64 start = ndInt64(child.GetIndex());
+				if ((start + count * 2 + 3) > ndInt64(indexCount))
+				{
+					return false;
+				}
+				ndUnsigned8* const face = &kinds[start];
+				for (ndInt32 k = 0; k < count; ++k)
+				{
+					face[k] = D_IMAGE_INDEX_VERTEX;
+					face[count + 2 + k] = D_IMAGE_INDEX_EDGE_NORMAL;
+				}
+				face[count + 1] = D_IMAGE_INDEX_NORMAL;
+				face[count * 2 + 2] = D_IMAGE_INDEX_FACE_SIZE;
+			}
+		}
+	}
+	return true;
+}
+
+// expands a compact image into a runtime image, 
+// the face points are followed by two new points per node box.
+static void* ndDecodeCompactImage(const void* const image, size_t sizeInBytes)
+{
+	const ndAabbPolygonSoup::ndImageHeader* const header = (ndAabbPolygonSoup::ndImageHeader*)image;
+	if (!ndValidateImageHeader(header, sizeInBytes, D_POLYGON_SOUP_IMAGE_COMPACT, sizeof(ndImageCompactNode)))
+	{
+		return nullptr;
+	}
+
+	const ndInt32 pointCount = header->m_vertexCount;
+	const ndInt32 nodesCount = header->m_nodesCount;
+	if (nodesCount > ((0x7fffffff - pointCount) >> 1))
+	{
+		return nullptr;
+	}
+
+	ndAabbPolygonSoup::ndImageHeader runtimeHeader;
+	memset(&runtimeHeader, 0, sizeof(runtimeHeader));
+	runtimeHeader.m_magic = D_POLYGON_SOUP_IMAGE_MAGIC;
+	runtimeHeader.m_version = D_POLYGON_SOUP_IMAGE_VERSION;
+	runtimeHeader.m_vertexSizeInBytes = sizeof(ndTriplex);
+	runtimeHeader.m_nodeSizeInBytes = sizeof(ndAabbPolygonSoup::ndNode);
+	runtimeHeader.m_vertexCount = pointCount + nodesCount * 2;
+	runtimeHeader.m_indexCount = header->m_indexCount;
+	runtimeHeader.m_nodesCount = nodesCount;
+	runtimeHeader.m_indexSizeInBytes = sizeof(ndInt32) * ndUnsigned64(header->m_indexCount);
+	ndMemCpy(runtimeHeader.m_rootBox, header->m_rootBox, 6);
+	ndSetImageLayout(runtimeHeader);
+
+	char* const dst = (char*)ndMemory::Malloc(size_t(runtimeHeader.m_imageSize));
+	memset(dst, 0, size_t(runtimeHeader.m_imageSize));
+	memcpy(dst, &runtimeHeader, sizeof(runtimeHeader));
+
+	const char* const src = (const char*)image;
+	ndTriplex* const points = (ndTriplex*)(dst + runtimeHeader.m_vertexOffset);
+	memcpy(points, src + header->m_vertexOffset, sizeof(ndTriplex) * size_t(pointCount));
+
+	// nodes are stored breadth first, so a parent box is always decoded before its children
+	ndTriplex* const boxPoints = &points[pointCount];
+	ndAabbPolygonSoup::ndNode* const nodes = (ndAabbPolygonSoup::ndNode*)(dst + runtimeHeader.m_nodeOffset);
+	const ndImageCompactNode* const compactNodes = (ndImageCompactNode*)(src + header->m_nodeOffset);
+	if (nodesCount)
+	{
+		ndMemCpy(&boxPoints[0].m_x, &header->m_rootBox[0], 3);
+		ndMemCpy(&boxPoints[1].m_x, &header->m_rootBox[3], 3);
+	}
+	bool state = true;
+	for (ndInt32 i = 0; state && (i < nodesCount); ++i)
+	{
+		ndAabbPolygonSoup::ndNode& node = nodes[i];
+		node.m_indexBox0 = pointCount + i * 2;
+		node.m_indexBox1 = pointCount + i * 2 + 1;
+		node.m_left.m_node = compactNodes[i].m_left;
+		node.m_right.m_node = compactNodes[i].m_right;
+
+		const ndFloat32 parentBox[6] = 
+		{ 
+			boxPoints[i * 2].m_x, boxPoints[i * 2].m_y, boxPoints[i * 2].m_z, 
+			boxPoints[i * 2 + 1].m_x, boxPoints[i * 2 + 1].m_y, boxPoints[i * 2 + 1].m_z 
+		};
+		for (ndInt32 j = 0; state && (j < 2); ++j)
+		{
+			const ndAabbPolygonSoup::ndNode::ndLeafNodePtr& child = j ? node.m_right : node.m_left;
+			if (!child.IsLeaf())
+			{
+				const ndInt32 index = ndInt32(child.m_node);
+				state = (index > i) && (index < nodesCount);
+				if (state)
+				{
+					ndFloat32 box[6];
+					ndDequantizeImageBox(parentBox, compactNodes[index].m_box, box);
+					ndMemCpy(&boxPoints[index * 2].m_x, &box[0], 3);
+					ndMemCpy(&boxPoints[index * 2 + 1].m_x, &box[3], 3);
+				}
+			}
+		}
+	}
+
+	// the face layout comes from the leaves, so the indices are decoded after the nodes
+	ndInt32* const indices = (ndInt32*)(dst + runtimeHeader.m_indexOffset);
+	ndStack<ndUnsigned8> kinds(ndMax(header->m_indexCount, 1));
+	state = state && ndClassifyImageIndices(nodes, nodesCount, &kinds[0], header->m_indexCount);
+
+	ndInt32 values[D_IMAGE_INDEX_KINDS];
+	memset(values, 0, sizeof(values));
+	const ndUnsigned8* ptr = (const ndUnsigned8*)(src + header->m_indexOffset);
+	const ndUnsigned8* const end = ptr + header->m_indexSizeInBytes;
+	for (ndInt32 i = 0; state && (i < header->m_indexCount); ++i)
+	{
+		ndInt32& value = values[kinds[i]];
+		state = ndDecodeImageIndex(ptr, end, value);
+		indices[i] = value;
+	}
+
+	if (!state)
+	{
+		ndMemory::Free(dst);
+		return nullptr;
+	}
+	return dst;
+}
+
 D_MSV_NEWTON_ALIGN_32
 class ndAabbPolygonSoup::ndNodeBuilder: public ndAabbPolygonSoup::ndNode
 {
@@ -117,6 +487,14 @@ class ndAabbPolygonSoup::ndNodeBuilder: public ndAabbPolygonSoup::ndNode
 	const ndInt32* m_faceIndices;
 } D_GCC_NEWTON_ALIGN_32;
 
+class ndAabbPolygonSoup::ndBuildTask
+{
+	public:
+	ndNodeBuilder* m_allocator;
+	ndInt32 m_firstBox;
+	ndInt32 m_lastBox;
+};
+
 class ndAabbPolygonSoup::ndSplitInfo
 {
 	public:
@@ -232,14 +610,25 @@ ndAabbPolygonSoup::ndAabbPolygonSoup ()
 	:ndPolygonSoupDatabase()
 	,m_aabb(nullptr)
 	,m_indices(nullptr)
+	,m_image(nullptr)
 	,m_nodesCount(0)
 	,m_indexCount(0)
+	,m_ownImage(false)
 {
 }
 
 ndAabbPolygonSoup::~ndAabbPolygonSoup ()
 {
-	if (m_aabb) 
+	if (m_image)
+	{
+		// the arrays live inside the image, do not let the base class free them
+		if (m_ownImage)
+		{
+			ndMemory::Free(m_image);
+		}
+		m_localVertex = nullptr;
+	}
+	else if (m_aabb) 
 	{
 		ndMemory::Free(m_aabb);
 		ndMemory::Free(m_indices);
@@ -294,149 +683,264 @@ void ndAabbPolygonSoup::GetAABB (ndVector& p0, ndVector& p1) const
 
 void ndAabbPolygonSoup::CalculateAdjacent ()
 {
-	ndVector p0;
-	ndVector p1;
-	GetAABB (p0, p1);
-	ndFastAabb box (p0, p1);
-
-	ndPolyhedra adjacentMesh;
-	adjacentMesh.BeginFace();
-	ForAllSectors(box, ndVector::m_zero, ndFloat32(1.0f), CalculateAllFaceEdgeNormals, &adjacentMesh);
-	adjacentMesh.EndFace();
-
-	ndInt32 mark = adjacentMesh.IncLRU();
-	ndPolyhedra::Iterator iter(adjacentMesh);
-	const ndTriplex* const vertexArray = (ndTriplex*)GetLocalVertexPool();
-	for (iter.Begin(); iter; iter++)
+	BuildAdjacency(nullptr);
+}
+
+void ndAabbPolygonSoup::CalculateAdjacent (ndThreadPool& threadPool)
+{
+	BuildAdjacency(&threadPool);
+}
+
+void ndAabbPolygonSoup::BuildAdjacency (ndThreadPool* const threadPool)
+{
+	D_TRACKTIME();
+	class ndFaceEdge
 	{
-		ndEdge* const edge = &(*iter);
-		if ((edge->m_mark != mark) && (edge->m_incidentFace >= 0) && (edge->m_twin->m_incidentFace >= 0))
+		public:
+		ndInt32 m_face;
+		ndInt32 m_count;
+		ndInt32 m_edge;
+		ndInt32 m_vertex;
+	};
+
+	class ndCompareEdge
+	{
+		public:
+		ndCompareEdge(void*)
 		{
-			ndInt32 indexCount0 = 0;
-			ndInt32 indexCount1 = 0;
-			ndInt32 offsetIndex0 = -1;
-			ndInt32 offsetIndex1 = -1;
-			ndInt32* const indexArray0 = (ndInt32*)edge->m_userData;
-			ndInt32* const indexArray1 = (ndInt32*)edge->m_twin->m_userData;
-			ndEdge* ptr = edge;
-			do
+		}
+
+		ndInt32 Compare(const ndFaceEdge& edgeA, const ndFaceEdge& edgeB) const
+		{
+			if (edgeA.m_vertex < edgeB.m_vertex)
 			{
-				indexCount0++;
-				ptr = ptr->m_next;
-			} while (ptr != edge);
+				return -1;
+			}
+			else if (edgeA.m_vertex > edgeB.m_vertex)
+			{
+				return 1;
+			}
+			else if (edgeA.m_face < edgeB.m_face)
+			{
+				return -1;
+			}
+			else if (edgeA.m_face > edgeB.m_face)
+			{
+				return 1;
+			}
+			return edgeA.m_edge - edgeB.m_edge;
+		}
+	};
+
+	// collect the faces in node order
+	ndArray<ndFaceEdge> faces;
+	ndInt32 edgeCount = 0;
+	for (ndInt32 i = 0; i < m_nodesCount; ++i) 
+	{
+		const ndNode* const node = &m_aabb[i];
+		if (node->m_left.IsLeaf() && node->m_left.GetCount()) 
+		{
+			ndFaceEdge face;
+			face.m_face = ndInt32(node->m_left.GetIndex());
+			face.m_count = ndInt32(node->m_left.GetCount());
+			face.m_edge = edgeCount;
+			face.m_vertex = 0;
+			faces.PushBack(face);
+			edgeCount += face.m_count;
+		}
+		if (node->m_right.IsLeaf() && node->m_right.GetCount()) 
+		{
+			ndFaceEdge face;
+			face.m_face = ndInt32(node->m_right.GetIndex());
+			face.m_count = ndInt32(node->m_right.GetCount());
+			face.m_edge = edgeCount;
+			face.m_vertex = 0;
+			faces.PushBack(face);
+			edgeCount += face.m_count;
+		}
+	}
+	const ndInt32 faceCount = ndInt32(faces.GetCount());
+
+	// bucket the edges by their lowest vertex index, 
+	// twin edges end up in the same small bucket.
+	const ndInt32 vertexCount = GetVertexCount();
+	ndArray<ndInt32> bucketStart;
+	ndArray<ndFaceEdge> edges;
+	bucketStart.SetCount(vertexCount + 1);
+	edges.SetCount(edgeCount);
+	for (ndInt32 i = 0; i <= vertexCount; ++i)
+	{
+		bucketStart[i] = 0;
+	}
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		const ndInt32* const face = &m_indices[faces[i].m_face];
+		const ndInt32 count = faces[i].m_count;
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			const ndInt32 k = (j == (count - 1)) ? 0 : j + 1;
+			bucketStart[ndMin(face[j], face[k])] ++;
+		}
+	}
+	ndInt32 bucketSum = 0;
+	for (ndInt32 i = 0; i <= vertexCount; ++i)
+	{
+		const ndInt32 count = bucketStart[i];
+		bucketStart[i] = bucketSum;
+		bucketSum += count;
+	}
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		const ndInt32* const face = &m_indices[faces[i].m_face];
+		const ndInt32 count = faces[i].m_count;
+		for (ndInt32 j = 0; j < count; ++j)
+		{
+			const ndInt32 k = (j == (count - 1)) ? 0 : j + 1;
+			ndFaceEdge& edge = edges[bucketStart[ndMin(face[j], face[k])]++];
+			edge.m_face = faces[i].m_face;
+			edge.m_count = count;
+			edge.m_edge = j;
+			edge.m_vertex = ndMax(face[j], face[k]);
+		}
+	}
+	for (ndInt32 i = vertexCount; i > 0; --i)
+	{
+		bucketStart[i] = bucketStart[i - 1];
+	}
+	bucketStart[0] = 0;
 
-			ptr = edge->m_twin;
-			do
+	// an edge shared by exactly two faces with opposite winding 
+	// gets the adjacent face normal when the edge is convex.
+	// each bucket is sorted by the other vertex, so twin edges are next to each other.
+	const ndTriplex* const vertexArray = (ndTriplex*)GetLocalVertexPool();
+	auto CalculateEdgeNormals = ndMakeObject::ndFunction([this, &edges, &bucketStart, vertexArray, vertexCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateEdgeNormals);
+		const ndStartEnd startEnd(vertexCount, threadIndex, threadCount);
+		for (ndInt32 bucket = startEnd.m_start; bucket < startEnd.m_end; ++bucket)
+		{
+			const ndInt32 start = bucketStart[bucket];
+			const ndInt32 end = bucketStart[bucket + 1];
+			if ((end - start) > 1)
+			{
+				ndSort<ndFaceEdge, ndCompareEdge>(&edges[start], end - start, nullptr);
+			}
+			for (ndInt32 i = start; i < end; )
 			{
-				indexCount1++;
-				ptr = ptr->m_next;
-			} while (ptr != edge->m_twin);
+				ndInt32 runEnd = i + 1;
+				while ((runEnd < end) && (edges[runEnd].m_vertex == edges[i].m_vertex))
+				{
+					runEnd++;
+				}
+				const ndInt32 twin = i + 1;
+				const ndInt32 runCount = runEnd - i;
+				const ndFaceEdge& edge0 = edges[i];
+				i = runEnd;
+				if ((runCount != 2) || (edge0.m_vertex == bucket))
+				{
+					continue;
+				}
 
-			ndVector n0(&vertexArray[indexArray0[indexCount0 + 1]].m_x);
-			ndVector q0(&vertexArray[indexArray0[0]].m_x);
-			n0 = n0 & ndVector::m_triplexMask;
-			q0 = q0 & ndVector::m_triplexMask;
+				const ndFaceEdge& edge1 = edges[twin];
+				ndInt32* const indexArray0 = &m_indices[edge0.m_face];
+				ndInt32* const indexArray1 = &m_indices[edge1.m_face];
+				if (indexArray0[edge0.m_edge] == indexArray1[edge1.m_edge])
+				{
+					// same winding, not a twin edge
+					continue;
+				}
 
-			ndVector n1(&vertexArray[indexArray1[indexCount1 + 1]].m_x);
-			ndVector q1(&vertexArray[indexArray1[0]].m_x);
-			n1 = n1 & ndVector::m_triplexMask;
-			q1 = q1 & ndVector::m_triplexMask;
+				const ndInt32 indexCount0 = edge0.m_count;
+				const ndInt32 indexCount1 = edge1.m_count;
+				ndVector n0(&vertexArray[indexArray0[indexCount0 + 1]].m_x);
+				ndVector q0(&vertexArray[indexArray0[0]].m_x);
+				n0 = n0 & ndVector::m_triplexMask;
+				q0 = q0 & ndVector::m_triplexMask;
 
-			ndPlane plane0(n0, -n0.DotProduct(q0).GetScalar());
-			ndPlane plane1(n1, -n1.DotProduct(q1).GetScalar());
+				ndVector n1(&vertexArray[indexArray1[indexCount1 + 1]].m_x);
+				ndVector q1(&vertexArray[indexArray1[0]].m_x);
+				n1 = n1 & ndVector::m_triplexMask;
+				q1 = q1 & ndVector::m_triplexMask;
 
-			ndFloat32 maxDist0 = ndFloat32(-1.0f);
-			for (ndInt32 i = 0; i < indexCount1; ++i)
-			{
-				if (edge->m_twin->m_incidentVertex == indexArray1[i])
+				ndPlane plane0(n0, -n0.DotProduct(q0).GetScalar());
+				ndPlane plane1(n1, -n1.DotProduct(q1).GetScalar());
+
+				ndFloat32 maxDist0 = ndFloat32(-1.0f);
+				for (ndInt32 k = 0; k < indexCount1; ++k)
 				{
-					offsetIndex1 = i;
+					ndVector point(&vertexArray[indexArray1[k]].m_x);
+					ndFloat32 dist(plane0.Evalue(point & ndVector::m_triplexMask));
+					maxDist0 = ndMax(maxDist0, dist);
 				}
-				ndVector point(&vertexArray[indexArray1[i]].m_x);
-				ndFloat32 dist(plane0.Evalue(point & ndVector::m_triplexMask));
-				maxDist0 = ndMax(maxDist0, dist);
-			}
 
-			ndFloat32 maxDist1 = ndFloat32(-1.0f);
-			for (ndInt32 i = 0; i < indexCount0; ++i)
-			{
-				if (edge->m_incidentVertex == indexArray0[i])
+				ndFloat32 maxDist1 = ndFloat32(-1.0f);
+				for (ndInt32 k = 0; k < indexCount0; ++k)
 				{
-					offsetIndex0 = i;
+					ndVector point(&vertexArray[indexArray0[k]].m_x);
+					ndFloat32 dist(plane1.Evalue(point & ndVector::m_triplexMask));
+					maxDist1 = ndMax(maxDist1, dist);
 				}
-				ndVector point(&vertexArray[indexArray0[i]].m_x);
-				ndFloat32 dist(plane1.Evalue(point & ndVector::m_triplexMask));
-				maxDist1 = ndMax(maxDist1, dist);
-			}
 
-			bool edgeIsConvex = (maxDist0 <= ndFloat32(1.0e-3f));
-			edgeIsConvex = edgeIsConvex && (maxDist1 <= ndFloat32(1.0e-3f));
-			edgeIsConvex = edgeIsConvex || (n0.DotProduct(n1).GetScalar() > ndFloat32(0.9991f));
+				bool edgeIsConvex = (maxDist0 <= ndFloat32(1.0e-3f));
+				edgeIsConvex = edgeIsConvex && (maxDist1 <= ndFloat32(1.0e-3f));
+				edgeIsConvex = edgeIsConvex || (n0.DotProduct(n1).GetScalar() > ndFloat32(0.9991f));
 
-			//hacks for testing adjacency
-			//edgeIsConvex = edgeIsConvex || (n0.DotProduct(n1).GetScalar() > ndFloat32(0.5f));
-			//edgeIsConvex = true;
-			if (edgeIsConvex)
-			{
-				ndAssert(offsetIndex0 >= 0);
-				ndAssert(offsetIndex1 >= 0);
-				indexArray0[indexCount0 + 2 + offsetIndex0] = indexArray1[indexCount1 + 1];
-				indexArray1[indexCount1 + 2 + offsetIndex1] = indexArray0[indexCount0 + 1];
+				//hacks for testing adjacency
+				//edgeIsConvex = edgeIsConvex || (n0.DotProduct(n1).GetScalar() > ndFloat32(0.5f));
+				//edgeIsConvex = true;
+				if (edgeIsConvex)
+				{
+					indexArray0[indexCount0 + 2 + edge0.m_edge] = indexArray1[indexCount1 + 1];
+					indexArray1[indexCount1 + 2 + edge1.m_edge] = indexArray0[indexCount0 + 1];
+				}
 			}
 		}
-		edge->m_mark = mark;
-		edge->m_twin->m_mark = mark;
-	}
+	});
+	ndParallelExecute(threadPool, CalculateEdgeNormals);
 
-	ndStack<ndTriplex> pool ((m_indexCount / 2) - 1);
-	ndInt32 normalCount = 0;
-	for (ndInt32 i = 0; i < m_nodesCount; ++i) 
+	// the edges without a convex neighbor get a normal perpendicular to the edge.
+	ndArray<ndInt32> normalStart;
+	normalStart.SetCount(faceCount + 1);
+	auto CountConcaveEdges = ndMakeObject::ndFunction([this, &faces, &normalStart, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		const ndNode* const node = &m_aabb[i];
-		if (node->m_left.IsLeaf()) 
+		D_TRACKTIME_NAMED(CountConcaveEdges);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndInt32 vCount = ndInt32 (node->m_left.GetCount());
-			if (vCount) 
+			const ndInt32 vCount = faces[i].m_count;
+			const ndInt32* const face = &m_indices[faces[i].m_face];
+			ndInt32 count = 0;
+			for (ndInt32 j = 0; j < vCount; ++j) 
 			{
-				ndInt32 index = ndInt32 (node->m_left.GetIndex());
-				ndInt32* const face = &m_indices[index];
-	
-				ndInt32 j0 = 2 * (vCount + 1) - 1;
-				ndVector normal (&vertexArray[face[vCount + 1]].m_x);
-				normal = normal & ndVector::m_triplexMask;
-				ndAssert (ndAbs (normal.DotProduct(normal).GetScalar() - ndFloat32 (1.0f)) < ndFloat32 (1.0e-6f));
-				ndVector q0 (&vertexArray[face[vCount - 1]].m_x);
-				q0 = q0 & ndVector::m_triplexMask;
-				for (ndInt32 j = 0; j < vCount; ++j) 
-				{
-					ndInt32 j1 = vCount + 2 + j;
-					ndVector q1 (&vertexArray[face[j]].m_x);
-					q1 = q1 & ndVector::m_triplexMask;
-					if (face[j0] & D_CONCAVE_EDGE_MASK)
-					{
-						ndVector e (q1 - q0);
-						ndVector n (e.CrossProduct(normal).Normalize());
-						ndAssert (ndAbs (n.DotProduct(n).GetScalar() - ndFloat32 (1.0f)) < ndFloat32 (1.0e-6f));
-						pool[normalCount].m_x = n.m_x;
-						pool[normalCount].m_y = n.m_y;
-						pool[normalCount].m_z = n.m_z;
-						face[j0] = normalCount | D_CONCAVE_EDGE_MASK;
-						normalCount ++;
-					}
-					q0 = q1;
-					j0 = j1;
-				}
+				count += (face[vCount + 2 + j] & D_CONCAVE_EDGE_MASK) ? 1 : 0;
 			}
+			normalStart[i] = count;
 		}
+	});
+	ndParallelExecute(threadPool, CountConcaveEdges);
+
+	ndInt32 normalCount = 0;
+	for (ndInt32 i = 0; i < faceCount; ++i)
+	{
+		const ndInt32 count = normalStart[i];
+		normalStart[i] = normalCount;
+		normalCount += count;
+	}
+	normalStart[faceCount] = normalCount;
 	
-		if (node->m_right.IsLeaf()) 
+	if (normalCount) 
+	{
+		ndStack<ndTriplex> pool (normalCount);
+		auto CalculateConcaveNormals = ndMakeObject::ndFunction([this, &faces, &normalStart, &pool, vertexArray, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 		{
-			ndInt32 vCount = ndInt32 (node->m_right.GetCount());
-			if (vCount) 
+			D_TRACKTIME_NAMED(CalculateConcaveNormals);
+			const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 			{
-				ndInt32 index = ndInt32 (node->m_right.GetIndex());
-				ndInt32* const face = &m_indices[index];
-	
+				const ndInt32 vCount = faces[i].m_count;
+				ndInt32* const face = &m_indices[faces[i].m_face];
+				ndInt32 normalIndex = normalStart[i];
+
 				ndInt32 j0 = 2 * (vCount + 1) - 1;
 				ndVector normal (&vertexArray[face[vCount + 1]].m_x);
 				normal = normal & ndVector::m_triplexMask;
@@ -453,23 +957,21 @@ void ndAabbPolygonSoup::CalculateAdjacent ()
 						ndVector e (q1 - q0);
 						ndVector n (e.CrossProduct(normal).Normalize());
 						ndAssert (ndAbs (n.DotProduct(n).GetScalar() - ndFloat32 (1.0f)) < ndFloat32 (1.0e-6f));
-						pool[normalCount].m_x = n.m_x;
-						pool[normalCount].m_y = n.m_y;
-						pool[normalCount].m_z = n.m_z;
-						face[j0] = normalCount | D_CONCAVE_EDGE_MASK;
-						normalCount ++;
+						pool[normalIndex].m_x = n.m_x;
+						pool[normalIndex].m_y = n.m_y;
+						pool[normalIndex].m_z = n.m_z;
+						face[j0] = normalIndex | D_CONCAVE_EDGE_MASK;
+						normalIndex ++;
 					}
 					q0 = q1;
 					j0 = j1;
 				}
 			}
-		}
-	}
-	
-	if (normalCount) 
-	{
+		});
+		ndParallelExecute(threadPool, CalculateConcaveNormals);
+
 		ndStack<ndInt32> indexArray (normalCount);
-		ndInt32 newNormalCount = ndVertexListToIndexList (&pool[0].m_x, sizeof (ndTriplex), 3, normalCount, &indexArray[0], ndFloat32 (1.0e-6f));
+		ndInt32 newNormalCount = ndVertexListToIndexList (threadPool, &pool[0].m_x, sizeof (ndTriplex), 3, normalCount, &indexArray[0], ndFloat32 (1.0e-6f));
 	
 		ndInt32 oldCount = GetVertexCount();
 		ndTriplex* const vertexArray1 = (ndTriplex*)ndMemory::Malloc (sizeof (ndTriplex) * (oldCount + newNormalCount));
@@ -481,14 +983,14 @@ void ndAabbPolygonSoup::CalculateAdjacent ()
 		m_localVertex = &vertexArray1[0].m_x;
 		m_vertexCount = oldCount + newNormalCount;
 	
-		for (ndInt32 i = 0; i < m_nodesCount; ++i) 
+		auto RemapConcaveNormals = ndMakeObject::ndFunction([this, &faces, &indexArray, oldCount, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 		{
-			const ndNode* const node = &m_aabb[i];
-			if (node->m_left.IsLeaf()) 
+			D_TRACKTIME_NAMED(RemapConcaveNormals);
+			const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 			{
-				ndInt32 vCount = ndInt32 (node->m_left.GetCount());
-				ndInt32 index = ndInt32 (node->m_left.GetIndex());
-				ndInt32* const face = &m_indices[index];
+				const ndInt32 vCount = faces[i].m_count;
+				ndInt32* const face = &m_indices[faces[i].m_face];
 				for (ndInt32 j = 0; j < vCount; ++j) 
 				{
 					ndInt32 edgeIndexNormal = face[vCount + 2 + j];
@@ -498,57 +1000,17 @@ void ndAabbPolygonSoup::CalculateAdjacent ()
 						face[vCount + 2 + j] = (indexArray[k] + oldCount) | D_CONCAVE_EDGE_MASK;
 					}
 					#ifdef _DEBUG	
-						//ndVector normal (&vertexArray1[face[vCount + 2 + j]].m_x);
-						ndVector normal (&vertexArray1[face[vCount + 2 + j] & (~D_CONCAVE_EDGE_MASK)].m_x);
+						ndVector normal(&((ndTriplex*)m_localVertex)[face[vCount + 2 + j] & (~D_CONCAVE_EDGE_MASK)].m_x);
 						normal = normal & ndVector::m_triplexMask;
 						ndAssert (ndAbs (normal.DotProduct(normal).GetScalar() - ndFloat32 (1.0f)) < ndFloat32 (1.0e-6f));
 					#endif
 				}
 			}
-	
-			if (node->m_right.IsLeaf()) 
-			{
-				ndInt32 vCount = ndInt32 (node->m_right.GetCount());
-				ndInt32 index = ndInt32 (node->m_right.GetIndex());
-				ndInt32* const face = &m_indices[index];
-				for (ndInt32 j = 0; j < vCount; ++j) 
-				{
-					ndInt32 edgeIndexNormal = face[vCount + 2 + j];
-					if (edgeIndexNormal & D_CONCAVE_EDGE_MASK)
-					{
-						ndInt32 k = edgeIndexNormal & (~D_CONCAVE_EDGE_MASK);
-						face[vCount + 2 + j] = (indexArray[k] + oldCount) | D_CONCAVE_EDGE_MASK;
-					}
-	
-					#ifdef _DEBUG	
-						//ndVector normal (&vertexArray1[face[vCount + 2 + j]].m_x);
-						ndVector normal(&vertexArray1[face[vCount + 2 + j] & (~D_CONCAVE_EDGE_MASK)].m_x);
-						normal = normal & ndVector::m_triplexMask;
-						ndAssert (ndAbs (normal.DotProduct(normal).GetScalar() - ndFloat32 (1.0f)) < ndFloat32 (1.0e-6f));
-					#endif
-				}
-			}
-		}
+		});
+		ndParallelExecute(threadPool, RemapConcaveNormals);
 	}
 }
 
-ndIntersectStatus ndAabbPolygonSoup::CalculateAllFaceEdgeNormals(void* const context, const ndFloat32* const, ndInt32, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32)
-{
-	ndInt32 face[256];
-	ndInt64 data[256];
-	ndPolyhedra& adjacency = *((ndPolyhedra*)context);
-
-	ndIntPtr userData;
-	userData.m_ptr = (void*)indexArray;
-	for (ndInt32 i = 0; i < indexCount; ++i)
-	{
-		face[i] = indexArray[i];
-		data[i] = userData.m_int;
-	}
-	adjacency.AddFace(indexCount, face, data);
-	return m_continueSearh;
-}
-
 ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator) const
 {
 	ndAssert (firstBox >= 0);
@@ -575,8 +1037,43 @@ ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDown (ndNodeBuilder
 	}
 }
 
+ndAabbPolygonSoup::ndNodeBuilder* ndAabbPolygonSoup::BuildTopDownTasks (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator, ndInt32 taskSize, ndArray<ndBuildTask>& tasks) const
+{
+	if ((lastBox - firstBox) < taskSize) 
+	{
+		// a sub tree of n leaves has n - 1 nodes, and its root is the first allocated node, 
+		// so the tree can be linked now and the sub tree built later on any thread.
+		ndBuildTask task;
+		task.m_firstBox = firstBox;
+		task.m_lastBox = lastBox;
+		task.m_allocator = *allocator;
+		tasks.PushBack(task);
+		*allocator = *allocator + (lastBox - firstBox);
+		return (lastBox == firstBox) ? &leafArray[firstBox] : task.m_allocator;
+	} 
+
+	ndSplitInfo info (&leafArray[firstBox], lastBox - firstBox + 1);
+	ndNodeBuilder* const parent = new (*allocator) ndNodeBuilder (info.m_p0, info.m_p1);
+	*allocator = *allocator + 1;
+
+	parent->m_right = BuildTopDownTasks (leafArray, firstBox + info.m_axis, lastBox, allocator, taskSize, tasks);
+	parent->m_left = BuildTopDownTasks (leafArray, firstBox, firstBox + info.m_axis - 1, allocator, taskSize, tasks);
+	return parent;
+}
+
 void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 {
+	BuildHierarchy(nullptr, builder);
+}
+
+void ndAabbPolygonSoup::Create (ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder)
+{
+	BuildHierarchy(&threadPool, builder);
+}
+
+void ndAabbPolygonSoup::BuildHierarchy (ndThreadPool* const threadPool, const ndPolygonSoupBuilder& builder)
+{
+	D_TRACKTIME();
 	if (builder.m_faceVertexCount.GetCount() == 0) 
 	{
 		return;
@@ -606,161 +1103,203 @@ void ndAabbPolygonSoup::Create (const ndPolygonSoupBuilder& builder)
 		tmpVertexArray[i + builder.m_vertexPoints.GetCount()] = builder.m_normalPoints[i];
 	}
 
+	const ndInt32 faceCount = ndInt32(builder.m_faceVertexCount.GetCount());
 	const ndInt32* const indices = &builder.m_vertexIndex[0];
-	ndStack<ndNodeBuilder> constructor (ndInt32(builder.m_faceVertexCount.GetCount() * 2 + 16));
+	ndStack<ndNodeBuilder> constructor (faceCount * 2 + 16);
+	ndStack<ndInt32> faceStart (faceCount);
 
 	ndInt32 polygonIndex = 0;
+	for (ndInt32 i = 0; i < faceCount; ++i) 
+	{
+		faceStart[i] = polygonIndex;
+		polygonIndex += builder.m_faceVertexCount[i];
+	}
+
 	ndInt32 allocatorIndex = 0;
-	if (builder.m_faceVertexCount.GetCount() == 1) 
+	if (faceCount == 1) 
 	{
 		ndInt32 indexCount = builder.m_faceVertexCount[0] - 1;
 		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], 0, indexCount, &indices[0]);
 		allocatorIndex ++;
 	}
-	for (ndInt32 i = 0; i < builder.m_faceVertexCount.GetCount(); ++i) 
+
+	const ndInt32 leafBase = allocatorIndex;
+	auto BuildLeafs = ndMakeObject::ndFunction([&builder, &constructor, &faceStart, tmpVertexArray, indices, leafBase, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		ndInt32 indexCount = builder.m_faceVertexCount[i] - 1;
-		new (&constructor[allocatorIndex]) ndNodeBuilder (&tmpVertexArray[0], i, indexCount, &indices[polygonIndex]);
-		allocatorIndex ++;
-		polygonIndex += (indexCount + 1);
-	}
+		D_TRACKTIME_NAMED(BuildLeafs);
+		const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			ndInt32 indexCount = builder.m_faceVertexCount[i] - 1;
+			new (&constructor[leafBase + i]) ndNodeBuilder (&tmpVertexArray[0], i, indexCount, &indices[faceStart[i]]);
+		}
+	});
+	ndParallelExecute(threadPool, BuildLeafs);
+	allocatorIndex += faceCount;
 
+	// the top of the tree is split serially, the sub trees are built in parallel.
+	// the split does not depend on the thread count, so neither does the tree.
+	ndArray<ndBuildTask> tasks;
 	ndNodeBuilder* constructorAllocator = &constructor[allocatorIndex];
-	ndNodeBuilder* const root = BuildTopDown (&constructor[0], 0, allocatorIndex - 1, &constructorAllocator);
+	const ndInt32 taskSize = ndMax(allocatorIndex / D_AABB_BUILD_TASKS, D_AABB_BUILD_TASK_MIN_SIZE);
+	ndNodeBuilder* const root = BuildTopDownTasks (&constructor[0], 0, allocatorIndex - 1, &constructorAllocator, taskSize, tasks);
 
+	ndAtomic<ndInt32> iterator(0);
+	auto BuildSubTrees = ndMakeObject::ndFunction([this, &iterator, &tasks, &constructor](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(BuildSubTrees);
+		const ndInt32 taskCount = ndInt32(tasks.GetCount());
+		for (ndInt32 i = iterator.fetch_add(1); i < taskCount; i = iterator.fetch_add(1))
+		{
+			const ndBuildTask& task = tasks[i];
+			ndNodeBuilder* allocator = task.m_allocator;
+			BuildTopDown (&constructor[0], task.m_firstBox, task.m_lastBox, &allocator);
+		}
+	});
+	ndParallelExecute(threadPool, BuildSubTrees);
 	ndAssert (root);
-	ndList<ndNodeBuilder*> list;
-	list.Append(root);
+
+	// enumerate the nodes breadth first, 
+	// and assign the vertex and index locations
+	const ndInt32 nodeCount = allocatorIndex * 2 - 1;
+	ndStack<ndNodeBuilder*> queue (nodeCount);
+	ndStack<ndInt32> leafIndexStart (nodeCount);
+	queue[0] = root;
+	root->m_parent = nullptr;
+	ndInt32 queueCount = 1;
 	ndInt32 nodeIndex = 0;
-	while (list.GetCount())
+	ndInt32 indexMap = 0;
+	for (ndInt32 i = 0; i < queueCount; ++i)
 	{
-		ndNodeBuilder* const node = list.GetFirst()->GetInfo();
-		list.Remove(list.GetFirst());
-
+		ndNodeBuilder* const node = queue[i];
 		if (node->m_left) 
 		{
+			ndAssert (node->m_right);
 			node->m_enumeration = nodeIndex;
 			nodeIndex ++;
-			ndAssert (node->m_right);
-			list.Append(node->m_left);
-			list.Append(node->m_right);
+			node->m_left->m_parent = node;
+			node->m_right->m_parent = node;
+			queue[queueCount] = node->m_left;
+			queue[queueCount + 1] = node->m_right;
+			queueCount += 2;
+		}
+		else
+		{
+			leafIndexStart[i] = indexMap;
+			indexMap += node->m_indexCount * 2 + 3;
 		}
 	}
-	ndAssert(!list.GetCount());
-
-	ndInt32 aabbBase = ndInt32(builder.m_vertexPoints.GetCount() + builder.m_normalPoints.GetCount());
+	ndAssert (queueCount == nodeCount);
+	ndAssert (nodeIndex <= m_nodesCount);
 
+	const ndInt32 aabbBase = ndInt32(builder.m_vertexPoints.GetCount() + builder.m_normalPoints.GetCount());
 	ndVector* const aabbPoints = &tmpVertexArray[aabbBase];
-
-	ndInt32 vertexIndex = 0;
-	ndInt32 aabbNodeIndex = 0;
-	list.Append(root);
-	ndInt32 indexMap = 0;
-	while (list.GetCount())
+	const ndInt32 normalBase = ndInt32(builder.m_vertexPoints.GetCount());
+	auto BuildNodes = ndMakeObject::ndFunction([this, &builder, &queue, &leafIndexStart, tmpVertexArray, aabbPoints, aabbBase, normalBase, queueCount](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		ndNodeBuilder* const node = list.GetFirst()->GetInfo();
-		list.Remove(list.GetFirst());
-
-		if (node->m_enumeration >= 0)
+		D_TRACKTIME_NAMED(BuildNodes);
+		const ndStartEnd startEnd(queueCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 		{
-			ndAssert (node->m_left);
-			ndAssert (node->m_right);
-			ndNode& aabbNode = m_aabb[aabbNodeIndex];
-			aabbNodeIndex ++;
-			ndAssert (aabbNodeIndex <= m_nodesCount);
-
-			if (node->m_parent)
+			const ndNodeBuilder* const node = queue[i];
+			if (node->m_enumeration >= 0)
 			{
-				if (node->m_parent->m_left == node)
+				ndAssert (node->m_left);
+				ndAssert (node->m_right);
+				ndNode& aabbNode = m_aabb[node->m_enumeration];
+				if (node->m_parent)
 				{
-					m_aabb[node->m_parent->m_enumeration].m_left = ndNode::ndLeafNodePtr (ndUnsigned32 (&m_aabb[node->m_enumeration] - m_aabb));
-				}
-				else 
-				{
-					ndAssert (node->m_parent->m_right == node);
-					m_aabb[node->m_parent->m_enumeration].m_right = ndNode::ndLeafNodePtr (ndUnsigned32 (&m_aabb[node->m_enumeration] - m_aabb));
+					if (node->m_parent->m_left == node)
+					{
+						m_aabb[node->m_parent->m_enumeration].m_left = ndNode::ndLeafNodePtr (ndUnsigned32 (node->m_enumeration));
+					}
+					else 
+					{
+						ndAssert (node->m_parent->m_right == node);
+						m_aabb[node->m_parent->m_enumeration].m_right = ndNode::ndLeafNodePtr (ndUnsigned32 (node->m_enumeration));
+					}
 				}
-			}
 
-			aabbPoints[vertexIndex + 0] = node->m_p0;
-			aabbPoints[vertexIndex + 1] = node->m_p1;
+				const ndInt32 vertexIndex = node->m_enumeration * 2;
+				aabbPoints[vertexIndex + 0] = node->m_p0;
+				aabbPoints[vertexIndex + 1] = node->m_p1;
 
-			aabbNode.m_indexBox0 = aabbBase + vertexIndex;
-			aabbNode.m_indexBox1 = aabbBase + vertexIndex + 1;
-
-			vertexIndex += 2;
-		}
-		else
-		{
-			ndAssert (!node->m_left);
-			ndAssert (!node->m_right);
-
-			if (node->m_parent)
+				aabbNode.m_indexBox0 = aabbBase + vertexIndex;
+				aabbNode.m_indexBox1 = aabbBase + vertexIndex + 1;
+			}
+			else
 			{
-				if (node->m_parent->m_left == node)
+				ndAssert (!node->m_left);
+				ndAssert (!node->m_right);
+
+				const ndInt32 indexMap1 = leafIndexStart[i];
+				if (node->m_parent)
 				{
-					m_aabb[node->m_parent->m_enumeration].m_left = ndNode::ndLeafNodePtr (ndUnsigned32(node->m_indexCount), ndUnsigned32(indexMap));
+					if (node->m_parent->m_left == node)
+					{
+						m_aabb[node->m_parent->m_enumeration].m_left = ndNode::ndLeafNodePtr (ndUnsigned32(node->m_indexCount), ndUnsigned32(indexMap1));
+					}
+					else 
+					{
+						ndAssert (node->m_parent->m_right == node);
+						m_aabb[node->m_parent->m_enumeration].m_right = ndNode::ndLeafNodePtr (ndUnsigned32(node->m_indexCount), ndUnsigned32(indexMap1));
+					}
 				}
-				else 
+
+				// index format i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
+				for (ndInt32 j = 0; j < node->m_indexCount; ++j) 
 				{
-					ndAssert (node->m_parent->m_right == node);
-					m_aabb[node->m_parent->m_enumeration].m_right = ndNode::ndLeafNodePtr (ndUnsigned32(node->m_indexCount), ndUnsigned32(indexMap));
+					m_indices[indexMap1 + j] = node->m_faceIndices[j];
+					m_indices[indexMap1 + j + node->m_indexCount + 2] = D_CONCAVE_EDGE_MASK | 0xffffffff;
 				}
-			}
 
-			// index format i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
-			for (ndInt32 j = 0; j < node->m_indexCount; ++j) 
-			{
-				m_indices[indexMap + j] = node->m_faceIndices[j];
-				m_indices[indexMap + j + node->m_indexCount + 2] = D_CONCAVE_EDGE_MASK | 0xffffffff;
+				// face attribute
+				m_indices[indexMap1 + node->m_indexCount] = node->m_faceIndices[node->m_indexCount];
+				// face normal
+				m_indices[indexMap1 + node->m_indexCount + 1] = normalBase + builder.m_normalIndex[node->m_faceIndex];
+				// face size
+				ndFloat32 faceMaxDiag = CalculateFaceMaxDiagonal(&tmpVertexArray[0], node->m_indexCount, node->m_faceIndices);
+				ndInt32 quantizedDiagSize = ndInt32(ndFloor(faceMaxDiag / D_FACE_CLIP_DIAGONAL_SCALE + ndFloat32(1.0f)));
+				m_indices[indexMap1 + node->m_indexCount * 2 + 2] = quantizedDiagSize;
 			}
-
-			// face attribute
-			m_indices[indexMap + node->m_indexCount] = node->m_faceIndices[node->m_indexCount];
-			// face normal
-			m_indices[indexMap + node->m_indexCount + 1] = ndInt32(builder.m_vertexPoints.GetCount()) + builder.m_normalIndex[node->m_faceIndex];
-			// face size
-			ndFloat32 faceMaxDiag = CalculateFaceMaxDiagonal(&tmpVertexArray[0], node->m_indexCount, node->m_faceIndices);
-			ndInt32 quantizedDiagSize = ndInt32(ndFloor(faceMaxDiag / D_FACE_CLIP_DIAGONAL_SCALE + ndFloat32(1.0f)));
-			m_indices[indexMap + node->m_indexCount * 2 + 2] = quantizedDiagSize;
-
-			indexMap += node->m_indexCount * 2 + 3;
-		}
-
-		if (node->m_left) 
-		{
-			ndAssert (node->m_right);
-			list.Append(node->m_left);
-			list.Append(node->m_right);
 		}
-	}
+	});
+	ndParallelExecute(threadPool, BuildNodes);
 
+	const ndInt32 vertexIndex = nodeIndex * 2;
 	ndStack<ndInt32> indexArray (vertexIndex);
-	ndInt32 aabbPointCount = ndVertexListToIndexList (&aabbPoints[0].m_x, sizeof (ndVector), 3, vertexIndex, &indexArray[0], ndFloat32 (1.0e-6f));
+	ndInt32 aabbPointCount = ndVertexListToIndexList (threadPool, &aabbPoints[0].m_x, sizeof (ndVector), 3, vertexIndex, &indexArray[0], ndFloat32 (1.0e-6f));
 
 	m_vertexCount = aabbBase + aabbPointCount;
 	m_localVertex = (ndFloat32*) ndMemory::Malloc (sizeof (ndTriplex) * m_vertexCount);
 
 	ndTriplex* const dstPoints = (ndTriplex*)m_localVertex;
-	for (ndInt32 i = 0; i < m_vertexCount; ++i) 
+	auto CopyVertices = ndMakeObject::ndFunction([this, &indexArray, dstPoints, tmpVertexArray, aabbBase](ndInt32 threadIndex, ndInt32 threadCount)
 	{
-		dstPoints[i].m_x = tmpVertexArray[i].m_x;
-		dstPoints[i].m_y = tmpVertexArray[i].m_y;
-		dstPoints[i].m_z = tmpVertexArray[i].m_z;
-	}
+		D_TRACKTIME_NAMED(CopyVertices);
+		const ndStartEnd startEnd(m_vertexCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			dstPoints[i].m_x = tmpVertexArray[i].m_x;
+			dstPoints[i].m_y = tmpVertexArray[i].m_y;
+			dstPoints[i].m_z = tmpVertexArray[i].m_z;
+		}
 
-	for (ndInt32 i = 0; i < m_nodesCount; ++i) 
-	{
-		ndNode& box = m_aabb[i];
+		const ndStartEnd startEnd1(m_nodesCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd1.m_start; i < startEnd1.m_end; ++i)
+		{
+			ndNode& box = m_aabb[i];
 
-		ndInt32 j = box.m_indexBox0 - aabbBase;
-		box.m_indexBox0 = indexArray[j] + aabbBase;
+			ndInt32 j = box.m_indexBox0 - aabbBase;
+			box.m_indexBox0 = indexArray[j] + aabbBase;
 
-		j = box.m_indexBox1 - aabbBase;
-		box.m_indexBox1 = indexArray[j] + aabbBase;
-	}
+			j = box.m_indexBox1 - aabbBase;
+			box.m_indexBox1 = indexArray[j] + aabbBase;
+		}
+	});
+	ndParallelExecute(threadPool, CopyVertices);
 
-	if (builder.m_faceVertexCount.GetCount() == 1) 
+	if (faceCount == 1) 
 	{
 		m_aabb[0].m_right = ndNode::ndLeafNodePtr (0, 0);
 	}
@@ -817,6 +1356,242 @@ void ndAabbPolygonSoup::Deserialize (const char* const path)
 	}
 }
 
+void ndAabbPolygonSoup::SerializeImage(const char* const path) const
+{
+	FILE* const file = fopen(path, "wb");
+	if (file)
+	{
+		ndImageHeader header;
+		memset(&header, 0, sizeof(header));
+		header.m_magic = D_POLYGON_SOUP_IMAGE_MAGIC;
+		header.m_version = D_POLYGON_SOUP_IMAGE_VERSION;
+		header.m_vertexSizeInBytes = sizeof(ndTriplex);
+		header.m_nodeSizeInBytes = sizeof(ndNode);
+		if (m_aabb)
+		{
+			header.m_vertexCount = m_vertexCount;
+			header.m_indexCount = m_indexCount;
+			header.m_nodesCount = m_nodesCount;
+			header.m_indexSizeInBytes = sizeof(ndInt32) * ndUnsigned64(m_indexCount);
+		}
+		ndSetImageLayout(header);
+
+		ndUnsigned64 offset = 0;
+		ndWriteImageSection(file, offset, 0, &header, sizeof(ndImageHeader));
+		if (m_aabb)
+		{
+			ndWriteImageSection(file, offset, header.m_vertexOffset, m_localVertex, sizeof(ndTriplex) * ndUnsigned64(m_vertexCount));
+			ndWriteImageSection(file, offset, header.m_indexOffset, m_indices, header.m_indexSizeInBytes);
+			ndWriteImageSection(file, offset, header.m_nodeOffset, m_aabb, sizeof(ndNode) * ndUnsigned64(m_nodesCount));
+		}
+		ndWriteImageSection(file, offset, header.m_imageSize, nullptr, 0);
+		fclose(file);
+	}
+}
+
+void ndAabbPolygonSoup::SerializeCompactImage(const char* const path) const
+{
+	FILE* const file = fopen(path, "wb");
+	if (file)
+	{
+		ndImageHeader header;
+		memset(&header, 0, sizeof(header));
+		header.m_magic = D_POLYGON_SOUP_IMAGE_MAGIC;
+		header.m_version = D_POLYGON_SOUP_IMAGE_VERSION;
+		header.m_flags = D_POLYGON_SOUP_IMAGE_COMPACT;
+		header.m_vertexSizeInBytes = sizeof(ndTriplex);
+		header.m_nodeSizeInBytes = sizeof(ndImageCompactNode);
+
+		ndArray<ndTriplex> points;
+		ndArray<ndUnsigned8> indexStream;
+		ndArray<ndImageCompactNode> compactNodes;
+		if (m_aabb)
+		{
+			ndArray<ndInt32> pointMap;
+			ndArray<ndUnsigned8> kinds;
+			pointMap.SetCount(m_vertexCount);
+			kinds.SetCount(ndMax(m_indexCount, 1));
+			ndClassifyImageIndices(m_aabb, m_nodesCount, &kinds[0], m_indexCount);
+
+			// the node box points are replaced by the quantized boxes, 
+			// only the points used by the faces are kept.
+			const ndTriplex* const vertexArray = (ndTriplex*)m_localVertex;
+			for (ndInt32 i = 0; i < m_vertexCount; ++i)
+			{
+				pointMap[i] = -1;
+			}
+			for (ndInt32 i = 0; i < m_indexCount; ++i)
+			{
+				if ((kinds[i] != D_IMAGE_INDEX_ATTRIBUTE) && (kinds[i] != D_IMAGE_INDEX_FACE_SIZE))
+				{
+					pointMap[m_indices[i] & (~D_CONCAVE_EDGE_MASK)] = 0;
+				}
+			}
+			for (ndInt32 i = 0; i < m_vertexCount; ++i)
+			{
+				if (pointMap[i] == 0)
+				{
+					pointMap[i] = ndInt32(points.GetCount());
+					points.PushBack(vertexArray[i]);
+				}
+			}
+
+			ndInt32 values[D_IMAGE_INDEX_KINDS];
+			memset(values, 0, sizeof(values));
+			for (ndInt32 i = 0; i < m_indexCount; ++i)
+			{
+				ndInt32 value = m_indices[i];
+				if ((kinds[i] != D_IMAGE_INDEX_ATTRIBUTE) && (kinds[i] != D_IMAGE_INDEX_FACE_SIZE))
+				{
+					value = pointMap[value & (~D_CONCAVE_EDGE_MASK)] | (value & D_CONCAVE_EDGE_MASK);
+				}
+				ndEncodeImageIndex(indexStream, value, values[kinds[i]]);
+				values[kinds[i]] = value;
+			}
+
+			// each box is quantized relative to the decoded box of its parent,
+			// the same way the loader rebuilds it.
+			ndVector p0;
+			ndVector p1;
+			GetNodeAabb(m_aabb, p0, p1);
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				header.m_rootBox[i] = p0[i];
+				header.m_rootBox[i + 3] = p1[i];
+			}
+
+			ndArray<ndFloat32> boxes;
+			boxes.SetCount(m_nodesCount * 6);
+			compactNodes.SetCount(m_nodesCount);
+			ndMemCpy(&boxes[0], header.m_rootBox, 6);
+			for (ndInt32 i = 0; i < 3; ++i)
+			{
+				compactNodes[0].m_box[i] = 0;
+				compactNodes[0].m_box[i + 3] = D_POLYGON_SOUP_IMAGE_QUANTIZE;
+			}
+			for (ndInt32 i = 0; i < m_nodesCount; ++i)
+			{
+				const ndNode& node = m_aabb[i];
+				compactNodes[i].m_left = node.m_left.m_node;
+				compactNodes[i].m_right = node.m_right.m_node;
+				const ndFloat32* const parentBox = &boxes[i * 6];
+				for (ndInt32 j = 0; j < 2; ++j)
+				{
+					const ndNode::ndLeafNodePtr& child = j ? node.m_right : node.m_left;
+					if (!child.IsLeaf())
+					{
+						const ndInt32 index = ndInt32(child.m_node);
+						ndAssert((index > i) && (index < m_nodesCount));
+						GetNodeAabb(&m_aabb[index], p0, p1);
+						ndImageCompactNode& compactNode = compactNodes[index];
+						for (ndInt32 k = 0; k < 3; ++k)
+						{
+							compactNode.m_box[k] = ndQuantizeImageCoord(parentBox[k], parentBox[k + 3], p0[k], false);
+							compactNode.m_box[k + 3] = ndQuantizeImageCoord(parentBox[k], parentBox[k + 3], p1[k], true);
+						}
+						ndDequantizeImageBox(parentBox, compactNode.m_box, &boxes[index * 6]);
+					}
+				}
+			}
+
+			header.m_vertexCount = ndInt32(points.GetCount());
+			header.m_indexCount = m_indexCount;
+			header.m_nodesCount = m_nodesCount;
+			header.m_indexSizeInBytes = ndUnsigned64(indexStream.GetCount());
+		}
+		ndSetImageLayout(header);
+
+		ndUnsigned64 offset = 0;
+		ndWriteImageSection(file, offset, 0, &header, sizeof(ndImageHeader));
+		if (m_aabb)
+		{
+			ndWriteImageSection(file, offset, header.m_vertexOffset, &points[0], sizeof(ndTriplex) * ndUnsigned64(points.GetCount()));
+			ndWriteImageSection(file, offset, header.m_indexOffset, &indexStream[0], header.m_indexSizeInBytes);
+			ndWriteImageSection(file, offset, header.m_nodeOffset, &compactNodes[0], sizeof(ndImageCompactNode) * ndUnsigned64(m_nodesCount));
+		}
+		ndWriteImageSection(file, offset, header.m_imageSize, nullptr, 0);
+		fclose(file);
+	}
+}
+
+bool ndAabbPolygonSoup::DeserializeImage(const char* const path)
+{
+	bool state = false;
+	FILE* const file = fopen(path, "rb");
+	if (file)
+	{
+		fseek(file, 0, SEEK_END);
+		const long fileSize = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (fileSize >= long(sizeof(ndImageHeader)))
+		{
+			// the whole image is read with a single allocation and a single read
+			size_t imageSize = size_t(fileSize);
+			void* image = ndMemory::Malloc(imageSize);
+			if (fread(image, imageSize, 1, file) == 1)
+			{
+				if (((ndImageHeader*)image)->m_flags & D_POLYGON_SOUP_IMAGE_COMPACT)
+				{
+					// a compact image is expanded into a second allocation
+					void* const runtimeImage = ndDecodeCompactImage(image, imageSize);
+					ndMemory::Free(image);
+					image = runtimeImage;
+					imageSize = image ? size_t(((ndImageHeader*)image)->m_imageSize) : 0;
+				}
+				state = image && SetImage(image, imageSize);
+			}
+			if (state)
+			{
+				m_ownImage = true;
+			}
+			else if (image)
+			{
+				ndMemory::Free(image);
+			}
+		}
+		fclose(file);
+	}
+	return state;
+}
+
+bool ndAabbPolygonSoup::SetImage(void* const image, size_t sizeInBytes)
+{
+	ndAssert(!m_aabb && !m_localVertex && !m_image);
+	if (!image || (sizeInBytes < sizeof(ndImageHeader)) || (size_t(image) & 0xf))
+	{
+		return false;
+	}
+
+	const ndImageHeader* const header = (ndImageHeader*)image;
+	if (!ndValidateImageHeader(header, sizeInBytes, 0, sizeof(ndNode)) ||
+		(header->m_indexSizeInBytes != sizeof(ndInt32) * ndUnsigned64(header->m_indexCount)))
+	{
+		return false;
+	}
+
+	char* const base = (char*)image;
+	ndNode* const nodes = (ndNode*)(base + header->m_nodeOffset);
+	ndInt32* const indices = (ndInt32*)(base + header->m_indexOffset);
+	if (header->m_nodesCount && !ndValidateImageTree(nodes, header->m_nodesCount, indices, header->m_indexCount, header->m_vertexCount))
+	{
+		return false;
+	}
+
+	m_image = image;
+	m_ownImage = false;
+	m_strideInBytes = sizeof(ndTriplex);
+	m_vertexCount = header->m_vertexCount;
+	m_indexCount = header->m_indexCount;
+	m_nodesCount = header->m_nodesCount;
+	if (m_nodesCount)
+	{
+		m_localVertex = (ndFloat32*)(base + header->m_vertexOffset);
+		m_indices = indices;
+		m_aabb = nodes;
+	}
+	return true;
+}
+
 ndVector ndAabbPolygonSoup::ForAllSectorsSupportVertex (const ndVector& dir) const
 {
 	ndVector supportVertex (ndFloat32 (0.0f));
@@ -25,11 +25,13 @@
 #include "ndCoreStdafx.h"
 #include "ndTypes.h"
 #include "ndUtils.h"
+#include "ndArray.h"
 #include "ndFastRay.h"
 #include "ndFastAabb.h"
 #include "ndIntersections.h"
 #include "ndPolygonSoupDatabase.h"
 
+class ndThreadPool;
 class ndPolygonSoupBuilder;
 
 // index format: i0, i1, i2, ... , id, normal, e0Normal, e1Normal, e2Normal, ..., faceSize
@@ -208,6 +210,8 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	};
 
 	class ndSplitInfo;
+	class ndBuildTask;
+	class ndImageHeader;
 	class ndNodeBuilder;
 
 	/// get the root node bounding box of the mesh.
@@ -219,12 +223,34 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	/// Reads a previously saved database binary file named path.
 	D_CORE_API virtual void Deserialize (const char* const path);
 
+	/// writes the database as a single versioned image that can be used in place.
+	D_CORE_API virtual void SerializeImage (const char* const path) const;
+
+	/// writes the database as a compact image, node boxes are quantized to 16 bit 
+	/// relative to the parent box and the face indices are delta encoded.
+	/// A compact image is expanded on load, it can not be used in place.
+	D_CORE_API virtual void SerializeCompactImage (const char* const path) const;
+
+	/// Reads an image or a compact image file, returns false if the image is not compatible or damaged.
+	D_CORE_API virtual bool DeserializeImage (const char* const path);
+
+	/// Uses an image in place, for example a memory mapped file. 
+	/// The memory is not owned and must outlive this object,
+	/// it must be writable (copy on write is fine) because face tags can be edited.
+	/// The whole image is validated, compact images are rejected.
+	D_CORE_API virtual bool SetImage (void* const image, size_t sizeInBytes);
+
 	protected:
 	D_CORE_API ndAabbPolygonSoup ();
 	D_CORE_API virtual ~ndAabbPolygonSoup ();
 
+	/// Builds the hierarchy, the thread pool versions produce the same image as the serial ones.
+	/// The median split and the kd cluster vertex weld are kept on purpose, a binned SAH
+	/// build or a spatial hash weld would be faster but would not give byte identical meshes.
 	D_CORE_API void Create (const ndPolygonSoupBuilder& builder);
+	D_CORE_API void Create (ndThreadPool& threadPool, const ndPolygonSoupBuilder& builder);
 	D_CORE_API void CalculateAdjacent ();
+	D_CORE_API void CalculateAdjacent (ndThreadPool& threadPool);
 	D_CORE_API virtual ndVector ForAllSectorsSupportVertex(const ndVector& dir) const;
 	D_CORE_API virtual void ForAllSectorsRayHit (const ndFastRay& ray, ndFloat32 maxT, ndRayIntersectCallback callback, void* const context) const;
 	D_CORE_API virtual void ForAllSectors (const ndFastAabb& obbAabb, const ndVector& boxDistanceTravel, ndFloat32 maxT, ndAaabbIntersectCallback callback, void* const context) const;
@@ -261,14 +287,18 @@ class ndAabbPolygonSoup: public ndPolygonSoupDatabase
 	}
 
 	private:
+	void BuildHierarchy (ndThreadPool* const threadPool, const ndPolygonSoupBuilder& builder);
+	void BuildAdjacency (ndThreadPool* const threadPool);
 	ndNodeBuilder* BuildTopDown (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator) const;
+	ndNodeBuilder* BuildTopDownTasks (ndNodeBuilder* const leafArray, ndInt32 firstBox, ndInt32 lastBox, ndNodeBuilder** const allocator, ndInt32 taskSize, ndArray<ndBuildTask>& tasks) const;
 	ndFloat32 CalculateFaceMaxDiagonal (const ndVector* const vertex, ndInt32 indexCount, const ndInt32* const indexArray) const;
-	static ndIntersectStatus CalculateAllFaceEdgeNormals(void* const context, const ndFloat32* const polygon, ndInt32 strideInBytes, const ndInt32* const indexArray, ndInt32 indexCount, ndFloat32 hitDistance);
 	
 	ndNode* m_aabb;
 	ndInt32* m_indices;
+	void* m_image;
 	ndInt32 m_nodesCount;
 	ndInt32 m_indexCount;
+	bool m_ownImage;
 	friend class ndContactSolver;
 };
 
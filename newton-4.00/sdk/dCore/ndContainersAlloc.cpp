@@ -28,6 +28,8 @@
 #include "ndThreadSyncUtils.h"
 
 #define D_FREELIST_DICTIONARY_SIZE 64
+#define D_FREELIST_CACHE_SIZE		16
+#define D_FREELIST_CACHE_BATCH		32
 
 class ndFreeListEntry
 {
@@ -43,18 +45,46 @@ class ndFreeListHeader
 	ndFreeListEntry* m_headPointer;
 };
 
+// a per thread free list in front of the global dictionary.
+// each thread keeps a few size classes of its own, they are refilled and 
+// drained in batches, so the global lock is only taken once every 
+// D_FREELIST_CACHE_BATCH allocations of the same size.
+class ndFreeListCache
+{
+	public:
+	ndFreeListCache();
+	~ndFreeListCache();
+
+	ndFreeListHeader* Find(ndInt32 size);
+
+	ndFreeListHeader m_entries[D_FREELIST_CACHE_SIZE];
+	ndInt32 m_count;
+	ndUnsigned64 m_hits;
+	ndUnsigned64 m_misses;
+
+	// set when the thread cache is destroyed, frees from later thread_local 
+	// or static destructors on this thread go to the global lists.
+	static thread_local bool m_destroyed;
+};
+
 class ndFreeListDictionary: public ndFixSizeArray<ndFreeListHeader, D_FREELIST_DICTIONARY_SIZE>
 {
 	public:
 	ndFreeListDictionary()
 		:ndFixSizeArray<ndFreeListHeader, D_FREELIST_DICTIONARY_SIZE>()
+		,m_stats()
 		,m_lock()
 	{
 	}
 
 	~ndFreeListDictionary()
 	{
-		Flush();
+		// the thread caches are gone by now, they already returned their lists
+		ndFreeListDictionary& me = *this;
+		for (ndInt32 i = 0; i < GetCount(); ++i)
+		{
+			Flush(&me[i]);
+		}
 	}
 
 	static ndFreeListDictionary& GetHeader()
@@ -63,6 +93,16 @@ class ndFreeListDictionary: public ndFixSizeArray<ndFreeListHeader, D_FREELIST_D
 		return dictionary;
 	}
 
+	static ndFreeListCache* GetCache()
+	{
+		if (ndFreeListCache::m_destroyed)
+		{
+			return nullptr;
+		}
+		static thread_local ndFreeListCache cache;
+		return &cache;
+	}
+
 	void Flush(ndFreeListHeader* const header)
 	{
 		ndFreeListEntry* next;
@@ -77,17 +117,47 @@ class ndFreeListDictionary: public ndFixSizeArray<ndFreeListHeader, D_FREELIST_D
 
 	void* Malloc(ndInt32 size)
 	{
+		const ndInt32 chunkSize = ndInt32(ndMemory::CalculateBufferSize(size_t(size)));
+		ndFreeListCache* const cache = GetCache();
+		ndFreeListHeader* const entry = cache ? cache->Find(chunkSize) : nullptr;
+		if (entry)
 		{
-			ndScopeSpinLock lock(m_lock);
-			ndFreeListHeader* const header = FindEntry(ndInt32(ndMemory::CalculateBufferSize(size_t(size))));
+			if (!entry->m_count)
+			{
+				cache->m_misses++;
+				Lock(cache);
+				Transfer(entry, FindEntry(chunkSize), D_FREELIST_CACHE_BATCH);
+				m_lock.Unlock();
+			}
+			else
+			{
+				cache->m_hits++;
+			}
+			if (entry->m_count)
+			{
+				entry->m_count--;
+				ndFreeListEntry* const self = entry->m_headPointer;
+				entry->m_headPointer = self->m_next;
+				ndMemory::SetCategory(self, ndMemory::GetCategory());
+				return self;
+			}
+		}
+		else
+		{
+			// too many size classes for this thread, or the thread cache is gone, use the global list
+			Lock(cache);
+			ndFreeListHeader* const header = FindEntry(chunkSize);
 			ndAssert(header->m_count >= 0);
 			if (header->m_count)
 			{
 				header->m_count--;
 				ndFreeListEntry* const self = header->m_headPointer;
 				header->m_headPointer = self->m_next;
+				m_lock.Unlock();
+				ndMemory::SetCategory(self, ndMemory::GetCategory());
 				return self;
 			}
+			m_lock.Unlock();
 		}
 		void* const ptr = ndMemory::Malloc(size_t(size));
 		ndAssert(ndMemory::GetSize(ptr) == ndMemory::CalculateBufferSize(size_t(size)));
@@ -96,36 +166,130 @@ class ndFreeListDictionary: public ndFixSizeArray<ndFreeListHeader, D_FREELIST_D
 
 	void Free(void* ptr)
 	{
-		ndScopeSpinLock lock(m_lock);
-		ndFreeListHeader* const header = FindEntry(ndInt32(ndMemory::GetSize(ptr)));
-		ndAssert(header);
+		const ndInt32 chunkSize = ndInt32(ndMemory::GetSize(ptr));
 		ndFreeListEntry* const self = (ndFreeListEntry*)ptr;
-
-		self->m_next = header->m_headPointer;
-		header->m_count++;
-		header->m_headPointer = self;
+		ndFreeListCache* const cache = GetCache();
+		ndFreeListHeader* const entry = cache ? cache->Find(chunkSize) : nullptr;
+		if (entry)
+		{
+			cache->m_hits++;
+			self->m_next = entry->m_headPointer;
+			entry->m_count++;
+			entry->m_headPointer = self;
+			if (entry->m_count >= 2 * D_FREELIST_CACHE_BATCH)
+			{
+				// keep one batch, return the rest
+				Lock(cache);
+				Transfer(FindEntry(chunkSize), entry, D_FREELIST_CACHE_BATCH);
+				m_lock.Unlock();
+			}
+		}
+		else
+		{
+			Lock(cache);
+			ndFreeListHeader* const header = FindEntry(chunkSize);
+			self->m_next = header->m_headPointer;
+			header->m_count++;
+			header->m_headPointer = self;
+			m_lock.Unlock();
+		}
 	}
 
 	void Flush()
 	{
-		ndScopeSpinLock lock(m_lock);
+		ndFreeListCache* const cache = GetCache();
+		Lock(cache);
 		ndFreeListDictionary& me = *this;
+		for (ndInt32 i = 0; cache && (i < cache->m_count); ++i)
+		{
+			Flush(&cache->m_entries[i]);
+		}
 		for (ndInt32 i = 0; i < GetCount(); ++i)
 		{
 			ndFreeListHeader* const header = &me[i];
 			Flush(header);
 		}
 		SetCount(0);
+		m_lock.Unlock();
 	}
 
 	void Flush(ndInt32 size)
 	{
-		ndScopeSpinLock lock(m_lock);
-		ndFreeListHeader* const header = FindEntry(ndInt32(ndMemory::CalculateBufferSize(size_t(size))));
+		const ndInt32 chunkSize = ndInt32(ndMemory::CalculateBufferSize(size_t(size)));
+		ndFreeListCache* const cache = GetCache();
+		ndFreeListHeader* const entry = cache ? cache->Find(chunkSize) : nullptr;
+		Lock(cache);
+		if (entry)
+		{
+			Flush(entry);
+		}
+		ndFreeListHeader* const header = FindEntry(chunkSize);
 		Flush(header);
+		m_lock.Unlock();
+	}
+
+	// a thread is going away, give its lists back to the global pool
+	void Release(ndFreeListCache& cache)
+	{
+		Lock(&cache);
+		for (ndInt32 i = 0; i < cache.m_count; ++i)
+		{
+			ndFreeListHeader* const entry = &cache.m_entries[i];
+			Transfer(FindEntry(entry->m_schunkSize), entry, entry->m_count);
+		}
+		cache.m_count = 0;
+		m_lock.Unlock();
+	}
+
+	void GetStats(ndFreeListAlloc::ndStats& stats)
+	{
+		Lock(GetCache());
+		stats = m_stats;
+		m_lock.Unlock();
+	}
+
+	void ResetStats()
+	{
+		Lock(GetCache());
+		m_stats = ndFreeListAlloc::ndStats();
+		m_lock.Unlock();
 	}
 
 	private:
+	// the thread counters are folded in the global ones every time the lock is taken
+	void Lock(ndFreeListCache* const cache)
+	{
+		bool contended = false;
+		if (!m_lock.TryLock())
+		{
+			contended = true;
+			m_lock.Lock();
+		}
+		m_stats.m_lockCount++;
+		m_stats.m_lockContentions += contended ? 1 : 0;
+		if (cache)
+		{
+			m_stats.m_cacheHits += cache->m_hits;
+			m_stats.m_cacheMisses += cache->m_misses;
+			cache->m_hits = 0;
+			cache->m_misses = 0;
+		}
+	}
+
+	// move up to count entries from one list to another
+	void Transfer(ndFreeListHeader* const dst, ndFreeListHeader* const src, ndInt32 count)
+	{
+		for (ndInt32 i = ndMin(count, src->m_count); i > 0; --i)
+		{
+			ndFreeListEntry* const self = src->m_headPointer;
+			src->m_headPointer = self->m_next;
+			src->m_count--;
+			self->m_next = dst->m_headPointer;
+			dst->m_headPointer = self;
+			dst->m_count++;
+		}
+	}
+
 	ndFreeListHeader* FindEntry(ndInt32 size)
 	{
 		ndInt32 i0 = 0;
@@ -181,9 +345,46 @@ class ndFreeListDictionary: public ndFixSizeArray<ndFreeListHeader, D_FREELIST_D
 		return &me[index];
 	}
 
+	ndFreeListAlloc::ndStats m_stats;
 	ndSpinLock m_lock;
 };
 
+thread_local bool ndFreeListCache::m_destroyed = false;
+
+ndFreeListCache::ndFreeListCache()
+	:m_count(0)
+	,m_hits(0)
+	,m_misses(0)
+{
+}
+
+ndFreeListCache::~ndFreeListCache()
+{
+	ndFreeListDictionary::GetHeader().Release(*this);
+	m_destroyed = true;
+}
+
+ndFreeListHeader* ndFreeListCache::Find(ndInt32 size)
+{
+	for (ndInt32 i = 0; i < m_count; ++i)
+	{
+		if (m_entries[i].m_schunkSize == size)
+		{
+			return &m_entries[i];
+		}
+	}
+	if (m_count < D_FREELIST_CACHE_SIZE)
+	{
+		ndFreeListHeader& entry = m_entries[m_count];
+		entry.m_count = 0;
+		entry.m_schunkSize = size;
+		entry.m_headPointer = nullptr;
+		m_count++;
+		return &entry;
+	}
+	return nullptr;
+}
+
 void ndFreeListAlloc::Flush()
 {
 	ndFreeListDictionary& dictionary = ndFreeListDictionary::GetHeader();
@@ -208,3 +409,15 @@ void ndFreeListAlloc::Flush(ndInt32 size)
 	dictionary.Flush(size);
 }
 
+
+void ndFreeListAlloc::GetStats(ndStats& stats)
+{
+	ndFreeListDictionary& dictionary = ndFreeListDictionary::GetHeader();
+	dictionary.GetStats(stats);
+}
+
+void ndFreeListAlloc::ResetStats()
+{
+	ndFreeListDictionary& dictionary = ndFreeListDictionary::GetHeader();
+	dictionary.ResetStats();
+}
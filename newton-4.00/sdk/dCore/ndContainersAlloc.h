@@ -44,9 +44,30 @@ class ndContainersAlloc: public ndClassAlloc
 class ndFreeListAlloc
 {
 	public:
+	// allocator counters, cache hits are allocations served by the 
+	// calling thread without taking the global lock.
+	class ndStats
+	{
+		public:
+		ndStats()
+			:m_cacheHits(0)
+			,m_cacheMisses(0)
+			,m_lockCount(0)
+			,m_lockContentions(0)
+		{
+		}
+
+		ndUnsigned64 m_cacheHits;
+		ndUnsigned64 m_cacheMisses;
+		ndUnsigned64 m_lockCount;
+		ndUnsigned64 m_lockContentions;
+	};
+
 	ndFreeListAlloc();
 	D_CORE_API static void Flush();
 	D_CORE_API static void Flush(ndInt32 size);
+	D_CORE_API static void GetStats(ndStats& stats);
+	D_CORE_API static void ResetStats();
 	D_CORE_API void *operator new (size_t size);
 	D_CORE_API void operator delete (void* ptr);
 };
@@ -130,6 +130,7 @@ ndConvexHull3dFace::ndConvexHull3dFace()
 	m_twin[0] = nullptr;
 	m_twin[1] = nullptr;
 	m_twin[2] = nullptr;
+	m_boundaryNode = nullptr;
 }
 
 ndFloat64 ndConvexHull3dFace::Evalue (const ndBigVector* const pointArray, const ndBigVector& point) const
@@ -149,14 +150,11 @@ ndFloat64 ndConvexHull3dFace::Evalue (const ndBigVector* const pointArray, const
 	ndFloat64 error;
 	ndFloat64 det = Determinant3x3 (matrix, &error);
 
-	// the code use double, however the threshold for accuracy test is the machine precision of a float.
-	// by changing this to a smaller number, the code should run faster since many small test will be considered valid
-	// the precision must be a power of two no smaller than the machine precision of a double, (1<<48)
-	// float64(1<<30) can be a good value
-
-	// ndFloat64 precision	= ndFloat64 (1.0f) / ndFloat64 (1<<30);
-	ndFloat64 precision	 = ndFloat64 (1.0f) / ndFloat64 (1<<24);
-	ndFloat64 errbound = error * precision;
+	// static filter for the sign of the determinant (Shewchuk's orient3d bound).
+	// the error is the permanent of the matrix, if the determinant is larger than 
+	// the bound the sign is exact, only near degenerate cases go to the googol path.
+	const ndFloat64 epsilon = ndFloat64(1.0f) / ndFloat64(1LL << 53);
+	const ndFloat64 errbound = (ndFloat64(7.0f) + ndFloat64(56.0f) * epsilon) * epsilon * error;
 	if (fabs(det) > errbound) 
 	{
 		return det;
@@ -933,10 +931,11 @@ void ndConvexHull3d::CalculateConvexHull3d (ndConvexHull3dAABBTreeNode* vertexTr
 
 	ndList<ndNode*> boundaryFaces;
 
-	boundaryFaces.Append(f0Node);
-	boundaryFaces.Append(f1Node);
-	boundaryFaces.Append(f2Node);
-	boundaryFaces.Append(f3Node);
+	// each face keeps its boundary node, so that removing it does not have to search the list
+	f0->m_boundaryNode = boundaryFaces.Append(f0Node);
+	f1->m_boundaryNode = boundaryFaces.Append(f1Node);
+	f2->m_boundaryNode = boundaryFaces.Append(f2Node);
+	f3->m_boundaryNode = boundaryFaces.Append(f3Node);
 	count -= 4;
 	maxVertexCount -= 4;
 	ndInt32 currentIndex = 4;
@@ -1049,9 +1048,8 @@ void ndConvexHull3d::CalculateConvexHull3d (ndConvexHull3dAABBTreeNode* vertexTr
 					{
 						ndInt32 j1 = (j0 == 2) ? 0 : j0 + 1;
 						ndNode* const newNode = AddFace (currentIndex, face1->m_index[j0], face1->m_index[j1]);
-						boundaryFaces.Addtop(newNode);
-
 						ndConvexHull3dFace* const newFace = &newNode->GetInfo();
+						newFace->m_boundaryNode = boundaryFaces.Addtop(newNode);
 						newFace->m_twin[1] = twinNode;
 						for (ndInt32 k = 0; k < 3; ++k) 
 						{
@@ -1102,7 +1100,11 @@ void ndConvexHull3d::CalculateConvexHull3d (ndConvexHull3dAABBTreeNode* vertexTr
 			for (ndInt32 i = 0; i < deletedCount; ++i) 
 			{
 				ndNode* const node = deleteList[i];
-				boundaryFaces.Remove (node);
+				ndConvexHull3dFace* const deletedFace = &node->GetInfo();
+				if (deletedFace->m_boundaryNode)
+				{
+					boundaryFaces.Remove (deletedFace->m_boundaryNode);
+				}
 				DeleteFace (node);
 			}
 
@@ -1112,7 +1114,8 @@ void ndConvexHull3d::CalculateConvexHull3d (ndConvexHull3dAABBTreeNode* vertexTr
 		} 
 		else 
 		{
-			boundaryFaces.Remove (faceNode);
+			boundaryFaces.Remove (face->m_boundaryNode);
+			face->m_boundaryNode = nullptr;
 		}
 	}
 	//m_count = currentIndex;
@@ -53,6 +53,7 @@ class ndConvexHull3dFace
 	private:
 	ndInt32 m_mark;
 	ndList<ndConvexHull3dFace>::ndNode* m_twin[3];
+	ndList<ndList<ndConvexHull3dFace>::ndNode*>::ndNode* m_boundaryNode;
 	friend class ndConvexHull3d;
 };
 
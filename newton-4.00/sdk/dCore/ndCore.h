@@ -42,6 +42,7 @@
 #include <ndString.h>
 #include <ndFastRay.h>
 #include <ndFastAabb.h>
+#include <ndFrameArena.h>
 #include <ndProfiler.h>
 #include <ndPolyhedra.h>
 #include <ndSyncMutex.h>
@@ -0,0 +1,108 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "ndCoreStdafx.h"
+#include "ndUtils.h"
+#include "ndMemory.h"
+#include "ndFrameArena.h"
+
+#define D_FRAME_ARENA_MIN_SIZE	(1024 * 16)
+
+class ndFrameArena::ndOverflow
+{
+	public:
+	ndOverflow* m_next;
+	ndInt64 m_padding[D_MEMORY_ALIGMNET / sizeof(ndInt64) - 1];
+};
+
+ndFrameArena::ndFrameArena()
+	:ndClassAlloc()
+	,m_buffer(nullptr)
+	,m_overflow(nullptr)
+	,m_used(0)
+	,m_usage(0)
+	,m_capacity(0)
+	,m_peakUsage(0)
+	,m_heapCalls(0)
+{
+}
+
+ndFrameArena::~ndFrameArena()
+{
+	CleanUp();
+}
+
+void ndFrameArena::CleanUp()
+{
+	Reset();
+	if (m_buffer)
+	{
+		ndMemory::Free(m_buffer);
+	}
+	m_buffer = nullptr;
+	m_capacity = 0;
+}
+
+void ndFrameArena::Reset()
+{
+	if (m_overflow)
+	{
+		ndOverflow* next;
+		for (ndOverflow* chunk = m_overflow; chunk; chunk = next)
+		{
+			next = chunk->m_next;
+			ndMemory::Free(chunk);
+		}
+		m_overflow = nullptr;
+
+		// grow to the peak with some slack, for next step
+		if (m_buffer)
+		{
+			ndMemory::Free(m_buffer);
+		}
+		m_capacity = ndMax(m_peakUsage + m_peakUsage / 4, size_t(D_FRAME_ARENA_MIN_SIZE));
+		m_capacity = (m_capacity + D_MEMORY_ALIGMNET - 1) & ~size_t(D_MEMORY_ALIGMNET - 1);
+		m_buffer = (ndUnsigned8*)ndMemory::Malloc(m_capacity);
+		m_heapCalls++;
+	}
+	m_used = 0;
+	m_usage = 0;
+}
+
+void* ndFrameArena::Alloc(size_t sizeInBytes)
+{
+	const size_t size = (ndMax(sizeInBytes, size_t(1)) + D_MEMORY_ALIGMNET - 1) & ~size_t(D_MEMORY_ALIGMNET - 1);
+	m_usage += size;
+	m_peakUsage = ndMax(m_peakUsage, m_usage);
+	if ((m_used + size) <= m_capacity)
+	{
+		void* const ptr = &m_buffer[m_used];
+		m_used += size;
+		return ptr;
+	}
+
+	// spill to the heap until the next reset
+	ndOverflow* const chunk = (ndOverflow*)ndMemory::Malloc(size + sizeof(ndOverflow));
+	chunk->m_next = m_overflow;
+	m_overflow = chunk;
+	m_heapCalls++;
+	return &chunk[1];
+}
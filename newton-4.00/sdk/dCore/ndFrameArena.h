@@ -0,0 +1,94 @@
+/* Copyright (c) <2003-2022> <Julio Jerez, Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely, subject to the following restrictions:
+*
+* 1. The origin of this software must not be misrepresented; you must not
+* claim that you wrote the original software. If you use this software
+* in a product, an acknowledgment in the product documentation would be
+* appreciated but is not required.
+*
+* 2. Altered source versions must be plainly marked as such, and must not be
+* misrepresented as being the original software.
+*
+* 3. This notice may not be removed or altered from any source distribution.
+*/
+
+#ifndef __ND_FRAME_ARENA_H__
+#define __ND_FRAME_ARENA_H__
+
+#include "ndCoreStdafx.h"
+#include "ndTypes.h"
+#include "ndClassAlloc.h"
+
+// a bump allocator for buffers that only live for one step.
+// all allocations are released at once by Reset. when a step needs more 
+// than the arena capacity the excess comes from the heap, and the next 
+// Reset grows the arena to the peak, so steady steps never call the heap.
+class ndFrameArena: public ndClassAlloc
+{
+	public:
+	D_CORE_API ndFrameArena();
+	D_CORE_API ~ndFrameArena();
+
+	// release all allocations made since the last reset
+	D_CORE_API void Reset();
+
+	// release all memory
+	D_CORE_API void CleanUp();
+
+	// returns D_MEMORY_ALIGMNET aligned memory, valid until the next reset
+	D_CORE_API void* Alloc(size_t sizeInBytes);
+
+	template<class T>
+	T* Alloc(ndInt32 count);
+
+	size_t GetUsage() const;
+	size_t GetCapacity() const;
+	size_t GetPeakUsage() const;
+	ndUnsigned64 GetHeapCallCount() const;
+
+	private:
+	class ndOverflow;
+
+	ndUnsigned8* m_buffer;
+	ndOverflow* m_overflow;
+	size_t m_used;
+	size_t m_usage;
+	size_t m_capacity;
+	size_t m_peakUsage;
+	ndUnsigned64 m_heapCalls;
+};
+
+template<class T>
+inline T* ndFrameArena::Alloc(ndInt32 count)
+{
+	return (T*)Alloc(size_t(count) * sizeof(T));
+}
+
+inline size_t ndFrameArena::GetUsage() const
+{
+	return m_usage;
+}
+
+inline size_t ndFrameArena::GetCapacity() const
+{
+	return m_capacity;
+}
+
+inline size_t ndFrameArena::GetPeakUsage() const
+{
+	return m_peakUsage;
+}
+
+inline ndUnsigned64 ndFrameArena::GetHeapCallCount() const
+{
+	return m_heapCalls;
+}
+
+#endif
@@ -25,8 +25,15 @@
 #include "ndVector.h"
 #include "ndMatrix.h"
 #include "ndProfiler.h"
+#include "ndThreadPool.h"
 #include "ndIsoSurface.h"
 
+#define D_ISO_BLOCK_BITS	3
+#define D_ISO_BLOCK_SIZE	(1 << D_ISO_BLOCK_BITS)
+#define D_ISO_BLOCK_MASK	(D_ISO_BLOCK_SIZE - 1)
+#define D_ISO_BLOCK_KEY_BITS	21
+#define D_ISO_BLOCK_EDGE_COUNT	(D_ISO_BLOCK_SIZE * D_ISO_BLOCK_SIZE * D_ISO_BLOCK_SIZE * 3)
+
 // adapted from code by written by Paul Bourke may 1994
 //http://paulbourke.net/geometry/polygonise/
 
@@ -59,7 +66,89 @@ class ndIsoSurface::ndImplementation : public ndClassAlloc
 		ndInt32* const indexList, ndInt32 strideInFloats, 
 		ndReal* const posit, ndReal* const normals);
 
+	void ClearBlocks();
+	void BuildIncrementalMesh(ndThreadPool& threadPool, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize);
+	void GetBlockMesh(ndThreadPool& threadPool, ndInt32* const indexList, ndInt32 strideInFloats, ndReal* const posit, ndReal* const normals) const;
+
 	private:
+	// point voxel, the block is relative to the aabb of the point cloud
+	class ndIsoPointKey
+	{
+		public:
+		ndUnsigned64 m_block;
+		ndUnsigned32 m_voxel;
+	};
+
+	// vertex on an edge owned by an upper neighbor block, with the 
+	// normal of the triangles of this block that use it
+	class ndIsoSharedVertex
+	{
+		public:
+		ndVector m_point;
+		ndVector m_normal;
+		ndInt32 m_neighbor;
+		ndInt32 m_edge;
+	};
+
+	// one bit per voxel of a block, a word per z layer
+	class ndIsoBlockOccupancy
+	{
+		public:
+		ndUnsigned64 m_key;
+		ndUnsigned64 m_bits[D_ISO_BLOCK_SIZE];
+	};
+
+	// persistent block, it owns the mesh of the cells whose lower corner is inside the block,
+	// and the vertices of the edges whose lower end is inside the block. triangles that use 
+	// a vertex of an upper neighbor refer to it by a negative index into m_shared.
+	class ndIsoBlock : public ndClassAlloc
+	{
+		public:
+		ndIsoBlock(ndInt32 x, ndInt32 y, ndInt32 z)
+			:ndClassAlloc()
+			,m_points(256)
+			,m_normals(256)
+			,m_indices(256)
+			,m_shared(64)
+			,m_x(x)
+			,m_y(y)
+			,m_z(z)
+			,m_frame(0)
+			,m_indexOffset(0)
+			,m_vertexOffset(0)
+			,m_dirty(false)
+		{
+			memset(m_bits, 0, sizeof(m_bits));
+			memset(m_edgeVertex, -1, sizeof(m_edgeVertex));
+		}
+
+		ndArray<ndVector> m_points;
+		ndArray<ndVector> m_normals;
+		ndArray<ndInt32> m_indices;
+		ndArray<ndIsoSharedVertex> m_shared;
+		ndUnsigned64 m_bits[D_ISO_BLOCK_SIZE];
+		ndInt16 m_edgeVertex[D_ISO_BLOCK_EDGE_COUNT];
+		ndInt32 m_x;
+		ndInt32 m_y;
+		ndInt32 m_z;
+		ndUnsigned32 m_frame;
+		ndInt32 m_indexOffset;
+		ndInt32 m_vertexOffset;
+		bool m_dirty;
+	};
+
+	class ndIsoBlockMap : public ndTree<ndIsoBlock*, ndUnsigned64, ndContainersFreeListAlloc<ndIsoBlock*>>
+	{
+	};
+
+	static ndUnsigned64 BlockKey(ndInt32 x, ndInt32 y, ndInt32 z);
+	ndIsoBlock* FindCreateBlock(ndInt32 x, ndInt32 y, ndInt32 z);
+	void CalculateBlockKeys(ndThreadPool& threadPool, const ndArray<ndVector>& points);
+	void UpdateBlockOccupancy();
+	void RemeshBlock(ndIsoBlock* const block) const;
+	void RemeshDirtyBlocks(ndThreadPool& threadPool);
+	void CalculateBlockOffsets();
+
 	class ndGridHash
 	{
 		public:
@@ -192,6 +281,24 @@ class ndIsoSurface::ndImplementation : public ndClassAlloc
 	ndInt32 m_volumeSizeY;
 	ndInt32 m_volumeSizeZ;
 	ndUpperDigit m_upperDigitsIsValid;
+
+	ndIsoBlockMap m_blocks;
+	ndArray<ndIsoPointKey> m_pointKeys;
+	ndArray<ndIsoPointKey> m_pointKeysScratchBuffer;
+	ndArray<ndIsoBlockOccupancy> m_occupiedBlocks;
+	ndArray<ndIsoBlock*> m_changedBlocks;
+	ndArray<ndIsoBlock*> m_dirtyBlocks;
+	ndArray<ndIsoBlock*> m_meshBlocks;
+	ndFloat32 m_blockGridSize;
+	ndInt32 m_blockOriginX;
+	ndInt32 m_blockOriginY;
+	ndInt32 m_blockOriginZ;
+	ndInt32 m_blockBitsX;
+	ndInt32 m_blockBitsY;
+	ndInt32 m_indexCount;
+	ndInt32 m_vertexCount;
+	ndInt32 m_remeshedBlockCount;
+	ndUnsigned32 m_blockFrame;
 	
 	static ndEdge m_edges[];
 	static ndInt32 m_faces[][3];
@@ -2598,11 +2705,29 @@ inline ndIsoSurface::ndImplementation::ndImplementation()
 	,m_volumeSizeY(1)
 	,m_volumeSizeZ(1)
 	,m_upperDigitsIsValid()
+	,m_blocks()
+	,m_pointKeys(256)
+	,m_pointKeysScratchBuffer(256)
+	,m_occupiedBlocks(256)
+	,m_changedBlocks(256)
+	,m_dirtyBlocks(256)
+	,m_meshBlocks(256)
+	,m_blockGridSize(ndFloat32(0.0f))
+	,m_blockOriginX(0)
+	,m_blockOriginY(0)
+	,m_blockOriginZ(0)
+	,m_blockBitsX(0)
+	,m_blockBitsY(0)
+	,m_indexCount(0)
+	,m_vertexCount(0)
+	,m_remeshedBlockCount(0)
+	,m_blockFrame(0)
 {
 }
 
 ndIsoSurface::ndImplementation::~ndImplementation()
 {
+	ClearBlocks();
 }
 
 ndVector ndIsoSurface::ndImplementation::GetOrigin() const
@@ -3381,6 +3506,554 @@ void ndIsoSurface::ndImplementation::BuildLowResolutionMesh(ndIsoSurface* const
 	ClearBuffers();
 }
 
+ndUnsigned64 ndIsoSurface::ndImplementation::BlockKey(ndInt32 x, ndInt32 y, ndInt32 z)
+{
+	const ndUnsigned64 bias = ndUnsigned64(1) << (D_ISO_BLOCK_KEY_BITS - 1);
+	const ndUnsigned64 mask = (ndUnsigned64(1) << D_ISO_BLOCK_KEY_BITS) - 1;
+	const ndUnsigned64 x0 = (ndUnsigned64(ndInt64(x)) + bias) & mask;
+	const ndUnsigned64 y0 = (ndUnsigned64(ndInt64(y)) + bias) & mask;
+	const ndUnsigned64 z0 = (ndUnsigned64(ndInt64(z)) + bias) & mask;
+	return (z0 << (2 * D_ISO_BLOCK_KEY_BITS)) | (y0 << D_ISO_BLOCK_KEY_BITS) | x0;
+}
+
+ndIsoSurface::ndImplementation::ndIsoBlock* ndIsoSurface::ndImplementation::FindCreateBlock(ndInt32 x, ndInt32 y, ndInt32 z)
+{
+	bool wasFound = false;
+	ndIsoBlockMap::ndNode* const node = m_blocks.FindCreate(BlockKey(x, y, z), wasFound);
+	if (!wasFound)
+	{
+		node->GetInfo() = new ndIsoBlock(x, y, z);
+	}
+	return node->GetInfo();
+}
+
+void ndIsoSurface::ndImplementation::ClearBlocks()
+{
+	ndIsoBlockMap::Iterator it(m_blocks);
+	for (it.Begin(); it; it++)
+	{
+		delete *it;
+	}
+	m_blocks.RemoveAll();
+	m_changedBlocks.SetCount(0);
+	m_dirtyBlocks.SetCount(0);
+	m_meshBlocks.SetCount(0);
+	m_indexCount = 0;
+	m_vertexCount = 0;
+}
+
+void ndIsoSurface::ndImplementation::CalculateBlockKeys(ndThreadPool& threadPool, const ndArray<ndVector>& points)
+{
+	D_TRACKTIME();
+	class ndKey_block
+	{
+		public:
+		ndKey_block(void* const context)
+			:m_shift(*((ndInt32*)context))
+		{
+		}
+
+		ndInt32 GetKey(const ndIsoPointKey& point) const
+		{
+			return ndInt32((point.m_block >> m_shift) & 0xff);
+		}
+
+		ndInt32 m_shift;
+	};
+
+	ndVector boxP0[D_MAX_THREADS_COUNT];
+	ndVector boxP1[D_MAX_THREADS_COUNT];
+	auto CalculateAabb = ndMakeObject::ndFunction([this, &points, &boxP0, &boxP1](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateAabb);
+		ndVector p0(ndFloat32(1.0e10f));
+		ndVector p1(ndFloat32(-1.0e10f));
+		const ndStartEnd startEnd(ndInt32(points.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			p0 = p0.GetMin(points[i]);
+			p1 = p1.GetMax(points[i]);
+		}
+		boxP0[threadIndex] = p0;
+		boxP1[threadIndex] = p1;
+	});
+	threadPool.ParallelExecute(CalculateAabb);
+
+	ndVector p0(boxP0[0]);
+	ndVector p1(boxP1[0]);
+	for (ndInt32 i = 1; i < threadPool.GetThreadCount(); ++i)
+	{
+		p0 = p0.GetMin(boxP0[i]);
+		p1 = p1.GetMax(boxP1[i]);
+	}
+
+	const ndVector voxel0((p0 * m_invGridSize).Floor().GetInt());
+	const ndVector voxel1((p1 * m_invGridSize).Floor().GetInt());
+	m_blockOriginX = ndInt32(voxel0.m_ix) >> D_ISO_BLOCK_BITS;
+	m_blockOriginY = ndInt32(voxel0.m_iy) >> D_ISO_BLOCK_BITS;
+	m_blockOriginZ = ndInt32(voxel0.m_iz) >> D_ISO_BLOCK_BITS;
+
+	// relative block coordinates are packed with as many bits as the extent of the cloud needs
+	const ndInt32 extent[3] = 
+	{
+		(ndInt32(voxel1.m_ix) >> D_ISO_BLOCK_BITS) - m_blockOriginX,
+		(ndInt32(voxel1.m_iy) >> D_ISO_BLOCK_BITS) - m_blockOriginY,
+		(ndInt32(voxel1.m_iz) >> D_ISO_BLOCK_BITS) - m_blockOriginZ,
+	};
+	ndInt32 bits[3];
+	for (ndInt32 i = 0; i < 3; ++i)
+	{
+		bits[i] = 1;
+		while ((bits[i] < 31) && ((1 << bits[i]) <= extent[i]))
+		{
+			bits[i]++;
+		}
+	}
+	if ((bits[0] > D_ISO_BLOCK_KEY_BITS) || (bits[1] > D_ISO_BLOCK_KEY_BITS) || (bits[2] > D_ISO_BLOCK_KEY_BITS))
+	{
+		// the persistent block keys can not tell apart blocks this far apart
+		ndTrace(("iso surface point cloud spans more than %d blocks, the mesh is empty\n", 1 << D_ISO_BLOCK_KEY_BITS));
+		ndAssert(0);
+		m_pointKeys.SetCount(0);
+		m_occupiedBlocks.SetCount(0);
+		return;
+	}
+	m_blockBitsX = bits[0];
+	m_blockBitsY = bits[1];
+	const ndInt32 shiftY = m_blockBitsX;
+	const ndInt32 shiftZ = m_blockBitsX + m_blockBitsY;
+
+	m_pointKeys.SetCount(points.GetCount());
+	auto CalculateKeys = ndMakeObject::ndFunction([this, &points, shiftY, shiftZ](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(CalculateKeys);
+		const ndVector invGridSize(m_invGridSize);
+		const ndStartEnd startEnd(ndInt32(points.GetCount()), threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndVector voxel((points[i] * invGridSize).Floor().GetInt());
+			const ndInt32 x = ndInt32(voxel.m_ix);
+			const ndInt32 y = ndInt32(voxel.m_iy);
+			const ndInt32 z = ndInt32(voxel.m_iz);
+			const ndUnsigned64 bx = ndUnsigned64((x >> D_ISO_BLOCK_BITS) - m_blockOriginX);
+			const ndUnsigned64 by = ndUnsigned64((y >> D_ISO_BLOCK_BITS) - m_blockOriginY);
+			const ndUnsigned64 bz = ndUnsigned64((z >> D_ISO_BLOCK_BITS) - m_blockOriginZ);
+
+			ndIsoPointKey& key = m_pointKeys[i];
+			key.m_block = (bz << shiftZ) | (by << shiftY) | bx;
+			key.m_voxel = ndUnsigned32(((z & D_ISO_BLOCK_MASK) << (2 * D_ISO_BLOCK_BITS)) | ((y & D_ISO_BLOCK_MASK) << D_ISO_BLOCK_BITS) | (x & D_ISO_BLOCK_MASK));
+		}
+	});
+	threadPool.ParallelExecute(CalculateKeys);
+
+	const ndInt32 keyBits = bits[0] + bits[1] + bits[2];
+	for (ndInt32 shift = 0; shift < keyBits; shift += 8)
+	{
+		ndCountingSort<ndIsoPointKey, ndKey_block, 8>(threadPool, m_pointKeys, m_pointKeysScratchBuffer, nullptr, &shift);
+	}
+
+	// one occupancy entry per block run
+	m_occupiedBlocks.SetCount(0);
+	const ndInt32 count = ndInt32(m_pointKeys.GetCount());
+	for (ndInt32 i = 0; i < count;)
+	{
+		const ndUnsigned64 block = m_pointKeys[i].m_block;
+		ndIsoBlockOccupancy occupancy;
+		memset(occupancy.m_bits, 0, sizeof(occupancy.m_bits));
+		occupancy.m_key = block;
+		for (; (i < count) && (m_pointKeys[i].m_block == block); ++i)
+		{
+			const ndUnsigned32 voxel = m_pointKeys[i].m_voxel;
+			occupancy.m_bits[voxel >> (2 * D_ISO_BLOCK_BITS)] |= ndUnsigned64(1) << (voxel & ((1 << (2 * D_ISO_BLOCK_BITS)) - 1));
+		}
+		m_occupiedBlocks.PushBack(occupancy);
+	}
+}
+
+void ndIsoSurface::ndImplementation::UpdateBlockOccupancy()
+{
+	D_TRACKTIME();
+	m_blockFrame++;
+	m_changedBlocks.SetCount(0);
+	for (ndInt32 i = 0; i < ndInt32(m_occupiedBlocks.GetCount()); ++i)
+	{
+		const ndIsoBlockOccupancy& occupancy = m_occupiedBlocks[i];
+		const ndUnsigned64 maskX = (ndUnsigned64(1) << m_blockBitsX) - 1;
+		const ndUnsigned64 maskY = (ndUnsigned64(1) << m_blockBitsY) - 1;
+		const ndInt32 x = m_blockOriginX + ndInt32(occupancy.m_key & maskX);
+		const ndInt32 y = m_blockOriginY + ndInt32((occupancy.m_key >> m_blockBitsX) & maskY);
+		const ndInt32 z = m_blockOriginZ + ndInt32(occupancy.m_key >> (m_blockBitsX + m_blockBitsY));
+		ndIsoBlock* const block = FindCreateBlock(x, y, z);
+		block->m_frame = m_blockFrame;
+		if (memcmp(block->m_bits, occupancy.m_bits, sizeof(occupancy.m_bits)))
+		{
+			memcpy(block->m_bits, occupancy.m_bits, sizeof(occupancy.m_bits));
+			m_changedBlocks.PushBack(block);
+		}
+	}
+
+	// blocks that lost all their points
+	ndIsoBlockMap::Iterator it(m_blocks);
+	for (it.Begin(); it; it++)
+	{
+		ndIsoBlock* const block = *it;
+		if (block->m_frame != m_blockFrame)
+		{
+			block->m_frame = m_blockFrame;
+			const ndUnsigned64 zero[D_ISO_BLOCK_SIZE] = {};
+			if (memcmp(block->m_bits, zero, sizeof(zero)))
+			{
+				memset(block->m_bits, 0, sizeof(block->m_bits));
+				m_changedBlocks.PushBack(block);
+			}
+		}
+	}
+
+	// a voxel is the upper corner of cells in the lower neighbor blocks
+	m_dirtyBlocks.SetCount(0);
+	for (ndInt32 i = 0; i < ndInt32(m_changedBlocks.GetCount()); ++i)
+	{
+		const ndIsoBlock* const changedBlock = m_changedBlocks[i];
+		for (ndInt32 j = 0; j < 8; ++j)
+		{
+			const ndInt32 x = changedBlock->m_x - (j & 1);
+			const ndInt32 y = changedBlock->m_y - ((j >> 1) & 1);
+			const ndInt32 z = changedBlock->m_z - (j >> 2);
+			ndIsoBlock* const block = FindCreateBlock(x, y, z);
+			if (!block->m_dirty)
+			{
+				block->m_dirty = true;
+				m_dirtyBlocks.PushBack(block);
+			}
+		}
+	}
+	m_remeshedBlockCount = ndInt32(m_dirtyBlocks.GetCount());
+}
+
+void ndIsoSurface::ndImplementation::RemeshBlock(ndIsoBlock* const block) const
+{
+	#define D_ISO_BLOCK_STRIDE (D_ISO_BLOCK_SIZE + 1)
+
+	// the block voxels plus the first layer of the upper neighbors
+	const ndIsoBlock* neighbors[8];
+	for (ndInt32 i = 0; i < 8; ++i)
+	{
+		const ndIsoBlockMap::ndNode* const node = m_blocks.Find(BlockKey(block->m_x + (i & 1), block->m_y + ((i >> 1) & 1), block->m_z + (i >> 2)));
+		neighbors[i] = node ? node->GetInfo() : nullptr;
+	}
+
+	ndUnsigned8 voxels[D_ISO_BLOCK_STRIDE * D_ISO_BLOCK_STRIDE * D_ISO_BLOCK_STRIDE];
+	for (ndInt32 z = 0; z < D_ISO_BLOCK_STRIDE; ++z)
+	{
+		for (ndInt32 y = 0; y < D_ISO_BLOCK_STRIDE; ++y)
+		{
+			for (ndInt32 x = 0; x < D_ISO_BLOCK_STRIDE; ++x)
+			{
+				const ndIsoBlock* const neighbor = neighbors[((z >> D_ISO_BLOCK_BITS) << 2) | ((y >> D_ISO_BLOCK_BITS) << 1) | (x >> D_ISO_BLOCK_BITS)];
+				const ndInt32 bit = ((y & D_ISO_BLOCK_MASK) << D_ISO_BLOCK_BITS) | (x & D_ISO_BLOCK_MASK);
+				voxels[(z * D_ISO_BLOCK_STRIDE + y) * D_ISO_BLOCK_STRIDE + x] = neighbor ? ndUnsigned8((neighbor->m_bits[z & D_ISO_BLOCK_MASK] >> bit) & 1) : 0;
+			}
+		}
+	}
+
+	ndInt32 cornerX[8];
+	ndInt32 cornerY[8];
+	ndInt32 cornerZ[8];
+	ndInt32 cornerOffset[8];
+	for (ndInt32 i = 0; i < 8; ++i)
+	{
+		cornerX[i] = ndInt32(m_gridCorners[i].m_x) + 1;
+		cornerY[i] = ndInt32(m_gridCorners[i].m_y) + 1;
+		cornerZ[i] = ndInt32(m_gridCorners[i].m_z) + 1;
+		cornerOffset[i] = (cornerZ[i] * D_ISO_BLOCK_STRIDE + cornerY[i]) * D_ISO_BLOCK_STRIDE + cornerX[i];
+	}
+
+	// edges are welded across blocks, an edge belongs to the block of its lower end.
+	// the map holds the index of each edge vertex, negative for the shared vertices.
+	const ndInt32 noVertex = 0x7fffffff;
+	ndInt32 edgeVertex[D_ISO_BLOCK_STRIDE * D_ISO_BLOCK_STRIDE * D_ISO_BLOCK_STRIDE * 3];
+	for (ndInt32 i = 0; i < ndInt32(sizeof(edgeVertex) / sizeof(edgeVertex[0])); ++i)
+	{
+		edgeVertex[i] = noVertex;
+	}
+	memset(block->m_edgeVertex, -1, sizeof(block->m_edgeVertex));
+
+	block->m_points.SetCount(0);
+	block->m_normals.SetCount(0);
+	block->m_indices.SetCount(0);
+	block->m_shared.SetCount(0);
+
+	const ndVector gridSize(m_gridSize);
+	const ndInt32 baseX = block->m_x << D_ISO_BLOCK_BITS;
+	const ndInt32 baseY = block->m_y << D_ISO_BLOCK_BITS;
+	const ndInt32 baseZ = block->m_z << D_ISO_BLOCK_BITS;
+	for (ndInt32 z = 0; z < D_ISO_BLOCK_SIZE; ++z)
+	{
+		for (ndInt32 y = 0; y < D_ISO_BLOCK_SIZE; ++y)
+		{
+			for (ndInt32 x = 0; x < D_ISO_BLOCK_SIZE; ++x)
+			{
+				const ndInt32 cell = (z * D_ISO_BLOCK_STRIDE + y) * D_ISO_BLOCK_STRIDE + x;
+				ndInt32 tableIndex = 0;
+				for (ndInt32 i = 0; i < 8; ++i)
+				{
+					tableIndex |= voxels[cell + cornerOffset[i]] << i;
+				}
+				if ((tableIndex == 0) || (tableIndex == 255))
+				{
+					continue;
+				}
+
+				ndInt32 vertlist[12];
+				const ndInt32 start = m_edgeScan[tableIndex];
+				const ndInt32 edgeCount = m_edgeScan[tableIndex + 1] - start;
+				for (ndInt32 i = 0; i < edgeCount; ++i)
+				{
+					const ndEdge& edge = m_edges[start + i];
+					const ndInt32 v0 = cell + cornerOffset[edge.m_p0];
+					const ndInt32 v1 = cell + cornerOffset[edge.m_p1];
+					const ndInt32 step = ndAbs(v1 - v0);
+					const ndInt32 axis = (step == 1) ? 0 : ((step == D_ISO_BLOCK_STRIDE) ? 1 : 2);
+					const ndInt32 lowerEnd = ndMin(v0, v1);
+					const ndInt32 edgeKey = lowerEnd * 3 + axis;
+					if (edgeVertex[edgeKey] == noVertex)
+					{
+						const ndVector p(
+							ndFloat32(baseX + x) + ndFloat32(cornerX[edge.m_p0] + cornerX[edge.m_p1]) * ndFloat32(0.5f),
+							ndFloat32(baseY + y) + ndFloat32(cornerY[edge.m_p0] + cornerY[edge.m_p1]) * ndFloat32(0.5f),
+							ndFloat32(baseZ + z) + ndFloat32(cornerZ[edge.m_p0] + cornerZ[edge.m_p1]) * ndFloat32(0.5f),
+							ndFloat32(0.0f));
+
+						const ndInt32 ex = lowerEnd % D_ISO_BLOCK_STRIDE;
+						const ndInt32 ey = (lowerEnd / D_ISO_BLOCK_STRIDE) % D_ISO_BLOCK_STRIDE;
+						const ndInt32 ez = lowerEnd / (D_ISO_BLOCK_STRIDE * D_ISO_BLOCK_STRIDE);
+						const ndInt32 neighbor = ((ez >> D_ISO_BLOCK_BITS) << 2) | ((ey >> D_ISO_BLOCK_BITS) << 1) | (ex >> D_ISO_BLOCK_BITS);
+						const ndInt32 ownerEdge = ((((ez & D_ISO_BLOCK_MASK) << D_ISO_BLOCK_BITS) | (ey & D_ISO_BLOCK_MASK)) << D_ISO_BLOCK_BITS | (ex & D_ISO_BLOCK_MASK)) * 3 + axis;
+						if (neighbor == 0)
+						{
+							edgeVertex[edgeKey] = ndInt32(block->m_points.GetCount());
+							block->m_edgeVertex[ownerEdge] = ndInt16(block->m_points.GetCount());
+							block->m_points.PushBack(p * gridSize);
+							block->m_normals.PushBack(ndVector::m_zero);
+						}
+						else
+						{
+							ndIsoSharedVertex shared;
+							shared.m_point = p * gridSize;
+							shared.m_normal = ndVector::m_zero;
+							shared.m_neighbor = neighbor;
+							shared.m_edge = ownerEdge;
+							edgeVertex[edgeKey] = -1 - ndInt32(block->m_shared.GetCount());
+							block->m_shared.PushBack(shared);
+						}
+					}
+					vertlist[edge.m_midPoint] = edgeVertex[edgeKey];
+				}
+
+				const ndInt32 faceStart = m_facesScan[tableIndex];
+				const ndInt32 faceCount = m_facesScan[tableIndex + 1] - faceStart;
+				for (ndInt32 i = 0; i < faceCount; ++i)
+				{
+					block->m_indices.PushBack(vertlist[m_faces[faceStart + i][0]]);
+					block->m_indices.PushBack(vertlist[m_faces[faceStart + i][1]]);
+					block->m_indices.PushBack(vertlist[m_faces[faceStart + i][2]]);
+				}
+			}
+		}
+	}
+
+	// the normals are partial sums, the faces of the lower neighbors are added when the mesh is read
+	ndArray<ndVector>& normals = block->m_normals;
+	ndArray<ndIsoSharedVertex>& shared = block->m_shared;
+	const ndArray<ndVector>& points = block->m_points;
+	const ndArray<ndInt32>& indices = block->m_indices;
+	for (ndInt32 i = 0; i < ndInt32(indices.GetCount()); i += 3)
+	{
+		ndInt32 index[3];
+		ndVector p[3];
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			index[j] = indices[i + j];
+			p[j] = (index[j] >= 0) ? points[index[j]] : shared[-1 - index[j]].m_point;
+		}
+		const ndVector normal((p[1] - p[0]).CrossProduct(p[2] - p[0]));
+		for (ndInt32 j = 0; j < 3; ++j)
+		{
+			ndVector& n = (index[j] >= 0) ? normals[index[j]] : shared[-1 - index[j]].m_normal;
+			n += normal;
+		}
+	}
+}
+
+void ndIsoSurface::ndImplementation::RemeshDirtyBlocks(ndThreadPool& threadPool)
+{
+	D_TRACKTIME();
+	ndAtomic<ndInt32> iterator(0);
+	auto RemeshBlocks = ndMakeObject::ndFunction([this, &iterator](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(RemeshBlocks);
+		const ndInt32 count = ndInt32(m_dirtyBlocks.GetCount());
+		for (ndInt32 i = iterator++; i < count; i = iterator++)
+		{
+			ndIsoBlock* const block = m_dirtyBlocks[i];
+			RemeshBlock(block);
+			block->m_dirty = false;
+		}
+	});
+	threadPool.ParallelExecute(RemeshBlocks);
+
+	// empty blocks with no triangles are not needed any longer
+	const ndUnsigned64 zero[D_ISO_BLOCK_SIZE] = {};
+	for (ndInt32 i = 0; i < ndInt32(m_dirtyBlocks.GetCount()); ++i)
+	{
+		ndIsoBlock* const block = m_dirtyBlocks[i];
+		if (!block->m_indices.GetCount() && !memcmp(block->m_bits, zero, sizeof(zero)))
+		{
+			m_blocks.Remove(BlockKey(block->m_x, block->m_y, block->m_z));
+			delete block;
+		}
+	}
+	m_dirtyBlocks.SetCount(0);
+}
+
+void ndIsoSurface::ndImplementation::CalculateBlockOffsets()
+{
+	D_TRACKTIME();
+	m_indexCount = 0;
+	m_vertexCount = 0;
+	m_meshBlocks.SetCount(0);
+	ndIsoBlockMap::Iterator it(m_blocks);
+	for (it.Begin(); it; it++)
+	{
+		ndIsoBlock* const block = *it;
+		if (block->m_indices.GetCount())
+		{
+			block->m_indexOffset = m_indexCount;
+			block->m_vertexOffset = m_vertexCount;
+			m_indexCount += ndInt32(block->m_indices.GetCount());
+			m_vertexCount += ndInt32(block->m_points.GetCount());
+			m_meshBlocks.PushBack(block);
+		}
+	}
+}
+
+void ndIsoSurface::ndImplementation::BuildIncrementalMesh(ndThreadPool& threadPool, const ndArray<ndVector>& points, ndFloat32 gridSize)
+{
+	D_TRACKTIME();
+	if (gridSize != m_blockGridSize)
+	{
+		ClearBlocks();
+		m_blockGridSize = gridSize;
+	}
+	m_isoValue = ndFloat32(0.5f);
+	m_gridSize = ndVector::m_triplexMask & ndVector(gridSize);
+	m_invGridSize = ndVector::m_triplexMask & ndVector(ndFloat32(1.0f) / gridSize);
+
+	m_occupiedBlocks.SetCount(0);
+	if (points.GetCount())
+	{
+		CalculateBlockKeys(threadPool, points);
+	}
+	UpdateBlockOccupancy();
+	RemeshDirtyBlocks(threadPool);
+	CalculateBlockOffsets();
+}
+
+void ndIsoSurface::ndImplementation::GetBlockMesh(ndThreadPool& threadPool, ndInt32* const indexList, ndInt32 strideInFloats, ndReal* const posit, ndReal* const normals) const
+{
+	D_TRACKTIME();
+	ndAtomic<ndInt32> iterator(0);
+	auto CopyBlocks = ndMakeObject::ndFunction([this, &iterator, indexList, strideInFloats, posit, normals](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(CopyBlocks);
+		const ndInt32 count = ndInt32(m_meshBlocks.GetCount());
+		for (ndInt32 i = iterator++; i < count; i = iterator++)
+		{
+			const ndIsoBlock* const block = m_meshBlocks[i];
+
+			// upper neighbors own the shared vertices of this block, 
+			// lower neighbors add their faces to the normals of this block.
+			const ndIsoBlock* upperNeighbors[8];
+			const ndIsoBlock* lowerNeighbors[8];
+			upperNeighbors[0] = block;
+			lowerNeighbors[0] = nullptr;
+			for (ndInt32 j = 1; j < 8; ++j)
+			{
+				const ndInt32 dx = j & 1;
+				const ndInt32 dy = (j >> 1) & 1;
+				const ndInt32 dz = j >> 2;
+				const ndIsoBlockMap::ndNode* const upperNode = m_blocks.Find(BlockKey(block->m_x + dx, block->m_y + dy, block->m_z + dz));
+				const ndIsoBlockMap::ndNode* const lowerNode = m_blocks.Find(BlockKey(block->m_x - dx, block->m_y - dy, block->m_z - dz));
+				upperNeighbors[j] = upperNode ? upperNode->GetInfo() : nullptr;
+				lowerNeighbors[j] = lowerNode ? lowerNode->GetInfo() : nullptr;
+			}
+
+			const ndInt32 vertexOffset = block->m_vertexOffset;
+			for (ndInt32 j = 0; j < ndInt32(block->m_points.GetCount()); ++j)
+			{
+				const ndInt32 k = (vertexOffset + j) * strideInFloats;
+				const ndVector& p = block->m_points[j];
+				const ndVector& n = block->m_normals[j];
+				posit[k + 0] = ndReal(p.m_x);
+				posit[k + 1] = ndReal(p.m_y);
+				posit[k + 2] = ndReal(p.m_z);
+				normals[k + 0] = ndReal(n.m_x);
+				normals[k + 1] = ndReal(n.m_y);
+				normals[k + 2] = ndReal(n.m_z);
+			}
+
+			for (ndInt32 j = 1; j < 8; ++j)
+			{
+				const ndIsoBlock* const neighbor = lowerNeighbors[j];
+				if (neighbor)
+				{
+					for (ndInt32 k = 0; k < ndInt32(neighbor->m_shared.GetCount()); ++k)
+					{
+						const ndIsoSharedVertex& shared = neighbor->m_shared[k];
+						if (shared.m_neighbor == j)
+						{
+							const ndInt32 vertex = block->m_edgeVertex[shared.m_edge];
+							ndAssert(vertex >= 0);
+							const ndInt32 m = (vertexOffset + vertex) * strideInFloats;
+							normals[m + 0] += ndReal(shared.m_normal.m_x);
+							normals[m + 1] += ndReal(shared.m_normal.m_y);
+							normals[m + 2] += ndReal(shared.m_normal.m_z);
+						}
+					}
+				}
+			}
+
+			for (ndInt32 j = 0; j < ndInt32(block->m_points.GetCount()); ++j)
+			{
+				const ndInt32 k = (vertexOffset + j) * strideInFloats;
+				const ndVector n(ndFloat32(normals[k + 0]), ndFloat32(normals[k + 1]), ndFloat32(normals[k + 2]), ndFloat32(0.0f));
+				const ndVector unitNormal(n * n.InvMagSqrt());
+				normals[k + 0] = ndReal(unitNormal.m_x);
+				normals[k + 1] = ndReal(unitNormal.m_y);
+				normals[k + 2] = ndReal(unitNormal.m_z);
+			}
+
+			ndInt32* const dst = &indexList[block->m_indexOffset];
+			for (ndInt32 j = 0; j < ndInt32(block->m_indices.GetCount()); ++j)
+			{
+				const ndInt32 index = block->m_indices[j];
+				if (index >= 0)
+				{
+					dst[j] = vertexOffset + index;
+				}
+				else
+				{
+					const ndIsoSharedVertex& shared = block->m_shared[-1 - index];
+					const ndIsoBlock* const owner = upperNeighbors[shared.m_neighbor];
+					ndAssert(owner && (owner->m_edgeVertex[shared.m_edge] >= 0));
+					dst[j] = owner->m_vertexOffset + owner->m_edgeVertex[shared.m_edge];
+				}
+			}
+		}
+	});
+	threadPool.ParallelExecute(CopyBlocks);
+}
+
 ndIsoSurface::ndIsoSurface()
 	:m_origin(ndVector::m_zero)
 	,m_points(1024)
@@ -3389,6 +4062,9 @@ ndIsoSurface::ndIsoSurface()
 	,m_volumeSizeX(1)
 	,m_volumeSizeY(1)
 	,m_volumeSizeZ(1)
+	,m_indexCount(0)
+	,m_vertexCount(0)
+	,m_remeshedBlockCount(0)
 	,m_isLowRes(true)
 {
 }
@@ -3437,4 +4113,21 @@ ndInt32 ndIsoSurface::GenerateListIndexList(ndInt32* const indexList, ndInt32 st
 		ndAssert(0);
 	}
 	return vertexCount;
-}
\ No newline at end of file
+}
+
+void ndIsoSurface::GenerateMesh(ndThreadPool& threadPool, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize)
+{
+	m_isLowRes = true;
+	m_points.SetCount(0);
+	m_implementation->BuildIncrementalMesh(threadPool, pointCloud, gridSize);
+	m_gridSize = gridSize;
+	m_origin = ndVector::m_zero;
+	m_indexCount = m_implementation->m_indexCount;
+	m_vertexCount = m_implementation->m_vertexCount;
+	m_remeshedBlockCount = m_implementation->m_remeshedBlockCount;
+}
+
+void ndIsoSurface::GetMesh(ndThreadPool& threadPool, ndInt32* const indexList, ndInt32 strideInFloats, ndReal* const posit, ndReal* const normals) const
+{
+	m_implementation->GetBlockMesh(threadPool, indexList, strideInFloats, posit, normals);
+}
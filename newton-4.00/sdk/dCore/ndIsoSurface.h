@@ -27,6 +27,8 @@
 #include "ndArray.h"
 #include "ndTree.h"
 
+class ndThreadPool;
+
 class ndIsoSurface: public ndClassAlloc
 {
 	public:
@@ -55,6 +57,19 @@ class ndIsoSurface: public ndClassAlloc
 	D_CORE_API void GenerateMesh(const ndArray<ndVector>& pointCloud, ndFloat32 gridSize, ndCalculateIsoValue* const computeIsoValue = nullptr);
 	D_CORE_API ndInt32 GenerateListIndexList(ndInt32 * const indexList, ndInt32 strideInFloat32, ndReal* const posit, ndReal* const normals) const;
 
+	// incremental mesher, the grid is split in blocks of 8 x 8 x 8 cells and 
+	// only the blocks whose occupied cells changed since the last call are remeshed.
+	// vertices are in world space, and the origin is zero.
+	D_CORE_API void GenerateMesh(ndThreadPool& threadPool, const ndArray<ndVector>& pointCloud, ndFloat32 gridSize);
+
+	// write the mesh of the last incremental update to the caller buffers, 
+	// posit and normals must hold GetVertexCount() vertices and indexList GetIndexCount() indices.
+	D_CORE_API void GetMesh(ndThreadPool& threadPool, ndInt32* const indexList, ndInt32 strideInFloat32, ndReal* const posit, ndReal* const normals) const;
+
+	ndInt32 GetIndexCount() const;
+	ndInt32 GetVertexCount() const;
+	ndInt32 GetRemeshedBlockCount() const;
+
 	private:
 	ndVector m_origin;
 	ndArray<ndVector> m_points;
@@ -63,6 +78,9 @@ class ndIsoSurface: public ndClassAlloc
 	ndInt32 m_volumeSizeX;
 	ndInt32 m_volumeSizeY;
 	ndInt32 m_volumeSizeZ;
+	ndInt32 m_indexCount;
+	ndInt32 m_vertexCount;
+	ndInt32 m_remeshedBlockCount;
 	bool m_isLowRes;
 };
 
@@ -76,5 +94,20 @@ inline ndVector ndIsoSurface::GetOrigin() const
 	return m_origin;
 }
 
+inline ndInt32 ndIsoSurface::GetIndexCount() const
+{
+	return m_indexCount;
+}
+
+inline ndInt32 ndIsoSurface::GetVertexCount() const
+{
+	return m_vertexCount;
+}
+
+inline ndInt32 ndIsoSurface::GetRemeshedBlockCount() const
+{
+	return m_remeshedBlockCount;
+}
+
 #endif
 
@@ -23,8 +23,6 @@
 #include "ndTypes.h"
 #include "ndMemory.h"
 
-ndAtomic<ndUnsigned64> ndMemory::m_memoryUsed(0);
-
 static ndMemFreeCallback m_freeMemory = free;
 static ndMemAllocCallback m_allocMemory = malloc;
 
@@ -34,8 +32,45 @@ class ndMemoryHeader
 	void* m_ptr;
 	ndUnsigned32 m_bufferSize;
 	ndUnsigned32 m_requestedSize;
+	ndUnsigned32 m_category;
+};
+
+class ndMemoryCategory
+{
+	public:
+	void Add(ndUnsigned64 bytes)
+	{
+		const ndUnsigned64 total = m_bytes.fetch_add(bytes) + bytes;
+		m_allocations.fetch_add(1);
+		for (ndUnsigned64 peak = m_peakBytes.load(); (total > peak) && !m_peakBytes.compare_exchange_weak(peak, total); peak = m_peakBytes.load());
+	}
+
+	void Remove(ndUnsigned64 bytes)
+	{
+		m_bytes.fetch_sub(bytes);
+		m_allocations.fetch_sub(1);
+	}
+
+	ndAtomic<ndUnsigned64> m_bytes;
+	ndAtomic<ndUnsigned64> m_peakBytes;
+	ndAtomic<ndUnsigned64> m_allocations;
+	ndAtomic<ndUnsigned64> m_totalAllocations;
 };
 
+static ndMemoryCategory m_categories[ndMemory::m_categoryCount];
+static thread_local ndMemory::ndCategory m_threadCategory = ndMemory::m_general;
+
+ndMemory::ndCategoryScope::ndCategoryScope(ndCategory category)
+	:m_category(m_threadCategory)
+{
+	m_threadCategory = category;
+}
+
+ndMemory::ndCategoryScope::~ndCategoryScope()
+{
+	m_threadCategory = m_category;
+}
+
 #define ndGetBufferPaddingInBytes size_t(D_MEMORY_ALIGMNET - 1 + sizeof (ndMemoryHeader))
 
 size_t ndMemory::CalculateBufferSize(size_t size)
@@ -44,6 +79,11 @@ size_t ndMemory::CalculateBufferSize(size_t size)
 }
 
 void* ndMemory::Malloc(size_t size)
+{
+	return Malloc(size, m_threadCategory);
+}
+
+void* ndMemory::Malloc(size_t size, ndCategory category)
 {
 	ndIntPtr metToVal;
 	size_t bufferSize = size + ndGetBufferPaddingInBytes;
@@ -57,7 +97,9 @@ void* ndMemory::Malloc(size_t size)
 	info->m_ptr = metToVal.m_ptr;
 	info->m_bufferSize = ndUnsigned32 (bufferSize);
 	info->m_requestedSize = ndUnsigned32(size);
-	m_memoryUsed.fetch_add(bufferSize);
+	info->m_category = ndUnsigned32(category);
+	m_categories[category].Add(bufferSize);
+	m_categories[category].m_totalAllocations.fetch_add(1);
 	return ret;
 }
 
@@ -66,7 +108,7 @@ void ndMemory::Free(void* const ptr)
 	if (ptr)
 	{
 		ndMemoryHeader* const info = ((ndMemoryHeader*)ptr) - 1;
-		m_memoryUsed.fetch_sub(ndUnsigned64(info->m_bufferSize));
+		m_categories[info->m_category].Remove(ndUnsigned64(info->m_bufferSize));
 		m_freeMemory(info->m_ptr);
 	}
 }
@@ -85,7 +127,65 @@ size_t ndMemory::GetOriginalSize(void* const ptr)
 
 ndUnsigned64 ndMemory::GetMemoryUsed()
 {
-	return m_memoryUsed.load();
+	ndUnsigned64 memory = 0;
+	for (ndInt32 i = 0; i < m_categoryCount; ++i)
+	{
+		memory += m_categories[i].m_bytes.load();
+	}
+	return memory;
+}
+
+ndMemory::ndCategory ndMemory::GetCategory()
+{
+	return m_threadCategory;
+}
+
+ndMemory::ndCategory ndMemory::GetCategory(void* const ptr)
+{
+	ndMemoryHeader* const info = ((ndMemoryHeader*)ptr) - 1;
+	return ndCategory(info->m_category);
+}
+
+void ndMemory::SetCategory(void* const ptr, ndCategory category)
+{
+	ndMemoryHeader* const info = ((ndMemoryHeader*)ptr) - 1;
+	if (info->m_category != ndUnsigned32(category))
+	{
+		m_categories[info->m_category].Remove(ndUnsigned64(info->m_bufferSize));
+		m_categories[category].Add(ndUnsigned64(info->m_bufferSize));
+		info->m_category = ndUnsigned32(category);
+	}
+}
+
+void ndMemory::GetCategoryInfo(ndCategory category, ndCategoryInfo& info)
+{
+	const ndMemoryCategory& data = m_categories[category];
+	info.m_bytes = data.m_bytes.load();
+	info.m_peakBytes = data.m_peakBytes.load();
+	info.m_allocations = data.m_allocations.load();
+	info.m_totalAllocations = data.m_totalAllocations.load();
+}
+
+const char* ndMemory::GetCategoryName(ndCategory category)
+{
+	static const char* names[] =
+	{
+		"general",
+		"bvh",
+		"contacts",
+		"solver",
+		"staticMesh",
+		"neuralNetwork",
+	};
+	return (category < m_categoryCount) ? names[category] : "unknown";
+}
+
+void ndMemory::ResetPeaks()
+{
+	for (ndInt32 i = 0; i < m_categoryCount; ++i)
+	{
+		m_categories[i].m_peakBytes.store(m_categories[i].m_bytes.load());
+	}
 }
 
 void ndMemory::SetMemoryAllocators(ndMemAllocCallback alloc, ndMemFreeCallback free)
@@ -33,11 +33,49 @@ typedef void (*ndMemFreeCallback) (void* const ptr);
 class ndMemory
 {
 	public:
+	/// Allocation categories, used to find which subsystem owns the memory.
+	enum ndCategory
+	{
+		m_general,
+		m_bvh,
+		m_contacts,
+		m_solver,
+		m_staticMesh,
+		m_neuralNetwork,
+		m_categoryCount
+	};
+
+	/// Memory accounting of one category.
+	class ndCategoryInfo
+	{
+		public:
+		ndUnsigned64 m_bytes;
+		ndUnsigned64 m_peakBytes;
+		ndUnsigned64 m_allocations;
+		ndUnsigned64 m_totalAllocations;
+	};
+
+	/// Tags all allocations made by the calling thread while the scope is alive.
+	/// \brief containers, class allocators and arrays all allocate with Malloc, so
+	/// they take the category of the scope they grow in.
+	class ndCategoryScope
+	{
+		public:
+		D_CORE_API ndCategoryScope(ndCategory category);
+		D_CORE_API ~ndCategoryScope();
+
+		private:
+		ndCategory m_category;
+	};
+
 	/// General Memory allocation function.
 	/// All memory allocations used by the Newton Engine and Tools 
 	/// are performed by calling this function.
 	D_CORE_API static void* Malloc(size_t size);
 
+	/// Allocate a memory buffer accounted to an explicit category.
+	D_CORE_API static void* Malloc(size_t size, ndCategory category);
+
 	/// Destroy a memory buffer previously allocated by Malloc.
 	D_CORE_API static void Free(void* const ptr);
 
@@ -53,6 +91,22 @@ class ndMemory
 	/// Return the total memory allocated by the newton engine and tools.
 	D_CORE_API static ndUnsigned64 GetMemoryUsed();
 
+	/// Return the category of the calling thread allocations.
+	D_CORE_API static ndCategory GetCategory();
+
+	/// Return the category a buffer is accounted to.
+	D_CORE_API static ndCategory GetCategory(void* const ptr);
+
+	/// Move the accounting of a buffer to another category, used when recycled memory changes owner.
+	D_CORE_API static void SetCategory(void* const ptr, ndCategory category);
+
+	/// Return the current and peak bytes and the allocation counts of a category.
+	D_CORE_API static void GetCategoryInfo(ndCategory category, ndCategoryInfo& info);
+	D_CORE_API static const char* GetCategoryName(ndCategory category);
+
+	/// Set the peak of every category to its current value.
+	D_CORE_API static void ResetPeaks();
+
 	/// Install low level system memory allocation functions.
 	/// \param ndMemAllocCallback alloc: is a function pointer callback to allocate a memory chunk.
 	/// \param ndMemFreeCallback free: is a function pointer callback to free a memory chunk.
@@ -68,9 +122,6 @@ class ndMemory
 	/// application or just before start using the engine.
 	D_CORE_API static void SetMemoryAllocators(ndMemAllocCallback alloc, ndMemFreeCallback free);
 	D_CORE_API static void GetMemoryAllocators(ndMemAllocCallback& alloc, ndMemFreeCallback& free);
-
-	private:
-	static ndAtomic<ndUnsigned64> m_memoryUsed;
 };
 
 #endif
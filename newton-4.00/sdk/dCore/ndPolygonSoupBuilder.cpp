@@ -30,6 +30,8 @@
 #include "ndTree.h"
 #include "ndStack.h"
 #include "ndPolyhedra.h"
+#include "ndProfiler.h"
+#include "ndThreadPool.h"
 #include "ndPolygonSoupBuilder.h"
 
 #define ND_POINTS_RUN (512 * 1024)
@@ -41,6 +43,15 @@ class ndPolygonSoupBuilder::ndFaceInfo
 	ndInt32 indexStart;
 };
 
+// a spatial cluster of faces of the same id, merged independently of the others
+class ndPolygonSoupBuilder::ndFacePartition
+{
+	public:
+	ndInt32 m_faceId;
+	ndInt32 m_start;
+	ndInt32 m_count;
+};
+
 class ndPolygonSoupBuilder::ndFaceBucket: public ndList<ndFaceInfo>
 {
 	public: 
@@ -382,7 +393,7 @@ void ndPolygonSoupBuilder::PackArray()
 	m_run = ND_POINTS_RUN;
 }
 
-void ndPolygonSoupBuilder::Finalize()
+void ndPolygonSoupBuilder::Finalize(ndThreadPool* const threadPool)
 {
 	const ndInt32 faceCount = ndInt32(m_faceVertexCount.GetCount());
 	if (faceCount)
@@ -390,7 +401,7 @@ void ndPolygonSoupBuilder::Finalize()
 		ndStack<ndInt32> indexMapPool(ndInt32(m_vertexPoints.GetCount()));
 
 		ndInt32* const indexMap = &indexMapPool[0];
-		ndInt32 vertexCount = ndVertexListToIndexList(&m_vertexPoints[0].m_x, sizeof (ndBigVector), 3, ndInt32(m_vertexPoints.GetCount()), &indexMap[0], ndFloat32 (1.0e-4f));
+		ndInt32 vertexCount = ndVertexListToIndexList(threadPool, &m_vertexPoints[0].m_x, sizeof (ndBigVector), 3, ndInt32(m_vertexPoints.GetCount()), &indexMap[0], ndFloat64 (1.0e-4f));
 		ndAssert(vertexCount <= m_vertexPoints.GetCount());
 		m_vertexPoints.SetCount(vertexCount);
 
@@ -413,7 +424,7 @@ void ndPolygonSoupBuilder::Finalize()
 
 void ndPolygonSoupBuilder::FinalizeAndOptimize(ndInt32 id)
 {
-	Finalize();
+	Finalize(nullptr);
 	ndPolyhedra polyhedra;
 	ndPolygonSoupBuilder source(*this);
 	ndPolygonSoupBuilder leftOver;
@@ -538,7 +549,7 @@ void ndPolygonSoupBuilder::FinalizeAndOptimize(ndInt32 id)
 		faceIndexNumber += (indexCount + 1); 
 	}
 
-	Finalize();
+	Finalize(nullptr);
 }
 
 void ndPolygonSoupBuilder::OptimizeByIndividualFaces()
@@ -579,71 +590,123 @@ void ndPolygonSoupBuilder::OptimizeByIndividualFaces()
 
 void ndPolygonSoupBuilder::End(bool optimize)
 {
+	EndBuild(nullptr, optimize);
+}
+
+void ndPolygonSoupBuilder::End(ndThreadPool& threadPool, bool optimize)
+{
+	EndBuild(&threadPool, optimize);
+}
+
+void ndPolygonSoupBuilder::EndBuild(ndThreadPool* const threadPool, bool optimize)
+{
+	D_TRACKTIME();
 	if (optimize) 
 	{
 		ndPolygonSoupBuilder copy (*this);
 		ndFaceMap faceMap (copy);
 
-		Begin();
+		ndArray<ndFaceInfo> faces;
+		ndArray<ndFacePartition> partitions;
 		ndFaceMap::Iterator iter (faceMap);
 		for (iter.Begin(); iter; iter ++) 
 		{
 			const ndFaceBucket& bucket = iter.GetNode()->GetInfo();
-			Optimize(iter.GetNode()->GetKey(), bucket, copy);
+			PartitionFaces(iter.GetNode()->GetKey(), bucket, copy, faces, partitions);
+		}
+
+		// partitions are merged independently, 
+		// and added back in order so the result does not depend on the thread count.
+		ndArray<ndPolygonSoupBuilder*> partitionBuilders;
+		partitionBuilders.SetCount(partitions.GetCount());
+		ndAtomic<ndInt32> iterator(0);
+		auto OptimizePartitions = ndMakeObject::ndFunction([&iterator, &faces, &partitions, &partitionBuilders, &copy](ndInt32, ndInt32)
+		{
+			D_TRACKTIME_NAMED(OptimizePartitions);
+			const ndInt32 count = ndInt32(partitions.GetCount());
+			for (ndInt32 i = iterator.fetch_add(1); i < count; i = iterator.fetch_add(1))
+			{
+				ndPolygonSoupBuilder* const builder = new ndPolygonSoupBuilder;
+				builder->OptimizePartition(partitions[i], &faces[0], copy);
+				partitionBuilders[i] = builder;
+			}
+		});
+		ndParallelExecute(threadPool, OptimizePartitions);
+
+		Begin();
+		for (ndInt32 i = 0; i < ndInt32(partitions.GetCount()); ++i)
+		{
+			AddFaces(*partitionBuilders[i], partitions[i].m_faceId);
+			delete partitionBuilders[i];
 		}
 	}
-	Finalize();
+	Finalize(threadPool);
+	CalculateNormals(threadPool);
+}
 
+void ndPolygonSoupBuilder::CalculateNormals(ndThreadPool* const threadPool)
+{
 	// build the normal array and adjacency array
-	ndInt32 indexCount = 0;
 	const ndInt32 faceCount = ndInt32(m_faceVertexCount.GetCount());
 	if (faceCount)
 	{
+		ndArray<ndInt32> faceStart;
+		faceStart.SetCount(faceCount);
+		ndInt32 indexCount = 0;
+		for (ndInt32 i = 0; i < faceCount; ++i)
+		{
+			faceStart[i] = indexCount;
+			indexCount += m_faceVertexCount[i];
+		}
+
 		// calculate all face the normals
 		m_normalPoints.Resize(faceCount);
 		m_normalPoints.SetCount(faceCount);
-		for (ndInt32 i = 0; i < faceCount; ++i)
+		auto CalculateFaceNormals = ndMakeObject::ndFunction([this, &faceStart, faceCount](ndInt32 threadIndex, ndInt32 threadCount)
 		{
-			ndInt32 faceIndexCount = m_faceVertexCount[i];
-
-			const ndInt32* const ptr = &m_vertexIndex[indexCount];
-			ndBigVector v0(&m_vertexPoints[ptr[0]].m_x);
-			ndBigVector v1(&m_vertexPoints[ptr[1]].m_x);
-			ndBigVector e0(v1 - v0);
-			ndBigVector normal0(ndBigVector::m_zero);
-			for (ndInt32 j = 2; j < faceIndexCount - 1; ++j)
+			D_TRACKTIME_NAMED(CalculateFaceNormals);
+			const ndStartEnd startEnd(faceCount, threadIndex, threadCount);
+			for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
 			{
-				ndBigVector v2(&m_vertexPoints[ptr[j]].m_x);
-				ndBigVector e1(v2 - v0);
-				normal0 += e0.CrossProduct(e1);
-				e0 = e1;
-			}
-			ndBigVector normal(normal0.Normalize());
+				ndInt32 faceIndexCount = m_faceVertexCount[i];
+
+				const ndInt32* const ptr = &m_vertexIndex[faceStart[i]];
+				ndBigVector v0(&m_vertexPoints[ptr[0]].m_x);
+				ndBigVector v1(&m_vertexPoints[ptr[1]].m_x);
+				ndBigVector e0(v1 - v0);
+				ndBigVector normal0(ndBigVector::m_zero);
+				for (ndInt32 j = 2; j < faceIndexCount - 1; ++j)
+				{
+					ndBigVector v2(&m_vertexPoints[ptr[j]].m_x);
+					ndBigVector e1(v2 - v0);
+					normal0 += e0.CrossProduct(e1);
+					e0 = e1;
+				}
+				ndBigVector normal(normal0.Normalize());
 
-			m_normalPoints[i].m_x = normal.m_x;
-			m_normalPoints[i].m_y = normal.m_y;
-			m_normalPoints[i].m_z = normal.m_z;
-			m_normalPoints[i].m_w = ndFloat32(0.0f);
-			indexCount += faceIndexCount;
-		}
+				m_normalPoints[i].m_x = normal.m_x;
+				m_normalPoints[i].m_y = normal.m_y;
+				m_normalPoints[i].m_z = normal.m_z;
+				m_normalPoints[i].m_w = ndFloat32(0.0f);
+			}
+		});
+		ndParallelExecute(threadPool, CalculateFaceNormals);
 
 		m_normalIndex.Resize(faceCount);;
 		m_normalIndex.SetCount(faceCount);
-		ndInt32 normalCount = ndVertexListToIndexList(&m_normalPoints[0].m_x, sizeof(ndBigVector), 3, faceCount, &m_normalIndex[0], ndFloat32(1.0e-6f));
+		ndInt32 normalCount = ndVertexListToIndexList(threadPool, &m_normalPoints[0].m_x, sizeof(ndBigVector), 3, faceCount, &m_normalIndex[0], ndFloat64(1.0e-6f));
 		ndAssert(normalCount <= m_normalPoints.GetCount());
 		m_normalPoints.SetCount(normalCount);
 	}
 }
 
-void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source)
+void ndPolygonSoupBuilder::PartitionFaces(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<ndFaceInfo>& faces, ndArray<ndFacePartition>& partitions) const
 {
 	#define DG_MESH_PARTITION_SIZE (1024 * 4)
 
 	const ndInt32* const indexArray = &source.m_vertexIndex[0];
 	const ndBigVector* const points = &source.m_vertexPoints[0];
 
-	ndVector face[256];
-	ndInt32 faceIndex[256];
 	if (faceBucket.GetCount() >= DG_MESH_PARTITION_SIZE) 
 	{
 		ndStack<ndFaceBucket::ndNode*> array(faceBucket.GetCount());
@@ -668,36 +731,14 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 
 			if (faceCount <= DG_MESH_PARTITION_SIZE) 
 			{
-				ndPolygonSoupBuilder tmpBuilder;
+				ndFacePartition partition;
+				partition.m_faceId = faceId;
+				partition.m_start = ndInt32(faces.GetCount());
+				partition.m_count = faceCount;
+				partitions.PushBack(partition);
 				for (ndInt32 i = 0; i < faceCount; ++i) 
 				{
-					const ndFaceInfo& faceInfo = array[faceStart + i]->GetInfo();
-
-					ndInt32 count1 = faceInfo.indexCount - 1;
-					ndInt32 start1 = faceInfo.indexStart;
-					ndAssert (faceId == indexArray[start1 + count1]);
-					for (ndInt32 j = 0; j < count1; ++j) 
-					{
-						ndInt32 index = indexArray[start1 + j];
-						face[j] = points[index];
-						faceIndex[j] = j;
-					}
-					tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count1);
-				}
-				tmpBuilder.FinalizeAndOptimize (faceId);
-
-				ndInt32 faceIndexNumber = 0;
-				for (ndInt32 i = 0; i < ndInt32(tmpBuilder.m_faceVertexCount.GetCount()); ++i)
-				{
-					ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-					for (ndInt32 j = 0; j < indexCount; ++j) 
-					{
-						ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-						face[j] = tmpBuilder.m_vertexPoints[index];
-						faceIndex[j] = j;
-					}
-					AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-					faceIndexNumber += (indexCount + 1); 
+					faces.PushBack(array[faceStart + i]->GetInfo());
 				}
 			} 
 			else 
@@ -786,38 +827,58 @@ void ndPolygonSoupBuilder::Optimize(ndInt32 faceId, const ndFaceBucket& faceBuck
 	} 
 	else 
 	{
-		ndPolygonSoupBuilder tmpBuilder;
+		ndFacePartition partition;
+		partition.m_faceId = faceId;
+		partition.m_start = ndInt32(faces.GetCount());
+		partition.m_count = ndInt32(faceBucket.GetCount());
+		partitions.PushBack(partition);
 		for (ndFaceBucket::ndNode* node = faceBucket.GetFirst(); node; node = node->GetNext()) 
 		{
-			const ndFaceInfo& faceInfo = node->GetInfo();
+			faces.PushBack(node->GetInfo());
+		}
+	}
+}
 
-			ndInt32 count = faceInfo.indexCount - 1;
-			ndInt32 start = faceInfo.indexStart;
-			ndAssert (faceId == indexArray[start + count]);
-			for (ndInt32 j = 0; j < count; ++j) 
-			{
-				ndInt32 index = indexArray[start + j];
-				face[j] = points[index];
-				faceIndex[j] = j;
-			}
-			tmpBuilder.AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, count);
+void ndPolygonSoupBuilder::OptimizePartition(const ndFacePartition& partition, const ndFaceInfo* const faces, const ndPolygonSoupBuilder& source)
+{
+	const ndInt32* const indexArray = &source.m_vertexIndex[0];
+	const ndBigVector* const points = &source.m_vertexPoints[0];
+
+	ndVector face[256];
+	ndInt32 faceIndex[256];
+	for (ndInt32 i = 0; i < partition.m_count; ++i) 
+	{
+		const ndFaceInfo& faceInfo = faces[partition.m_start + i];
+		ndInt32 count = faceInfo.indexCount - 1;
+		ndInt32 start = faceInfo.indexStart;
+		ndAssert (partition.m_faceId == indexArray[start + count]);
+		for (ndInt32 j = 0; j < count; ++j) 
+		{
+			ndInt32 index = indexArray[start + j];
+			face[j] = points[index];
+			faceIndex[j] = j;
 		}
-		tmpBuilder.FinalizeAndOptimize (faceId);
+		AddFaceIndirect(&face[0].m_x, sizeof(ndVector), partition.m_faceId, faceIndex, count);
+	}
+	FinalizeAndOptimize (partition.m_faceId);
+}
 
-		ndInt32 faceIndexNumber = 0;
-		for (ndInt32 i = 0; i < ndInt32(tmpBuilder.m_faceVertexCount.GetCount()); ++i)
+void ndPolygonSoupBuilder::AddFaces(const ndPolygonSoupBuilder& source, ndInt32 faceId)
+{
+	ndVector face[256];
+	ndInt32 faceIndex[256];
+	ndInt32 faceIndexNumber = 0;
+	for (ndInt32 i = 0; i < ndInt32(source.m_faceVertexCount.GetCount()); ++i)
+	{
+		ndInt32 indexCount = source.m_faceVertexCount[i] - 1;
+		for (ndInt32 j = 0; j < indexCount; ++j) 
 		{
-			ndInt32 indexCount = tmpBuilder.m_faceVertexCount[i] - 1;
-			for (ndInt32 j = 0; j < indexCount; ++j) 
-			{
-				ndInt32 index = tmpBuilder.m_vertexIndex[faceIndexNumber + j];
-				face[j] = tmpBuilder.m_vertexPoints[index];
-				faceIndex[j] = j;
-			}
-			AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
-		
-			faceIndexNumber += (indexCount + 1); 
+			ndInt32 index = source.m_vertexIndex[faceIndexNumber + j];
+			face[j] = source.m_vertexPoints[index];
+			faceIndex[j] = j;
 		}
+		AddFaceIndirect(&face[0].m_x, sizeof(ndVector), faceId, faceIndex, indexCount);
+		faceIndexNumber += (indexCount + 1); 
 	}
 }
 
@@ -34,6 +34,8 @@
 #include "ndVector.h"
 #include "ndMatrix.h"
 
+class ndThreadPool;
+
 /// Helper intermediate class for encoding a face adjacent face to an edge of a face.
 class ndAdjacentFace
 {
@@ -49,6 +51,7 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 	class ndFaceMap;
 	class ndFaceInfo;
 	class ndFaceBucket;
+	class ndFacePartition;
 	class ndPolySoupFilterAllocator;
 
 	public:
@@ -58,6 +61,7 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 
 	D_CORE_API virtual void Begin();
 	D_CORE_API virtual void End(bool optimize);
+	D_CORE_API virtual void End(ndThreadPool& threadPool, bool optimize);
 	D_CORE_API virtual void AddFace(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 vertexCount, const ndInt32 faceId);
 	D_CORE_API virtual void AddFaceIndirect(const ndFloat32* const vertex, ndInt32 strideInBytes, ndInt32 faceId, const ndInt32* const indexArray, ndInt32 indexCount);
 
@@ -65,9 +69,13 @@ class ndPolygonSoupBuilder: public ndClassAlloc
 	D_CORE_API void SavePLY(const char* const fileName) const;
 
 	private:
-	void Optimize(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source);
+	void EndBuild(ndThreadPool* const threadPool, bool optimize);
+	void CalculateNormals(ndThreadPool* const threadPool);
+	void PartitionFaces(ndInt32 faceId, const ndFaceBucket& faceBucket, const ndPolygonSoupBuilder& source, ndArray<ndFaceInfo>& faces, ndArray<ndFacePartition>& partitions) const;
+	void OptimizePartition(const ndFacePartition& partition, const ndFaceInfo* const faces, const ndPolygonSoupBuilder& source);
+	void AddFaces(const ndPolygonSoupBuilder& source, ndInt32 faceId);
 
-	void Finalize();
+	void Finalize(ndThreadPool* const threadPool);
 	void OptimizeByIndividualFaces();
 	void FinalizeAndOptimize(ndInt32 id);
 	ndInt32 FilterFace (ndInt32 count, ndInt32* const indexArray);
@@ -162,6 +162,7 @@ class ndTaskImplement : public ndTask
 		,m_threadPool(threadPool)
 		,m_threadIndex(threadIndex)
 		,m_threadCount(threadPool->GetThreadCount())
+		,m_category(ndMemory::GetCategory())
 	{
 	}
 
@@ -172,6 +173,8 @@ class ndTaskImplement : public ndTask
 	private:
 	void Execute() const
 	{
+		// workers allocate in the memory category of the thread that dispatched the job
+		ndMemory::ndCategoryScope scope(m_category);
 		m_function(m_threadIndex, m_threadCount);
 	}
 
@@ -179,6 +182,7 @@ class ndTaskImplement : public ndTask
 	ndThreadPool* m_threadPool;
 	const ndInt32 m_threadIndex;
 	const ndInt32 m_threadCount;
+	const ndMemory::ndCategory m_category;
 	friend class ndThreadPool;
 };
 
@@ -221,4 +225,18 @@ void ndThreadPool::ParallelExecute(const Function& callback)
 	}
 }
 
+// runs the job across the pool, or on the calling thread when there is no pool.
+template <typename Function>
+inline void ndParallelExecute(ndThreadPool* const threadPool, const Function& callback)
+{
+	if (threadPool)
+	{
+		threadPool->ParallelExecute(callback);
+	}
+	else
+	{
+		callback(0, 1);
+	}
+}
+
 #endif
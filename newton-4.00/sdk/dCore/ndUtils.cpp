@@ -25,6 +25,8 @@
 #include "ndUtils.h"
 #include "ndVector.h"
 #include "ndMatrix.h"
+#include "ndProfiler.h"
+#include "ndThreadPool.h"
 
 #define D_VERTEXLIST_INDEX_LIST_BASH (1024)
 
@@ -66,12 +68,11 @@ class ndSortKey
 	ndInt32 m_vertexIndex;
 };
 
+// welds the vertices of one cluster, the indices are relative to the cluster
 static ndInt32 SortVertices(
-	ndFloat64* const vertListOut, ndInt32* const indexList,
 	const ndFloat64* const vertexList, ndInt32 stride, 
 	ndInt32 compareCount, ndFloat64 tol,
-	ndSortKey* const remapIndex,
-	const ndSortCluster& cluster, ndInt32 baseCount)
+	ndSortKey* const remapIndex, const ndSortCluster& cluster)
 {
 	const ndBigVector origin(cluster.m_sum.Scale(ndFloat32(1.0f) / (ndFloat32)cluster.m_count));
 	const ndBigVector variance(ndBigVector::m_zero.GetMax(cluster.m_sum2.Scale(ndFloat32(1.0f) / (ndFloat32)cluster.m_count) - origin * origin).Sqrt());
@@ -161,17 +162,26 @@ static ndInt32 SortVertices(
 
 					if (test)
 					{
-						remapIndex[j].m_mask = newCount + baseCount;
+						remapIndex[j].m_mask = newCount;
 					}
 				}
 			}
 	
 			remapIndex[newCount].m_vertexIndex = remapIndex[i].m_vertexIndex;
-			remapIndex[i].m_mask = newCount + baseCount;
+			remapIndex[i].m_mask = newCount;
 			newCount++;
 		}
 	}
-	
+	return newCount;
+}
+
+// copies the welded vertices of one cluster to their final location
+static void EmitVertices(
+	ndFloat64* const vertListOut, ndInt32* const indexList,
+	const ndFloat64* const vertexList, ndInt32 stride,
+	const ndSortKey* const remapIndex, 
+	const ndSortCluster& cluster, ndInt32 newCount, ndInt32 baseCount)
+{
 	for (ndInt32 i = 0; i < newCount; ++i)
 	{
 		ndInt32 dst = (baseCount + i) * stride;
@@ -182,14 +192,12 @@ static ndInt32 SortVertices(
 	for (ndInt32 i = 0; i < cluster.m_count; ++i)
 	{
 		ndInt32 i1 = remapIndex[i].m_ordinal;
-		ndInt32 index = remapIndex[i].m_mask;
+		ndInt32 index = remapIndex[i].m_mask + baseCount;
 		indexList[i1] = index;
 	}
-
-	return newCount;
 }
 
-static ndInt32 QuickSortVertices(ndFloat64* const vertListOut, ndInt32 stride, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance)
+static ndInt32 QuickSortVertices(ndThreadPool* const threadPool, ndFloat64* const vertListOut, ndInt32 stride, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance)
 {
 	ndSortCluster cluster;
 	cluster.m_start = 0;
@@ -215,7 +223,9 @@ static ndInt32 QuickSortVertices(ndFloat64* const vertListOut, ndInt32 stride, n
 		cluster.m_sum2 += x * x;
 	}
 
-	ndInt32 baseCount = 0;
+	// split the points in small spatial clusters, 
+	// clusters are welded independently and emitted in order.
+	ndArray<ndSortCluster> clusters;
 	if (cluster.m_count > D_VERTEXLIST_INDEX_LIST_BASH)
 	{
 		ndSortCluster spliteStack[128];
@@ -234,7 +244,7 @@ static ndInt32 QuickSortVertices(ndFloat64* const vertListOut, ndInt32 stride, n
 			ndSortKey* const remapIndex = &indirectList[cluster.m_start];
 			if ((cluster.m_count <= D_VERTEXLIST_INDEX_LIST_BASH) || (stack > (ndInt32 (sizeof(spliteStack) / sizeof(spliteStack[0])) - 4)) || (maxVariance2 < ndFloat32(4.0f)))
 			{
-				baseCount += SortVertices(vertListOut, indexListOut, vertList, stride, compareCount, tolerance, remapIndex, cluster, baseCount);
+				clusters.PushBack(cluster);
 			}
 			else
 			{
@@ -327,12 +337,53 @@ static ndInt32 QuickSortVertices(ndFloat64* const vertListOut, ndInt32 stride, n
 	}
 	else
 	{
-		baseCount = SortVertices(vertListOut, indexListOut, vertList, stride, compareCount, tolerance, indirectList, cluster, 0);
+		clusters.PushBack(cluster);
 	}
+
+	const ndInt32 clusterCount = ndInt32(clusters.GetCount());
+	ndStack<ndInt32> clusterBase(clusterCount + 1);
+	ndAtomic<ndInt32> iterator(0);
+	auto WeldClusters = ndMakeObject::ndFunction([&iterator, &clusters, &clusterBase, vertList, indirectList, stride, compareCount, tolerance, clusterCount](ndInt32, ndInt32)
+	{
+		D_TRACKTIME_NAMED(WeldClusters);
+		for (ndInt32 i = iterator.fetch_add(1); i < clusterCount; i = iterator.fetch_add(1))
+		{
+			const ndSortCluster& cluster1 = clusters[i];
+			clusterBase[i] = SortVertices(vertList, stride, compareCount, tolerance, &indirectList[cluster1.m_start], cluster1);
+		}
+	});
+	ndParallelExecute(threadPool, WeldClusters);
+
+	ndInt32 baseCount = 0;
+	for (ndInt32 i = 0; i < clusterCount; ++i)
+	{
+		const ndInt32 count = clusterBase[i];
+		clusterBase[i] = baseCount;
+		baseCount += count;
+	}
+	clusterBase[clusterCount] = baseCount;
+
+	auto EmitClusters = ndMakeObject::ndFunction([&clusters, &clusterBase, vertListOut, indexListOut, vertList, indirectList, stride, clusterCount](ndInt32 threadIndex, ndInt32 threadCount)
+	{
+		D_TRACKTIME_NAMED(EmitClusters);
+		const ndStartEnd startEnd(clusterCount, threadIndex, threadCount);
+		for (ndInt32 i = startEnd.m_start; i < startEnd.m_end; ++i)
+		{
+			const ndSortCluster& cluster1 = clusters[i];
+			const ndInt32 newCount = clusterBase[i + 1] - clusterBase[i];
+			EmitVertices(vertListOut, indexListOut, vertList, stride, &indirectList[cluster1.m_start], cluster1, newCount, clusterBase[i]);
+		}
+	});
+	ndParallelExecute(threadPool, EmitClusters);
 	return baseCount;
 }
 
 ndInt32 ndVertexListToIndexList(ndFloat64* const vertList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance)
+{
+	return ndVertexListToIndexList(nullptr, vertList, strideInBytes, compareCount, vertexCount, indexListOut, tolerance);
+}
+
+ndInt32 ndVertexListToIndexList(ndThreadPool* const threadPool, ndFloat64* const vertList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance)
 {
 	if (strideInBytes < 3 * ndInt32(sizeof(ndFloat64))) 
 	{
@@ -344,6 +395,6 @@ ndInt32 ndVertexListToIndexList(ndFloat64* const vertList, ndInt32 strideInBytes
 	}
 
 	ndInt32 stride = strideInBytes / ndInt32(sizeof(ndFloat64));
-	ndInt32 count = QuickSortVertices(vertList, stride, compareCount, vertexCount, indexListOut, tolerance);
+	ndInt32 count = QuickSortVertices(threadPool, vertList, stride, compareCount, vertexCount, indexListOut, tolerance);
 	return count;
 }
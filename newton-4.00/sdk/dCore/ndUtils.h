@@ -28,6 +28,8 @@
 #include "ndMemory.h"
 #include "ndFixSizeArray.h"
 
+class ndThreadPool;
+
 // assume this function returns memory aligned to 16 bytes
 #define ndAlloca(type, count) (type*) alloca (sizeof (type) * size_t(count))
 
@@ -217,9 +219,13 @@ D_CORE_API ndFloat64 ndRoundToFloat(ndFloat64 val);
 /// removed all duplicate points from an array and place the location in the index array
 D_CORE_API ndInt32 ndVertexListToIndexList(ndFloat64* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance = ndEpsilon);
 
+/// same as above, the spatial clusters are welded across the thread pool when one is given. 
+/// the result is the same as the serial version.
+D_CORE_API ndInt32 ndVertexListToIndexList(ndThreadPool* const threadPool, ndFloat64* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, ndFloat64 tolerance = ndEpsilon);
+
 /// removed all duplicate points from an array and place the location in the index array
 template <class T>
-ndInt32 ndVertexListToIndexList(T* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, T tolerance = ndEpsilon)
+ndInt32 ndVertexListToIndexList(ndThreadPool* const threadPool, T* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, T tolerance = ndEpsilon)
 {
 	ndInt32 stride = ndInt32(strideInBytes / sizeof(T));
 	ndStack<ndFloat64> pool(vertexCount * stride);
@@ -235,7 +241,7 @@ ndInt32 ndVertexListToIndexList(T* const vertexList, ndInt32 strideInBytes, ndIn
 		}
 	}
 
-	ndInt32 count = ndVertexListToIndexList(data, ndInt32(stride * sizeof(ndFloat64)), compareCount, vertexCount, indexListOut, ndFloat64(tolerance));
+	ndInt32 count = ndVertexListToIndexList(threadPool, data, ndInt32(stride * sizeof(ndFloat64)), compareCount, vertexCount, indexListOut, ndFloat64(tolerance));
 	for (ndInt32 i = 0; i < count; ++i)
 	{
 		const ndFloat64* const src = &data[i * stride];
@@ -249,6 +255,13 @@ ndInt32 ndVertexListToIndexList(T* const vertexList, ndInt32 strideInBytes, ndIn
 	return count;
 }
 
+/// removed all duplicate points from an array and place the location in the index array
+template <class T>
+ndInt32 ndVertexListToIndexList(T* const vertexList, ndInt32 strideInBytes, ndInt32 compareCount, ndInt32 vertexCount, ndInt32* const indexListOut, T tolerance = ndEpsilon)
+{
+	return ndVertexListToIndexList((ndThreadPool*)nullptr, vertexList, strideInBytes, compareCount, vertexCount, indexListOut, tolerance);
+}
+
 /// Simple moving average class, useful for stuff like frame rate smoothing
 template <ndInt32 size>
 class ndMovingAverage: public ndFixSizeArray<ndReal, size>
@@ -369,7 +369,7 @@ void ndIkSolver::BuildMassMatrix()
 
 			for (it.Begin(); it; it++)
 			{
-				ndContact* const contact = it.GetNode()->GetInfo();
+				ndContact* const contact = *it;
 				if (contact->IsActive())
 				{
 					bool duplicate = false;
@@ -555,7 +555,7 @@ void ndIkSolver::Solve()
 				ndBodyKinematic::ndContactMap::Iterator it(contactMap);
 				for (it.Begin(); it; it++)
 				{
-					ndContact* const fronterContact = it.GetNode()->GetInfo();
+					ndContact* const fronterContact = *it;
 					if (fronterContact->IsActive() && (fronterContact != contact))
 					{
 						if (body == fronterContact->GetBody0())
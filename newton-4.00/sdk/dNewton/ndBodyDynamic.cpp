@@ -394,7 +394,7 @@ void ndBodyDynamic::EvaluateSleepState(ndFloat32 freezeSpeed2, ndFloat32 freezeA
 		ndContactMap::Iterator it(m_contactList);
 		for (it.Begin(); it; it++)
 		{
-			ndContact* const contact = it.GetNode()->GetInfo();
+			ndContact* const contact = *it;
 			if (contact->IsActive() && !contact->IsTestOnly())
 			{
 				checkConnection++;
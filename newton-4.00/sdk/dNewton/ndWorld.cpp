@@ -541,9 +541,11 @@ void ndWorld::SubStepUpdate(ndFloat32 timestep)
 
 	m_scene->m_lru = m_scene->m_lru + 1;
 	m_scene->SetTimestep(timestep);
+	m_scene->ResetFrameArena();
 
 	m_scene->BalanceScene();
 	m_scene->ApplyExtForce();
+	m_scene->ParticleCoupling();
 	m_scene->InitBodyArray();
 
 	// update the collision system
@@ -566,7 +568,10 @@ void ndWorld::SubStepUpdate(ndFloat32 timestep)
 
 	// calculate internal forces, integrate bodies and update matrices.
 	ndAssert(m_solver);
-	m_solver->Update();
+	{
+		ndMemory::ndCategoryScope scope(ndMemory::m_solver);
+		m_solver->Update();
+	}
 
 	// second pass on models
 	ModelPostUpdate();
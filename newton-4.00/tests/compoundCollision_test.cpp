@@ -0,0 +1,201 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+// box that counts the support queries made by the narrow phase
+class ndCountingBox: public ndShapeBox
+{
+  public:
+  ndCountingBox(ndFloat32 size_x, ndFloat32 size_y, ndFloat32 size_z)
+    :ndShapeBox(size_x, size_y, size_z)
+    ,m_supportCount(0)
+  {
+  }
+
+  virtual ndVector SupportVertex(const ndVector& dir) const
+  {
+    m_supportCount++;
+    return ndShapeBox::SupportVertex(dir);
+  }
+
+  virtual ndVector SupportVertexSpecial(const ndVector& dir, ndFloat32 skinMargin) const
+  {
+    m_supportCount++;
+    return ndShapeBox::SupportVertexSpecial(dir, skinMargin);
+  }
+
+  mutable ndInt32 m_supportCount;
+};
+
+static void AddBoxChild(ndShapeInstance& compoundInstance, ndShapeBox* const box, const ndVector& posit)
+{
+  ndMatrix localMatrix(ndGetIdentityMatrix());
+  localMatrix.m_posit = posit;
+  ndShapeInstance child(box);
+  child.SetLocalMatrix(localMatrix);
+  compoundInstance.GetShape()->GetAsShapeCompound()->AddCollision(&child);
+}
+
+static void AddBoxChild(ndShapeInstance& compoundInstance, const ndVector& size, const ndVector& posit)
+{
+  AddBoxChild(compoundInstance, new ndShapeBox(size.m_x, size.m_y, size.m_z), posit);
+}
+
+/* A compound resting on a compound floor must settle on top of it,
+   child pairs that stay apart are skipped by the narrow phase cache. */
+TEST(CompoundCollision, CompoundRestOnCompound) {
+  ndWorld world;
+  world.SetSubSteps(2);
+
+  // floor made of a grid of tiles, the top face is at y = 0
+  ndShapeInstance floorShape(new ndShapeCompound());
+  floorShape.GetShape()->GetAsShapeCompound()->BeginAddRemove();
+  for (ndInt32 i = 0; i < 4; ++i) {
+    for (ndInt32 j = 0; j < 4; ++j) {
+      const ndVector posit(ndFloat32(i * 2 - 3), -0.5f, ndFloat32(j * 2 - 3), 1.0f);
+      AddBoxChild(floorShape, ndVector(2.0f, 1.0f, 2.0f, 0.0f), posit);
+    }
+  }
+  floorShape.GetShape()->GetAsShapeCompound()->EndAddRemove();
+
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  floor->SetMatrix(ndGetIdentityMatrix());
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  // dumbbell of two boxes and a bar
+  ndShapeInstance bodyShape(new ndShapeCompound());
+  bodyShape.GetShape()->GetAsShapeCompound()->BeginAddRemove();
+  ndCountingBox* const end = new ndCountingBox(1.0f, 1.0f, 1.0f);
+  ndCountingBox* const pad = new ndCountingBox(0.5f, 0.5f, 0.5f);
+  AddBoxChild(bodyShape, end, ndVector(-1.5f, 0.0f, 0.0f, 1.0f));
+  AddBoxChild(bodyShape, ndVector(1.0f, 1.0f, 1.0f, 0.0f), ndVector(1.5f, 0.0f, 0.0f, 1.0f));
+  AddBoxChild(bodyShape, ndVector(2.0f, 0.25f, 0.25f, 0.0f), ndVector(0.0f, 0.0f, 0.0f, 1.0f));
+  // a pad hanging a little above the tiles
+  AddBoxChild(bodyShape, pad, ndVector(0.0f, -0.2f, 0.0f, 1.0f));
+  bodyShape.GetShape()->GetAsShapeCompound()->EndAddRemove();
+
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit = ndVector(0.25f, 2.0f, 0.25f, 1.0f);
+  ndBodyDynamic* const body = new ndBodyDynamic();
+  body->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+  body->SetMatrix(matrix);
+  body->SetCollisionShape(bodyShape);
+  body->SetMassMatrix(10.0f, bodyShape);
+  body->SetAutoSleep(false);
+  ndSharedPtr<ndBody> bodyPtr(body);
+  world.AddBody(bodyPtr);
+
+  for (ndInt32 i = 0; i < 120; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  // the boxes are half a unit tall, so the body rests at y = 0.5
+  const ndVector posit(body->GetMatrix().m_posit);
+  EXPECT_NEAR(posit.m_y, 0.5f, 0.05f);
+  EXPECT_NEAR(posit.m_x, 0.25f, 0.05f);
+  EXPECT_NEAR(posit.m_z, 0.25f, 0.05f);
+
+  // slide the body slowly, the end boxes are tested every frame but the pad 
+  // is inside the tiles aabb and only tested when the motion uses up its gap
+  ndInt32 endFrames = 0;
+  ndInt32 padFrames = 0;
+  for (ndInt32 i = 0; i < 60; ++i) {
+    const ndInt32 endCount = end->m_supportCount;
+    const ndInt32 padCount = pad->m_supportCount;
+    body->SetVelocity(ndVector(0.25f, 0.0f, 0.0f, 0.0f));
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+    endFrames += (end->m_supportCount != endCount) ? 1 : 0;
+    padFrames += (pad->m_supportCount != padCount) ? 1 : 0;
+  }
+  EXPECT_EQ(endFrames, 60);
+  EXPECT_GT(padFrames, 0);
+  EXPECT_LT(padFrames, endFrames / 4);
+  world.CleanUp();
+}
+
+/* Removing and moving children must refit the compound bounds. */
+TEST(CompoundCollision, IncrementalRemoveAndRefit) {
+  ndShapeInstance compoundInstance(new ndShapeCompound());
+  ndShapeCompound* const compound = compoundInstance.GetShape()->GetAsShapeCompound();
+
+  ndShapeCompound::ndTreeArray::ndNode* nodes[16];
+  compound->BeginAddRemove();
+  for (ndInt32 i = 0; i < 16; ++i) {
+    ndMatrix localMatrix(ndGetIdentityMatrix());
+    localMatrix.m_posit = ndVector(ndFloat32(i * 2), 0.0f, 0.0f, 1.0f);
+    ndShapeInstance child(new ndShapeBox(1.0f, 1.0f, 1.0f));
+    child.SetLocalMatrix(localMatrix);
+    nodes[i] = compound->AddCollision(&child);
+  }
+  compound->EndAddRemove();
+
+  ndVector p0;
+  ndVector p1;
+  compoundInstance.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  EXPECT_NEAR(p1.m_x, 30.5f, 0.2f);
+
+  // the aabb is padded by a small margin, remove the upper half one child at a time
+  for (ndInt32 i = 15; i >= 8; --i) {
+    compound->BeginAddRemove();
+    compound->RemoveNode(nodes[i]);
+    compound->EndAddRemove();
+  }
+  EXPECT_EQ(compound->GetTree().GetCount(), 8);
+  compoundInstance.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  EXPECT_NEAR(p1.m_x, 14.5f, 0.2f);
+  EXPECT_NEAR(p1.m_y, 0.5f, 0.2f);
+
+  // move the first child up with only a refit
+  ndMatrix localMatrix(ndGetIdentityMatrix());
+  localMatrix.m_posit = ndVector(0.0f, 10.0f, 0.0f, 1.0f);
+  compound->BeginAddRemove();
+  compound->SetSubShapeLocalMatrix(nodes[0], localMatrix);
+  compound->EndAddRemove();
+  compoundInstance.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  EXPECT_NEAR(p1.m_y, 10.5f, 0.2f);
+  EXPECT_NEAR(p0.m_y, -0.5f, 0.2f);
+
+  // mix an interface move with an in place edit of another child, both are picked up
+  const ndUnsigned32 version = compound->GetVersion();
+  localMatrix.m_posit = ndVector(0.0f, 20.0f, 0.0f, 1.0f);
+  compound->BeginAddRemove();
+  compound->SetSubShapeLocalMatrix(nodes[0], localMatrix);
+  EXPECT_NE(compound->GetVersion(), version);
+  localMatrix.m_posit = ndVector(2.0f, -20.0f, 0.0f, 1.0f);
+  compound->GetShapeInstance(nodes[1])->SetLocalMatrix(localMatrix);
+  compound->MarkChildDirty(nodes[1]);
+  compound->EndAddRemove();
+  compoundInstance.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  EXPECT_NEAR(p1.m_y, 20.5f, 0.2f);
+  EXPECT_NEAR(p0.m_y, -20.5f, 0.2f);
+
+  // reading the children does not change the compound
+  const ndUnsigned32 readVersion = compound->GetVersion();
+  const ndUnsigned64 hash = compound->GetHash(0);
+  EXPECT_TRUE(compound->GetShapeInstance(nodes[2]) != nullptr);
+  EXPECT_EQ(compound->GetHash(0), hash);
+  EXPECT_EQ(compound->GetVersion(), readVersion);
+
+  // the children that remain must still be reachable from the tree
+  const ndShapeCompound::ndTreeArray& tree = compound->GetTree();
+  ndShapeCompound::ndTreeArray::Iterator it(tree);
+  ndInt32 count = 0;
+  for (it.Begin(); it; it++) {
+    count++;
+  }
+  EXPECT_EQ(count, 8);
+}
@@ -0,0 +1,146 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+/* Points are kept in order in a buffer out of the contact, and the list can
+   still be walked node by node. */
+TEST(ContactManifold, ContiguousPoints) {
+  // the point data does not make the contact any larger
+  EXPECT_LT(sizeof(ndContact), 2 * sizeof(ndContactMaterial));
+
+  ndContactPointList list;
+  EXPECT_EQ(list.GetCapacity(), 0);
+  for (ndInt32 i = 0; i < D_CONTACT_MIN_POINTS_CAPACITY; ++i) {
+    list.Append()->GetInfo().m_penetration = ndFloat32(i);
+  }
+  EXPECT_EQ(list.GetCapacity(), D_CONTACT_MIN_POINTS_CAPACITY);
+
+  for (ndInt32 i = D_CONTACT_MIN_POINTS_CAPACITY; i < 10; ++i) {
+    ndContactMaterial point;
+    point.m_penetration = ndFloat32(i);
+    list.Append(point);
+  }
+  EXPECT_EQ(list.GetCount(), 10);
+  EXPECT_EQ(list.GetCapacity(), 16);
+
+  list.Remove(3);
+  list.Remove(list.GetFirst());
+  ndInt32 count = 0;
+  ndFloat32 expected[] = { 1.0f, 2.0f, 4.0f, 5.0f, 6.0f, 7.0f, 8.0f, 9.0f };
+  for (ndContactPointList::ndNode* node = list.GetFirst(); node; node = node->GetNext()) {
+    EXPECT_EQ(node->GetInfo().m_penetration, expected[count]);
+    EXPECT_EQ(list[count].m_penetration, expected[count]);
+    count++;
+  }
+  EXPECT_EQ(count, list.GetCount());
+  EXPECT_EQ(list.GetLast()->GetInfo().m_penetration, 9.0f);
+
+  // the buffer is kept for the next manifold
+  const ndInt32 capacity = list.GetCapacity();
+  list.RemoveAll();
+  EXPECT_EQ(list.GetFirst(), (ndContactPointList::ndNode*)nullptr);
+  list.Append();
+  EXPECT_EQ(list.GetCapacity(), capacity);
+}
+
+/* Resting boxes keep their manifolds in the smallest buffer. */
+TEST(ContactManifold, RestingBoxes) {
+  ndWorld world;
+  world.SetThreadCount(2);
+
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit.m_y = -0.5f;
+  floor->SetMatrix(matrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  const ndInt32 boxCount = 256;
+  for (ndInt32 i = 0; i < boxCount; ++i) {
+    matrix.m_posit = ndVector(ndFloat32(i % 16) * 1.5f, 0.5f + ndFloat32(i / 128), ndFloat32((i / 16) % 8) * 1.5f, 1.0f);
+    ndBodyDynamic* const box = new ndBodyDynamic();
+    box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    box->SetMatrix(matrix);
+    box->SetCollisionShape(boxShape);
+    box->SetMassMatrix(1.0f, boxShape);
+    box->SetAutoSleep(false);
+    ndSharedPtr<ndBody> boxPtr(box);
+    world.AddBody(boxPtr);
+  }
+
+  for (ndInt32 i = 0; i < 120; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  ndInt32 touching = 0;
+  const ndContactArray& contacts = world.GetContactList();
+  for (ndInt32 i = 0; i < ndInt32(contacts.GetCount()); ++i) {
+    const ndContact* const contact = contacts[i];
+    if (contact->IsActive() && contact->GetContactPoints().GetCount()) {
+      touching++;
+      EXPECT_LE(contact->GetContactPoints().GetCount(), D_CONTACT_MIN_POINTS_CAPACITY);
+      EXPECT_EQ(contact->GetContactPoints().GetCapacity(), D_CONTACT_MIN_POINTS_CAPACITY);
+    }
+  }
+  EXPECT_GE(touching, boxCount);
+  world.CleanUp();
+}
+
+/* The contact constructor checks at compile time that the hot data spans at 
+   most two cache lines when the contact starts at offset 0 or 32 of a line, 
+   the contacts made by the scene must be aligned for that check to hold. */
+TEST(ContactManifold, ContactAlignment) {
+  ndWorld world;
+  world.SetThreadCount(2);
+
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit.m_y = -0.5f;
+  floor->SetMatrix(matrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  // rows of touching boxes, so that boxes have contacts with each other and with the floor
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  const ndInt32 boxCount = 1024;
+  for (ndInt32 i = 0; i < boxCount; ++i) {
+    matrix.m_posit = ndVector(ndFloat32(i % 32) * 1.01f, 0.5f, ndFloat32(i / 32) * 1.5f, 1.0f);
+    ndBodyDynamic* const box = new ndBodyDynamic();
+    box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    box->SetMatrix(matrix);
+    box->SetCollisionShape(boxShape);
+    box->SetMassMatrix(1.0f, boxShape);
+    box->SetAutoSleep(false);
+    ndSharedPtr<ndBody> boxPtr(box);
+    world.AddBody(boxPtr);
+  }
+
+  for (ndInt32 i = 0; i < 60; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  const ndContactArray& contacts = world.GetContactList();
+  const ndInt32 contactCount = ndInt32(contacts.GetCount());
+  ASSERT_GT(contactCount, boxCount);
+  for (ndInt32 i = 0; i < contactCount; ++i) {
+    EXPECT_EQ(size_t(contacts[i]) % D_MEMORY_ALIGMNET, size_t(0));
+  }
+  world.CleanUp();
+}
@@ -0,0 +1,96 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define PILE_GRID 16
+#define PILE_HEIGHT 3
+
+/* A floor touching hundreds of boxes, the floor contact map must stay
+   consistent while contacts are created and deleted. */
+TEST(ContactMap, PileUpOnFloor) {
+  ndWorld world;
+  world.SetSubSteps(2);
+  world.SetThreadCount(4);
+
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndMatrix floorMatrix(ndGetIdentityMatrix());
+  floorMatrix.m_posit.m_y = -0.5f;
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  floor->SetMatrix(floorMatrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndArray<ndBodyKinematic*> boxes;
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  for (ndInt32 k = 0; k < PILE_HEIGHT; ++k) {
+    for (ndInt32 i = 0; i < PILE_GRID; ++i) {
+      for (ndInt32 j = 0; j < PILE_GRID; ++j) {
+        ndMatrix matrix(ndGetIdentityMatrix());
+        matrix.m_posit = ndVector(ndFloat32(i) * 1.01f, 0.5f + ndFloat32(k) * 1.01f, ndFloat32(j) * 1.01f, 1.0f);
+        ndBodyDynamic* const box = new ndBodyDynamic();
+        box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+        box->SetMatrix(matrix);
+        box->SetCollisionShape(boxShape);
+        box->SetMassMatrix(1.0f, boxShape);
+        ndSharedPtr<ndBody> boxPtr(box);
+        world.AddBody(boxPtr);
+        boxes.PushBack(box);
+      }
+    }
+  }
+
+  for (ndInt32 i = 0; i < 60; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  // every box of the bottom layer is in the floor contact map
+  const ndBodyKinematic::ndContactMap& floorContacts = floor->GetContactMap();
+  EXPECT_TRUE(floorContacts.SanityCheck());
+  EXPECT_GE(floorContacts.GetCount(), PILE_GRID * PILE_GRID);
+  for (ndInt32 i = 0; i < PILE_GRID * PILE_GRID; ++i) {
+    const ndContact* const contact = floorContacts.FindContact(floor, boxes[i]);
+    ASSERT_TRUE(contact != nullptr);
+    EXPECT_TRUE(contact == boxes[i]->GetContactMap().FindContact(boxes[i], floor));
+  }
+
+  ndInt32 count = 0;
+  ndBodyKinematic::ndContactMap::Iterator it(floorContacts);
+  for (it.Begin(); it; it++) {
+    const ndContact* const contact = *it;
+    EXPECT_TRUE((contact->GetBody0() == floor) || (contact->GetBody1() == floor));
+    count++;
+  }
+  EXPECT_EQ(count, floorContacts.GetCount());
+
+  // removing the top layer deletes its contacts from the maps of the layer below
+  for (ndInt32 i = ndInt32(boxes.GetCount()) - 1; i >= 2 * PILE_GRID * PILE_GRID; --i) {
+    world.RemoveBody(boxes[i]);
+  }
+  for (ndInt32 i = 0; i < 10; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  for (ndInt32 i = PILE_GRID * PILE_GRID; i < 2 * PILE_GRID * PILE_GRID; ++i) {
+    EXPECT_TRUE(boxes[i]->GetContactMap().SanityCheck());
+    ndBodyKinematic::ndContactMap::Iterator iter(boxes[i]->GetContactMap());
+    for (iter.Begin(); iter; iter++) {
+      const ndContact* const contact = *iter;
+      const ndBodyKinematic* const other = (contact->GetBody0() == boxes[i]) ? contact->GetBody1() : contact->GetBody0();
+      EXPECT_TRUE(other->GetScene() != nullptr);
+    }
+  }
+  EXPECT_TRUE(floorContacts.SanityCheck());
+  world.CleanUp();
+}
@@ -0,0 +1,107 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include "ndTestThreadPool.h"
+
+// a mesh that records the progress reports, and cancels after a few of them
+class ndTestMesh : public ndMeshEffect
+{
+  public:
+  ndTestMesh(const ndShapeInstance& shape, ndInt32 cancelAfter)
+    :ndMeshEffect(shape)
+    ,m_lastProgress(0.0f)
+    ,m_reportCount(0)
+    ,m_cancelAfter(cancelAfter)
+  {
+  }
+
+  virtual bool ReportProgress(ndFloat32 progress) const
+  {
+    m_lastProgress = progress;
+    m_reportCount++;
+    return m_reportCount < m_cancelAfter;
+  }
+
+  mutable ndFloat32 m_lastProgress;
+  mutable ndInt32 m_reportCount;
+  ndInt32 m_cancelAfter;
+};
+
+static void BuildCloud(ndArray<ndVector>& cloud, ndInt32 count)
+{
+  ndSetRandSeed(count);
+  for (ndInt32 i = 0; i < count; ++i) {
+    cloud.PushBack(ndVector(ndRand() * 1.8f - 0.9f, ndRand() * 0.8f - 0.4f, ndRand() * 1.8f - 0.9f, 0.0f));
+  }
+}
+
+static void GetPieceVolumes(ndShapeInstance* const compoundInstance, ndArray<ndFloat32>& volumes)
+{
+  ndShapeCompound* const compound = compoundInstance->GetShape()->GetAsShapeCompound();
+  ndShapeCompound::ndTreeArray::Iterator it(compound->GetTree());
+  for (it.Begin(); it; it++) {
+    volumes.PushBack(it.GetNode()->GetInfo()->GetShape()->GetVolume());
+  }
+}
+
+/* The compound is the same for any thread count and its pieces fill the mesh. */
+TEST(ConvexDecomposition, VoronoiCompound) {
+  ndShapeInstance box(new ndShapeBox(2.0f, 1.0f, 2.0f));
+  ndTestMesh mesh(box, 0x7fffffff);
+  ndArray<ndVector> cloud;
+  BuildCloud(cloud, 64);
+
+  ndTestThreadPool serialPool("convexDecomposition", 1);
+  ndShapeInstance* const serial = mesh.CreateVoronoiConvexCompound(serialPool, cloud);
+  ASSERT_TRUE(serial != nullptr);
+  EXPECT_EQ(mesh.m_lastProgress, 1.0f);
+
+  // completion is reported even when the last cell is done by a worker thread
+  mesh.m_lastProgress = 0.0f;
+  ndTestThreadPool parallelPool("convexDecomposition", 4);
+  ndShapeInstance* const parallel = mesh.CreateVoronoiConvexCompound(parallelPool, cloud);
+  ASSERT_TRUE(parallel != nullptr);
+  EXPECT_EQ(mesh.m_lastProgress, 1.0f);
+
+  ndArray<ndFloat32> serialVolumes;
+  ndArray<ndFloat32> parallelVolumes;
+  GetPieceVolumes(serial, serialVolumes);
+  GetPieceVolumes(parallel, parallelVolumes);
+  ASSERT_EQ(serialVolumes.GetCount(), parallelVolumes.GetCount());
+  EXPECT_GT(ndInt32(serialVolumes.GetCount()), 32);
+
+  // the pieces do not overlap and cover the box
+  ndFloat32 volume = 0.0f;
+  for (ndInt32 i = 0; i < ndInt32(serialVolumes.GetCount()); ++i) {
+    EXPECT_EQ(serialVolumes[i], parallelVolumes[i]);
+    volume += serialVolumes[i];
+  }
+  EXPECT_NEAR(volume, 4.0f, 4.0f * 1.0e-3f);
+
+  delete serial;
+  delete parallel;
+}
+
+/* Returning false from the progress report cancels the decomposition. */
+TEST(ConvexDecomposition, Cancel) {
+  ndShapeInstance box(new ndShapeBox(2.0f, 1.0f, 2.0f));
+  ndTestMesh mesh(box, 4);
+  ndArray<ndVector> cloud;
+  BuildCloud(cloud, 64);
+
+  ndTestThreadPool threadPool("convexDecomposition", 1);
+  ndShapeInstance* const compound = mesh.CreateVoronoiConvexCompound(threadPool, cloud);
+  EXPECT_TRUE(compound == nullptr);
+  EXPECT_EQ(mesh.m_reportCount, 4);
+  EXPECT_LT(mesh.m_lastProgress, 1.0f);
+}
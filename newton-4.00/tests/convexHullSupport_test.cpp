@@ -0,0 +1,37 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+ *
+ * This software is provided 'as-is', without any express or implied
+ * warranty. In no event will the authors be held liable for any damages
+ * arising from the use of this software.
+ *
+ * Permission is granted to anyone to use this software for any purpose,
+ * including commercial applications, and to alter it and redistribute it
+ * freely
+ */
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+TEST(ConvexHull, CachedSupportVertex)
+{
+	ndFixSizeArray<ndVector, 256> points;
+	for (ndInt32 i = 0; i < 200; ++i)
+	{
+		const ndVector dir(ndGaussianRandom(0.0f, 1.0f), ndGaussianRandom(0.0f, 1.0f), ndGaussianRandom(0.0f, 1.0f), ndFloat32(0.0f));
+		points.PushBack(dir.Normalize().Scale(ndRand() * 0.5f + 1.0f));
+	}
+
+	ndShapeInstance hull(new ndShapeConvexHull(points.GetCount(), sizeof(ndVector), ndFloat32(0.0f), &points[0].m_x));
+	EXPECT_GT(hull.GetConvexVertexCount(), 24);
+
+	ndInt32 cache = 0;
+	for (ndInt32 i = 0; i < 1000; ++i)
+	{
+		const ndVector dir(ndVector(ndGaussianRandom(0.0f, 1.0f), ndGaussianRandom(0.0f, 1.0f), ndGaussianRandom(0.0f, 1.0f), ndFloat32(0.0f)).Normalize());
+		const ndVector p0(hull.SupportVertex(dir));
+		const ndVector p1(hull.SupportVertexSpecial(dir, &cache));
+		const ndFloat32 proj0 = p0.DotProduct(dir).GetScalar();
+		const ndFloat32 proj1 = p1.DotProduct(dir).GetScalar();
+		EXPECT_NEAR(proj0, proj1, 1.0e-5f);
+	}
+}
@@ -0,0 +1,122 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include "ndTestThreadPool.h"
+
+// random points inside a unit ball, with a fraction on the surface
+static void BuildBallCloud(ndArray<ndBigVector>& points, ndInt32 count)
+{
+  ndSetRandSeed(count);
+  points.SetCount(0);
+  while (ndInt32(points.GetCount()) < count) {
+    const ndBigVector p(ndRand() * 2.0f - 1.0f, ndRand() * 2.0f - 1.0f, ndRand() * 2.0f - 1.0f, 0.0f);
+    const ndFloat64 mag2 = p.DotProduct(p & ndBigVector::m_triplexMask).GetScalar();
+    if ((mag2 > 1.0e-6f) && (mag2 <= 1.0f)) {
+      points.PushBack((ndInt32(points.GetCount()) & 3) ? p : p.Scale(1.0f / sqrt(mag2)));
+    }
+  }
+}
+
+// a cubic lattice, every face of the hull has many coplanar points
+static void BuildLatticeCloud(ndArray<ndBigVector>& points, ndInt32 count)
+{
+  const ndInt32 side = ndInt32(ceil(pow(ndFloat64(count), 1.0 / 3.0)));
+  points.SetCount(0);
+  for (ndInt32 i = 0; (i < side * side * side) && (ndInt32(points.GetCount()) < count); ++i) {
+    points.PushBack(ndBigVector(ndFloat64(i % side), ndFloat64((i / side) % side), ndFloat64(i / (side * side)), 0.0f).Scale(0.1f));
+  }
+}
+
+// every input point is inside or on the hull
+static bool IsEnclosed(const ndConvexHull3d& hull, const ndArray<ndBigVector>& points)
+{
+  const ndArray<ndBigVector>& vertex = hull.GetVertexPool();
+  for (ndConvexHull3d::ndNode* node = hull.GetFirst(); node; node = node->GetNext()) {
+    const ndConvexHull3dFace& face = node->GetInfo();
+    const ndBigPlane plane(vertex[face.m_index[0]], vertex[face.m_index[1]], vertex[face.m_index[2]]);
+    const ndFloat64 mag = sqrt(plane.DotProduct(plane & ndBigVector::m_triplexMask).GetScalar());
+    for (ndInt32 i = 0; i < ndInt32(points.GetCount()); ++i) {
+      if (plane.Evalue(points[i]) > mag * 1.0e-6f) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+/* Hulls of degenerate and random clouds enclose every input point. */
+TEST(ConvexHull3d, Robustness) {
+  ndArray<ndBigVector> points;
+  BuildLatticeCloud(points, 1000);
+  ndConvexHull3d lattice(&points[0].m_x, sizeof(ndBigVector), ndInt32(points.GetCount()), 0.0f);
+  EXPECT_TRUE(IsEnclosed(lattice, points));
+  ndFloat64 volume;
+  ndFloat64 area;
+  lattice.CalculateVolumeAndSurfaceArea(volume, area);
+  EXPECT_NEAR(volume, 0.9 * 0.9 * 0.9, 1.0e-6);
+
+  BuildBallCloud(points, 2000);
+  ndConvexHull3d ball(&points[0].m_x, sizeof(ndBigVector), ndInt32(points.GetCount()), 0.0f);
+  EXPECT_TRUE(IsEnclosed(ball, points));
+  EXPECT_GT(ball.GetCount(), 500);
+}
+
+/* Hulls build on clouds of 1k to 100k points. */
+TEST(ConvexHull3d, LargeClouds) {
+  ndArray<ndBigVector> points;
+  for (ndInt32 count = 1000; count <= 100000; count *= 10) {
+    BuildBallCloud(points, count);
+    ndConvexHull3d ball(&points[0].m_x, sizeof(ndBigVector), count, 0.0f);
+
+    BuildLatticeCloud(points, count);
+    ndConvexHull3d lattice(&points[0].m_x, sizeof(ndBigVector), count, 0.0f);
+    EXPECT_GT(ball.GetCount(), 0);
+    EXPECT_GT(lattice.GetCount(), 0);
+  }
+}
+
+/* A batch of hulls built across the thread pool matches the serial build. */
+TEST(ConvexHull3d, ParallelBatch) {
+  ndTestThreadPool threadPool("convexHull");
+
+  const ndInt32 hullCount = 64;
+  ndArray<ndBigVector> points;
+  ndArray<ndFloat32> clouds[hullCount];
+  ndInt32 pointCount[hullCount];
+  const ndFloat32* vertexArray[hullCount];
+  for (ndInt32 i = 0; i < hullCount; ++i) {
+    pointCount[i] = 500 + i * 100;
+    BuildBallCloud(points, pointCount[i]);
+    for (ndInt32 j = 0; j < pointCount[i]; ++j) {
+      clouds[i].PushBack(ndFloat32(points[j].m_x));
+      clouds[i].PushBack(ndFloat32(points[j].m_y));
+      clouds[i].PushBack(ndFloat32(points[j].m_z));
+    }
+    vertexArray[i] = &clouds[i][0];
+  }
+
+  ndShapeConvexHull* serial[hullCount];
+  for (ndInt32 i = 0; i < hullCount; ++i) {
+    serial[i] = new ndShapeConvexHull(pointCount[i], 3 * sizeof(ndFloat32), 0.0f, vertexArray[i]);
+  }
+
+  ndShapeConvexHull* batch[hullCount];
+  ndShapeConvexHull::CreateHulls(threadPool, hullCount, pointCount, vertexArray, 3 * sizeof(ndFloat32), 0.0f, batch);
+
+  for (ndInt32 i = 0; i < hullCount; ++i) {
+    ndShapeInstance serialInstance(serial[i]);
+    ndShapeInstance batchInstance(batch[i]);
+    EXPECT_EQ(serialInstance.GetVolume(), batchInstance.GetVolume());
+    EXPECT_GT(batchInstance.GetVolume(), 3.0f);
+  }
+}
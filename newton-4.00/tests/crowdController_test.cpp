@@ -0,0 +1,142 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define AGENT_RADIUS 0.3f
+#define AGENT_HEIGHT 1.8f
+#define AGENT_STEP 0.3f
+
+static void AddStaticBox(ndWorld& world, const ndVector& size, const ndVector& posit)
+{
+  ndShapeInstance shape(new ndShapeBox(size.m_x, size.m_y, size.m_z));
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit = posit;
+  matrix.m_posit.m_w = 1.0f;
+  ndBodyKinematic* const body = new ndBodyDynamic();
+  body->SetMatrix(matrix);
+  body->SetCollisionShape(shape);
+  ndSharedPtr<ndBody> bodyPtr(body);
+  world.AddBody(bodyPtr);
+}
+
+static ndBodyCrowdController* AddCrowd(ndWorld& world)
+{
+  // a floor with its top at zero
+  AddStaticBox(world, ndVector(400.0f, 1.0f, 400.0f, 0.0f), ndVector(0.0f, -0.5f, 0.0f, 0.0f));
+
+  ndBodyCrowdController* const crowd = new ndBodyCrowdController(AGENT_RADIUS, AGENT_HEIGHT, AGENT_STEP);
+  crowd->SetGravity(ndVector(0.0f, -10.0f, 0.0f, 0.0f));
+  ndSharedPtr<ndBody> crowdPtr(crowd);
+  world.AddBody(crowdPtr);
+  return crowd;
+}
+
+static void Simulate(ndWorld& world, ndInt32 frames)
+{
+  for (ndInt32 i = 0; i < frames; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+}
+
+/* Agents fall on the floor, walk over low steps, and stop at walls. */
+TEST(CrowdController, MoveAndSlide) {
+  ndWorld world;
+  world.SetThreadCount(2);
+  ndBodyCrowdController* const crowd = AddCrowd(world);
+
+  // a low step and a wall across the agent paths
+  AddStaticBox(world, ndVector(1.0f, 0.2f, 2.0f, 0.0f), ndVector(2.5f, 0.1f, 0.0f, 0.0f));
+  AddStaticBox(world, ndVector(1.0f, 2.0f, 2.0f, 0.0f), ndVector(2.5f, 1.0f, 10.0f, 0.0f));
+
+  const ndInt32 stepAgent = crowd->AddAgent(ndVector(0.0f, 1.0f, 0.0f, 0.0f));
+  const ndInt32 wallAgent = crowd->AddAgent(ndVector(0.0f, 1.0f, 10.0f, 0.0f));
+  const ndInt32 fallAgent = crowd->AddAgent(ndVector(-10.0f, 3.0f, 0.0f, 0.0f));
+
+  Simulate(world, 60);
+  for (ndInt32 i = 0; i < crowd->GetAgentCount(); ++i) {
+    EXPECT_TRUE(crowd->IsOnFloor(i));
+    EXPECT_NEAR(crowd->GetPositions()[i].m_y, 0.0f, 0.05f);
+  }
+
+  crowd->SetDesiredVelocity(stepAgent, ndVector(1.0f, 0.0f, 0.0f, 0.0f));
+  crowd->SetDesiredVelocity(wallAgent, ndVector(1.0f, 0.0f, 0.0f, 0.0f));
+  Simulate(world, 150);
+
+  // on top of the step
+  const ndVector p0(crowd->GetPositions()[stepAgent]);
+  EXPECT_NEAR(p0.m_x, 2.5f, 0.1f);
+  EXPECT_NEAR(p0.m_y, 0.2f, 0.05f);
+  EXPECT_TRUE(crowd->IsOnFloor(stepAgent));
+
+  // against the wall
+  const ndVector p1(crowd->GetPositions()[wallAgent]);
+  EXPECT_NEAR(p1.m_x, 2.0f - AGENT_RADIUS, 0.05f);
+  EXPECT_NEAR(p1.m_y, 0.0f, 0.05f);
+
+  // the agent that did not move stays put
+  EXPECT_NEAR(crowd->GetPositions()[fallAgent].m_x, -10.0f, 1.0e-3f);
+  world.CleanUp();
+}
+
+/* Overlapping agents are pushed apart without rigid contacts. */
+TEST(CrowdController, Separation) {
+  ndWorld world;
+  world.SetThreadCount(2);
+  ndBodyCrowdController* const crowd = AddCrowd(world);
+  for (ndInt32 i = 0; i < 8; ++i) {
+    crowd->AddAgent(ndVector(ndFloat32(i) * 0.05f, 0.0f, ndFloat32(i & 1) * 0.05f, 0.0f));
+  }
+
+  Simulate(world, 120);
+  const ndArray<ndVector>& posit = crowd->GetPositions();
+  for (ndInt32 i = 0; i < crowd->GetAgentCount(); ++i) {
+    for (ndInt32 j = i + 1; j < crowd->GetAgentCount(); ++j) {
+      const ndVector diff(posit[i] - posit[j]);
+      const ndFloat32 dist = ndSqrt(diff.m_x * diff.m_x + diff.m_z * diff.m_z);
+      EXPECT_GT(dist, 2.0f * AGENT_RADIUS * 0.9f);
+    }
+  }
+  world.CleanUp();
+}
+
+/* Thousands of agents walking across the floor. */
+TEST(CrowdController, LargeCrowd) {
+  ndWorld world;
+  world.SetThreadCount(4);
+  ndBodyCrowdController* const crowd = AddCrowd(world);
+
+  const ndInt32 side = 72;
+  for (ndInt32 i = 0; i < side; ++i) {
+    for (ndInt32 j = 0; j < side; ++j) {
+      const ndInt32 agent = crowd->AddAgent(ndVector(ndFloat32(i) * 1.0f - 36.0f, 0.0f, ndFloat32(j) * 1.0f - 36.0f, 0.0f));
+      crowd->SetDesiredVelocity(agent, ndVector(((i + j) & 1) ? 1.0f : -1.0f, 0.0f, 0.5f, 0.0f));
+    }
+  }
+
+  Simulate(world, 60);
+
+  ndInt32 onFloor = 0;
+  for (ndInt32 i = 0; i < crowd->GetAgentCount(); ++i) {
+    onFloor += crowd->IsOnFloor(i) ? 1 : 0;
+    EXPECT_NEAR(crowd->GetPositions()[i].m_y, 0.0f, 0.05f);
+  }
+  EXPECT_EQ(onFloor, crowd->GetAgentCount());
+
+  // removing an agent moves the last one in its place
+  const ndVector last(crowd->GetPositions()[crowd->GetAgentCount() - 1]);
+  crowd->RemoveAgent(0);
+  EXPECT_EQ(crowd->GetAgentCount(), side * side - 1);
+  EXPECT_EQ(crowd->GetPositions()[0].m_x, last.m_x);
+  world.CleanUp();
+}
@@ -0,0 +1,80 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+/* A frame that spills to the heap grows the arena, so the same frame
+   fits in the arena after the next reset. */
+TEST(FrameArena, GrowsToPeak) {
+  ndFrameArena arena;
+  for (ndInt32 frame = 0; frame < 4; ++frame) {
+    arena.Reset();
+    const ndUnsigned64 heapCalls = arena.GetHeapCallCount();
+    for (ndInt32 i = 0; i < 100; ++i) {
+      ndInt32* const buffer = arena.Alloc<ndInt32>(1000 + i);
+      EXPECT_EQ(ndUnsigned64(buffer) & (D_MEMORY_ALIGMNET - 1), 0u);
+      buffer[0] = i;
+      buffer[999 + i] = i;
+    }
+    if (frame > 1) {
+      EXPECT_EQ(arena.GetHeapCallCount(), heapCalls);
+    }
+  }
+  EXPECT_GE(arena.GetCapacity(), arena.GetPeakUsage());
+  EXPECT_EQ(arena.GetUsage(), arena.GetPeakUsage());
+
+  arena.CleanUp();
+  EXPECT_EQ(arena.GetCapacity(), size_t(0));
+}
+
+/* Steady steps take their transient buffers from the arenas only. */
+TEST(FrameArena, WorldSteadyState) {
+  ndWorld world;
+  world.SetSubSteps(2);
+  world.SetThreadCount(2);
+
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit.m_y = -0.5f;
+  floor->SetMatrix(matrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  for (ndInt32 i = 0; i < 64; ++i) {
+    matrix.m_posit = ndVector(ndFloat32(i % 8) * 1.5f, 0.5f + ndFloat32(i / 32), ndFloat32((i / 8) % 4) * 1.5f, 1.0f);
+    ndBodyDynamic* const box = new ndBodyDynamic();
+    box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    box->SetMatrix(matrix);
+    box->SetCollisionShape(boxShape);
+    box->SetMassMatrix(1.0f, boxShape);
+    box->SetAutoSleep(false);
+    ndSharedPtr<ndBody> boxPtr(box);
+    world.AddBody(boxPtr);
+  }
+
+  for (ndInt32 i = 0; i < 30; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  ndScene* const scene = world.GetScene();
+  const ndUnsigned64 heapCalls = scene->GetFrameArena().GetHeapCallCount();
+  for (ndInt32 i = 0; i < 30; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  EXPECT_GT(scene->GetFrameArenaPeakUsage(), size_t(0));
+  EXPECT_EQ(scene->GetFrameArena().GetHeapCallCount(), heapCalls);
+  world.CleanUp();
+}
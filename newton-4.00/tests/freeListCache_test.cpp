@@ -0,0 +1,105 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include <thread>
+#include "ndTestThreadPool.h"
+
+typedef ndList<ndInt32, ndContainersFreeListAlloc<ndInt32> > ndTestList;
+
+/* Threads churning list nodes are served by their own caches, and the
+   global lock is only taken once per batch. */
+TEST(FreeListCache, ThreadCaches) {
+  ndTestThreadPool threadPool("freeListCache");
+  ndFreeListAlloc::ResetStats();
+
+  const ndInt32 rounds = 200;
+  const ndInt32 nodeCount = 1000;
+  ndAtomic<ndInt32> checksum(0);
+  auto Churn = ndMakeObject::ndFunction([&checksum](ndInt32, ndInt32)
+  {
+    ndTestList list;
+    ndInt32 sum = 0;
+    for (ndInt32 i = 0; i < rounds; ++i) {
+      for (ndInt32 j = 0; j < nodeCount; ++j) {
+        list.Append(j);
+      }
+      for (ndTestList::ndNode* node = list.GetFirst(); node; node = node->GetNext()) {
+        sum += node->GetInfo();
+      }
+      list.RemoveAll();
+    }
+    checksum.fetch_add(sum);
+  });
+  threadPool.ParallelExecute(Churn);
+
+  const ndInt32 threadCount = threadPool.GetThreadCount();
+  EXPECT_EQ(checksum.load(), threadCount * rounds * (nodeCount * (nodeCount - 1) / 2));
+
+  ndFreeListAlloc::ndStats stats;
+  ndFreeListAlloc::GetStats(stats);
+  const ndUnsigned64 operations = ndUnsigned64(threadCount) * rounds * nodeCount * 2;
+  // the counters of threads that have not taken the lock lately may lag by up to a batch
+  EXPECT_GT(stats.m_cacheHits, operations * 9 / 10);
+  EXPECT_LT(stats.m_lockCount, operations / 16);
+  EXPECT_LE(stats.m_lockContentions, stats.m_lockCount);
+  ndFreeListAlloc::Flush();
+}
+
+/* Flushing releases the nodes held by the calling thread cache. */
+TEST(FreeListCache, Flush) {
+  const ndUnsigned64 memory0 = ndMemory::GetMemoryUsed();
+  {
+    ndTestList list;
+    for (ndInt32 i = 0; i < 1000; ++i) {
+      list.Append(i);
+    }
+  }
+  EXPECT_GT(ndMemory::GetMemoryUsed(), memory0);
+  ndTestList::FlushFreeList();
+  EXPECT_LE(ndMemory::GetMemoryUsed(), memory0);
+}
+
+// a thread local built before the thread cache, so it is destroyed after it
+class ndTestLateFree
+{
+  public:
+  ndTestLateFree()
+    :m_list(nullptr)
+  {
+  }
+
+  ~ndTestLateFree()
+  {
+    delete m_list;
+  }
+
+  ndTestList* m_list;
+};
+
+/* Nodes freed on a thread after its cache is gone go back to the global lists. */
+TEST(FreeListCache, FreeAfterThreadCache) {
+  ndFreeListAlloc::Flush();
+  const ndUnsigned64 memory0 = ndMemory::GetMemoryUsed();
+  std::thread thread([]()
+  {
+    static thread_local ndTestLateFree lateFree;
+    lateFree.m_list = new ndTestList;
+    for (ndInt32 i = 0; i < 100; ++i) {
+      lateFree.m_list->Append(i);
+    }
+  });
+  thread.join();
+
+  ndFreeListAlloc::Flush();
+  EXPECT_LE(ndMemory::GetMemoryUsed(), memory0);
+}
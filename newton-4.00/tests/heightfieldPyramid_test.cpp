@@ -0,0 +1,109 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define TERRAIN_SIZE 513
+
+static ndShapeHeightfield* BuildTerrain()
+{
+  ndShapeHeightfield* const heightfield = new ndShapeHeightfield(TERRAIN_SIZE, TERRAIN_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f);
+  ndArray<ndReal>& elevation = heightfield->GetElevationMap();
+  for (ndInt32 z = 0; z < TERRAIN_SIZE; ++z) {
+    for (ndInt32 x = 0; x < TERRAIN_SIZE; ++x) {
+      elevation[z * TERRAIN_SIZE + x] = 4.0f * ndSin(ndFloat32(x) * 0.05f) * ndCos(ndFloat32(z) * 0.03f);
+    }
+  }
+  heightfield->UpdateElevationMapAabb();
+  return heightfield;
+}
+
+static bool CastRay(const ndShapeInstance& instance, const ndVector& p0, const ndVector& p1, ndVector& hit)
+{
+  ndRayCastClosestHitCallback callback;
+  if (callback.TraceShape(p0, p1, instance, ndGetIdentityMatrix())) {
+    hit = callback.m_contact.m_point;
+    return true;
+  }
+  return false;
+}
+
+static ndFloat32 ElevationAt(const ndShapeInstance& instance, ndFloat32 x, ndFloat32 z)
+{
+  ndVector hit;
+  const bool state = CastRay(instance, ndVector(x, 100.0f, z, 1.0f), ndVector(x, -100.0f, z, 1.0f), hit);
+  return state ? hit.m_y : -1000.0f;
+}
+
+/* Long shallow rays skip the empty space over the terrain and must
+   still report the first surface crossing. */
+TEST(HeightfieldPyramid, LongRays) {
+  ndShapeInstance instance(BuildTerrain());
+
+  ndInt32 hitCount = 0;
+  for (ndInt32 i = 0; i < 64; ++i) {
+    const ndFloat32 z = 4.0f + ndFloat32(i) * 7.7f;
+    const ndVector p0(0.5f, 6.0f, z, 1.0f);
+    const ndVector p1(ndFloat32(TERRAIN_SIZE - 2), -3.0f, z + 20.0f, 1.0f);
+    ndVector hit;
+    if (CastRay(instance, p0, p1, hit)) {
+      hitCount++;
+      EXPECT_NEAR(hit.m_y, ElevationAt(instance, hit.m_x, hit.m_z), 1.0e-2f);
+
+      // the ray is above the terrain before the hit
+      for (ndInt32 j = 1; j < 8; ++j) {
+        const ndVector q(p0 + (hit - p0).Scale(ndFloat32(j) / 8.0f));
+        EXPECT_GT(q.m_y, ElevationAt(instance, q.m_x, q.m_z) - 1.0e-2f);
+      }
+    }
+  }
+  EXPECT_GT(hitCount, 32);
+
+  // a ray above the highest point misses without touching a cell
+  ndVector hit;
+  EXPECT_FALSE(CastRay(instance, ndVector(0.5f, 5.0f, 0.5f, 1.0f), ndVector(510.0f, 5.0f, 510.0f, 1.0f), hit));
+}
+
+/* Editing a region only refreshes the blocks that contain it. */
+TEST(HeightfieldPyramid, IncrementalUpdate) {
+  ndShapeInstance instance(new ndShapeHeightfield(TERRAIN_SIZE, TERRAIN_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const heightfield = instance.GetShape()->GetAsShapeHeightfield();
+
+  // a flat terrain does not stop a low horizontal ray
+  ndVector hit;
+  const ndVector p0(1.0f, 0.5f, 300.5f, 1.0f);
+  const ndVector p1(500.0f, 0.5f, 300.5f, 1.0f);
+  EXPECT_FALSE(CastRay(instance, p0, p1, hit));
+
+  // raise a wall across the ray path
+  const ndUnsigned32 version = heightfield->GetVersion();
+  ndArray<ndReal>& elevation = heightfield->GetElevationMap();
+  for (ndInt32 z = 290; z <= 310; ++z) {
+    for (ndInt32 x = 400; x <= 402; ++x) {
+      elevation[z * TERRAIN_SIZE + x] = 2.0f;
+    }
+  }
+  heightfield->UpdateElevationMapAabb(400, 290, 402, 310);
+  EXPECT_NE(heightfield->GetVersion(), version);
+
+  EXPECT_TRUE(CastRay(instance, p0, p1, hit));
+  EXPECT_GT(hit.m_x, 399.0f);
+  EXPECT_LT(hit.m_x, 401.0f);
+
+  // the region bounds see the wall, the rest of the terrain stays flat
+  ndVector boxP0;
+  ndVector boxP1;
+  heightfield->GetLocalAabb(ndVector(395.0f, -1.0f, 295.0f, 0.0f), ndVector(405.0f, 1.0f, 305.0f, 0.0f), boxP0, boxP1);
+  EXPECT_FLOAT_EQ(boxP1.m_y, 2.0f);
+  heightfield->GetLocalAabb(ndVector(10.0f, -1.0f, 10.0f, 0.0f), ndVector(300.0f, 1.0f, 300.0f, 0.0f), boxP0, boxP1);
+  EXPECT_FLOAT_EQ(boxP1.m_y, 0.0f);
+}
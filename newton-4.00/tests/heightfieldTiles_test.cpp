@@ -0,0 +1,184 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define TILE_SIZE 16
+#define TILE_COUNT 4
+#define GRID_SIZE (TILE_SIZE * TILE_COUNT + 1)
+
+static void LoadTile(ndShapeHeightfield* const heightfield, ndInt32 tile_x, ndInt32 tile_z, ndReal base)
+{
+  // a gentle slope along x, border vertices are shared with the neighbor tiles
+  ndReal elevation[(TILE_SIZE + 1) * (TILE_SIZE + 1)];
+  for (ndInt32 z = 0; z <= TILE_SIZE; ++z) {
+    for (ndInt32 x = 0; x <= TILE_SIZE; ++x) {
+      const ndInt32 gx = tile_x * TILE_SIZE + x;
+      elevation[z * (TILE_SIZE + 1) + x] = base + ndReal(gx) * 0.01f;
+    }
+  }
+  heightfield->SetTile(tile_x, tile_z, elevation, nullptr);
+}
+
+static ndFloat32 CastDown(const ndShapeInstance& instance, ndFloat32 x, ndFloat32 z)
+{
+  ndRayCastClosestHitCallback callback;
+  const ndVector p0(x, 20.0f, z, 1.0f);
+  const ndVector p1(x, -20.0f, z, 1.0f);
+  if (callback.TraceShape(p0, p1, instance, ndGetIdentityMatrix())) {
+    return callback.m_contact.m_point.m_y;
+  }
+  return -1000.0f;
+}
+
+/* Tiles can be loaded, updated and unloaded at runtime,
+   rays only hit cells of resident tiles. */
+TEST(HeightfieldTiles, LoadUpdateUnload) {
+  ndShapeInstance instance(new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, TILE_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const heightfield = instance.GetShape()->GetAsShapeHeightfield();
+  EXPECT_EQ(heightfield->GetTileCount_x(), TILE_COUNT);
+  EXPECT_EQ(heightfield->GetTileCount_z(), TILE_COUNT);
+
+  // nothing is resident yet
+  EXPECT_LT(CastDown(instance, 10.5f, 10.5f), -100.0f);
+
+  for (ndInt32 i = 0; i < TILE_COUNT; ++i) {
+    for (ndInt32 j = 0; j < TILE_COUNT; ++j) {
+      LoadTile(heightfield, i, j, 1.0f);
+    }
+  }
+  EXPECT_TRUE(heightfield->IsTileResident(1, 1));
+
+  // the quantization error is a fraction of the tile elevation range
+  EXPECT_NEAR(CastDown(instance, 10.5f, 10.5f), 1.0f + 10.5f * 0.01f, 1.0e-3f);
+  EXPECT_NEAR(CastDown(instance, 40.5f, 50.5f), 1.0f + 40.5f * 0.01f, 1.0e-3f);
+
+  // a tile border is read from either of its tiles
+  EXPECT_NEAR(CastDown(instance, 16.0f, 16.0f), 1.0f + 16.0f * 0.01f, 1.0e-3f);
+
+  // update a resident tile in place
+  LoadTile(heightfield, 0, 0, 3.0f);
+  EXPECT_NEAR(CastDown(instance, 10.5f, 10.5f), 3.0f + 10.5f * 0.01f, 1.0e-3f);
+
+  // unload it, rays go through the hole
+  heightfield->UnloadTile(0, 0);
+  EXPECT_FALSE(heightfield->IsTileResident(0, 0));
+  EXPECT_LT(CastDown(instance, 10.5f, 10.5f), -100.0f);
+  EXPECT_NEAR(CastDown(instance, 20.5f, 10.5f), 1.0f + 20.5f * 0.01f, 1.0e-3f);
+}
+
+/* Bodies rest on resident tiles and fall through the ones that are not. */
+TEST(HeightfieldTiles, ContactsOnResidentTiles) {
+  ndWorld world;
+  world.SetSubSteps(2);
+
+  ndShapeInstance floorShape(new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, TILE_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const heightfield = floorShape.GetShape()->GetAsShapeHeightfield();
+  for (ndInt32 i = 0; i < TILE_COUNT; ++i) {
+    for (ndInt32 j = 0; j < TILE_COUNT; ++j) {
+      if (i || j) {
+        LoadTile(heightfield, i, j, 0.0f);
+      }
+    }
+  }
+
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  floor->SetMatrix(ndGetIdentityMatrix());
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndBodyDynamic* boxes[2];
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  for (ndInt32 i = 0; i < 2; ++i) {
+    // the first box is above the unloaded tile
+    ndMatrix matrix(ndGetIdentityMatrix());
+    matrix.m_posit = ndVector(8.5f + ndFloat32(i * 32), 2.0f, 8.5f, 1.0f);
+    boxes[i] = new ndBodyDynamic();
+    boxes[i]->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    boxes[i]->SetMatrix(matrix);
+    boxes[i]->SetCollisionShape(boxShape);
+    boxes[i]->SetMassMatrix(1.0f, boxShape);
+    ndSharedPtr<ndBody> boxPtr(boxes[i]);
+    world.AddBody(boxPtr);
+  }
+
+  for (ndInt32 i = 0; i < 90; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  EXPECT_LT(boxes[0]->GetMatrix().m_posit.m_y, -1.0f);
+  EXPECT_NEAR(boxes[1]->GetMatrix().m_posit.m_y, 0.5f + 40.5f * 0.01f, 0.1f);
+  world.CleanUp();
+}
+
+/* A border vertex is read from one of its two tiles, the bounds of the 
+   other tile must include it even if the tiles disagree on its elevation. */
+TEST(HeightfieldTiles, SharedBorderBounds) {
+  ndShapeInstance instance(new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, TILE_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const heightfield = instance.GetShape()->GetAsShapeHeightfield();
+
+  ndReal elevation[(TILE_SIZE + 1) * (TILE_SIZE + 1)];
+  for (ndInt32 i = 0; i < (TILE_SIZE + 1) * (TILE_SIZE + 1); ++i) {
+    elevation[i] = 0.0f;
+  }
+  heightfield->SetTile(0, 0, elevation, nullptr);
+  const ndUnsigned64 hash0 = instance.GetShape()->GetHash();
+  for (ndInt32 i = 0; i < (TILE_SIZE + 1) * (TILE_SIZE + 1); ++i) {
+    elevation[i] = 5.0f;
+  }
+  heightfield->SetTile(1, 0, elevation, nullptr);
+  EXPECT_NE(instance.GetShape()->GetHash(), hash0);
+
+  // the last cells of the first tile rise to the border read from the second tile, 
+  // a ray over the first tile only must not skip them.
+  ndRayCastClosestHitCallback callback;
+  const ndVector p0(1.0f, 2.5f, 8.5f, 1.0f);
+  const ndVector p1(15.9f, 2.5f, 8.5f, 1.0f);
+  ASSERT_TRUE(callback.TraceShape(p0, p1, instance, ndGetIdentityMatrix()));
+  EXPECT_NEAR(callback.m_contact.m_point.m_x, 15.5f, 1.0e-3f);
+
+  // the same flat tile at another location is another shape
+  ndShapeInstance other(new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, TILE_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const otherHeightfield = other.GetShape()->GetAsShapeHeightfield();
+  otherHeightfield->SetTile(0, 1, elevation, nullptr);
+  heightfield->UnloadTile(0, 0);
+  EXPECT_NE(other.GetShape()->GetHash(), instance.GetShape()->GetHash());
+}
+
+/* The partial blocks of a region query read shared border vertices 
+   from the same tile as the cells. */
+TEST(HeightfieldTiles, PartialBlockBounds) {
+  ndShapeInstance instance(new ndShapeHeightfield(GRID_SIZE, GRID_SIZE, TILE_SIZE, ndShapeHeightfield::m_normalDiagonals, 1.0f, 1.0f));
+  ndShapeHeightfield* const heightfield = instance.GetShape()->GetAsShapeHeightfield();
+
+  // the first tile has its own copy of the right border at 0, the second tile has it at 5
+  ndReal elevation[(TILE_SIZE + 1) * (TILE_SIZE + 1)];
+  for (ndInt32 z = 0; z <= TILE_SIZE; ++z) {
+    for (ndInt32 x = 0; x <= TILE_SIZE; ++x) {
+      elevation[z * (TILE_SIZE + 1) + x] = (x == TILE_SIZE) ? 0.0f : 1.0f;
+    }
+  }
+  heightfield->SetTile(0, 0, elevation, nullptr);
+  for (ndInt32 i = 0; i < (TILE_SIZE + 1) * (TILE_SIZE + 1); ++i) {
+    elevation[i] = 5.0f;
+  }
+  heightfield->SetTile(1, 0, elevation, nullptr);
+
+  // the copy at 0 is never read, so it is not in the region bounds
+  ndVector boxP0;
+  ndVector boxP1;
+  heightfield->GetLocalAabb(ndVector(2.0f, -1.0f, 2.0f, 0.0f), ndVector(14.0f, 1.0f, 6.0f, 0.0f), boxP0, boxP1);
+  EXPECT_NEAR(boxP0.m_y, 1.0f, 1.0e-4f);
+  EXPECT_FLOAT_EQ(boxP1.m_y, 5.0f);
+}
@@ -0,0 +1,249 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include "ndTestThreadPool.h"
+
+#define ISO_GRID_SIZE 0.1f
+
+// a ball of particles, one every half voxel
+static void BuildBall(ndArray<ndVector>& points, const ndVector& center, ndFloat32 radius)
+{
+  const ndInt32 steps = ndInt32(radius / (ISO_GRID_SIZE * 0.5f));
+  for (ndInt32 z = -steps; z <= steps; ++z) {
+    for (ndInt32 y = -steps; y <= steps; ++y) {
+      for (ndInt32 x = -steps; x <= steps; ++x) {
+        const ndVector p(ndVector(ndFloat32(x), ndFloat32(y), ndFloat32(z), 0.0f).Scale(ISO_GRID_SIZE * 0.5f));
+        if (p.DotProduct(p).GetScalar() <= radius * radius) {
+          points.PushBack(center + p);
+        }
+      }
+    }
+  }
+}
+
+// area weighted centroid and total area of a triangle list
+static void MeshMoments(const ndArray<ndVector>& points, const ndArray<ndInt32>& indices, ndVector& centroid, ndFloat32& area)
+{
+  area = 0.0f;
+  centroid = ndVector::m_zero;
+  for (ndInt32 i = 0; i < ndInt32(indices.GetCount()); i += 3) {
+    const ndVector& p0 = points[indices[i + 0]];
+    const ndVector& p1 = points[indices[i + 1]];
+    const ndVector& p2 = points[indices[i + 2]];
+    const ndVector normal((p1 - p0).CrossProduct(p2 - p0));
+    const ndFloat32 triangleArea = ndSqrt(normal.DotProduct(normal).GetScalar()) * 0.5f;
+    area += triangleArea;
+    centroid += (p0 + p1 + p2).Scale(triangleArea / 3.0f);
+  }
+  centroid = centroid.Scale(1.0f / area);
+}
+
+static void GetMesh(ndThreadPool& threadPool, const ndIsoSurface& isoSurface, ndArray<ndVector>& points, ndArray<ndInt32>& indices, ndArray<ndVector>* const vertexNormals = nullptr)
+{
+  ndArray<ndReal> posit;
+  ndArray<ndReal> normals;
+  posit.SetCount(isoSurface.GetVertexCount() * 3);
+  normals.SetCount(isoSurface.GetVertexCount() * 3);
+  indices.SetCount(isoSurface.GetIndexCount());
+  isoSurface.GetMesh(threadPool, &indices[0], 3, &posit[0], &normals[0]);
+
+  points.SetCount(0);
+  for (ndInt32 i = 0; i < isoSurface.GetVertexCount(); ++i) {
+    points.PushBack(ndVector(posit[i * 3 + 0], posit[i * 3 + 1], posit[i * 3 + 2], 0.0f));
+    if (vertexNormals) {
+      vertexNormals->PushBack(ndVector(normals[i * 3 + 0], normals[i * 3 + 1], normals[i * 3 + 2], 0.0f));
+    }
+  }
+}
+
+/* The incremental mesher produces the same surface as the serial mesher. */
+TEST(IsoSurface, MatchesSerialMesh) {
+  ndTestThreadPool threadPool("isoSurface");
+
+  ndArray<ndVector> cloud;
+  BuildBall(cloud, ndVector(0.33f, -0.71f, 1.27f, 0.0f), 1.0f);
+
+  ndIsoSurface serial;
+  serial.GenerateMesh(cloud, ISO_GRID_SIZE);
+  ndArray<ndVector> serialPoints;
+  ndArray<ndInt32> serialIndices;
+  for (ndInt32 i = 0; i < ndInt32(serial.GetPoints().GetCount()); ++i) {
+    serialPoints.PushBack(serial.GetPoints()[i] + serial.GetOrigin());
+    serialIndices.PushBack(i);
+  }
+
+  ndIsoSurface incremental;
+  incremental.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  ndArray<ndVector> points;
+  ndArray<ndInt32> indices;
+  GetMesh(threadPool, incremental, points, indices);
+  EXPECT_EQ(incremental.GetIndexCount(), ndInt32(serialIndices.GetCount()));
+
+  ndFloat32 area0;
+  ndFloat32 area1;
+  ndVector centroid0;
+  ndVector centroid1;
+  MeshMoments(serialPoints, serialIndices, centroid0, area0);
+  MeshMoments(points, indices, centroid1, area1);
+  EXPECT_NEAR(area0, area1, area0 * 1.0e-4f);
+  EXPECT_NEAR(centroid0.m_x, centroid1.m_x, 1.0e-3f);
+  EXPECT_NEAR(centroid0.m_y, centroid1.m_y, 1.0e-3f);
+  EXPECT_NEAR(centroid0.m_z, centroid1.m_z, 1.0e-3f);
+
+  // normals point out of the ball
+  ndInt32 outward = 0;
+  for (ndInt32 i = 0; i < ndInt32(indices.GetCount()); i += 3) {
+    const ndVector& p0 = points[indices[i + 0]];
+    const ndVector normal((points[indices[i + 1]] - p0).CrossProduct(points[indices[i + 2]] - p0));
+    outward += (normal.DotProduct(p0 - centroid1).GetScalar() > 0.0f) ? 1 : 0;
+  }
+  EXPECT_EQ(outward * 3, ndInt32(indices.GetCount()));
+}
+
+/* Only the blocks around moved particles are remeshed. */
+TEST(IsoSurface, IncrementalUpdate) {
+  ndTestThreadPool threadPool("isoSurface");
+
+  ndArray<ndVector> cloud;
+  BuildBall(cloud, ndVector(0.0f, 0.0f, 0.0f, 0.0f), 1.5f);
+
+  ndIsoSurface isoSurface;
+  isoSurface.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  const ndInt32 blockCount = isoSurface.GetRemeshedBlockCount();
+  EXPECT_GT(blockCount, 64);
+
+  // nothing moved
+  isoSurface.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  EXPECT_EQ(isoSurface.GetRemeshedBlockCount(), 0);
+
+  // a drop leaves the surface
+  const ndInt32 dropCount = 16;
+  for (ndInt32 i = 0; i < dropCount; ++i) {
+    cloud[i] = ndVector(0.0f, 2.0f, 0.0f, 0.0f) + ndVector(ndFloat32(i & 1), ndFloat32((i >> 1) & 1), ndFloat32(i >> 2), 0.0f).Scale(ISO_GRID_SIZE * 0.5f);
+  }
+  isoSurface.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  EXPECT_GT(isoSurface.GetRemeshedBlockCount(), 0);
+  EXPECT_LT(isoSurface.GetRemeshedBlockCount(), 24);
+
+  // the updated mesh is the same as a mesh built from scratch
+  ndIsoSurface fresh;
+  fresh.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  EXPECT_EQ(isoSurface.GetIndexCount(), fresh.GetIndexCount());
+  EXPECT_EQ(isoSurface.GetVertexCount(), fresh.GetVertexCount());
+
+  ndArray<ndVector> points0;
+  ndArray<ndVector> points1;
+  ndArray<ndInt32> indices0;
+  ndArray<ndInt32> indices1;
+  GetMesh(threadPool, isoSurface, points0, indices0);
+  GetMesh(threadPool, fresh, points1, indices1);
+  for (ndInt32 i = 0; i < ndInt32(indices0.GetCount()); ++i) {
+    ASSERT_EQ(indices0[i], indices1[i]);
+  }
+  for (ndInt32 i = 0; i < ndInt32(points0.GetCount()); ++i) {
+    const ndVector diff(points0[i] - points1[i]);
+    ASSERT_EQ(diff.DotProduct(diff).GetScalar(), 0.0f);
+  }
+
+  // removing every particle empties the mesh
+  cloud.SetCount(0);
+  isoSurface.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  EXPECT_EQ(isoSurface.GetIndexCount(), 0);
+  EXPECT_EQ(isoSurface.GetVertexCount(), 0);
+}
+
+/* Vertices on block borders are shared, so the mesh of a ball is closed, and
+   their normals include the faces of every block around them. */
+TEST(IsoSurface, SharedBlockBorders) {
+  ndTestThreadPool threadPool("isoSurface");
+
+  ndArray<ndVector> cloud;
+  BuildBall(cloud, ndVector(0.33f, -0.71f, 1.27f, 0.0f), 1.0f);
+
+  ndIsoSurface isoSurface;
+  isoSurface.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  ndArray<ndVector> points;
+  ndArray<ndInt32> indices;
+  ndArray<ndVector> normals;
+  GetMesh(threadPool, isoSurface, points, indices, &normals);
+
+  // no two vertices at the same place
+  ndTree<ndInt32, ndUnsigned64> positions;
+  for (ndInt32 i = 0; i < ndInt32(points.GetCount()); ++i) {
+    const ndVector p((points[i].Scale(2.0f / ISO_GRID_SIZE) + ndVector(1024.0f)).Floor().GetInt());
+    const ndUnsigned64 key = (ndUnsigned64(p.m_iz) << 40) | (ndUnsigned64(p.m_iy) << 20) | ndUnsigned64(p.m_ix);
+    ASSERT_TRUE(positions.Insert(i, key) != nullptr);
+  }
+
+  // every edge is used by exactly two triangles
+  ndTree<ndInt32, ndUnsigned64> edges;
+  for (ndInt32 i = 0; i < ndInt32(indices.GetCount()); i += 3) {
+    for (ndInt32 j = 0; j < 3; ++j) {
+      const ndUnsigned64 i0 = ndUnsigned64(indices[i + j]);
+      const ndUnsigned64 i1 = ndUnsigned64(indices[i + (j + 1) % 3]);
+      const ndUnsigned64 key = (i0 < i1) ? ((i0 << 32) | i1) : ((i1 << 32) | i0);
+      ndTree<ndInt32, ndUnsigned64>::ndNode* node = edges.Find(key);
+      if (!node) {
+        node = edges.Insert(0, key);
+      }
+      node->GetInfo()++;
+    }
+  }
+  ndTree<ndInt32, ndUnsigned64>::Iterator it(edges);
+  for (it.Begin(); it; it++) {
+    ASSERT_EQ(*it, 2);
+  }
+
+  // normals match the average of all the faces around each vertex
+  ndArray<ndVector> faceNormals;
+  faceNormals.SetCount(points.GetCount());
+  for (ndInt32 i = 0; i < ndInt32(points.GetCount()); ++i) {
+    faceNormals[i] = ndVector::m_zero;
+  }
+  for (ndInt32 i = 0; i < ndInt32(indices.GetCount()); i += 3) {
+    const ndVector& p0 = points[indices[i + 0]];
+    const ndVector normal((points[indices[i + 1]] - p0).CrossProduct(points[indices[i + 2]] - p0));
+    for (ndInt32 j = 0; j < 3; ++j) {
+      faceNormals[indices[i + j]] += normal;
+    }
+  }
+  for (ndInt32 i = 0; i < ndInt32(points.GetCount()); ++i) {
+    const ndVector n(faceNormals[i].Normalize());
+    EXPECT_NEAR(n.DotProduct(normals[i]).GetScalar(), 1.0f, 1.0e-3f);
+  }
+}
+
+/* Clouds that span more than a thousand blocks are not folded over. */
+TEST(IsoSurface, LargeExtent) {
+  ndTestThreadPool threadPool("isoSurface");
+
+  ndArray<ndVector> cloud;
+  BuildBall(cloud, ndVector(0.0f, 0.0f, 0.0f, 0.0f), 0.5f);
+  ndIsoSurface single;
+  single.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+
+  // the second ball is about 1250 blocks away
+  BuildBall(cloud, ndVector(1000.0f, 0.0f, 0.0f, 0.0f), 0.5f);
+  ndIsoSurface pair;
+  pair.GenerateMesh(threadPool, cloud, ISO_GRID_SIZE);
+  EXPECT_EQ(pair.GetIndexCount(), single.GetIndexCount() * 2);
+
+  ndArray<ndVector> points;
+  ndArray<ndInt32> indices;
+  GetMesh(threadPool, pair, points, indices);
+  ndInt32 farCount = 0;
+  for (ndInt32 i = 0; i < ndInt32(points.GetCount()); ++i) {
+    farCount += (points[i].m_x > 500.0f) ? 1 : 0;
+  }
+  EXPECT_EQ(farCount * 2, ndInt32(points.GetCount()));
+}
@@ -0,0 +1,132 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include "ndTestThreadPool.h"
+
+static ndUnsigned64 CategoryBytes(ndMemory::ndCategory category)
+{
+  ndMemory::ndCategoryInfo info;
+  ndMemory::GetCategoryInfo(category, info);
+  return info.m_bytes;
+}
+
+/* Allocations take the category of the enclosing scope, and free list
+   nodes move to the category of the scope that recycles them. */
+TEST(MemoryCategory, Scopes) {
+  const ndUnsigned64 solver0 = CategoryBytes(ndMemory::m_solver);
+  void* const ptr = ndMemory::Malloc(1000, ndMemory::m_solver);
+  EXPECT_EQ(ndMemory::GetCategory(ptr), ndMemory::m_solver);
+  EXPECT_EQ(CategoryBytes(ndMemory::m_solver), solver0 + ndMemory::GetSize(ptr));
+  ndMemory::Free(ptr);
+  EXPECT_EQ(CategoryBytes(ndMemory::m_solver), solver0);
+
+  ndList<ndInt32, ndContainersFreeListAlloc<ndInt32> > list;
+  {
+    ndMemory::ndCategoryScope scope(ndMemory::m_bvh);
+    EXPECT_EQ(ndMemory::GetCategory(), ndMemory::m_bvh);
+    {
+      ndMemory::ndCategoryScope nested(ndMemory::m_contacts);
+      EXPECT_EQ(ndMemory::GetCategory(), ndMemory::m_contacts);
+    }
+    EXPECT_EQ(ndMemory::GetCategory(), ndMemory::m_bvh);
+
+    ndArray<ndInt32> array;
+    array.SetCount(1000);
+    EXPECT_EQ(ndMemory::GetCategory(&array[0]), ndMemory::m_bvh);
+    list.Append(1);
+    EXPECT_EQ(ndMemory::GetCategory(list.GetFirst()), ndMemory::m_bvh);
+    list.RemoveAll();
+  }
+  EXPECT_EQ(ndMemory::GetCategory(), ndMemory::m_general);
+  {
+    ndMemory::ndCategoryScope scope(ndMemory::m_contacts);
+    list.Append(2);
+    EXPECT_EQ(ndMemory::GetCategory(list.GetFirst()), ndMemory::m_contacts);
+    list.RemoveAll();
+  }
+
+  ndUnsigned64 sum = 0;
+  for (ndInt32 i = 0; i < ndMemory::m_categoryCount; ++i) {
+    ndMemory::ndCategoryInfo info;
+    ndMemory::GetCategoryInfo(ndMemory::ndCategory(i), info);
+    EXPECT_GE(info.m_peakBytes, info.m_bytes);
+    sum += info.m_bytes;
+  }
+  EXPECT_EQ(sum, ndMemory::GetMemoryUsed());
+}
+
+/* Jobs run by the workers of a thread pool allocate in the category of the
+   thread that dispatched them. */
+TEST(MemoryCategory, ParallelJobs) {
+  ndTestThreadPool threadPool("memoryCategory");
+  ndMemory::ndCategory categories[D_MAX_THREADS_COUNT];
+  auto Allocate = ndMakeObject::ndFunction([&categories](ndInt32 threadIndex, ndInt32)
+  {
+    void* const ptr = ndMemory::Malloc(256);
+    categories[threadIndex] = ndMemory::GetCategory(ptr);
+    ndMemory::Free(ptr);
+  });
+  {
+    ndMemory::ndCategoryScope scope(ndMemory::m_solver);
+    threadPool.ParallelExecute(Allocate);
+  }
+  for (ndInt32 i = 0; i < threadPool.GetThreadCount(); ++i) {
+    EXPECT_EQ(categories[i], ndMemory::m_solver);
+  }
+
+  threadPool.ParallelExecute(Allocate);
+  for (ndInt32 i = 0; i < threadPool.GetThreadCount(); ++i) {
+    EXPECT_EQ(categories[i], ndMemory::m_general);
+  }
+}
+
+/* A running world reports its memory by subsystem. */
+TEST(MemoryCategory, WorldSubsystems) {
+  ndMemory::ResetPeaks();
+  ndWorld world;
+  world.SetThreadCount(2);
+
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit.m_y = -0.5f;
+  floor->SetMatrix(matrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  for (ndInt32 i = 0; i < 128; ++i) {
+    matrix.m_posit = ndVector(ndFloat32(i % 8) * 1.5f, 0.5f + ndFloat32(i / 64), ndFloat32((i / 8) % 8) * 1.5f, 1.0f);
+    ndBodyDynamic* const box = new ndBodyDynamic();
+    box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    box->SetMatrix(matrix);
+    box->SetCollisionShape(boxShape);
+    box->SetMassMatrix(1.0f, boxShape);
+    ndSharedPtr<ndBody> boxPtr(box);
+    world.AddBody(boxPtr);
+  }
+  for (ndInt32 i = 0; i < 30; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  const ndMemory::ndCategory categories[] = { ndMemory::m_bvh, ndMemory::m_contacts, ndMemory::m_solver };
+  for (ndInt32 i = 0; i < ndInt32(sizeof(categories) / sizeof(categories[0])); ++i) {
+    ndMemory::ndCategoryInfo info;
+    ndMemory::GetCategoryInfo(categories[i], info);
+    EXPECT_GT(info.m_bytes, 0u);
+    EXPECT_GE(info.m_peakBytes, info.m_bytes);
+  }
+  world.CleanUp();
+}
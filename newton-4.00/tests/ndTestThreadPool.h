@@ -0,0 +1,39 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#ifndef __ND_TEST_THREAD_POOL_H__
+#define __ND_TEST_THREAD_POOL_H__
+
+#include "ndNewton.h"
+
+// a thread pool for the tests that drive sdk code outside of a world
+class ndTestThreadPool : public ndThreadPool
+{
+  public:
+  ndTestThreadPool(const char* const name, ndInt32 threadCount = 4)
+    :ndThreadPool(name)
+  {
+    SetThreadCount(threadCount);
+    Begin();
+  }
+
+  ~ndTestThreadPool()
+  {
+    End();
+    Finish();
+  }
+
+  virtual void ThreadFunction()
+  {
+  }
+};
+
+#endif
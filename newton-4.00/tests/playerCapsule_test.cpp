@@ -0,0 +1,113 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+#define PLAYER_GRID 6
+
+class ndTestPlayerCapsule : public ndBodyPlayerCapsule
+{
+  public:
+  ndTestPlayerCapsule(const ndMatrix& localAxis, ndFloat32 speed)
+    :ndBodyPlayerCapsule(localAxis, 100.0f, 0.5f, 1.9f, 0.5f)
+    ,m_speed(speed)
+  {
+  }
+
+  void ApplyInputs(ndFloat32 timestep)
+  {
+    const ndVector gravity(0.0f, -10.0f, 0.0f, 0.0f);
+    m_impulse += gravity.Scale(m_mass * timestep);
+    SetForwardSpeed(m_speed);
+  }
+
+  ndFloat32 m_speed;
+};
+
+static void BuildPlayerScene(ndWorld& world, ndArray<ndBodyKinematic*>& players)
+{
+  ndShapeInstance floorShape(new ndShapeBox(200.0f, 1.0f, 200.0f));
+  ndMatrix floorMatrix(ndGetIdentityMatrix());
+  floorMatrix.m_posit.m_y = -0.5f;
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  floor->SetMatrix(floorMatrix);
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndMatrix localAxis(ndGetIdentityMatrix());
+  localAxis[0] = ndVector(0.0f, 1.0f, 0.0f, 0.0f);
+  localAxis[1] = ndVector(1.0f, 0.0f, 0.0f, 0.0f);
+  localAxis[2] = localAxis[0].CrossProduct(localAxis[1]);
+
+  // players far apart update concurrently
+  for (ndInt32 i = 0; i < PLAYER_GRID; ++i) {
+    for (ndInt32 j = 0; j < PLAYER_GRID; ++j) {
+      ndMatrix matrix(ndGetIdentityMatrix());
+      matrix.m_posit = ndVector(ndFloat32(i * 4), 0.0f, ndFloat32(j * 4), 1.0f);
+      ndTestPlayerCapsule* const player = new ndTestPlayerCapsule(localAxis, 1.0f);
+      player->SetMatrix(matrix);
+      ndSharedPtr<ndBody> playerPtr(player);
+      world.AddBody(playerPtr);
+      players.PushBack(player);
+    }
+  }
+
+  // a pair of overlapping players is updated in the serial pass
+  for (ndInt32 i = 0; i < 2; ++i) {
+    ndMatrix matrix(ndGetIdentityMatrix());
+    matrix.m_posit = ndVector(-10.0f + ndFloat32(i) * 0.8f, 0.0f, -10.0f, 1.0f);
+    ndTestPlayerCapsule* const player = new ndTestPlayerCapsule(localAxis, 0.0f);
+    player->SetMatrix(matrix);
+    ndSharedPtr<ndBody> playerPtr(player);
+    world.AddBody(playerPtr);
+    players.PushBack(player);
+  }
+}
+
+/* Player capsules update on the scene workers, the result must
+   not depend on the thread count. */
+TEST(PlayerCapsule, ParallelSpecialUpdate) {
+  ndVector positions[2][PLAYER_GRID * PLAYER_GRID + 2];
+  for (ndInt32 pass = 0; pass < 2; ++pass) {
+    ndWorld world;
+    world.SetSubSteps(2);
+    world.SetThreadCount(pass ? 4 : 1);
+
+    ndArray<ndBodyKinematic*> players;
+    BuildPlayerScene(world, players);
+    for (ndInt32 i = 0; i < 120; ++i) {
+      world.Update(1.0f / 60.0f);
+      world.Sync();
+    }
+    for (ndInt32 i = 0; i < ndInt32(players.GetCount()); ++i) {
+      positions[pass][i] = players[i]->GetMatrix().m_posit;
+    }
+    world.CleanUp();
+  }
+
+  const ndInt32 count = PLAYER_GRID * PLAYER_GRID;
+  for (ndInt32 i = 0; i < count; ++i) {
+    // players stay on the floor and walk about two units
+    const ndVector start(ndFloat32((i / PLAYER_GRID) * 4), 0.0f, ndFloat32((i % PLAYER_GRID) * 4), 1.0f);
+    const ndVector step(positions[0][i] - start);
+    EXPECT_NEAR(positions[0][i].m_y, 0.0f, 0.05f);
+    EXPECT_GT(ndSqrt(step.m_x * step.m_x + step.m_z * step.m_z), 1.0f);
+
+    const ndVector diff(positions[0][i] - positions[1][i]);
+    EXPECT_NEAR(diff.DotProduct(diff & ndVector::m_triplexMask).GetScalar(), 0.0f, 1.0e-6f);
+  }
+
+  // the overlapping pair pushed each other apart
+  const ndVector separation(positions[1][count + 1] - positions[1][count]);
+  EXPECT_GT(ndAbs(separation.m_x), 0.9f);
+}
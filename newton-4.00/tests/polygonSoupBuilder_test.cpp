@@ -0,0 +1,104 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include "ndTestThreadPool.h"
+
+// a grid with flat patches and bumps, so that the optimizer has faces to merge
+static void AddGrid(ndPolygonSoupBuilder& meshBuilder, ndInt32 size)
+{
+  meshBuilder.Begin();
+  for (ndInt32 i = 0; i < size; ++i) {
+    for (ndInt32 j = 0; j < size; ++j) {
+      ndVector p[4];
+      for (ndInt32 k = 0; k < 4; ++k) {
+        const ndInt32 x = i + (k & 1);
+        const ndInt32 z = j + (k >> 1);
+        const ndFloat32 y = ndFloat32(((x * 7 + z * 13) % 5)) * 0.01f;
+        p[k] = ndVector(ndFloat32(x - size / 2), y, ndFloat32(z - size / 2), 0.0f);
+      }
+      ndVector face0[3] = { p[0], p[2], p[1] };
+      ndVector face1[3] = { p[1], p[2], p[3] };
+      meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, (i >> 4) & 1);
+      meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, (i >> 4) & 1);
+    }
+  }
+}
+
+static void ReadImage(const char* const path, ndArray<char>& data)
+{
+  FILE* const file = fopen(path, "rb");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, 0, SEEK_END);
+  data.SetCount(ndInt32(ftell(file)));
+  fseek(file, 0, SEEK_SET);
+  EXPECT_EQ(fread(&data[0], size_t(data.GetCount()), 1, file), size_t(1));
+  fclose(file);
+  remove(path);
+}
+
+static void ExpectSameMesh(ndShapeStatic_bvh* const mesh0, ndShapeStatic_bvh* const mesh1)
+{
+  ndArray<char> image0;
+  ndArray<char> image1;
+  mesh0->SerializeImage("polygonSoupSerial.bin");
+  mesh1->SerializeImage("polygonSoupParallel.bin");
+  ReadImage("polygonSoupSerial.bin", image0);
+  ReadImage("polygonSoupParallel.bin", image1);
+  ASSERT_EQ(image0.GetCount(), image1.GetCount());
+  EXPECT_EQ(memcmp(&image0[0], &image1[0], size_t(image0.GetCount())), 0);
+}
+
+/* The thread pool builder produces the same mesh as the serial builder. */
+TEST(PolygonSoupBuilder, ParallelMatchesSerial) {
+  ndTestThreadPool threadPool("polygonSoup");
+  for (ndInt32 optimize = 0; optimize < 2; ++optimize) {
+    ndPolygonSoupBuilder serialBuilder;
+    AddGrid(serialBuilder, 96);
+    serialBuilder.End(optimize ? true : false);
+    ndShapeInstance serial(new ndShapeStatic_bvh(serialBuilder));
+
+    ndPolygonSoupBuilder parallelBuilder;
+    AddGrid(parallelBuilder, 96);
+    parallelBuilder.End(threadPool, optimize ? true : false);
+    ndShapeInstance parallel(new ndShapeStatic_bvh(threadPool, parallelBuilder));
+
+    EXPECT_EQ(serialBuilder.m_faceVertexCount.GetCount(), parallelBuilder.m_faceVertexCount.GetCount());
+    EXPECT_EQ(serialBuilder.m_vertexPoints.GetCount(), parallelBuilder.m_vertexPoints.GetCount());
+    if (optimize) {
+      EXPECT_LT(parallelBuilder.m_faceVertexCount.GetCount(), 96 * 96 * 2);
+    }
+    ExpectSameMesh(serial.GetShape()->GetAsShapeStaticBVH(), parallel.GetShape()->GetAsShapeStaticBVH());
+  }
+}
+
+/* Large grids build the same mesh serially and on the thread pool. */
+TEST(PolygonSoupBuilder, LargeGrid) {
+  ndTestThreadPool threadPool("polygonSoup");
+  const ndInt32 sizes[] = { 256, 128 };
+  for (ndInt32 optimize = 0; optimize < 2; ++optimize) {
+    const ndInt32 size = sizes[optimize];
+    ndPolygonSoupBuilder serialBuilder;
+    AddGrid(serialBuilder, size);
+    serialBuilder.End(optimize ? true : false);
+    ndShapeInstance serial(new ndShapeStatic_bvh(serialBuilder));
+
+    ndPolygonSoupBuilder parallelBuilder;
+    AddGrid(parallelBuilder, size);
+    parallelBuilder.End(threadPool, optimize ? true : false);
+    ndShapeInstance parallel(new ndShapeStatic_bvh(threadPool, parallelBuilder));
+
+    EXPECT_EQ(serialBuilder.m_faceVertexCount.GetCount(), parallelBuilder.m_faceVertexCount.GetCount());
+    ExpectSameMesh(serial.GetShape()->GetAsShapeStaticBVH(), parallel.GetShape()->GetAsShapeStaticBVH());
+  }
+}
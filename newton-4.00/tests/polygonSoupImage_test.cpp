@@ -0,0 +1,305 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#define GRID_SIZE 128
+
+static ndShapeStatic_bvh* BuildGridMesh()
+{
+  ndPolygonSoupBuilder meshBuilder;
+  meshBuilder.Begin();
+  for (ndInt32 i = 0; i < GRID_SIZE; ++i) {
+    for (ndInt32 j = 0; j < GRID_SIZE; ++j) {
+      // a slightly bumpy grid so that the faces do not get merged
+      ndVector p[4];
+      for (ndInt32 k = 0; k < 4; ++k) {
+        const ndInt32 x = i + (k & 1);
+        const ndInt32 z = j + (k >> 1);
+        const ndFloat32 y = ndFloat32(((x * 7 + z * 13) % 5)) * 0.01f;
+        p[k] = ndVector(ndFloat32(x - GRID_SIZE / 2), y, ndFloat32(z - GRID_SIZE / 2), 0.0f);
+      }
+      ndVector face0[3] = { p[0], p[2], p[1] };
+      ndVector face1[3] = { p[1], p[2], p[3] };
+      meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, 0);
+      meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, 0);
+    }
+  }
+  meshBuilder.End(false);
+  return new ndShapeStatic_bvh(meshBuilder);
+}
+
+/* A mesh loaded from an image must match the original and the legacy format,
+   and loading it must take a single allocation. */
+TEST(PolygonSoupImage, LoadMemory) {
+  const char* const legacyPath = "polygonSoupLegacy.bin";
+  const char* const imagePath = "polygonSoupImage.bin";
+
+  ndShapeInstance source(BuildGridMesh());
+  ndShapeStatic_bvh* const sourceMesh = source.GetShape()->GetAsShapeStaticBVH();
+  sourceMesh->Serialize(legacyPath);
+  sourceMesh->SerializeImage(imagePath);
+
+  ndVector p0;
+  ndVector p1;
+  sourceMesh->GetAABB(p0, p1);
+
+  // legacy format, one allocation per array
+  ndUnsigned64 memory = ndMemory::GetMemoryUsed();
+  ndShapeInstance legacy(new ndShapeStatic_bvh());
+  legacy.GetShape()->GetAsShapeStaticBVH()->Deserialize(legacyPath);
+  const ndUnsigned64 legacyMemory = ndMemory::GetMemoryUsed() - memory;
+
+  // image format, one read into one allocation
+  memory = ndMemory::GetMemoryUsed();
+  ndShapeInstance image(new ndShapeStatic_bvh());
+  EXPECT_TRUE(image.GetShape()->GetAsShapeStaticBVH()->DeserializeImage(imagePath));
+  const ndUnsigned64 imageMemory = ndMemory::GetMemoryUsed() - memory;
+
+  ndVector q0;
+  ndVector q1;
+  ndShapeStatic_bvh* const imageMesh = image.GetShape()->GetAsShapeStaticBVH();
+  imageMesh->GetAABB(q0, q1);
+  EXPECT_EQ(imageMesh->GetVertexCount(), sourceMesh->GetVertexCount());
+  EXPECT_FLOAT_EQ(q0.m_x, p0.m_x);
+  EXPECT_FLOAT_EQ(q0.m_y, p0.m_y);
+  EXPECT_FLOAT_EQ(q1.m_x, p1.m_x);
+  EXPECT_FLOAT_EQ(q1.m_y, p1.m_y);
+  EXPECT_FLOAT_EQ(q1.m_z, p1.m_z);
+
+  // the image only adds the alignment padding over the legacy layout
+  EXPECT_LE(imageMemory, legacyMemory + 1024);
+
+  // the shape constructor also computes the bounds and the face count
+  ndShapeInstance imageShape(new ndShapeStatic_bvh(imagePath));
+  ndVector r0;
+  ndVector r1;
+  imageShape.GetShape()->GetAsShapeStaticBVH()->GetAABB(r0, r1);
+  EXPECT_FLOAT_EQ(r1.m_x, p1.m_x);
+
+  remove(legacyPath);
+  remove(imagePath);
+}
+
+/* Loading an image is a single read followed by a validation of every node and 
+   face, the legacy format is three reads with no validation. The validation must 
+   stay within a small factor of the read. */
+TEST(PolygonSoupImage, LoadTime) {
+  const char* const legacyPath = "polygonSoupLegacyTime.bin";
+  const char* const imagePath = "polygonSoupImageTime.bin";
+  {
+    ndShapeInstance source(BuildGridMesh());
+    source.GetShape()->GetAsShapeStaticBVH()->Serialize(legacyPath);
+    source.GetShape()->GetAsShapeStaticBVH()->SerializeImage(imagePath);
+  }
+
+  // best of several loads, so that a busy machine does not decide the result
+  ndUnsigned64 legacyTime = ndUnsigned64(-1);
+  ndUnsigned64 imageTime = ndUnsigned64(-1);
+  for (ndInt32 i = 0; i < 8; ++i) {
+    ndUnsigned64 time = ndGetTimeInMicroseconds();
+    ndShapeInstance legacy(new ndShapeStatic_bvh());
+    legacy.GetShape()->GetAsShapeStaticBVH()->Deserialize(legacyPath);
+    legacyTime = ndMin(legacyTime, ndGetTimeInMicroseconds() - time);
+
+    time = ndGetTimeInMicroseconds();
+    ndShapeInstance image(new ndShapeStatic_bvh());
+    const bool state = image.GetShape()->GetAsShapeStaticBVH()->DeserializeImage(imagePath);
+    imageTime = ndMin(imageTime, ndGetTimeInMicroseconds() - time);
+    ASSERT_TRUE(state);
+  }
+  EXPECT_LT(imageTime, legacyTime * 4);
+
+  remove(legacyPath);
+  remove(imagePath);
+}
+
+/* A caller owned image is used in place, the way a memory mapped file is,
+   and bodies must collide with it. */
+TEST(PolygonSoupImage, InPlaceImageCollision) {
+  const char* const imagePath = "polygonSoupInPlace.bin";
+  {
+    ndShapeInstance source(BuildGridMesh());
+    source.GetShape()->GetAsShapeStaticBVH()->SerializeImage(imagePath);
+  }
+
+  FILE* const file = fopen(imagePath, "rb");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, 0, SEEK_END);
+  const size_t size = size_t(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  void* const buffer = ndMemory::Malloc(size);
+  EXPECT_EQ(fread(buffer, size, 1, file), size_t(1));
+  fclose(file);
+  remove(imagePath);
+
+  // a corrupted header must be rejected
+  ndUnsigned32 magic = *((ndUnsigned32*)buffer);
+  *((ndUnsigned32*)buffer) = 0;
+  ndShapeInstance badShape(new ndShapeStatic_bvh(buffer, size));
+  EXPECT_TRUE(badShape.GetShape()->GetAsShapeStaticBVH()->GetRootNode() == nullptr);
+  *((ndUnsigned32*)buffer) = magic;
+
+  {
+    ndWorld world;
+    world.SetSubSteps(2);
+
+    ndShapeInstance floorShape(new ndShapeStatic_bvh(buffer, size));
+    EXPECT_TRUE(floorShape.GetShape()->GetAsShapeStaticBVH()->GetRootNode() != nullptr);
+    ndBodyKinematic* const floor = new ndBodyDynamic();
+    floor->SetMatrix(ndGetIdentityMatrix());
+    floor->SetCollisionShape(floorShape);
+    ndSharedPtr<ndBody> floorPtr(floor);
+    world.AddBody(floorPtr);
+
+    ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+    ndMatrix matrix(ndGetIdentityMatrix());
+    matrix.m_posit = ndVector(0.3f, 2.0f, 0.3f, 1.0f);
+    ndBodyDynamic* const box = new ndBodyDynamic();
+    box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+    box->SetMatrix(matrix);
+    box->SetCollisionShape(boxShape);
+    box->SetMassMatrix(1.0f, boxShape);
+    ndSharedPtr<ndBody> boxPtr(box);
+    world.AddBody(boxPtr);
+
+    for (ndInt32 i = 0; i < 120; ++i) {
+      world.Update(1.0f / 60.0f);
+      world.Sync();
+    }
+
+    // the grid is at most 0.04 units tall
+    const ndVector posit(box->GetMatrix().m_posit);
+    EXPECT_GT(posit.m_y, 0.45f);
+    EXPECT_LT(posit.m_y, 0.6f);
+    world.CleanUp();
+  }
+  ndMemory::Free(buffer);
+}
+
+static size_t GetFileSize(const char* const path)
+{
+  FILE* const file = fopen(path, "rb");
+  if (!file) {
+    return 0;
+  }
+  fseek(file, 0, SEEK_END);
+  const size_t size = size_t(ftell(file));
+  fclose(file);
+  return size;
+}
+
+/* A compact image is smaller than the runtime image and loads into a mesh 
+   that gets the same ray hits as the original. */
+TEST(PolygonSoupImage, CompactImage) {
+  const char* const imagePath = "polygonSoupRuntime.bin";
+  const char* const compactPath = "polygonSoupCompact.bin";
+
+  ndShapeInstance source(BuildGridMesh());
+  ndShapeStatic_bvh* const sourceMesh = source.GetShape()->GetAsShapeStaticBVH();
+  sourceMesh->SerializeImage(imagePath);
+  sourceMesh->SerializeCompactImage(compactPath);
+
+  const size_t imageSize = GetFileSize(imagePath);
+  const size_t compactSize = GetFileSize(compactPath);
+  EXPECT_LT(compactSize * 3, imageSize * 2);
+
+  ndShapeInstance compact(new ndShapeStatic_bvh(compactPath));
+  ndShapeStatic_bvh* const compactMesh = compact.GetShape()->GetAsShapeStaticBVH();
+  ASSERT_TRUE(compactMesh->GetRootNode() != nullptr);
+
+  ndVector p0;
+  ndVector p1;
+  ndVector q0;
+  ndVector q1;
+  sourceMesh->GetAABB(p0, p1);
+  compactMesh->GetAABB(q0, q1);
+  for (ndInt32 i = 0; i < 3; ++i) {
+    EXPECT_EQ(p0[i], q0[i]);
+    EXPECT_EQ(p1[i], q1[i]);
+  }
+
+  const ndMatrix matrix(ndGetIdentityMatrix());
+  for (ndInt32 i = 0; i < 32; ++i) {
+    for (ndInt32 j = 0; j < 32; ++j) {
+      const ndVector origin(ndFloat32(i) * 3.9f - 62.3f, 2.0f, ndFloat32(j) * 3.7f - 58.1f, 1.0f);
+      const ndVector target(origin + ndVector(0.5f, -4.0f, 0.25f, 0.0f));
+      ndRayCastClosestHitCallback hit0;
+      ndRayCastClosestHitCallback hit1;
+      const bool state0 = hit0.TraceShape(origin, target, source, matrix);
+      const bool state1 = hit1.TraceShape(origin, target, compact, matrix);
+      ASSERT_EQ(state0, state1);
+      EXPECT_EQ(hit0.m_param, hit1.m_param);
+    }
+  }
+
+  // a damaged stream must be rejected instead of being expanded
+  FILE* const file = fopen(compactPath, "r+b");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, long(compactSize / 2), SEEK_SET);
+  const char damage[16] = { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 };
+  fwrite(damage, sizeof(damage), 1, file);
+  fclose(file);
+  ndShapeInstance damaged(new ndShapeStatic_bvh());
+  EXPECT_FALSE(damaged.GetShape()->GetAsShapeStaticBVH()->DeserializeImage(compactPath));
+
+  remove(imagePath);
+  remove(compactPath);
+}
+
+/* Node child and face indices of an image are validated before it is used in place. */
+TEST(PolygonSoupImage, DamagedImage) {
+  const char* const imagePath = "polygonSoupDamaged.bin";
+  ndShapeInstance source(BuildGridMesh());
+  ndShapeStatic_bvh* const sourceMesh = source.GetShape()->GetAsShapeStaticBVH();
+  sourceMesh->SerializeImage(imagePath);
+
+  FILE* const file = fopen(imagePath, "rb");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, 0, SEEK_END);
+  const size_t size = size_t(ftell(file));
+  fseek(file, 0, SEEK_SET);
+  void* const buffer = ndMemory::Malloc(size);
+  EXPECT_EQ(fread(buffer, size, 1, file), size_t(1));
+  fclose(file);
+  remove(imagePath);
+
+  // the image is used in place, so the nodes of a valid shape point into the buffer
+  ndAabbPolygonSoup::ndNode* node = nullptr;
+  {
+    ndShapeInstance goodShape(new ndShapeStatic_bvh(buffer, size));
+    ndShapeStatic_bvh* const mesh = goodShape.GetShape()->GetAsShapeStaticBVH();
+    node = mesh->GetRootNode();
+    ASSERT_TRUE(node != nullptr);
+    while (mesh->GetBackNode(node)) {
+      node = mesh->GetBackNode(node);
+    }
+  }
+  ASSERT_TRUE(node->m_left.IsLeaf());
+
+  // a child that points back to the root makes a loop
+  const ndUnsigned32 left = node->m_left.m_node;
+  node->m_left.m_node = 0;
+  ndShapeInstance loopShape(new ndShapeStatic_bvh(buffer, size));
+  EXPECT_TRUE(loopShape.GetShape()->GetAsShapeStaticBVH()->GetRootNode() == nullptr);
+
+  // a face that reads past the index array
+  node->m_left.m_node = left | 0x00ffffff;
+  ndShapeInstance faceShape(new ndShapeStatic_bvh(buffer, size));
+  EXPECT_TRUE(faceShape.GetShape()->GetAsShapeStaticBVH()->GetRootNode() == nullptr);
+
+  node->m_left.m_node = left;
+  ndShapeInstance goodShape(new ndShapeStatic_bvh(buffer, size));
+  EXPECT_TRUE(goodShape.GetShape()->GetAsShapeStaticBVH()->GetRootNode() != nullptr);
+  ndMemory::Free(buffer);
+}
@@ -0,0 +1,216 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+class ndTestProceduralGrid : public ndShapeStaticProceduralMesh
+{
+  public:
+  ndTestProceduralGrid()
+    :ndShapeStaticProceduralMesh(200.0f, 10.0f, 200.0f)
+    ,m_generateCount(0)
+    ,m_height(0.0f)
+  {
+  }
+
+  virtual void GetCollidingFaces(ndPolygonMeshDesc* const data) const
+  {
+    ndShapeStaticProceduralMesh::GetCollidingFaces(data);
+  }
+
+  // a flat grid of unit quads at m_height, every quad that overlaps the box
+  virtual void GetCollidingFaces(const ndVector& minBox, const ndVector& maxBox, ndArray<ndVector>& vertex, ndArray<ndInt32>& faceList, ndArray<ndInt32>& faceMaterial, ndArray<ndInt32>& indexList) const
+  {
+    m_generateCount.fetch_add(1);
+    if ((minBox.m_y > m_height) || (maxBox.m_y < m_height)) {
+      return;
+    }
+    const ndInt32 x0 = ndInt32(ndFloor(minBox.m_x));
+    const ndInt32 z0 = ndInt32(ndFloor(minBox.m_z));
+    const ndInt32 x1 = ndInt32(ndFloor(maxBox.m_x)) + 1;
+    const ndInt32 z1 = ndInt32(ndFloor(maxBox.m_z)) + 1;
+    const ndInt32 base = ndInt32(vertex.GetCount());
+    for (ndInt32 z = z0; z <= z1; ++z) {
+      for (ndInt32 x = x0; x <= x1; ++x) {
+        vertex.PushBack(ndVector(ndFloat32(x), m_height, ndFloat32(z), 0.0f));
+      }
+    }
+    const ndInt32 stride = x1 - x0 + 1;
+    for (ndInt32 z = 0; z < z1 - z0; ++z) {
+      for (ndInt32 x = 0; x < x1 - x0; ++x) {
+        faceList.PushBack(4);
+        faceMaterial.PushBack(0);
+        indexList.PushBack(base + (z + 0) * stride + x + 0);
+        indexList.PushBack(base + (z + 1) * stride + x + 0);
+        indexList.PushBack(base + (z + 1) * stride + x + 1);
+        indexList.PushBack(base + (z + 0) * stride + x + 1);
+      }
+    }
+  }
+
+  mutable ndAtomic<ndInt32> m_generateCount;
+  ndFloat32 m_height;
+};
+
+static ndTestProceduralGrid* BuildScene(ndWorld& world, ndArray<ndBodyDynamic*>& boxes, ndFloat32 cellSize, ndFloat32 spacing = 1.5f)
+{
+  ndTestProceduralGrid* const grid = new ndTestProceduralGrid();
+  grid->SetFaceCacheCellSize(cellSize);
+  ndShapeInstance floorShape(grid);
+  ndBodyKinematic* const floor = new ndBodyDynamic();
+  floor->SetMatrix(ndGetIdentityMatrix());
+  floor->SetCollisionShape(floorShape);
+  ndSharedPtr<ndBody> floorPtr(floor);
+  world.AddBody(floorPtr);
+
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  for (ndInt32 i = 0; i < 4; ++i) {
+    for (ndInt32 j = 0; j < 4; ++j) {
+      ndMatrix matrix(ndGetIdentityMatrix());
+      matrix.m_posit = ndVector(ndFloat32(i) * spacing + 0.25f, 1.0f, ndFloat32(j) * spacing + 0.25f, 1.0f);
+      ndBodyDynamic* const box = new ndBodyDynamic();
+      box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, -10.0f, 0.0f, 0.0f)));
+      box->SetMatrix(matrix);
+      box->SetCollisionShape(boxShape);
+      box->SetMassMatrix(1.0f, boxShape);
+      ndSharedPtr<ndBody> boxPtr(box);
+      world.AddBody(boxPtr);
+      boxes.PushBack(box);
+    }
+  }
+  return (ndTestProceduralGrid*)floor->GetCollisionShape().GetShape();
+}
+
+/* Boxes resting on a procedural mesh must settle the same way with the face
+   cache on, while the generator runs once per cell instead of once per query. */
+TEST(ProceduralMeshCache, ReuseFacesAcrossSubsteps) {
+  ndInt32 generateCount[2];
+  ndVector positions[2][16];
+  for (ndInt32 pass = 0; pass < 2; ++pass) {
+    ndWorld world;
+    world.SetSubSteps(2);
+    world.SetThreadCount(2);
+
+    ndArray<ndBodyDynamic*> boxes;
+    ndTestProceduralGrid* const grid = BuildScene(world, boxes, pass ? 2.0f : 0.0f);
+    for (ndInt32 i = 0; i < 90; ++i) {
+      world.Update(1.0f / 60.0f);
+      world.Sync();
+    }
+    generateCount[pass] = grid->m_generateCount.load();
+    for (ndInt32 i = 0; i < 16; ++i) {
+      positions[pass][i] = boxes[i]->GetMatrix().m_posit;
+    }
+    if (pass) {
+      EXPECT_GT(grid->GetFaceCacheCellCount(), 0);
+    }
+    world.CleanUp();
+  }
+
+  EXPECT_LT(generateCount[1] * 4, generateCount[0]);
+  for (ndInt32 i = 0; i < 16; ++i) {
+    EXPECT_NEAR(positions[0][i].m_y, 0.5f, 0.05f);
+    EXPECT_NEAR(positions[1][i].m_y, 0.5f, 0.05f);
+    EXPECT_NEAR(positions[1][i].m_x, positions[0][i].m_x, 0.05f);
+    EXPECT_NEAR(positions[1][i].m_z, positions[0][i].m_z, 0.05f);
+  }
+}
+
+/* Cached faces are only regenerated after the cache is invalidated. */
+TEST(ProceduralMeshCache, Invalidate) {
+  ndWorld world;
+  world.SetSubSteps(2);
+
+  ndArray<ndBodyDynamic*> boxes;
+  ndTestProceduralGrid* const grid = BuildScene(world, boxes, 2.0f);
+  for (ndInt32 i = 0; i < ndInt32(boxes.GetCount()); ++i) {
+    // resting boxes must keep querying the mesh
+    boxes[i]->SetAutoSleep(false);
+  }
+  for (ndInt32 i = 0; i < 60; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+
+  // lower the source, the stale cache still holds the boxes
+  grid->m_height = -2.0f;
+  for (ndInt32 i = 0; i < 30; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  EXPECT_NEAR(boxes[0]->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+
+  // invalidate only the cells under the first box
+  const ndInt32 cellCount = grid->GetFaceCacheCellCount();
+  grid->InvalidateFaceCache(ndVector(-1.0f, -5.0f, -1.0f, 0.0f), ndVector(1.0f, 5.0f, 1.0f, 0.0f));
+  EXPECT_LT(grid->GetFaceCacheCellCount(), cellCount);
+  for (ndInt32 i = 0; i < ndInt32(boxes.GetCount()); ++i) {
+    // waking a body at rest drops its cached contacts
+    boxes[i]->SetVelocity(ndVector::m_zero);
+    boxes[i]->SetOmega(ndVector::m_zero);
+    boxes[i]->SetSleepState(false);
+  }
+  for (ndInt32 i = 0; i < 120; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  EXPECT_NEAR(boxes[0]->GetMatrix().m_posit.m_y, -1.5f, 0.05f);
+  EXPECT_NEAR(boxes[15]->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+  world.CleanUp();
+}
+
+/* With several threads sharing the cache every cell is generated once. */
+TEST(ProceduralMeshCache, GenerateOncePerCell) {
+  ndWorld world;
+  world.SetSubSteps(2);
+  world.SetThreadCount(4);
+
+  ndArray<ndBodyDynamic*> boxes;
+  ndTestProceduralGrid* const grid = BuildScene(world, boxes, 2.0f);
+  for (ndInt32 i = 0; i < 30; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+  EXPECT_GT(grid->GetFaceCacheCellCount(), 0);
+  EXPECT_EQ(grid->m_generateCount.load(), grid->GetFaceCacheCellCount());
+  world.CleanUp();
+}
+
+/* The cache never holds more cells than its budget, and the evicted cells are
+   generated again when a query needs them. */
+TEST(ProceduralMeshCache, Budget) {
+  ndWorld world;
+  world.SetSubSteps(2);
+
+  ndArray<ndBodyDynamic*> boxes;
+  // boxes far apart, so that each one touches its own cells
+  ndTestProceduralGrid* const grid = BuildScene(world, boxes, 2.0f, 8.0f);
+  EXPECT_EQ(grid->GetFaceCacheBudget(), D_FACE_CACHE_DEFAULT_BUDGET);
+  grid->SetFaceCacheBudget(8);
+  for (ndInt32 i = 0; i < ndInt32(boxes.GetCount()); ++i) {
+    boxes[i]->SetAutoSleep(false);
+  }
+  for (ndInt32 i = 0; i < 60; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+    EXPECT_LE(grid->GetFaceCacheCellCount(), 8);
+  }
+  EXPECT_GT(grid->m_generateCount.load(), 16);
+  for (ndInt32 i = 0; i < ndInt32(boxes.GetCount()); ++i) {
+    EXPECT_NEAR(boxes[i]->GetMatrix().m_posit.m_y, 0.5f, 0.05f);
+  }
+
+  // shrinking the budget evicts right away
+  grid->SetFaceCacheBudget(4);
+  EXPECT_LE(grid->GetFaceCacheCellCount(), 4);
+  world.CleanUp();
+}
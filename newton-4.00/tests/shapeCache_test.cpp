@@ -0,0 +1,255 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+// the cache files go to the working directory and are removed by the tests
+static void RemoveEntry(ndUnsigned64 key, const char* const extension)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "./%016llx.%s", (long long unsigned)key, extension);
+  remove(path);
+}
+
+static void AddGrid(ndPolygonSoupBuilder& meshBuilder, ndInt32 size)
+{
+  meshBuilder.Begin();
+  for (ndInt32 i = 0; i < size; ++i) {
+    for (ndInt32 j = 0; j < size; ++j) {
+      ndVector p[4];
+      for (ndInt32 k = 0; k < 4; ++k) {
+        const ndInt32 x = i + (k & 1);
+        const ndInt32 z = j + (k >> 1);
+        const ndFloat32 y = ndFloat32(((x * 7 + z * 13) % 5)) * 0.01f;
+        p[k] = ndVector(ndFloat32(x - size / 2), y, ndFloat32(z - size / 2), 0.0f);
+      }
+      ndVector face0[3] = { p[0], p[2], p[1] };
+      ndVector face1[3] = { p[1], p[2], p[3] };
+      meshBuilder.AddFace(&face0[0].m_x, sizeof(ndVector), 3, 0);
+      meshBuilder.AddFace(&face1[0].m_x, sizeof(ndVector), 3, 0);
+    }
+  }
+}
+
+static void BuildBallCloud(ndArray<ndVector>& points, ndInt32 count, ndInt32 seed)
+{
+  ndSetRandSeed(seed);
+  points.SetCount(0);
+  while (ndInt32(points.GetCount()) < count) {
+    const ndVector p(ndRand() * 2.0f - 1.0f, ndRand() * 2.0f - 1.0f, ndRand() * 2.0f - 1.0f, 0.0f);
+    if (p.DotProduct(p).GetScalar() <= 1.0f) {
+      points.PushBack(p);
+    }
+  }
+}
+
+static void ExpectSameConvex(const ndShapeInstance& shape0, const ndShapeInstance& shape1)
+{
+  EXPECT_EQ(shape0.GetConvexVertexCount(), shape1.GetConvexVertexCount());
+  EXPECT_EQ(shape0.GetVolume(), shape1.GetVolume());
+  for (ndInt32 i = 0; i < 64; ++i) {
+    const ndVector dir(ndVector(ndRand() - 0.5f, ndRand() - 0.5f, ndRand() - 0.5f, 0.0f).Normalize());
+    const ndVector p0(shape0.SupportVertex(dir));
+    const ndVector p1(shape1.SupportVertex(dir));
+    EXPECT_EQ(p0.m_x, p1.m_x);
+    EXPECT_EQ(p0.m_y, p1.m_y);
+    EXPECT_EQ(p0.m_z, p1.m_z);
+  }
+}
+
+/* A static mesh is built once, then read from the cache without ending the builder. */
+TEST(ShapeCache, StaticMeshHit) {
+  ndShapeCache cache(".");
+  ndPolygonSoupBuilder meshBuilder;
+  AddGrid(meshBuilder, 64);
+  const ndUnsigned64 key = ndShapeCache::CalculateKey(meshBuilder, false);
+  EXPECT_NE(key, ndShapeCache::CalculateKey(meshBuilder, true));
+  RemoveEntry(key, "bvh");
+
+  ndShapeInstance built(cache.CreateStaticMesh(meshBuilder, false));
+  EXPECT_EQ(cache.GetMissCount(), 1);
+
+  // a hit does not end the builder, the faces are still the raw input
+  ndPolygonSoupBuilder hitBuilder;
+  AddGrid(hitBuilder, 64);
+  const ndInt32 rawVertexCount = ndInt32(hitBuilder.m_vertexPoints.GetCount());
+  ndShapeInstance loaded(cache.CreateStaticMesh(hitBuilder, false));
+  EXPECT_EQ(ndInt32(hitBuilder.m_vertexPoints.GetCount()), rawVertexCount);
+
+  EXPECT_EQ(cache.GetMissCount(), 1);
+  EXPECT_EQ(cache.GetHitCount(), 1);
+  ndShapeStatic_bvh* const mesh0 = built.GetShape()->GetAsShapeStaticBVH();
+  ndShapeStatic_bvh* const mesh1 = loaded.GetShape()->GetAsShapeStaticBVH();
+  ASSERT_TRUE(mesh1->GetRootNode() != nullptr);
+  EXPECT_NE(mesh0, mesh1);
+  EXPECT_EQ(mesh0->GetVertexCount(), mesh1->GetVertexCount());
+
+  ndVector p0;
+  ndVector p1;
+  ndVector q0;
+  ndVector q1;
+  built.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  loaded.CalculateAabb(ndGetIdentityMatrix(), q0, q1);
+  EXPECT_EQ(p0.m_x, q0.m_x);
+  EXPECT_EQ(p1.m_y, q1.m_y);
+
+  // a different mesh has a different key
+  ndPolygonSoupBuilder otherBuilder;
+  AddGrid(otherBuilder, 63);
+  EXPECT_NE(key, ndShapeCache::CalculateKey(otherBuilder, false));
+
+  // and so does a mesh with the same counts and one vertex moved
+  ndPolygonSoupBuilder movedBuilder;
+  AddGrid(movedBuilder, 64);
+  movedBuilder.m_vertexPoints[0].m_y += 0.5f;
+  EXPECT_NE(key, ndShapeCache::CalculateKey(movedBuilder, false));
+  RemoveEntry(key, "bvh");
+}
+
+/* A truncated static mesh entry is a miss, it is rebuilt and written again. */
+TEST(ShapeCache, DamagedStaticMesh) {
+  ndShapeCache cache(".");
+  ndPolygonSoupBuilder meshBuilder;
+  AddGrid(meshBuilder, 32);
+  const ndUnsigned64 key = ndShapeCache::CalculateKey(meshBuilder, false);
+  RemoveEntry(key, "bvh");
+  ndShapeInstance built(cache.CreateStaticMesh(meshBuilder, false));
+
+  char path[256];
+  snprintf(path, sizeof(path), "./%016llx.bvh", (long long unsigned)key);
+  ndArray<char> data;
+  FILE* file = fopen(path, "rb");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, 0, SEEK_END);
+  data.SetCount(ndInt32(ftell(file)));
+  fseek(file, 0, SEEK_SET);
+  EXPECT_EQ(fread(&data[0], size_t(data.GetCount()), 1, file), size_t(1));
+  fclose(file);
+  file = fopen(path, "wb");
+  ASSERT_TRUE(file != nullptr);
+  fwrite(&data[0], size_t(data.GetCount() / 2), 1, file);
+  fclose(file);
+
+  ndPolygonSoupBuilder rebuildBuilder;
+  AddGrid(rebuildBuilder, 32);
+  ndShapeInstance rebuilt(cache.CreateStaticMesh(rebuildBuilder, false));
+  EXPECT_EQ(cache.GetMissCount(), 2);
+  EXPECT_EQ(cache.GetHitCount(), 0);
+  EXPECT_TRUE(rebuilt.GetShape()->GetAsShapeStaticBVH()->GetRootNode() != nullptr);
+
+  ndPolygonSoupBuilder hitBuilder;
+  AddGrid(hitBuilder, 32);
+  ndShapeInstance reloaded(cache.CreateStaticMesh(hitBuilder, false));
+  EXPECT_EQ(cache.GetHitCount(), 1);
+  EXPECT_EQ(built.GetShape()->GetAsShapeStaticBVH()->GetVertexCount(), reloaded.GetShape()->GetAsShapeStaticBVH()->GetVertexCount());
+  RemoveEntry(key, "bvh");
+}
+
+/* A cooked hull loads with the same vertex, support tree and mass properties. */
+TEST(ShapeCache, ConvexHullHit) {
+  ndShapeCache cache(".");
+  ndArray<ndVector> points;
+  BuildBallCloud(points, 2000, 7);
+  const ndUnsigned64 key = ndShapeCache::CalculateKey(ndInt32(points.GetCount()), sizeof(ndVector), 1.0e-3f, &points[0].m_x, 0x7fffffff);
+  RemoveEntry(key, "hull");
+
+  ndShapeInstance built(cache.CreateConvexHull(ndInt32(points.GetCount()), sizeof(ndVector), 1.0e-3f, &points[0].m_x));
+  ndShapeInstance loaded(cache.CreateConvexHull(ndInt32(points.GetCount()), sizeof(ndVector), 1.0e-3f, &points[0].m_x));
+
+  EXPECT_EQ(cache.GetMissCount(), 1);
+  EXPECT_EQ(cache.GetHitCount(), 1);
+  EXPECT_NE(built.GetShape(), loaded.GetShape());
+  ExpectSameConvex(built, loaded);
+
+  // a damaged entry is rebuilt and written again
+  char path[256];
+  snprintf(path, sizeof(path), "./%016llx.hull", (long long unsigned)key);
+  FILE* const file = fopen(path, "r+b");
+  ASSERT_TRUE(file != nullptr);
+  fseek(file, 0, SEEK_END);
+  const long size = ftell(file);
+  fseek(file, size / 2, SEEK_SET);
+  const ndInt32 garbage[] = { -1000, 1 << 20, -1000, 1 << 20 };
+  fwrite(garbage, sizeof(garbage), 1, file);
+  fclose(file);
+
+  ndShapeInstance rebuilt(cache.CreateConvexHull(ndInt32(points.GetCount()), sizeof(ndVector), 1.0e-3f, &points[0].m_x));
+  ndShapeInstance reloaded(cache.CreateConvexHull(ndInt32(points.GetCount()), sizeof(ndVector), 1.0e-3f, &points[0].m_x));
+  ExpectSameConvex(built, rebuilt);
+  ExpectSameConvex(built, reloaded);
+  EXPECT_EQ(cache.GetHitCount(), 2);
+  RemoveEntry(key, "hull");
+}
+
+/* A compound of hulls loads with the same children and tree. */
+TEST(ShapeCache, CompoundHit) {
+  ndShapeCache cache(".");
+  const ndUnsigned64 key = ndCRC64("shapeCacheTestCompound");
+  RemoveEntry(key, "compound");
+  ndShapeInstance* const missing = cache.LoadCompound(key);
+  EXPECT_TRUE(missing == nullptr);
+
+  ndShapeInstance compoundInstance(new ndShapeCompound());
+  ndShapeCompound* const compound = compoundInstance.GetShape()->GetAsShapeCompound();
+  compound->BeginAddRemove();
+  for (ndInt32 i = 0; i < 24; ++i) {
+    ndArray<ndVector> points;
+    BuildBallCloud(points, 40, i + 1);
+    ndShapeInstance child(new ndShapeConvexHull(ndInt32(points.GetCount()), sizeof(ndVector), 0.0f, &points[0].m_x));
+    ndMatrix localMatrix(ndPitchMatrix(ndFloat32(i) * 0.3f));
+    localMatrix.m_posit = ndVector(ndFloat32(i % 4) * 2.5f, ndFloat32(i / 8) * 2.5f, ndFloat32((i / 4) % 2) * 2.5f, 1.0f);
+    child.SetLocalMatrix(localMatrix);
+    if (i & 1) {
+      child.SetScale(ndVector(1.0f, 0.5f, 2.0f, 0.0f));
+    }
+    compound->AddCollision(&child);
+  }
+  compound->EndAddRemove();
+  EXPECT_TRUE(cache.SaveCompound(key, compoundInstance));
+
+  ndShapeInstance* const loaded = cache.LoadCompound(key);
+  ASSERT_TRUE(loaded != nullptr);
+  ndShapeCompound* const loadedCompound = loaded->GetShape()->GetAsShapeCompound();
+  ASSERT_TRUE(loadedCompound != nullptr);
+  EXPECT_EQ(compound->GetTree().GetCount(), loadedCompound->GetTree().GetCount());
+  EXPECT_EQ(compound->GetHash(0), loadedCompound->GetHash(0));
+  EXPECT_NEAR(compoundInstance.GetVolume(), loaded->GetVolume(), 1.0e-4f);
+
+  ndVector p0;
+  ndVector p1;
+  ndVector q0;
+  ndVector q1;
+  compoundInstance.CalculateAabb(ndGetIdentityMatrix(), p0, p1);
+  loaded->CalculateAabb(ndGetIdentityMatrix(), q0, q1);
+  EXPECT_NEAR(p0.m_x, q0.m_x, 1.0e-5f);
+  EXPECT_NEAR(p0.m_y, q0.m_y, 1.0e-5f);
+  EXPECT_NEAR(p1.m_z, q1.m_z, 1.0e-5f);
+
+  // the children keep their keys
+  ndShapeCompound::ndTreeArray::Iterator iter0(compound->GetTree());
+  ndShapeCompound::ndTreeArray::Iterator iter1(loadedCompound->GetTree());
+  for (iter0.Begin(), iter1.Begin(); iter0 && iter1; iter0++, iter1++) {
+    EXPECT_EQ(iter0.GetNode()->GetKey(), iter1.GetNode()->GetKey());
+    ExpectSameConvex(*iter0.GetNode()->GetInfo()->GetShape(), *iter1.GetNode()->GetInfo()->GetShape());
+  }
+  delete loaded;
+
+  // compounds with other children are not stored
+  ndShapeInstance boxCompound(new ndShapeCompound());
+  boxCompound.GetShape()->GetAsShapeCompound()->BeginAddRemove();
+  ndShapeInstance box(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  boxCompound.GetShape()->GetAsShapeCompound()->AddCollision(&box);
+  boxCompound.GetShape()->GetAsShapeCompound()->EndAddRemove();
+  EXPECT_FALSE(cache.SaveCompound(key + 1, boxCompound));
+  RemoveEntry(key, "compound");
+}
@@ -0,0 +1,230 @@
+/* Copyright (c) <2003-2019> <Newton Game Dynamics>
+*
+* This software is provided 'as-is', without any express or implied
+* warranty. In no event will the authors be held liable for any damages
+* arising from the use of this software.
+*
+* Permission is granted to anyone to use this software for any purpose,
+* including commercial applications, and to alter it and redistribute it
+* freely
+*/
+
+#include "ndNewton.h"
+#include <gtest/gtest.h>
+
+static ndBodySphFluid* AddFluid(ndWorld& world, ndFloat32 radius)
+{
+  ndBodySphFluid* const fluid = new ndBodySphFluid();
+  fluid->SetParticleRadius(radius);
+  fluid->SetAsynUpdate(false);
+  ndSharedPtr<ndBody> fluidPtr(fluid);
+  world.AddBody(fluidPtr);
+  return fluid;
+}
+
+static void Simulate(ndWorld& world, ndInt32 frames)
+{
+  for (ndInt32 i = 0; i < frames; ++i) {
+    world.Update(1.0f / 60.0f);
+    world.Sync();
+  }
+}
+
+static ndVector PairSeparation(const ndVector& veloc)
+{
+  ndWorld world;
+  ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+
+  // the pair straddles a cell border
+  fluid->GetPositions().PushBack(ndVector(-0.1f, 2.0f, 0.2f, 1.0f));
+  fluid->GetPositions().PushBack(ndVector(0.1f, 2.0f, 0.2f, 1.0f));
+  fluid->GetVelocity().PushBack(veloc);
+  fluid->GetVelocity().PushBack(veloc);
+  Simulate(world, 60);
+
+  const ndVector separation(fluid->GetPositions()[1] - fluid->GetPositions()[0]);
+  world.CleanUp();
+  return separation;
+}
+
+/* Particles closer than a diameter push each other apart, and the result does 
+   not change when the pair drifts across many cells. */
+TEST(SphFluid, NeighborPairs) {
+  const ndVector rest(PairSeparation(ndVector::m_zero));
+  const ndVector moving(PairSeparation(ndVector(8.0f, 0.0f, 6.0f, 0.0f)));
+
+  EXPECT_GT(rest.m_x, 0.25f);
+  EXPECT_NEAR(rest.m_y, 0.0f, 1.0e-5f);
+  EXPECT_NEAR(rest.m_z, 0.0f, 1.0e-5f);
+  EXPECT_NEAR(moving.m_x, rest.m_x, 1.0e-3f);
+  EXPECT_NEAR(moving.m_z, rest.m_z, 1.0e-3f);
+}
+
+/* Particles further apart than a diameter do not interact. */
+TEST(SphFluid, IsolatedParticles) {
+  ndWorld world;
+  ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+  for (ndInt32 i = 0; i < 8; ++i) {
+    for (ndInt32 j = 0; j < 8; ++j) {
+      fluid->GetPositions().PushBack(ndVector(ndFloat32(i) * 0.6f, 2.0f, ndFloat32(j) * 0.6f, 1.0f));
+      fluid->GetVelocity().PushBack(ndVector::m_zero);
+    }
+  }
+  Simulate(world, 10);
+
+  for (ndInt32 i = 0; i < 8; ++i) {
+    for (ndInt32 j = 0; j < 8; ++j) {
+      const ndVector& p = fluid->GetPositions()[i * 8 + j];
+      EXPECT_FLOAT_EQ(p.m_x, ndFloat32(i) * 0.6f);
+      EXPECT_FLOAT_EQ(p.m_z, ndFloat32(j) * 0.6f);
+    }
+  }
+  world.CleanUp();
+}
+
+/* A compressed block of fluid expands and stays finite. */
+TEST(SphFluid, BlockExpansion) {
+  ndWorld world;
+  ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+  const ndInt32 size_x = 32;
+  const ndInt32 size_y = 16;
+  const ndInt32 size_z = 32;
+  for (ndInt32 y = 0; y < size_y; ++y) {
+    for (ndInt32 z = 0; z < size_z; ++z) {
+      for (ndInt32 x = 0; x < size_x; ++x) {
+        fluid->GetPositions().PushBack(ndVector(ndFloat32(x) * 0.4f, 1.0f + ndFloat32(y) * 0.4f, ndFloat32(z) * 0.4f, 1.0f));
+        fluid->GetVelocity().PushBack(ndVector::m_zero);
+      }
+    }
+  }
+
+  const ndInt32 count = ndInt32(fluid->GetPositions().GetCount());
+  Simulate(world, 30);
+
+  ndVector minBox(ndFloat32(1.0e10f));
+  ndVector maxBox(ndFloat32(-1.0e10f));
+  const ndArray<ndVector>& posit = fluid->GetPositions();
+  for (ndInt32 i = 0; i < count; ++i) {
+    ASSERT_TRUE(ndCheckVector(posit[i]));
+    EXPECT_GE(posit[i].m_y, 1.0f);
+    minBox = minBox.GetMin(posit[i]);
+    maxBox = maxBox.GetMax(posit[i]);
+  }
+  EXPECT_GT(maxBox.m_x - minBox.m_x, ndFloat32(size_x - 1) * 0.4f);
+  EXPECT_GT(maxBox.m_z - minBox.m_z, ndFloat32(size_z - 1) * 0.4f);
+  world.CleanUp();
+}
+
+static ndBodyDynamic* AddBox(ndWorld& world, const ndVector& posit, ndFloat32 gravity)
+{
+  ndShapeInstance boxShape(new ndShapeBox(1.0f, 1.0f, 1.0f));
+  ndMatrix matrix(ndGetIdentityMatrix());
+  matrix.m_posit = posit;
+  ndBodyDynamic* const box = new ndBodyDynamic();
+  box->SetNotifyCallback(new ndBodyNotify(ndVector(0.0f, gravity, 0.0f, 0.0f)));
+  box->SetMatrix(matrix);
+  box->SetCollisionShape(boxShape);
+  box->SetMassMatrix(1.0f, boxShape);
+  ndSharedPtr<ndBody> boxPtr(box);
+  world.AddBody(boxPtr);
+  return box;
+}
+
+/* A box falling on a bed of particles is held by them only when 
+   body coupling is enabled. */
+TEST(SphFluid, BodyCouplingSupport) {
+  ndFloat32 height[2];
+  for (ndInt32 pass = 0; pass < 2; ++pass) {
+    ndWorld world;
+    world.SetSubSteps(2);
+    world.SetThreadCount(2);
+    ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+    fluid->SetBodyCoupling(pass ? true : false);
+    for (ndInt32 i = 0; i < 20; ++i) {
+      for (ndInt32 j = 0; j < 20; ++j) {
+        fluid->GetPositions().PushBack(ndVector(ndFloat32(i) * 0.45f - 4.5f, 1.0f, ndFloat32(j) * 0.45f - 4.5f, 1.0f));
+        fluid->GetVelocity().PushBack(ndVector::m_zero);
+      }
+    }
+    ndBodyDynamic* const box = AddBox(world, ndVector(0.0f, 3.0f, 0.0f, 1.0f), -10.0f);
+    Simulate(world, 120);
+    height[pass] = box->GetMatrix().m_posit.m_y;
+    world.CleanUp();
+  }
+  EXPECT_LT(height[0], -10.0f);
+  EXPECT_GT(height[1], 1.2f);
+  EXPECT_LT(height[1], 2.0f);
+}
+
+/* A stream of particles hitting a floating box pushes it, and the 
+   particles lose the momentum they hand over. */
+TEST(SphFluid, BodyCouplingMomentum) {
+  ndWorld world;
+  world.SetSubSteps(2);
+  ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+  fluid->SetBodyCoupling(true);
+  for (ndInt32 i = 0; i < 3; ++i) {
+    for (ndInt32 j = 0; j < 3; ++j) {
+      for (ndInt32 k = 0; k < 3; ++k) {
+        fluid->GetPositions().PushBack(ndVector(-0.4f - ndFloat32(i) * 0.55f, 4.45f + ndFloat32(j) * 0.55f, -0.55f + ndFloat32(k) * 0.55f, 1.0f));
+        fluid->GetVelocity().PushBack(ndVector(2.0f, 0.0f, 0.0f, 0.0f));
+      }
+    }
+  }
+  ndBodyDynamic* const box = AddBox(world, ndVector(0.5f, 5.0f, 0.0f, 1.0f), 0.0f);
+  Simulate(world, 120);
+
+  ndFloat32 particleSpeed = 0.0f;
+  const ndArray<ndVector>& veloc = fluid->GetVelocity();
+  for (ndInt32 i = 0; i < ndInt32(veloc.GetCount()); ++i) {
+    particleSpeed += veloc[i].m_x;
+  }
+  particleSpeed /= ndFloat32(veloc.GetCount());
+  EXPECT_GT(box->GetVelocity().m_x, 0.1f);
+  EXPECT_LT(particleSpeed, 2.0f);
+  world.CleanUp();
+}
+
+/* The particles and the body get equal and opposite impulses, the change of the 
+   total momentum is the impulse of the external force on the body. */
+TEST(SphFluid, BodyCouplingMomentumExchange) {
+  ndWorld world;
+  world.SetSubSteps(2);
+  ndBodySphFluid* const fluid = AddFluid(world, 0.25f);
+  fluid->SetBodyCoupling(true);
+  // a sheet of particles further apart than a diameter, so that only the box pushes them
+  for (ndInt32 i = 0; i < 5; ++i) {
+    for (ndInt32 j = 0; j < 5; ++j) {
+      fluid->GetPositions().PushBack(ndVector(-0.3f, 4.0f + ndFloat32(i) * 0.6f, -1.2f + ndFloat32(j) * 0.6f, 1.0f));
+      fluid->GetVelocity().PushBack(ndVector(1.0f, 0.0f, 0.0f, 0.0f));
+    }
+  }
+  // the box is pushed toward the particles by a constant external force
+  const ndFloat32 externalAccel = -2.0f;
+  ndBodyDynamic* const box = AddBox(world, ndVector(0.5f, 5.2f, 0.0f, 1.0f), 0.0f);
+  box->SetNotifyCallback(new ndBodyNotify(ndVector(externalAccel, 0.0f, 0.0f, 0.0f)));
+  box->SetVelocity(ndVector(-1.0f, 0.0f, 0.0f, 0.0f));
+
+  const ndFloat32 particleMass = fluid->GetParticleMass();
+  const ndArray<ndVector>& veloc = fluid->GetVelocity();
+  auto Momentum = [&]() {
+    ndVector momentum(box->GetVelocity().Scale(box->GetMassMatrix().m_w));
+    for (ndInt32 i = 0; i < ndInt32(veloc.GetCount()); ++i) {
+      momentum += veloc[i].Scale(particleMass);
+    }
+    return momentum;
+  };
+
+  const ndVector momentum0(Momentum());
+  const ndInt32 frames = 20;
+  Simulate(world, frames);
+  const ndVector momentum1(Momentum());
+
+  // the particles pushed the box back against the external force
+  const ndFloat32 externalImpulse = box->GetMassMatrix().m_w * externalAccel * ndFloat32(frames) / 60.0f;
+  EXPECT_GT(box->GetVelocity().m_x, 0.0f);
+  EXPECT_NEAR(momentum1.m_x - momentum0.m_x, externalImpulse, 1.0e-3f);
+  EXPECT_NEAR(momentum1.m_y - momentum0.m_y, 0.0f, 1.0e-3f);
+  EXPECT_NEAR(momentum1.m_z - momentum0.m_z, 0.0f, 1.0e-3f);
+  world.CleanUp();
+}
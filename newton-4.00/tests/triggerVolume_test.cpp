@@ -117,3 +117,84 @@ TEST(DynamicsTrigger, TriggerCollision)
 	world->CleanUp();
 	delete world;
 }
+
+class csBatchTrigger : public ndBodyTriggerVolume
+{
+	public:
+	csBatchTrigger()
+		:ndBodyTriggerVolume()
+		,m_enterCount(0)
+		,m_stayCount(0)
+		,m_exitCount(0)
+		,m_batchCount(0)
+	{
+	}
+
+	virtual void OnTriggerEvents(ndFloat32)
+	{
+		m_batchCount++;
+		m_enterCount += ndInt32(GetEnterEvents().GetCount());
+		m_stayCount += ndInt32(GetStayEvents().GetCount());
+		m_exitCount += ndInt32(GetExitEvents().GetCount());
+	}
+
+	ndInt32 m_enterCount;
+	ndInt32 m_stayCount;
+	ndInt32 m_exitCount;
+	ndInt32 m_batchCount;
+};
+
+// bodies falling through a trigger zone report one enter and one exit each,
+// delivered once per step for all the bodies.
+TEST(BatchTrigger, EnterStayExitEvents)
+{
+	ndWorld world;
+	world.SetThreadCount(2);
+
+	csBatchTrigger* const trigger = new csBatchTrigger();
+	ndShapeInstance zoneShape(new ndShapeBox(ndFloat32(20.0f), ndFloat32(2.0f), ndFloat32(20.0f)));
+	trigger->SetCollisionShape(zoneShape);
+	trigger->SetMatrix(ndGetIdentityMatrix());
+	ndSharedPtr<ndBody> triggerPtr(trigger);
+	world.AddBody(triggerPtr);
+
+	const ndInt32 fallingCount = 16;
+	ndShapeInstance sphereShape(new ndShapeSphere(ndFloat32(0.25f)));
+	for (ndInt32 i = 0; i < fallingCount; ++i)
+	{
+		ndMatrix matrix(ndGetIdentityMatrix());
+		matrix.m_posit = ndVector(ndFloat32(i - fallingCount / 2), ndFloat32(3.0f), ndFloat32(0.0f), ndFloat32(1.0f));
+		ndBodyDynamic* const body = new ndBodyDynamic();
+		body->SetNotifyCallback(new ndBodyNotify(ndVector(ndFloat32(0.0f), ndFloat32(-10.0f), ndFloat32(0.0f), ndFloat32(0.0f))));
+		body->SetCollisionShape(sphereShape);
+		body->SetMatrix(matrix);
+		body->SetMassMatrix(ndFloat32(1.0f), sphereShape);
+		ndSharedPtr<ndBody> bodyPtr(body);
+		world.AddBody(bodyPtr);
+	}
+
+	// a body resting just outside the zone never enters
+	ndMatrix matrix(ndGetIdentityMatrix());
+	matrix.m_posit = ndVector(ndFloat32(0.0f), ndFloat32(1.35f), ndFloat32(5.0f), ndFloat32(1.0f));
+	ndBodyDynamic* const outside = new ndBodyDynamic();
+	outside->SetNotifyCallback(new ndBodyNotify(ndVector(ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f), ndFloat32(0.0f))));
+	outside->SetCollisionShape(sphereShape);
+	outside->SetMatrix(matrix);
+	outside->SetMassMatrix(ndFloat32(1.0f), sphereShape);
+	ndSharedPtr<ndBody> outsidePtr(outside);
+	world.AddBody(outsidePtr);
+
+	ndInt32 steps = 0;
+	for (ndInt32 i = 0; i < 120; ++i)
+	{
+		world.Update(1.0f / 60.0f);
+		world.Sync();
+		steps++;
+	}
+
+	EXPECT_EQ(trigger->m_enterCount, fallingCount);
+	EXPECT_EQ(trigger->m_exitCount, fallingCount);
+	EXPECT_GT(trigger->m_stayCount, fallingCount);
+	EXPECT_LE(trigger->m_batchCount, steps * 2);
+	world.CleanUp();
+}